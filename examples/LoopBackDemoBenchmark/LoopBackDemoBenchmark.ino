@@ -0,0 +1,302 @@
+//----------------------------------------------------------------------------------------
+// This demo runs on NUCLEO_L432KC, NUCLEO_F303K8 and NUCLEO_F103RB
+// The CAN module is configured in internal loop back mode: it
+// internally receives every CAN frame it sends, nothing is emitted on TxCAN pin.
+
+// This sketch measures the cost of the driver routines, using the DWT cycle counter:
+//   - tryToSendReturnStatus, receive0, dispatchReceivedMessage (per call);
+//   - message_isr_rx0 and message_isr_tx (per call), the matching NVIC interrupt
+//     being disabled during the measure, so the routine is invoked from the sketch;
+//   - loop back throughput (frames per second).
+// Every measure is given in CPU cycles: min / average / max.
+// For comparing with the interrupt fast path in RAM, add a build_opt.h file
+// containing -DACAN_STM32_RAM_ISR to the sketch folder.
+
+// No external hardware is required.
+//----------------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+
+//----------------------------------------------------------------------------------------
+
+#ifdef STM32F303x8
+  static const IRQn_Type RX0_IRQn = CAN_RX0_IRQn ;
+  static const IRQn_Type TX_IRQn  = CAN_TX_IRQn ;
+#else
+  static const IRQn_Type RX0_IRQn = CAN1_RX0_IRQn ;
+  static const IRQn_Type TX_IRQn  = CAN1_TX_IRQn ;
+#endif
+
+//----------------------------------------------------------------------------------------
+//   CYCLE COUNTER
+//----------------------------------------------------------------------------------------
+
+static void enableCycleCounter (void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk ;
+  DWT->CYCCNT = 0 ;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static inline uint32_t cycles (void) {
+  return DWT->CYCCNT ;
+}
+
+//----------------------------------------------------------------------------------------
+//   STATISTICS
+//----------------------------------------------------------------------------------------
+
+class Measure {
+  public: Measure (const char * inTitle) : mTitle (inTitle) { }
+
+  public: void add (const uint32_t inCycles) {
+    mCount += 1 ;
+    mTotal += inCycles ;
+    if (mMin > inCycles) {
+      mMin = inCycles ;
+    }
+    if (mMax < inCycles) {
+      mMax = inCycles ;
+    }
+  }
+
+  public: void print (void) const {
+    Serial.print (mTitle) ;
+    Serial.print (": ") ;
+    if (mCount == 0) {
+      Serial.println ("no measure") ;
+    }else{
+      Serial.print (mMin) ;
+      Serial.print (" / ") ;
+      Serial.print (uint32_t (mTotal / mCount)) ;
+      Serial.print (" / ") ;
+      Serial.print (mMax) ;
+      Serial.print (" cycles (") ;
+      Serial.print (mCount) ;
+      Serial.println (" calls)") ;
+    }
+  }
+
+  private: const char * mTitle ;
+  private: uint32_t mCount = 0 ;
+  private: uint64_t mTotal = 0 ;
+  private: uint32_t mMin = UINT32_MAX ;
+  private: uint32_t mMax = 0 ;
+} ;
+
+//----------------------------------------------------------------------------------------
+//   DISPATCH CALL BACK
+//----------------------------------------------------------------------------------------
+
+static uint32_t gDispatchedCount = 0 ;
+
+//----------------------------------------------------------------------------------------
+
+static void callBack (const CANMessage & /* inMessage */) {
+  gDispatchedCount += 1 ;
+}
+
+//----------------------------------------------------------------------------------------
+//   BENCHMARKS
+//----------------------------------------------------------------------------------------
+
+static const uint32_t SAMPLE_COUNT = 1000 ;
+static const uint32_t RECEIVE_FIFO_SIZE = 64 ;
+
+//----------------------------------------------------------------------------------------
+
+static void waitUntilReceiveFIFOCount (const uint32_t inCount) {
+  const uint32_t deadline = millis () + 100 ;
+  while ((can.driverReceiveFIFO0Count () < inCount) && (millis () < deadline)) {}
+}
+
+//----------------------------------------------------------------------------------------
+
+static void drainReceiveFIFO (void) {
+  CANMessage message ;
+  while (can.receive0 (message)) {}
+}
+
+//----------------------------------------------------------------------------------------
+
+static void benchmarkSendAndReceive (void) {
+  Measure sendMeasure ("tryToSendReturnStatus") ;
+  Measure receiveMeasure ("receive0") ;
+  Measure dispatchMeasure ("dispatchReceivedMessage") ;
+  CANMessage message ;
+  message.id = 0x123 ;
+  message.len = 8 ;
+  uint32_t remaining = SAMPLE_COUNT ;
+  while (remaining > 0) {
+  //--- Send a burst that fits in driver transmit FIFO
+    const uint32_t burst = min (remaining, can.driverTransmitFIFOSize ()) ;
+    for (uint32_t i = 0 ; i < burst ; i++) {
+      const uint32_t start = cycles () ;
+      const uint32_t status = can.tryToSendReturnStatus (message) ;
+      const uint32_t duration = cycles () - start ;
+      if (status == 0) {
+        sendMeasure.add (duration) ;
+      }
+    }
+  //--- Receive half of the burst with receive0, dispatch the other half
+    waitUntilReceiveFIFOCount (burst) ;
+    for (uint32_t i = 0 ; i < burst ; i++) {
+      const uint32_t start = cycles () ;
+      bool ok ;
+      if ((i & 1) == 0) {
+        ok = can.receive0 (message) ;
+      }else{
+        ok = can.dispatchReceivedMessage () ;
+      }
+      const uint32_t duration = cycles () - start ;
+      if (ok) {
+        if ((i & 1) == 0) {
+          receiveMeasure.add (duration) ;
+        }else{
+          dispatchMeasure.add (duration) ;
+        }
+      }
+    }
+    remaining -= burst ;
+  }
+  sendMeasure.print () ;
+  receiveMeasure.print () ;
+  dispatchMeasure.print () ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static void benchmarkReceiveISR (void) {
+  Measure measure ("message_isr_rx0") ;
+  CANMessage message ;
+  message.id = 0x456 ;
+  message.len = 8 ;
+  for (uint32_t i = 0 ; i < SAMPLE_COUNT ; i++) {
+    NVIC_DisableIRQ (RX0_IRQn) ;
+    can.tryToSendReturnStatus (message) ;
+    const uint32_t deadline = millis () + 10 ;
+    while (((CAN1->RF0R & CAN_RF0R_FMP0) == 0) && (millis () < deadline)) {}
+    const uint32_t start = cycles () ;
+    can.message_isr_rx0 () ;
+    const uint32_t duration = cycles () - start ;
+    NVIC_ClearPendingIRQ (RX0_IRQn) ;
+    NVIC_EnableIRQ (RX0_IRQn) ;
+    measure.add (duration) ;
+    drainReceiveFIFO () ;
+  }
+  measure.print () ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static void benchmarkTransmitISR (void) {
+  Measure measure ("message_isr_tx") ;
+  CANMessage message ;
+  message.id = 0x789 ;
+  message.len = 8 ;
+  for (uint32_t i = 0 ; i < SAMPLE_COUNT ; i++) {
+    NVIC_DisableIRQ (TX_IRQn) ;
+  //--- First frame goes into mailbox 0, second one in driver transmit FIFO
+    can.tryToSendReturnStatus (message) ;
+    can.tryToSendReturnStatus (message) ;
+    const uint32_t deadline = millis () + 10 ;
+    while (((CAN1->TSR & CAN_TSR_TME0) == 0) && (millis () < deadline)) {}
+  //--- The ISR loads the second frame into the mailbox
+    const uint32_t start = cycles () ;
+    can.message_isr_tx () ;
+    const uint32_t duration = cycles () - start ;
+    NVIC_ClearPendingIRQ (TX_IRQn) ;
+    NVIC_EnableIRQ (TX_IRQn) ;
+    measure.add (duration) ;
+    waitUntilReceiveFIFOCount (2) ;
+    drainReceiveFIFO () ;
+  }
+  measure.print () ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static void benchmarkThroughput (void) {
+  CANMessage message ;
+  message.id = 0x542 ;
+  message.len = 8 ;
+  uint32_t sentCount = 0 ;
+  uint32_t receivedCount = 0 ;
+  const uint32_t start = millis () ;
+  while ((millis () - start) < 1000) {
+    if (can.tryToSendReturnStatus (message) == 0) {
+      sentCount += 1 ;
+    }
+    while (can.receive0 (message)) {
+      receivedCount += 1 ;
+    }
+  }
+  Serial.print ("Throughput: ") ;
+  Serial.print (sentCount) ;
+  Serial.print (" frames sent, ") ;
+  Serial.print (receivedCount) ;
+  Serial.println (" frames received per second") ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void setup () {
+  pinMode (LED_BUILTIN, OUTPUT) ;
+  Serial.begin (115200) ;
+  while (!Serial) {
+    delay (50) ;
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+  }
+  Serial.println ("CAN loopback benchmark") ;
+  enableCycleCounter () ;
+
+  ACAN_STM32_Settings settings (1000 * 1000) ;
+  settings.mModuleMode = ACAN_STM32_Settings::INTERNAL_LOOP_BACK ;
+  settings.mDriverReceiveFIFO0Size = RECEIVE_FIFO_SIZE ;
+
+  ACAN_STM32::Filters filters ;
+  filters.addExtendedMask (0, 0, ACAN_STM32::DATA_OR_REMOTE, callBack, ACAN_STM32::FIFO0) ;
+  filters.addStandardMasks (0, 0, ACAN_STM32::DATA_OR_REMOTE, callBack,
+                            0, 0, ACAN_STM32::DATA_OR_REMOTE, callBack,
+                            ACAN_STM32::FIFO0) ;
+
+  const uint32_t errorCode = can.begin (settings, filters) ;
+  if (0 == errorCode) {
+    Serial.println ("can configuration ok") ;
+  }else{
+    Serial.print ("Error can configuration: 0x") ;
+    Serial.println (errorCode, HEX) ;
+  }
+  Serial.print ("CPU clock: ") ;
+  Serial.print (SystemCoreClock) ;
+  Serial.println (" Hz") ;
+  #ifdef ACAN_STM32_RAM_ISR
+    Serial.println ("Interrupt fast path in RAM") ;
+  #else
+    Serial.println ("Interrupt fast path in flash") ;
+  #endif
+}
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t PERIOD = 5000 ;
+static uint32_t gBenchmarkDate = 0 ;
+
+//----------------------------------------------------------------------------------------
+
+void loop () {
+  if (gBenchmarkDate <= millis ()) {
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+    Serial.println ("--------------------------------") ;
+    benchmarkSendAndReceive () ;
+    benchmarkReceiveISR () ;
+    benchmarkTransmitISR () ;
+    benchmarkThroughput () ;
+    Serial.print ("Dispatched: ") ;
+    Serial.println (gDispatchedCount) ;
+    gBenchmarkDate = millis () + PERIOD ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
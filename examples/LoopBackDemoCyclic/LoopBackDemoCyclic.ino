@@ -0,0 +1,93 @@
+//----------------------------------------------------------------------------------------
+// This demo runs on NUCLEO_L432KC, NUCLEO_F303K8 and NUCLEO_F103RB
+// The CAN module is configured in internal loop back mode: it
+// internally receives every CAN frame it sends, nothing is emitted on TxCAN pin.
+
+// Periodic frames are sent by a cyclic scheduler: 4 frames every 10 ms (phases
+// 0, 2, 4, 6 ms), 2 frames every 100 ms (automatic phase), 1 frame every second,
+// whose payload is updated by a call back.
+
+// No external hardware is required.
+//----------------------------------------------------------------------------------------
+
+#include <ACAN_STM32_CyclicScheduler.h>
+
+//----------------------------------------------------------------------------------------
+
+static ACAN_STM32_CyclicScheduler gScheduler (can) ;
+
+static ACAN_STM32_CyclicFrame gFastFrames [4] ;
+static ACAN_STM32_CyclicFrame gSlowFrames [2] ;
+static ACAN_STM32_CyclicFrame gCounterFrame ;
+
+//----------------------------------------------------------------------------------------
+
+static void updateCounterFrame (ACAN_STM32_CyclicFrame & ioFrame) {
+  ioFrame.mMessage.data32 [0] += 1 ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void setup () {
+  pinMode (LED_BUILTIN, OUTPUT) ;
+  Serial.begin (115200) ;
+  while (!Serial) {
+    delay (50) ;
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+  }
+  Serial.println ("CAN loopback cyclic scheduler test") ;
+
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mModuleMode = ACAN_STM32_Settings::INTERNAL_LOOP_BACK ;
+
+  const uint32_t errorCode = can.begin (settings) ;
+  if (0 == errorCode) {
+    Serial.println ("can configuration ok") ;
+  }else{
+    Serial.print ("Error can configuration: 0x") ;
+    Serial.println (errorCode, HEX) ;
+  }
+//--- Register frames
+  for (uint32_t i = 0 ; i < 4 ; i++) {
+    gFastFrames [i].mMessage.id = 0x100 + i ;
+    gFastFrames [i].mMessage.len = 8 ;
+    gScheduler.add (gFastFrames [i], 10, 2 * i) ;
+  }
+  for (uint32_t i = 0 ; i < 2 ; i++) {
+    gSlowFrames [i].mMessage.id = 0x200 + i ;
+    gSlowFrames [i].mMessage.len = 2 ;
+    gScheduler.add (gSlowFrames [i], 100) ;
+  }
+  gCounterFrame.mMessage.id = 0x300 ;
+  gCounterFrame.mMessage.len = 4 ;
+  gCounterFrame.mUpdateCallBack = updateCounterFrame ;
+  gScheduler.add (gCounterFrame, 1000) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t PERIOD = 1000 ;
+static uint32_t gBlinkDate = PERIOD ;
+static uint32_t gReceivedCount = 0 ;
+
+//----------------------------------------------------------------------------------------
+
+void loop () {
+  gScheduler.service () ;
+  CANMessage message ;
+  while (can.receive0 (message)) {
+    gReceivedCount += 1 ;
+  }
+  if (gBlinkDate <= millis ()) {
+    gBlinkDate += PERIOD ;
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+    Serial.print ("Received: ") ;
+    Serial.print (gReceivedCount) ;
+    Serial.print (", counter: ") ;
+    Serial.print (gCounterFrame.mMessage.data32 [0]) ;
+    Serial.print (", missed periods: ") ;
+    Serial.println (gScheduler.missedPeriodCount ()) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
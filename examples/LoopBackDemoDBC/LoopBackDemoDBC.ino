@@ -0,0 +1,138 @@
+//----------------------------------------------------------------------------------------
+// This demo runs on NUCLEO_L432KC, NUCLEO_F303K8 and NUCLEO_F103RB
+// The CAN module is configured in internal loop back mode: it
+// internally receives every CAN frame it sends, nothing is emitted on TxCAN pin.
+
+// Powertrain.h and Powertrain.cpp are generated from Powertrain.dbc for the Dashboard
+// node, by the extras/dbc2acan.py script (Powertrain_report.txt is the bus load and
+// memory footprint report):
+//   python3 dbc2acan.py Powertrain.dbc --node Dashboard --prefix Powertrain
+// The sketch encodes the messages received by the Dashboard node with the generated
+// signal codecs, and sends them; the generated filters dispatch them to the
+// handlers defined below (handlers that are not defined are empty).
+// The sketch also sends the DashboardCommand message, that is rejected by filters.
+
+// No external hardware is required.
+//----------------------------------------------------------------------------------------
+
+#include "Powertrain.h"
+
+//----------------------------------------------------------------------------------------
+//   HANDLERS (called by can.dispatchReceivedMessage)
+//----------------------------------------------------------------------------------------
+
+void Powertrain_EngineData_received (const CANMessage & inMessage) {
+  Serial.print ("Engine speed: ") ;
+  Serial.print (Powertrain_EngineData::EngineSpeed.decode (inMessage)) ;
+  Serial.print (" rpm, coolant: ") ;
+  Serial.print (Powertrain_EngineData::CoolantTemperature.decode (inMessage)) ;
+  Serial.print (" degC, oil pressure: ") ;
+  Serial.print (Powertrain_EngineData::OilPressure.decode (inMessage)) ;
+  Serial.println (" kPa") ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void Powertrain_EngineStatus_received (const CANMessage & inMessage) {
+  float value ;
+  if (Powertrain_EngineStatus::RunningHours.decode (inMessage, value)) {
+    Serial.print ("Running hours: ") ;
+    Serial.println (value) ;
+  }
+  if (Powertrain_EngineStatus::FuelRate.decode (inMessage, value)) {
+    Serial.print ("Fuel rate: ") ;
+    Serial.print (value) ;
+    Serial.print (" l/h, battery: ") ;
+    Serial.print (Powertrain_EngineStatus::BatteryVoltage.signal ().decode (inMessage)) ;
+    Serial.println (" V") ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void Powertrain_VehicleSpeed_received (const CANMessage & inMessage) {
+  Serial.print ("Vehicle speed: ") ;
+  Serial.print (Powertrain_VehicleSpeed::Speed.decode (inMessage)) ;
+  Serial.println (" km/h") ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void setup () {
+  pinMode (LED_BUILTIN, OUTPUT) ;
+  Serial.begin (115200) ;
+  while (!Serial) {
+    delay (50) ;
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+  }
+  Serial.println ("CAN loopback DBC generated code test") ;
+
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mModuleMode = ACAN_STM32_Settings::INTERNAL_LOOP_BACK ;
+
+  ACAN_STM32::Filters filters ;
+  Powertrain_configureFilters (filters) ;
+
+  const uint32_t errorCode = can.begin (settings, filters) ;
+  if (0 == errorCode) {
+    Serial.println ("can configuration ok") ;
+  }else{
+    Serial.print ("Error can configuration: 0x") ;
+    Serial.println (errorCode, HEX) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t PERIOD = 1000 ;
+static uint32_t gSendDate = 0 ;
+static uint32_t gStatusPage = 0 ;
+
+//----------------------------------------------------------------------------------------
+
+void loop () {
+  if (gSendDate <= millis ()) {
+    gSendDate += PERIOD ;
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+    Serial.println ("--------------------------------") ;
+    CANMessage message ;
+  //--- EngineData
+    message.id = Powertrain_EngineData::IDENTIFIER ;
+    message.ext = Powertrain_EngineData::EXTENDED ;
+    message.len = Powertrain_EngineData::LENGTH ;
+    Powertrain_EngineData::EngineSpeed.encode (message, 1000.0f + float (millis () % 3000)) ;
+    Powertrain_EngineData::CoolantTemperature.encode (message, 85.0f) ;
+    Powertrain_EngineData::OilPressure.encode (message, 320.5f) ;
+    can.tryToSendReturnStatus (message) ;
+  //--- EngineStatus, page 0 and page 1 alternately
+    message.data64 = 0 ;
+    message.id = Powertrain_EngineStatus::IDENTIFIER ;
+    message.ext = Powertrain_EngineStatus::EXTENDED ;
+    message.len = Powertrain_EngineStatus::LENGTH ;
+    if (gStatusPage == 0) {
+      Powertrain_EngineStatus::RunningHours.encode (message, 1234.5f) ;
+    }else{
+      Powertrain_EngineStatus::FuelRate.encode (message, 12.25f) ;
+      Powertrain_EngineStatus::BatteryVoltage.encode (message, 13.8f) ;
+    }
+    gStatusPage ^= 1 ;
+    can.tryToSendReturnStatus (message) ;
+  //--- VehicleSpeed (extended)
+    message.data64 = 0 ;
+    message.id = Powertrain_VehicleSpeed::IDENTIFIER ;
+    message.ext = Powertrain_VehicleSpeed::EXTENDED ;
+    message.len = Powertrain_VehicleSpeed::LENGTH ;
+    Powertrain_VehicleSpeed::Speed.encode (message, 88.5f) ;
+    can.tryToSendReturnStatus (message) ;
+  //--- DashboardCommand, not received by Dashboard: rejected by filters
+    message.data64 = 0 ;
+    message.id = Powertrain_DashboardCommand::IDENTIFIER ;
+    message.ext = Powertrain_DashboardCommand::EXTENDED ;
+    message.len = Powertrain_DashboardCommand::LENGTH ;
+    Powertrain_DashboardCommand::Backlight.encode (message, 50.0f) ;
+    can.tryToSendReturnStatus (message) ;
+  }
+  can.dispatchReceivedMessage () ;
+}
+
+//----------------------------------------------------------------------------------------
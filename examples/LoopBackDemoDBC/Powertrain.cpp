@@ -0,0 +1,78 @@
+//------------------------------------------------------------------------------
+// Generated by dbc2acan.py for node Dashboard: do not edit
+//------------------------------------------------------------------------------
+
+#include "Powertrain.h"
+
+//------------------------------------------------------------------------------
+//   HANDLERS
+//------------------------------------------------------------------------------
+
+__attribute__ ((weak)) void Powertrain_EngineData_received (const CANMessage & /* inMessage */) {
+}
+
+__attribute__ ((weak)) void Powertrain_EngineStatus_received (const CANMessage & /* inMessage */) {
+}
+
+__attribute__ ((weak)) void Powertrain_TransmissionData_received (const CANMessage & /* inMessage */) {
+}
+
+__attribute__ ((weak)) void Powertrain_VehicleSpeed_received (const CANMessage & /* inMessage */) {
+}
+
+//------------------------------------------------------------------------------
+//   DISPATCH TABLE (sorted by key: identifier, bit 29 set for extended)
+//------------------------------------------------------------------------------
+
+typedef struct {
+  uint32_t mKey ;
+  ACANCallBackRoutine mHandler ;
+} Powertrain_DispatchEntry ;
+
+static const Powertrain_DispatchEntry DISPATCH_TABLE [4] = {
+  {0x00000100, Powertrain_EngineData_received},
+  {0x00000110, Powertrain_EngineStatus_received},
+  {0x00000200, Powertrain_TransmissionData_received},
+  {0x38FF0300, Powertrain_VehicleSpeed_received}
+} ;
+
+static const uint32_t DISPATCH_TABLE_SIZE = 4 ;
+
+//------------------------------------------------------------------------------
+
+bool Powertrain_dispatch (const CANMessage & inMessage) {
+  const uint32_t key = inMessage.id | (inMessage.ext ? (1U << 29) : 0) ;
+  uint32_t low = 0 ;
+  uint32_t high = DISPATCH_TABLE_SIZE ;
+  while (low < high) {
+    const uint32_t middle = (low + high) / 2 ;
+    if (DISPATCH_TABLE [middle].mKey < key) {
+      low = middle + 1 ;
+    }else{
+      high = middle ;
+    }
+  }
+  const bool found = (low < DISPATCH_TABLE_SIZE) && (DISPATCH_TABLE [low].mKey == key) ;
+  if (found) {
+    DISPATCH_TABLE [low].mHandler (inMessage) ;
+  }
+  return found ;
+}
+
+//------------------------------------------------------------------------------
+//   FILTERS
+//------------------------------------------------------------------------------
+
+void Powertrain_configureFilters (ACAN_STM32::Filters & ioFilters,
+                                  const ACAN_STM32::Action inAction) {
+  ioFilters.addStandardQuad (0x100, false, Powertrain_EngineData_received,
+                             0x110, false, Powertrain_EngineStatus_received,
+                             0x200, false, Powertrain_TransmissionData_received,
+                             0x200, false, Powertrain_TransmissionData_received,
+                             inAction) ;
+  ioFilters.addExtendedDual (0x18FF0300, false, Powertrain_VehicleSpeed_received,
+                             0x18FF0300, false, Powertrain_VehicleSpeed_received,
+                             inAction) ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,106 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Generated by dbc2acan.py for node Dashboard: do not edit
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <ACAN_STM32_Signal.h>
+
+//------------------------------------------------------------------------------
+
+class Powertrain_EngineData {
+  public: static const uint32_t IDENTIFIER = 0x100 ;
+  public: static const bool EXTENDED = false ;
+  public: static const uint8_t LENGTH = 8 ;
+  public: static const uint32_t CYCLE_TIME = 10 ; // ms, 0 if not periodic
+  public: typedef ACAN_STM32_Signal <0, 16, kIntel, false> EngineSpeed_Type ;
+  public: static constexpr EngineSpeed_Type EngineSpeed {0.25f, 0.0f} ; // rpm
+  public: typedef ACAN_STM32_Signal <16, 8, kIntel, true> CoolantTemperature_Type ;
+  public: static constexpr CoolantTemperature_Type CoolantTemperature {1.0f, -40.0f} ; // degC
+  public: typedef ACAN_STM32_Signal <24, 8, kIntel, false> Throttle_Type ;
+  public: static constexpr Throttle_Type Throttle {0.4f, 0.0f} ; // %
+  public: typedef ACAN_STM32_Signal <39, 10, kMotorola, false> OilPressure_Type ;
+  public: static constexpr OilPressure_Type OilPressure {0.5f, 0.0f} ; // kPa
+  public: typedef ACAN_STM32_Signal <45, 14, kMotorola, true> Torque_Type ;
+  public: static constexpr Torque_Type Torque {0.1f, -500.0f} ; // Nm
+} ;
+
+//------------------------------------------------------------------------------
+
+class Powertrain_EngineStatus {
+  public: static const uint32_t IDENTIFIER = 0x110 ;
+  public: static const bool EXTENDED = false ;
+  public: static const uint8_t LENGTH = 4 ;
+  public: static const uint32_t CYCLE_TIME = 100 ; // ms, 0 if not periodic
+  public: typedef ACAN_STM32_Signal <0, 4, kIntel, false> StatusPage_Type ;
+  public: static constexpr StatusPage_Type StatusPage {1.0f, 0.0f} ;
+  public: static constexpr ACAN_STM32_MultiplexedSignal <StatusPage_Type, 0, ACAN_STM32_Signal <8, 24, kIntel, false>> RunningHours {ACAN_STM32_Signal <8, 24, kIntel, false> (0.1f, 0.0f)} ; // h
+  public: static constexpr ACAN_STM32_MultiplexedSignal <StatusPage_Type, 1, ACAN_STM32_Signal <8, 16, kIntel, false>> FuelRate {ACAN_STM32_Signal <8, 16, kIntel, false> (0.05f, 0.0f)} ; // l/h
+  public: static constexpr ACAN_STM32_MultiplexedSignal <StatusPage_Type, 1, ACAN_STM32_Signal <24, 8, kIntel, false>> BatteryVoltage {ACAN_STM32_Signal <24, 8, kIntel, false> (0.1f, 0.0f)} ; // V
+} ;
+
+//------------------------------------------------------------------------------
+
+class Powertrain_TransmissionData {
+  public: static const uint32_t IDENTIFIER = 0x200 ;
+  public: static const bool EXTENDED = false ;
+  public: static const uint8_t LENGTH = 6 ;
+  public: static const uint32_t CYCLE_TIME = 20 ; // ms, 0 if not periodic
+  public: typedef ACAN_STM32_Signal <0, 4, kIntel, true> Gear_Type ;
+  public: static constexpr Gear_Type Gear {1.0f, 0.0f} ;
+  public: typedef ACAN_STM32_Signal <8, 16, kIntel, false> OutputSpeed_Type ;
+  public: static constexpr OutputSpeed_Type OutputSpeed {0.25f, 0.0f} ; // rpm
+  public: typedef ACAN_STM32_Signal <31, 8, kMotorola, false> OilTemperature_Type ;
+  public: static constexpr OilTemperature_Type OilTemperature {1.0f, -40.0f} ; // degC
+} ;
+
+//------------------------------------------------------------------------------
+
+class Powertrain_VehicleSpeed {
+  public: static const uint32_t IDENTIFIER = 0x18FF0300 ;
+  public: static const bool EXTENDED = true ;
+  public: static const uint8_t LENGTH = 8 ;
+  public: static const uint32_t CYCLE_TIME = 100 ; // ms, 0 if not periodic
+  public: typedef ACAN_STM32_Signal <0, 16, kIntel, false> Speed_Type ;
+  public: static constexpr Speed_Type Speed {0.00390625f, 0.0f} ; // km/h
+  public: typedef ACAN_STM32_Signal <16, 32, kIntel, false> Odometer_Type ;
+  public: static constexpr Odometer_Type Odometer {0.1f, 0.0f} ; // km
+} ;
+
+//------------------------------------------------------------------------------
+
+class Powertrain_DashboardCommand {
+  public: static const uint32_t IDENTIFIER = 0x300 ;
+  public: static const bool EXTENDED = false ;
+  public: static const uint8_t LENGTH = 2 ;
+  public: static const uint32_t CYCLE_TIME = 0 ; // ms, 0 if not periodic
+  public: typedef ACAN_STM32_Signal <0, 8, kIntel, false> Backlight_Type ;
+  public: static constexpr Backlight_Type Backlight {1.0f, 0.0f} ; // %
+  public: typedef ACAN_STM32_Signal <8, 1, kIntel, false> Unit_Type ;
+  public: static constexpr Unit_Type Unit {1.0f, 0.0f} ;
+} ;
+
+//------------------------------------------------------------------------------
+// Reception handlers (weak, empty by default: define the ones you need)
+//------------------------------------------------------------------------------
+
+void Powertrain_EngineData_received (const CANMessage & inMessage) ;
+void Powertrain_EngineStatus_received (const CANMessage & inMessage) ;
+void Powertrain_TransmissionData_received (const CANMessage & inMessage) ;
+void Powertrain_VehicleSpeed_received (const CANMessage & inMessage) ;
+
+//------------------------------------------------------------------------------
+// Filters for the 4 messages received by Dashboard, with their handlers
+//------------------------------------------------------------------------------
+
+void Powertrain_configureFilters (ACAN_STM32::Filters & ioFilters,
+                                  const ACAN_STM32::Action inAction = ACAN_STM32::FIFO0) ;
+
+//------------------------------------------------------------------------------
+// Dispatch by identifier (binary search); returns false if the message is unknown
+//------------------------------------------------------------------------------
+
+bool Powertrain_dispatch (const CANMessage & inMessage) ;
+
+//------------------------------------------------------------------------------
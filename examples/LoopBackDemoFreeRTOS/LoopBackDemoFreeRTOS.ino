@@ -0,0 +1,96 @@
+//----------------------------------------------------------------------------------------
+// This demo runs on NUCLEO_L432KC, NUCLEO_F303K8 and NUCLEO_F103RB
+// It requires the STM32FreeRTOS library.
+// The CAN module is configured in internal loop back mode. A sender task sends a
+// frame every 100 ms with the blocking send method, a receiver task waits for
+// frames with the blocking receive0 method: both tasks are blocked on a FreeRTOS
+// semaphore signalled by the CAN ISRs, instead of polling the driver.
+
+// No external hardware is required.
+//----------------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <ACAN_STM32_FreeRTOS.h>
+
+//----------------------------------------------------------------------------------------
+
+static ACAN_STM32_FreeRTOSNotifier gReceiveNotifier ;
+static ACAN_STM32_FreeRTOSNotifier gTransmitNotifier ;
+
+//----------------------------------------------------------------------------------------
+
+static void senderTask (void * /* inParameter */) {
+  CANMessage message ;
+  message.id = 0x123 ;
+  message.len = 1 ;
+  while (true) {
+    const uint32_t sendStatus = can.send (message, 10) ;
+    if (sendStatus != 0) {
+      Serial.print ("Send error 0x") ;
+      Serial.println (sendStatus, HEX) ;
+    }
+    message.data [0] += 1 ;
+    vTaskDelay (pdMS_TO_TICKS (100)) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+static void receiverTask (void * /* inParameter */) {
+  uint32_t receivedCount = 0 ;
+  while (true) {
+    CANMessage message ;
+    if (can.receive0 (message, 1000)) {
+      receivedCount += 1 ;
+      digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+      Serial.print ("Received: ") ;
+      Serial.print (receivedCount) ;
+      Serial.print (", data: ") ;
+      Serial.println (message.data [0]) ;
+    }else{
+      Serial.println ("Receive timeout") ;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void setup () {
+  pinMode (LED_BUILTIN, OUTPUT) ;
+  Serial.begin (115200) ;
+  while (!Serial) {
+    delay (50) ;
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+  }
+  Serial.println ("CAN loopback FreeRTOS test") ;
+
+  gReceiveNotifier.begin () ;
+  gTransmitNotifier.begin () ;
+  can.setReceiveNotifier (& gReceiveNotifier) ;
+  can.setTransmitNotifier (& gTransmitNotifier) ;
+
+  ACAN_STM32_Settings settings (125 * 1000) ;
+  settings.mModuleMode = ACAN_STM32_Settings::INTERNAL_LOOP_BACK ;
+//--- CAN ISRs call FreeRTOS API: their priority should not be higher than
+//    configMAX_SYSCALL_INTERRUPT_PRIORITY
+  settings.mMessageIRQPriority = 6 ;
+
+  const uint32_t errorCode = can.begin (settings) ;
+  if (0 == errorCode) {
+    Serial.println ("can configuration ok") ;
+  }else{
+    Serial.print ("Error can configuration: 0x") ;
+    Serial.println (errorCode, HEX) ;
+  }
+
+  xTaskCreate (senderTask, "sender", 256, nullptr, 2, nullptr) ;
+  xTaskCreate (receiverTask, "receiver", 256, nullptr, 1, nullptr) ;
+  vTaskStartScheduler () ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void loop () {
+}
+
+//----------------------------------------------------------------------------------------
@@ -11,12 +11,14 @@
 
 //----------------------------------------------------------------------------------------
 
+static const uint16_t BUFFER_SIZE = 100 ;
+static CANMessage gBufferMessages [BUFFER_SIZE] ;
 static ACAN_STM32_FIFO gBuffer ;
 
 //----------------------------------------------------------------------------------------
 
 void setup () {
-  gBuffer.initWithSize (100) ;
+  gBuffer.initWithBuffer (gBufferMessages, nullptr, BUFFER_SIZE) ;
   pinMode (LED_BUILTIN, OUTPUT) ;
   Serial.begin (115200) ;
   while (!Serial) {
@@ -0,0 +1,181 @@
+//----------------------------------------------------------------------------------------
+// This demo runs on NUCLEO_L432KC, NUCLEO_F303K8 and NUCLEO_F103RB
+// The CAN module is configured in internal loop back mode: it
+// internally receives every CAN frame it sends, nothing is emitted on TxCAN pin.
+
+// ISO-TP throughput benchmark: two pairs of channels (client 0x7E0 / 0x7E8 and
+// server 0x7E8 / 0x7E0, client 0x7E1 / 0x7E9 and server 0x7E9 / 0x7E1) transfer
+// 4095-byte messages concurrently (2048-byte messages on NUCLEO_F303K8, that has
+// 12 KB of SRAM), at 500 kbit/s and at 1 Mbit/s, with several block size and STmin
+// settings. Received messages are checked. With internal loop back, every frame
+// (including flow controls) is received by the node itself, and handled by the
+// channel whose receive identifier matches. Both clients send the same (read only)
+// buffer; each server has its own receive buffer.
+
+// No external hardware is required.
+//----------------------------------------------------------------------------------------
+
+#include <ACAN_STM32_IsoTp.h>
+
+//----------------------------------------------------------------------------------------
+
+static ACAN_STM32_IsoTp gIsoTp (can) ;
+
+static const uint32_t PAIR_COUNT = 2 ;
+
+static ACAN_STM32_IsoTpChannel gClients [PAIR_COUNT] = {
+  {0x7E0, 0x7E8},
+  {0x7E1, 0x7E9}
+} ;
+
+static ACAN_STM32_IsoTpChannel gServers [PAIR_COUNT] = {
+  {0x7E8, 0x7E0},
+  {0x7E9, 0x7E1}
+} ;
+
+#ifdef STM32F303x8
+  static const uint16_t MESSAGE_LENGTH = 2048 ;
+#else
+  static const uint16_t MESSAGE_LENGTH = ACAN_STM32_IsoTp::MAX_MESSAGE_LENGTH ;
+#endif
+
+static uint8_t gTransmitBuffer [MESSAGE_LENGTH] ;
+static uint8_t gReceiveBuffers [PAIR_COUNT][MESSAGE_LENGTH] ;
+
+//----------------------------------------------------------------------------------------
+
+static uint32_t gReceivedMessageCount = 0 ;
+static uint32_t gReceivedByteCount = 0 ;
+static uint32_t gErrorCount = 0 ;
+
+//----------------------------------------------------------------------------------------
+
+static void messageReceived (ACAN_STM32_IsoTpChannel & ioChannel, const tIsoTpResult inResult) {
+  bool ok = (inResult == kIsoTpOk) && (ioChannel.receivedLength () == MESSAGE_LENGTH) ;
+  for (uint32_t i = 0 ; (i < ioChannel.receivedLength ()) && ok ; i++) {
+    ok = ioChannel.receiveBuffer () [i] == gTransmitBuffer [i] ;
+  }
+  if (ok) {
+    gReceivedMessageCount += 1 ;
+    gReceivedByteCount += ioChannel.receivedLength () ;
+  }else{
+    gErrorCount += 1 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+static void messageSent (ACAN_STM32_IsoTpChannel & /* ioChannel */, const tIsoTpResult inResult) {
+  if (inResult != kIsoTpOk) {
+    gErrorCount += 1 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+// With a separation time, the next consecutive frame is timed from the transmit
+// completion of the previous one
+
+static void transmitComplete (const uint32_t inTag,
+                              const ACAN_STM32::TransmitStatus inStatus,
+                              const uint32_t /* inLatencyMicros */) {
+  gIsoTp.transmitComplete (inTag, inStatus) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static void runBenchmark (const uint32_t inBitRate,
+                          const uint8_t inBlockSize,
+                          const uint8_t inSeparationTime) {
+  ACAN_STM32_Settings settings (inBitRate) ;
+  settings.mModuleMode = ACAN_STM32_Settings::INTERNAL_LOOP_BACK ;
+  const uint32_t errorCode = can.begin (settings) ;
+  if (errorCode != 0) {
+    Serial.print ("Error can configuration: 0x") ;
+    Serial.println (errorCode, HEX) ;
+  }else{
+    for (uint32_t i = 0 ; i < PAIR_COUNT ; i++) {
+      gServers [i].mBlockSize = inBlockSize ;
+      gServers [i].mSeparationTime = inSeparationTime ;
+      gIsoTp.addChannel (gClients [i]) ;
+      gIsoTp.addChannel (gServers [i]) ;
+    }
+    gReceivedMessageCount = 0 ;
+    gReceivedByteCount = 0 ;
+    gErrorCount = 0 ;
+    uint32_t frameCount = 0 ;
+    const uint32_t start = millis () ;
+    while ((millis () - start) < 2000) {
+      for (uint32_t i = 0 ; i < PAIR_COUNT ; i++) {
+        if (!gClients [i].transmitInProgress ()) {
+          gIsoTp.send (gClients [i], gTransmitBuffer, MESSAGE_LENGTH) ;
+        }
+      }
+      CANMessage frame ;
+      while (can.receive0 (frame)) {
+        frameCount += 1 ;
+        gIsoTp.handleReceivedMessage (frame) ;
+      }
+      gIsoTp.service () ;
+    }
+    const uint32_t duration = millis () - start ;
+    can.end () ;
+  //--- Removing channels drops the transfers in progress
+    for (uint32_t i = 0 ; i < PAIR_COUNT ; i++) {
+      gIsoTp.removeChannel (gClients [i]) ;
+      gIsoTp.removeChannel (gServers [i]) ;
+    }
+  //--- Display
+    Serial.print (inBitRate / 1000) ;
+    Serial.print (" kbit/s, BS ") ;
+    Serial.print (inBlockSize) ;
+    Serial.print (", STmin 0x") ;
+    Serial.print (inSeparationTime, HEX) ;
+    Serial.print (": ") ;
+    Serial.print (gReceivedMessageCount) ;
+    Serial.print (" messages, ") ;
+    Serial.print ((gReceivedByteCount * 1000) / duration) ;
+    Serial.print (" bytes/s, ") ;
+    Serial.print ((frameCount * 1000) / duration) ;
+    Serial.print (" frames/s, errors: ") ;
+    Serial.println (gErrorCount) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+void setup () {
+  pinMode (LED_BUILTIN, OUTPUT) ;
+  Serial.begin (115200) ;
+  while (!Serial) {
+    delay (50) ;
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+  }
+  Serial.println ("CAN loopback ISO-TP throughput test") ;
+  for (uint32_t j = 0 ; j < MESSAGE_LENGTH ; j++) {
+    gTransmitBuffer [j] = uint8_t (j * 7) ;
+  }
+  for (uint32_t i = 0 ; i < PAIR_COUNT ; i++) {
+    gClients [i].mTransmitCallBack = messageSent ;
+    gServers [i].setReceiveBuffer (gReceiveBuffers [i], MESSAGE_LENGTH) ;
+    gServers [i].mReceiveCallBack = messageReceived ;
+  }
+  can.setTransmitCompleteCallBack (transmitComplete) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t BIT_RATES [2] = {500 * 1000, 1000 * 1000} ;
+
+//----------------------------------------------------------------------------------------
+
+void loop () {
+  digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+  Serial.println ("--------------------------------") ;
+  for (uint32_t i = 0 ; i < 2 ; i++) {
+    runBenchmark (BIT_RATES [i], 0, 0) ;    // No flow control after first frame
+    runBenchmark (BIT_RATES [i], 8, 0) ;    // Flow control every 8 frames
+    runBenchmark (BIT_RATES [i], 0, 0xF5) ; // 500 us between frames
+  }
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,98 @@
+//----------------------------------------------------------------------------------------
+// This demo runs on NUCLEO_L432KC, NUCLEO_F303K8 and NUCLEO_F103RB
+// The CAN module is configured in internal loop back mode, and in polling mode:
+// no CAN interrupt is enabled, the sketch calls can.poll () in a cyclic loop.
+
+// The cost of can.poll () is measured with the DWT cycle counter (CPU cycles),
+// its worst case is reached when both hardware receive FIFOs hold 3 frames and
+// 3 transmit mailboxes are loaded.
+
+// No external hardware is required.
+//----------------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+
+//----------------------------------------------------------------------------------------
+
+void setup () {
+  pinMode (LED_BUILTIN, OUTPUT) ;
+  Serial.begin (115200) ;
+  while (!Serial) {
+    delay (50) ;
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+  }
+  Serial.println ("CAN loopback polling test") ;
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk ;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk ;
+
+  ACAN_STM32_Settings settings (1000 * 1000) ;
+  settings.mModuleMode = ACAN_STM32_Settings::INTERNAL_LOOP_BACK ;
+  settings.mPollingMode = true ;
+
+  const uint32_t errorCode = can.begin (settings) ;
+  if (0 == errorCode) {
+    Serial.println ("can configuration ok") ;
+  }else{
+    Serial.print ("Error can configuration: 0x") ;
+    Serial.println (errorCode, HEX) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t PERIOD = 1000 ;
+static uint32_t gBlinkDate = PERIOD ;
+static uint32_t gSentCount = 0 ;
+static uint32_t gReceivedCount = 0 ;
+static uint32_t gPollMinCycles = UINT32_MAX ; // During the current period
+static uint32_t gPollMaxCycles = 0 ; // During the current period
+static uint32_t gPollWorstCaseCycles = 0 ; // Since start
+
+//----------------------------------------------------------------------------------------
+
+void loop () {
+//--- Keep the driver transmit FIFO full
+  CANMessage message ;
+  message.id = 0x123 ;
+  message.len = 8 ;
+  while (can.tryToSendReturnStatus (message) == 0) {
+    gSentCount += 1 ;
+  }
+//--- Poll
+  const uint32_t start = DWT->CYCCNT ;
+  can.poll () ;
+  const uint32_t duration = DWT->CYCCNT - start ;
+  if (gPollMinCycles > duration) {
+    gPollMinCycles = duration ;
+  }
+  if (gPollMaxCycles < duration) {
+    gPollMaxCycles = duration ;
+  }
+  if (gPollWorstCaseCycles < duration) {
+    gPollWorstCaseCycles = duration ;
+  }
+//--- Receive
+  while (can.receive0 (message)) {
+    gReceivedCount += 1 ;
+  }
+//--- Blink led and display
+  if (gBlinkDate <= millis ()) {
+    gBlinkDate += PERIOD ;
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+    Serial.print ("Sent: ") ;
+    Serial.print (gSentCount) ;
+    Serial.print (", received: ") ;
+    Serial.print (gReceivedCount) ;
+    Serial.print (", poll: ") ;
+    Serial.print (gPollMinCycles) ;
+    Serial.print (" ... ") ;
+    Serial.print (gPollMaxCycles) ;
+    Serial.print (" cycles, worst case per call: ") ;
+    Serial.print (gPollWorstCaseCycles) ;
+    Serial.println (" cycles") ;
+    gPollMinCycles = UINT32_MAX ;
+    gPollMaxCycles = 0 ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,93 @@
+//----------------------------------------------------------------------------------------
+// This demo runs on NUCLEO_L432KC, NUCLEO_F303K8 and NUCLEO_F103RB
+// The CAN module is configured in internal loop back mode: it
+// internally receives every CAN frame it sends, nothing is emitted on TxCAN pin.
+
+// 8 frames are sent every 10 ms by a cyclic scheduler, and are supervised with a
+// 15 ms timeout. Every 2 seconds, the transmission of one of them is suspended or
+// resumed: the supervisor reports its timeout and its recovery.
+
+// No external hardware is required.
+//----------------------------------------------------------------------------------------
+
+#include <ACAN_STM32_CyclicScheduler.h>
+#include <ACAN_STM32_MessageSupervisor.h>
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t FRAME_COUNT = 8 ;
+
+static ACAN_STM32_CyclicScheduler gScheduler (can) ;
+static ACAN_STM32_MessageSupervisor gSupervisor (can, FRAME_COUNT) ;
+
+static ACAN_STM32_CyclicFrame gFrames [FRAME_COUNT] ;
+static ACAN_STM32_SupervisedMessage gSupervisedMessages [FRAME_COUNT] ;
+
+//----------------------------------------------------------------------------------------
+
+static void supervisionCallBack (ACAN_STM32_SupervisedMessage & ioMessage, const bool inAlive) {
+  Serial.print ("Message 0x") ;
+  Serial.print (ioMessage.identifier (), HEX) ;
+  Serial.print (inAlive ? " alive" : " timed out") ;
+  Serial.print (" at ") ;
+  Serial.print (millis ()) ;
+  Serial.print (" ms, last reception at ") ;
+  Serial.print (ioMessage.lastReceptionDate ()) ;
+  Serial.println (" ms") ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void setup () {
+  pinMode (LED_BUILTIN, OUTPUT) ;
+  Serial.begin (115200) ;
+  while (!Serial) {
+    delay (50) ;
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+  }
+  Serial.println ("CAN loopback message supervisor test") ;
+
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mModuleMode = ACAN_STM32_Settings::INTERNAL_LOOP_BACK ;
+
+  const uint32_t errorCode = can.begin (settings) ;
+  if (0 == errorCode) {
+    Serial.println ("can configuration ok") ;
+  }else{
+    Serial.print ("Error can configuration: 0x") ;
+    Serial.println (errorCode, HEX) ;
+  }
+  for (uint32_t i = 0 ; i < FRAME_COUNT ; i++) {
+    gFrames [i].mMessage.id = 0x100 + i ;
+    gFrames [i].mMessage.len = 8 ;
+    gScheduler.add (gFrames [i], 10) ;
+    gSupervisor.add (gSupervisedMessages [i], 0x100 + i, kStandard, 15, supervisionCallBack) ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t PERIOD = 2000 ;
+static uint32_t gToggleDate = PERIOD ;
+static bool gSuspended = false ;
+
+//----------------------------------------------------------------------------------------
+
+void loop () {
+  gScheduler.service () ;
+  gSupervisor.service () ;
+  CANMessage message ;
+  while (can.receive0 (message)) {}
+  if (gToggleDate <= millis ()) {
+    gToggleDate += PERIOD ;
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+    gSuspended = !gSuspended ;
+    if (gSuspended) {
+      gScheduler.remove (gFrames [3]) ;
+    }else{
+      gScheduler.add (gFrames [3], 10) ;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,176 @@
+//----------------------------------------------------------------------------------------
+// This demo runs on NUCLEO_L432KC, NUCLEO_F303K8, NUCLEO_F103RB and NUCLEO_F446RE
+// It compares the cost of decoding and encoding the signals of a frame payload
+// with the compile-time signal codec (ACAN_STM32_Signal.h), and with a naive
+// loop that handles one bit at a time (DBC bit numbering), using the DWT cycle
+// counter. Signals cover the whole payload: decoded values are checked against
+// the naive loop, and encoding them back should give the original payload.
+
+// The CAN module is not used; no external hardware is required.
+//----------------------------------------------------------------------------------------
+
+#include <ACAN_STM32_Signal.h>
+
+//----------------------------------------------------------------------------------------
+//   SIGNALS
+//----------------------------------------------------------------------------------------
+
+static constexpr ACAN_STM32_Signal <0, 16, kIntel, false> kEngineSpeed (0.25f) ;
+static constexpr ACAN_STM32_Signal <16, 8, kIntel, true> kCoolantTemperature (1.0f, -40.0f) ;
+static constexpr ACAN_STM32_Signal <24, 8, kIntel, false> kThrottle (0.4f) ;
+static constexpr ACAN_STM32_Signal <39, 10, kMotorola, false> kOilPressure (0.5f) ;
+static constexpr ACAN_STM32_Signal <45, 14, kMotorola, true> kTorque (0.1f, -500.0f) ;
+static constexpr ACAN_STM32_Signal <56, 8, kIntel, false> kGear ;
+
+static const uint32_t SIGNAL_COUNT = 6 ;
+
+//--- Layout for the naive decoder
+static const uint8_t START_BITS [SIGNAL_COUNT] = {0, 16, 24, 39, 45, 56} ;
+static const uint8_t LENGTHS [SIGNAL_COUNT] = {16, 8, 8, 10, 14, 8} ;
+static const bool MOTOROLA_SIGNALS [SIGNAL_COUNT] = {false, false, false, true, true, false} ;
+static const bool SIGNED_SIGNALS [SIGNAL_COUNT] = {false, true, false, false, true, false} ;
+static const float FACTORS [SIGNAL_COUNT] = {0.25f, 1.0f, 0.4f, 0.5f, 0.1f, 1.0f} ;
+static const float OFFSETS [SIGNAL_COUNT] = {0.0f, -40.0f, 0.0f, 0.0f, -500.0f, 0.0f} ;
+
+//----------------------------------------------------------------------------------------
+//   NAIVE BIT LOOP
+//----------------------------------------------------------------------------------------
+
+static int64_t naiveRaw (const CANMessage & inMessage, const uint32_t inSignalIndex) {
+  uint64_t value = 0 ;
+  uint32_t bit = START_BITS [inSignalIndex] ;
+  const uint32_t length = LENGTHS [inSignalIndex] ;
+  if (MOTOROLA_SIGNALS [inSignalIndex]) { // From MSB, sawtooth bit numbering
+    for (uint32_t i = 0 ; i < length ; i++) {
+      value = (value << 1) | ((inMessage.data [bit / 8] >> (bit % 8)) & 1) ;
+      bit = ((bit % 8) == 0) ? (bit + 15) : (bit - 1) ;
+    }
+  }else{ // From MSB (start bit + length - 1) down to LSB (start bit)
+    for (uint32_t i = length ; i > 0 ; i--) {
+      const uint32_t b = bit + i - 1 ;
+      value = (value << 1) | ((inMessage.data [b / 8] >> (b % 8)) & 1) ;
+    }
+  }
+  int64_t result = int64_t (value) ;
+  if (SIGNED_SIGNALS [inSignalIndex] && (((value >> (length - 1)) & 1) != 0)) {
+    result = int64_t (value | ~ ((uint64_t (1) << length) - 1)) ;
+  }
+  return result ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static void naiveDecode (const CANMessage & inMessage, float outValues []) {
+  for (uint32_t i = 0 ; i < SIGNAL_COUNT ; i++) {
+    outValues [i] = float (naiveRaw (inMessage, i)) * FACTORS [i] + OFFSETS [i] ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
+
+static void codecDecode (const CANMessage & inMessage, float outValues []) {
+  ACAN_STM32_decodeSignals (inMessage, outValues,
+                            kEngineSpeed, kCoolantTemperature, kThrottle,
+                            kOilPressure, kTorque, kGear) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static void codecEncode (CANMessage & ioMessage, const float inValues []) {
+  kEngineSpeed.encode (ioMessage, inValues [0]) ;
+  kCoolantTemperature.encode (ioMessage, inValues [1]) ;
+  kThrottle.encode (ioMessage, inValues [2]) ;
+  kOilPressure.encode (ioMessage, inValues [3]) ;
+  kTorque.encode (ioMessage, inValues [4]) ;
+  kGear.encode (ioMessage, inValues [5]) ;
+}
+
+//----------------------------------------------------------------------------------------
+//   BENCHMARK
+//----------------------------------------------------------------------------------------
+
+static const uint32_t SAMPLE_COUNT = 1000 ;
+
+//----------------------------------------------------------------------------------------
+
+static void runBenchmark (void) {
+  uint32_t naiveCycles = 0 ;
+  uint32_t codecDecodeCycles = 0 ;
+  uint32_t codecEncodeCycles = 0 ;
+  uint32_t mismatchCount = 0 ;
+  for (uint32_t n = 0 ; n < SAMPLE_COUNT ; n++) {
+    CANMessage message ;
+    message.len = 8 ;
+    message.data32 [0] = uint32_t (random (INT32_MAX)) ;
+    message.data32 [1] = uint32_t (random (INT32_MAX)) ;
+    float naiveValues [SIGNAL_COUNT] ;
+    float codecValues [SIGNAL_COUNT] ;
+  //--- Naive decoding
+    uint32_t start = DWT->CYCCNT ;
+    naiveDecode (message, naiveValues) ;
+    naiveCycles += DWT->CYCCNT - start ;
+  //--- Codec decoding
+    start = DWT->CYCCNT ;
+    codecDecode (message, codecValues) ;
+    codecDecodeCycles += DWT->CYCCNT - start ;
+  //--- Codec encoding, back to the same payload
+    CANMessage encoded ;
+    start = DWT->CYCCNT ;
+    codecEncode (encoded, codecValues) ;
+    codecEncodeCycles += DWT->CYCCNT - start ;
+  //--- Check
+    for (uint32_t i = 0 ; i < SIGNAL_COUNT ; i++) {
+      const float difference = naiveValues [i] - codecValues [i] ;
+      if ((difference > 0.001f) || (difference < -0.001f)) {
+        mismatchCount += 1 ;
+      }
+    }
+    if (encoded.data64 != message.data64) {
+      mismatchCount += 1 ;
+    }
+  }
+  Serial.print ("Naive bit loop decoding: ") ;
+  Serial.print (naiveCycles / SAMPLE_COUNT) ;
+  Serial.println (" cycles per frame") ;
+  Serial.print ("Codec decoding: ") ;
+  Serial.print (codecDecodeCycles / SAMPLE_COUNT) ;
+  Serial.println (" cycles per frame") ;
+  Serial.print ("Codec encoding: ") ;
+  Serial.print (codecEncodeCycles / SAMPLE_COUNT) ;
+  Serial.println (" cycles per frame") ;
+  Serial.print ("Mismatches: ") ;
+  Serial.println (mismatchCount) ;
+}
+
+//----------------------------------------------------------------------------------------
+
+void setup () {
+  pinMode (LED_BUILTIN, OUTPUT) ;
+  Serial.begin (115200) ;
+  while (!Serial) {
+    delay (50) ;
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+  }
+  Serial.println ("Signal codec benchmark") ;
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk ;
+  DWT->CYCCNT = 0 ;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk ;
+}
+
+//----------------------------------------------------------------------------------------
+
+static const uint32_t PERIOD = 5000 ;
+static uint32_t gBenchmarkDate = 0 ;
+
+//----------------------------------------------------------------------------------------
+
+void loop () {
+  if (gBenchmarkDate <= millis ()) {
+    digitalWrite (LED_BUILTIN, !digitalRead (LED_BUILTIN)) ;
+    Serial.println ("--------------------------------") ;
+    runBenchmark () ;
+    gBenchmarkDate = millis () + PERIOD ;
+  }
+}
+
+//----------------------------------------------------------------------------------------
@@ -0,0 +1,494 @@
+#!/usr/bin/env python3
+#-------------------------------------------------------------------------------
+# dbc2acan: DBC to ACAN_STM32 code generator
+#
+# Reads a DBC file, and generates for a given node:
+#   - <prefix>.h: constexpr signal codecs (ACAN_STM32_Signal.h) for every
+#     message, and declarations;
+#   - <prefix>.cpp: the filter setup for the messages received by the node, the
+#     identifier-indexed dispatch table, and weak (empty) reception handlers;
+#   - <prefix>_report.txt: bus load and memory footprint report.
+#
+# Filters: every received identifier gets its own filter entry in list mode
+# (4 standard identifiers or 2 extended identifiers per bank), so the driver
+# dispatches a frame to its handler with no search (the filter match index
+# selects the call back). When the bank count exceeds --max-banks, identifiers
+# are merged into mask filters (2 standard masks or 1 extended mask per bank),
+# merging first the identifiers that accept the fewest unexpected identifiers;
+# frames accepted by a mask filter are dispatched by a binary search in the
+# dispatch table, and frames that are not in the DBC are ignored.
+#
+# Usage:
+#   python3 dbc2acan.py input.dbc --node NAME [--prefix PREFIX] [--output DIR]
+#                       [--bitrate BITS_PER_SECOND] [--max-banks N]
+#
+# Only the Python 3 standard library is required. Tests: test_dbc2acan.py.
+#-------------------------------------------------------------------------------
+
+import argparse
+import os
+import re
+import sys
+
+#-------------------------------------------------------------------------------
+#   DBC MODEL
+#-------------------------------------------------------------------------------
+
+class Signal:
+  def __init__ (self, name, start, length, motorola, signed, factor, offset, unit, receivers, multiplexing):
+    self.name = name
+    self.start = start
+    self.length = length
+    self.motorola = motorola
+    self.signed = signed
+    self.factor = factor
+    self.offset = offset
+    self.unit = unit
+    self.receivers = receivers
+    self.multiplexing = multiplexing # None, 'M' (multiplexor), or multiplexor value (int)
+
+#-------------------------------------------------------------------------------
+
+class Message:
+  def __init__ (self, identifier, extended, name, length, transmitter):
+    self.identifier = identifier
+    self.extended = extended
+    self.name = name
+    self.length = length
+    self.transmitter = transmitter
+    self.signals = []
+    self.cycleTime = 0 # ms, 0 if not periodic
+
+  def key (self):
+    return self.identifier | ((1 << 29) if self.extended else 0)
+
+  def receivers (self):
+    result = set ()
+    for signal in self.signals:
+      result.update (signal.receivers)
+    return result
+
+#-------------------------------------------------------------------------------
+#   DBC PARSER
+#-------------------------------------------------------------------------------
+
+MESSAGE_RE = re.compile (r'^BO_\s+(\d+)\s+(\w+)\s*:\s*(\d+)\s+(\w+)')
+SIGNAL_RE = re.compile (
+  r'^SG_\s+(\w+)\s*(M|m\d+)?\s*:\s*(\d+)\|(\d+)@([01])([+-])\s*'
+  r'\(\s*([^,\s]+)\s*,\s*([^)\s]+)\s*\)\s*\[[^\]]*\]\s*"([^"]*)"\s*(.*)$'
+)
+CYCLE_TIME_RE = re.compile (r'^BA_\s+"GenMsgCycleTime"\s+BO_\s+(\d+)\s+(\d+)\s*;')
+NODES_RE = re.compile (r'^BU_\s*:(.*)$')
+
+#--- Pseudo message of the signals that belong to no message (written by CANdb++)
+INDEPENDENT_SIGNALS_MESSAGE_NAME = 'VECTOR__INDEPENDENT_SIG_MSG'
+
+#-------------------------------------------------------------------------------
+
+def parseDBC (fileName):
+  messages = []
+  messageDictionary = {}
+  nodes = []
+  currentMessage = None
+  with open (fileName, encoding = 'latin-1') as f:
+    for lineNumber, rawLine in enumerate (f, 1):
+      line = rawLine.strip ()
+      m = NODES_RE.match (line)
+      if m:
+        nodes = m.group (1).split ()
+        continue
+      m = MESSAGE_RE.match (line)
+      if m:
+        rawIdentifier = int (m.group (1))
+        extended = (rawIdentifier & 0x80000000) != 0
+        identifier = rawIdentifier & 0x1FFFFFFF
+        if m.group (2) == INDEPENDENT_SIGNALS_MESSAGE_NAME: # Its signals are parsed, and dropped
+          currentMessage = Message (identifier, extended, m.group (2), 0, m.group (4))
+          continue
+        if not extended and identifier > 0x7FF:
+          sys.exit ('%s:%d: standard identifier 0x%X exceeds 11 bits' % (fileName, lineNumber, identifier))
+        currentMessage = Message (identifier, extended, m.group (2), int (m.group (3)), m.group (4))
+        if currentMessage.length > 8:
+          sys.exit ('%s:%d: message %s: length %d exceeds 8' % (fileName, lineNumber, currentMessage.name, currentMessage.length))
+        messages.append (currentMessage)
+        messageDictionary [rawIdentifier] = currentMessage
+        continue
+      m = SIGNAL_RE.match (line)
+      if m:
+        if currentMessage is None:
+          sys.exit ('%s:%d: signal outside message' % (fileName, lineNumber))
+        multiplexing = None
+        if m.group (2) == 'M':
+          multiplexing = 'M'
+        elif m.group (2) is not None:
+          multiplexing = int (m.group (2) [1:])
+        receivers = [r for r in re.split (r'[\s,]+', m.group (10).strip ()) if r and r != 'Vector__XXX']
+        currentMessage.signals.append (Signal (
+          m.group (1), int (m.group (3)), int (m.group (4)), m.group (5) == '0', m.group (6) == '-',
+          float (m.group (7)), float (m.group (8)), m.group (9), receivers, multiplexing
+        ))
+        continue
+      if line.startswith ('SG_'):
+        sys.exit ('%s:%d: cannot parse signal "%s"' % (fileName, lineNumber, line))
+      if line == '': # A blank line ends the signal list of a message
+        currentMessage = None
+      m = CYCLE_TIME_RE.match (line)
+      if m:
+        rawIdentifier = int (m.group (1))
+        if rawIdentifier in messageDictionary:
+          messageDictionary [rawIdentifier].cycleTime = int (m.group (2))
+  return nodes, messages
+
+#-------------------------------------------------------------------------------
+#   SIGNAL CHECKS
+#-------------------------------------------------------------------------------
+
+def checkSignal (message, signal):
+  if signal.length < 1 or signal.length > 64:
+    sys.exit ('message %s, signal %s: invalid length %d' % (message.name, signal.name, signal.length))
+  if signal.motorola:
+    msbPosition = (7 - signal.start // 8) * 8 + signal.start % 8
+    ok = msbPosition >= signal.length - 1
+  else:
+    ok = signal.start + signal.length <= 64
+  if not ok or signal.start > 63:
+    sys.exit ('message %s, signal %s: exceeds payload' % (message.name, signal.name))
+#--- Last byte of the signal: most significant byte (Intel) or least significant byte (Motorola)
+  if signal.motorola:
+    lastByte = 7 - (msbPosition - (signal.length - 1)) // 8
+  else:
+    lastByte = (signal.start + signal.length - 1) // 8
+  if lastByte >= message.length:
+    sys.exit ('message %s, signal %s: exceeds message length %d' % (message.name, signal.name, message.length))
+  if signal.factor == 0.0:
+    sys.exit ('message %s, signal %s: factor is 0' % (message.name, signal.name))
+
+#-------------------------------------------------------------------------------
+#   FRAME DURATION (same as ACAN_STM32_Settings::worstCaseFrameBitCount)
+#-------------------------------------------------------------------------------
+
+def worstCaseFrameBitCount (length, extended):
+  if extended:
+    return 67 + 8 * length + (54 + 8 * length - 1) // 4
+  else:
+    return 47 + 8 * length + (34 + 8 * length - 1) // 4
+
+#-------------------------------------------------------------------------------
+#   FILTERS
+#-------------------------------------------------------------------------------
+
+class MaskGroup:
+  def __init__ (self, keys, extended):
+    self.keys = sorted (keys)
+    self.extended = extended
+    bits = 29 if extended else 11
+    allOnes = (1 << bits) - 1
+    self.base = self.keys [0] & allOnes
+    self.mask = allOnes
+    for k in self.keys:
+      self.mask &= ~ ((k & allOnes) ^ self.base)
+    self.base &= self.mask
+    self.wildcardCount = bits - bin (self.mask).count ('1')
+
+  def acceptedCount (self):
+    return 1 << self.wildcardCount
+
+#-------------------------------------------------------------------------------
+
+def bankCount (standardList, standardGroups, extendedList, extendedGroups):
+  return ((len (standardList) + 3) // 4 + (len (standardGroups) + 1) // 2
+          + (len (extendedList) + 1) // 2 + len (extendedGroups))
+
+#-------------------------------------------------------------------------------
+# Greedy merge: items are single identifiers (list mode) or mask groups; only
+# neighbour items (in identifier order) are candidates, the merge that adds the
+# fewest unexpected accepted identifiers is done first.
+
+def computeFilters (receivedMessages, maxBanks):
+  standard = [[m.identifier] for m in receivedMessages if not m.extended]
+  extended = [[m.identifier] for m in receivedMessages if m.extended]
+  standard.sort ()
+  extended.sort ()
+  def split ():
+    sl = [i [0] for i in standard if len (i) == 1]
+    sg = [MaskGroup (i, False) for i in standard if len (i) > 1]
+    el = [i [0] for i in extended if len (i) == 1]
+    eg = [MaskGroup (i, True) for i in extended if len (i) > 1]
+    return sl, sg, el, eg
+  while bankCount (*split ()) > maxBanks:
+    best = None
+    for items, isExtended in ((standard, False), (extended, True)):
+      for i in range (len (items) - 1):
+        merged = MaskGroup (items [i] + items [i + 1], isExtended)
+        cost = merged.acceptedCount () - len (merged.keys)
+        if best is None or cost < best [0]:
+          best = (cost, items, i)
+    if best is None:
+      break
+    cost, items, i = best
+    items [i : i + 2] = [sorted (items [i] + items [i + 1])]
+  return split ()
+
+#-------------------------------------------------------------------------------
+#   CODE GENERATION
+#-------------------------------------------------------------------------------
+
+def cIdentifier (name):
+  result = re.sub (r'\W', '_', name)
+  if result [0].isdigit ():
+    result = '_' + result
+  return result
+
+#-------------------------------------------------------------------------------
+
+def floatLiteral (value):
+  return repr (float (value)) + 'f'
+
+#-------------------------------------------------------------------------------
+
+def signalType (signal):
+  return 'ACAN_STM32_Signal <%d, %d, %s, %s>' % (
+    signal.start, signal.length, 'kMotorola' if signal.motorola else 'kIntel', 'true' if signal.signed else 'false'
+  )
+
+#-------------------------------------------------------------------------------
+
+def handlerName (prefix, message):
+  return '%s_%s_received' % (prefix, cIdentifier (message.name))
+
+#-------------------------------------------------------------------------------
+
+def generateHeader (prefix, node, messages, receivedMessages):
+  s = '#pragma once\n\n'
+  s += '//' + '-' * 78 + '\n'
+  s += '// Generated by dbc2acan.py for node %s: do not edit\n' % node
+  s += '//' + '-' * 78 + '\n\n'
+  s += '#include <ACAN_STM32.h>\n#include <ACAN_STM32_Signal.h>\n\n'
+  for message in messages:
+    className = '%s_%s' % (prefix, cIdentifier (message.name))
+    s += '//' + '-' * 78 + '\n\n'
+    s += 'class %s {\n' % className
+    s += '  public: static const uint32_t IDENTIFIER = 0x%X ;\n' % message.identifier
+    s += '  public: static const bool EXTENDED = %s ;\n' % ('true' if message.extended else 'false')
+    s += '  public: static const uint8_t LENGTH = %d ;\n' % message.length
+    s += '  public: static const uint32_t CYCLE_TIME = %d ; // ms, 0 if not periodic\n' % message.cycleTime
+    multiplexor = None
+    for signal in message.signals:
+      if signal.multiplexing == 'M':
+        multiplexor = signal
+  #--- The multiplexor type is declared before multiplexed signals
+    for signal in sorted (message.signals, key = lambda sg : sg.multiplexing != 'M'):
+      checkSignal (message, signal)
+      name = cIdentifier (signal.name)
+      unit = (' // ' + signal.unit) if signal.unit else ''
+      scaling = '%s, %s' % (floatLiteral (signal.factor), floatLiteral (signal.offset))
+      if isinstance (signal.multiplexing, int):
+        if multiplexor is None:
+          sys.exit ('message %s, signal %s: no multiplexor' % (message.name, signal.name))
+        s += '  public: static constexpr ACAN_STM32_MultiplexedSignal <%s_Type, %d, %s> %s {%s (%s)} ;%s\n' % (
+          cIdentifier (multiplexor.name), signal.multiplexing, signalType (signal), name, signalType (signal), scaling, unit
+        )
+      else:
+        s += '  public: typedef %s %s_Type ;\n' % (signalType (signal), name)
+        s += '  public: static constexpr %s_Type %s {%s} ;%s\n' % (name, name, scaling, unit)
+    s += '} ;\n\n'
+  s += '//' + '-' * 78 + '\n'
+  s += '// Reception handlers (weak, empty by default: define the ones you need)\n'
+  s += '//' + '-' * 78 + '\n\n'
+  for message in receivedMessages:
+    s += 'void %s (const CANMessage & inMessage) ;\n' % handlerName (prefix, message)
+  s += '\n//' + '-' * 78 + '\n'
+  s += '// Filters for the %d messages received by %s, with their handlers\n' % (len (receivedMessages), node)
+  s += '//' + '-' * 78 + '\n\n'
+  s += 'void %s_configureFilters (ACAN_STM32::Filters & ioFilters,\n' % prefix
+  s += ' ' * (len (prefix) + 24) + 'const ACAN_STM32::Action inAction = ACAN_STM32::FIFO0) ;\n\n'
+  s += '//' + '-' * 78 + '\n'
+  s += '// Dispatch by identifier (binary search); returns false if the message is unknown\n'
+  s += '//' + '-' * 78 + '\n\n'
+  s += 'bool %s_dispatch (const CANMessage & inMessage) ;\n\n' % prefix
+  s += '//' + '-' * 78 + '\n'
+  return s
+
+#-------------------------------------------------------------------------------
+
+def generateSource (prefix, node, receivedMessages, filters):
+  standardList, standardGroups, extendedList, extendedGroups = filters
+  byKey = {m.key () : m for m in receivedMessages}
+  s = '//' + '-' * 78 + '\n'
+  s += '// Generated by dbc2acan.py for node %s: do not edit\n' % node
+  s += '//' + '-' * 78 + '\n\n'
+  s += '#include "%s.h"\n\n' % prefix
+  s += '//' + '-' * 78 + '\n'
+  s += '//   HANDLERS\n'
+  s += '//' + '-' * 78 + '\n\n'
+  for message in receivedMessages:
+    s += '__attribute__ ((weak)) void %s (const CANMessage & /* inMessage */) {\n}\n\n' % handlerName (prefix, message)
+  s += '//' + '-' * 78 + '\n'
+  s += '//   DISPATCH TABLE (sorted by key: identifier, bit 29 set for extended)\n'
+  s += '//' + '-' * 78 + '\n\n'
+  s += 'typedef struct {\n  uint32_t mKey ;\n  ACANCallBackRoutine mHandler ;\n} %s_DispatchEntry ;\n\n' % prefix
+  s += 'static const %s_DispatchEntry DISPATCH_TABLE [%d] = {\n' % (prefix, max (1, len (receivedMessages)))
+  entries = []
+  for key in sorted (byKey):
+    entries.append ('  {0x%08X, %s}' % (key, handlerName (prefix, byKey [key])))
+  if not entries:
+    entries.append ('  {0xFFFFFFFF, nullptr}')
+  s += ',\n'.join (entries) + '\n} ;\n\n'
+  s += 'static const uint32_t DISPATCH_TABLE_SIZE = %d ;\n\n' % len (receivedMessages)
+  s += '//' + '-' * 78 + '\n\n'
+  s += 'bool %s_dispatch (const CANMessage & inMessage) {\n' % prefix
+  s += '  const uint32_t key = inMessage.id | (inMessage.ext ? (1U << 29) : 0) ;\n'
+  s += '  uint32_t low = 0 ;\n'
+  s += '  uint32_t high = DISPATCH_TABLE_SIZE ;\n'
+  s += '  while (low < high) {\n'
+  s += '    const uint32_t middle = (low + high) / 2 ;\n'
+  s += '    if (DISPATCH_TABLE [middle].mKey < key) {\n'
+  s += '      low = middle + 1 ;\n'
+  s += '    }else{\n'
+  s += '      high = middle ;\n'
+  s += '    }\n'
+  s += '  }\n'
+  s += '  const bool found = (low < DISPATCH_TABLE_SIZE) && (DISPATCH_TABLE [low].mKey == key) ;\n'
+  s += '  if (found) {\n'
+  s += '    DISPATCH_TABLE [low].mHandler (inMessage) ;\n'
+  s += '  }\n'
+  s += '  return found ;\n'
+  s += '}\n\n'
+  if standardGroups or extendedGroups:
+    s += '//' + '-' * 78 + '\n'
+    s += '//   DISPATCH FOR MASK FILTERS\n'
+    s += '//' + '-' * 78 + '\n\n'
+    s += 'static void dispatchMaskFilter (const CANMessage & inMessage) {\n'
+    s += '  %s_dispatch (inMessage) ;\n' % prefix
+    s += '}\n\n'
+  s += '//' + '-' * 78 + '\n'
+  s += '//   FILTERS\n'
+  s += '//' + '-' * 78 + '\n\n'
+  s += 'void %s_configureFilters (ACAN_STM32::Filters & ioFilters,\n' % prefix
+  s += ' ' * (len (prefix) + 24) + 'const ACAN_STM32::Action inAction) {\n'
+  if (len (standardList) + len (standardGroups) + len (extendedList) + len (extendedGroups)) == 0:
+    s += '  (void) ioFilters ;\n  (void) inAction ;\n'
+  def handler (identifier, extended):
+    return handlerName (prefix, byKey [identifier | ((1 << 29) if extended else 0)])
+#--- Standard identifiers, list mode (a quad is padded by repeating its last identifier)
+  for i in range (0, len (standardList), 4):
+    quad = standardList [i : i + 4]
+    quad += [quad [-1]] * (4 - len (quad))
+    s += '  ioFilters.addStandardQuad ('
+    s += ',\n                             '.join ('0x%03X, false, %s' % (identifier, handler (identifier, False)) for identifier in quad)
+    s += ',\n                             inAction) ;\n'
+#--- Standard mask groups (a pair is padded by repeating its last group)
+  for i in range (0, len (standardGroups), 2):
+    pair = standardGroups [i : i + 2]
+    pair += [pair [-1]] * (2 - len (pair))
+    s += '  ioFilters.addStandardMasks ('
+    s += ',\n                              '.join ('0x%03X, 0x%03X, ACAN_STM32::DATA, dispatchMaskFilter' % (g.base, g.mask) for g in pair)
+    s += ',\n                              inAction) ;\n'
+#--- Extended identifiers, list mode (a pair is padded by repeating its last identifier)
+  for i in range (0, len (extendedList), 2):
+    pair = extendedList [i : i + 2]
+    pair += [pair [-1]] * (2 - len (pair))
+    s += '  ioFilters.addExtendedDual ('
+    s += ',\n                             '.join ('0x%08X, false, %s' % (identifier, handler (identifier, True)) for identifier in pair)
+    s += ',\n                             inAction) ;\n'
+#--- Extended mask groups
+  for g in extendedGroups:
+    s += '  ioFilters.addExtendedMask (0x%08X, 0x%08X, ACAN_STM32::DATA, dispatchMaskFilter, inAction) ;\n' % (g.base, g.mask)
+  s += '}\n\n'
+  s += '//' + '-' * 78 + '\n'
+  return s
+
+#-------------------------------------------------------------------------------
+#   REPORT
+#-------------------------------------------------------------------------------
+
+def generateReport (dbcFileName, node, bitRate, maxBanks, messages, receivedMessages, filters):
+  standardList, standardGroups, extendedList, extendedGroups = filters
+  bitDuration = 1.0 / bitRate
+  lines = []
+  lines.append ('dbc2acan report for %s, node %s, %d bit/s' % (os.path.basename (dbcFileName), node, bitRate))
+  lines.append ('')
+  lines.append ('%-32s %-11s %3s %8s %5s %8s  %s' % ('Message', 'Identifier', 'DLC', 'Cycle', 'Bits', 'Load', 'Direction'))
+  totalLoad = 0.0
+  transmittedLoad = 0.0
+  receivedSet = set (m.key () for m in receivedMessages)
+  for message in messages:
+    bits = worstCaseFrameBitCount (message.length, message.extended)
+    load = (bits * bitDuration * 1000.0 / message.cycleTime) if message.cycleTime > 0 else 0.0
+    totalLoad += load
+    direction = 'transmitted' if message.transmitter == node else ('received' if message.key () in receivedSet else '-')
+    if direction == 'transmitted':
+      transmittedLoad += load
+    lines.append ('%-32s %-11s %3d %8s %5d %7.2f%%  %s' % (
+      message.name [:32],
+      ('0x%08X' if message.extended else '0x%03X') % message.identifier,
+      message.length,
+      ('%d ms' % message.cycleTime) if message.cycleTime > 0 else '-',
+      bits, load * 100.0, direction
+    ))
+  lines.append ('')
+  lines.append ('Worst-case bus load (periodic messages): %.2f%%' % (totalLoad * 100.0))
+  lines.append ('  transmitted by %s: %.2f%%' % (node, transmittedLoad * 100.0))
+  lines.append ('')
+  banks = bankCount (standardList, standardGroups, extendedList, extendedGroups)
+  lines.append ('Filters: %d received messages, %d filter banks (max %d)' % (len (receivedMessages), banks, maxBanks))
+  lines.append ('  standard list: %d identifiers, standard masks: %d, extended list: %d identifiers, extended masks: %d' % (
+    len (standardList), len (standardGroups), len (extendedList), len (extendedGroups)
+  ))
+  unexpected = sum (g.acceptedCount () - len (g.keys) for g in standardGroups + extendedGroups)
+  lines.append ('  unexpected identifiers accepted by mask filters: %d' % unexpected)
+  if banks > maxBanks:
+    lines.append ('  WARNING: filter bank count exceeds %d' % maxBanks)
+  filterEntryCount = 4 * ((len (standardList) + 3) // 4) + 2 * ((len (standardGroups) + 1) // 2) \
+                   + 2 * ((len (extendedList) + 1) // 2) + len (extendedGroups)
+  lines.append ('')
+  lines.append ('Memory footprint (32-bit target):')
+  lines.append ('  RAM, driver call back array: %d bytes (heap, one pointer per filter entry)' % (4 * filterEntryCount))
+  lines.append ('  RAM, ACAN_STM32::Filters while configuring: %d bytes (heap, released after begin)' % (
+    8 * banks + 4 * filterEntryCount
+  ))
+  lines.append ('  Flash, dispatch table: %d bytes' % (8 * max (1, len (receivedMessages))))
+  lines.append ('  Signal codecs: no RAM (constexpr); factor and offset are folded into the code')
+  return '\n'.join (lines) + '\n'
+
+#-------------------------------------------------------------------------------
+#   MAIN
+#-------------------------------------------------------------------------------
+
+def main ():
+  parser = argparse.ArgumentParser (description = 'DBC to ACAN_STM32 code generator')
+  parser.add_argument ('dbc', help = 'input DBC file')
+  parser.add_argument ('--node', required = True, help = 'node the code is generated for')
+  parser.add_argument ('--prefix', help = 'prefix of generated files and identifiers (default: DBC file name)')
+  parser.add_argument ('--output', default = '.', help = 'output directory')
+  parser.add_argument ('--bitrate', type = int, default = 500000, help = 'bit rate, for the bus load report')
+  parser.add_argument ('--max-banks', type = int, default = 14, help = 'available filter banks (14, or 28 shared on STM32F446)')
+  args = parser.parse_args ()
+  prefix = cIdentifier (args.prefix if args.prefix else os.path.splitext (os.path.basename (args.dbc)) [0])
+  nodes, messages = parseDBC (args.dbc)
+  if nodes and args.node not in nodes:
+    sys.exit ('node %s is not declared in BU_ (%s)' % (args.node, ', '.join (nodes)))
+  keys = set ()
+  for message in messages:
+    if message.key () in keys:
+      sys.exit ('message %s: duplicate identifier 0x%X' % (message.name, message.identifier))
+    keys.add (message.key ())
+  receivedMessages = [m for m in messages if m.transmitter != args.node and args.node in m.receivers ()]
+  receivedMessages.sort (key = lambda m : m.key ())
+  filters = computeFilters (receivedMessages, args.max_banks)
+  os.makedirs (args.output, exist_ok = True)
+  outputs = (
+    (prefix + '.h', generateHeader (prefix, args.node, messages, receivedMessages)),
+    (prefix + '.cpp', generateSource (prefix, args.node, receivedMessages, filters)),
+    (prefix + '_report.txt', generateReport (args.dbc, args.node, args.bitrate, args.max_banks, messages, receivedMessages, filters))
+  )
+  for fileName, contents in outputs:
+    with open (os.path.join (args.output, fileName), 'w') as f:
+      f.write (contents)
+
+#-------------------------------------------------------------------------------
+
+if __name__ == '__main__':
+  main ()
+
+#-------------------------------------------------------------------------------
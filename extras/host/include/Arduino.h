@@ -0,0 +1,392 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Host build of the library: Arduino core, CMSIS and LL subset used by src/
+//
+// Registers of the CAN peripherals, RCC and DWT->CYCCNT are HostRegister
+// objects: every access is forwarded to the bxCAN simulator (HostSimulator.cpp),
+// that implements their hardware semantics (write 1 to clear bits, mailbox and
+// FIFO state, error counters, peripheral reset...), advances the virtual time,
+// and runs pending interrupt handlers, as the NVIC would. Other registers (GPIO)
+// are plain memory.
+//
+// The device is selected by STM32F446xx (dual CAN, 28 filter banks, the
+// default) or STM32F303x8 (single CAN, 14 filter banks).
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+//------------------------------------------------------------------------------
+
+#if !defined (STM32F446xx) && !defined (STM32F303x8)
+  #define STM32F446xx
+#endif
+
+//------------------------------------------------------------------------------
+//   SIMULATED REGISTER
+//------------------------------------------------------------------------------
+
+class HostRegister ;
+
+uint32_t hostRegisterRead (const volatile HostRegister * inRegister) ;
+void hostRegisterWrite (volatile HostRegister * inRegister, const uint32_t inValue) ;
+
+//------------------------------------------------------------------------------
+
+class HostRegister {
+  public: inline operator uint32_t (void) const volatile {
+    return hostRegisterRead (this) ;
+  }
+
+  public: inline void operator = (const uint32_t inValue) volatile {
+    hostRegisterWrite (this, inValue) ;
+  }
+
+  public: inline void operator |= (const uint32_t inValue) volatile {
+    hostRegisterWrite (this, hostRegisterRead (this) | inValue) ;
+  }
+
+  public: inline void operator &= (const uint32_t inValue) volatile {
+    hostRegisterWrite (this, hostRegisterRead (this) & inValue) ;
+  }
+
+//--- Storage, accessed by the simulator without side effect
+  public: uint32_t mValue ;
+} ;
+
+//------------------------------------------------------------------------------
+//   DEVICE
+//------------------------------------------------------------------------------
+
+#define __NVIC_PRIO_BITS 4
+
+#ifdef STM32F446xx
+  typedef enum {
+    CAN1_TX_IRQn = 19, CAN1_RX0_IRQn = 20, CAN1_RX1_IRQn = 21, CAN1_SCE_IRQn = 22,
+    CAN2_TX_IRQn = 63, CAN2_RX0_IRQn = 64, CAN2_RX1_IRQn = 65, CAN2_SCE_IRQn = 66
+  } IRQn_Type ;
+  static const uint32_t HOST_CAN_COUNT = 2 ;
+  static const uint32_t HOST_FILTER_BANK_COUNT = 28 ;
+  static const uint32_t HOST_CORE_CLOCK = 180 * 1000 * 1000 ;
+  static const uint32_t HOST_PCLK1 = 45 * 1000 * 1000 ;
+#else
+  typedef enum {
+    CAN_TX_IRQn = 19, CAN_RX0_IRQn = 20, CAN_RX1_IRQn = 21, CAN_SCE_IRQn = 22
+  } IRQn_Type ;
+  static const uint32_t HOST_CAN_COUNT = 1 ;
+  static const uint32_t HOST_FILTER_BANK_COUNT = 14 ;
+  static const uint32_t HOST_CORE_CLOCK = 64 * 1000 * 1000 ;
+  static const uint32_t HOST_PCLK1 = 32 * 1000 * 1000 ;
+#endif
+
+//------------------------------------------------------------------------------
+
+typedef struct {
+  volatile HostRegister TIR ;
+  volatile HostRegister TDTR ;
+  volatile HostRegister TDLR ;
+  volatile HostRegister TDHR ;
+} CAN_TxMailBox_TypeDef ;
+
+typedef struct {
+  volatile HostRegister RIR ;
+  volatile HostRegister RDTR ;
+  volatile HostRegister RDLR ;
+  volatile HostRegister RDHR ;
+} CAN_FIFOMailBox_TypeDef ;
+
+typedef struct {
+  volatile HostRegister FR1 ;
+  volatile HostRegister FR2 ;
+} CAN_FilterRegister_TypeDef ;
+
+typedef struct {
+  volatile HostRegister MCR ;
+  volatile HostRegister MSR ;
+  volatile HostRegister TSR ;
+  volatile HostRegister RF0R ;
+  volatile HostRegister RF1R ;
+  volatile HostRegister IER ;
+  volatile HostRegister ESR ;
+  volatile HostRegister BTR ;
+  uint32_t RESERVED0 [88] ;
+  CAN_TxMailBox_TypeDef sTxMailBox [3] ;
+  CAN_FIFOMailBox_TypeDef sFIFOMailBox [2] ;
+  uint32_t RESERVED1 [12] ;
+  volatile HostRegister FMR ;
+  volatile HostRegister FM1R ;
+  uint32_t RESERVED2 ;
+  volatile HostRegister FS1R ;
+  uint32_t RESERVED3 ;
+  volatile HostRegister FFA1R ;
+  uint32_t RESERVED4 ;
+  volatile HostRegister FA1R ;
+  uint32_t RESERVED5 [8] ;
+  CAN_FilterRegister_TypeDef sFilterRegister [28] ;
+} CAN_TypeDef ;
+
+typedef struct {
+  volatile uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR, AFR [2] ;
+} GPIO_TypeDef ;
+
+typedef struct {
+  volatile HostRegister APB1RSTR ;
+  volatile HostRegister APB1ENR ;
+} RCC_TypeDef ;
+
+typedef struct {
+  volatile uint32_t CTRL ;
+  volatile HostRegister CYCCNT ;
+} DWT_Type ;
+
+typedef struct {
+  volatile uint32_t DEMCR ;
+} CoreDebug_Type ;
+
+//------------------------------------------------------------------------------
+
+extern CAN_TypeDef gHostCAN [HOST_CAN_COUNT] ;
+extern GPIO_TypeDef gHostGPIO [2] ;
+extern RCC_TypeDef gHostRCC ;
+extern DWT_Type gHostDWT ;
+extern CoreDebug_Type gHostCoreDebug ;
+
+#define GPIOA (& gHostGPIO [0])
+#define GPIOB (& gHostGPIO [1])
+#define RCC (& gHostRCC)
+#define DWT (& gHostDWT)
+#define CoreDebug (& gHostCoreDebug)
+
+#ifdef STM32F446xx
+  #define CAN1 (& gHostCAN [0])
+  #define CAN2 (& gHostCAN [1])
+  #define RCC_APB1ENR_CAN1EN_Pos 25
+  #define RCC_APB1ENR_CAN2EN_Pos 26
+  #define RCC_APB1RSTR_CAN1RST_Pos 25
+  #define RCC_APB1RSTR_CAN2RST_Pos 26
+#else
+  #define CAN (& gHostCAN [0])
+  #define CAN1 CAN // Alias of the device header
+  #define RCC_APB1ENR_CANEN_Pos 25
+  #define RCC_APB1RSTR_CANRST_Pos 25
+#endif
+
+//------------------------------------------------------------------------------
+//   REGISTER BITS
+//------------------------------------------------------------------------------
+
+#define CAN_MCR_INRQ  (1U << 0)
+#define CAN_MCR_SLEEP (1U << 1)
+#define CAN_MCR_TXFP  (1U << 2)
+#define CAN_MCR_RFLM  (1U << 3)
+#define CAN_MCR_NART  (1U << 4)
+#define CAN_MCR_AWUM  (1U << 5)
+#define CAN_MCR_ABOM  (1U << 6)
+#define CAN_MCR_TTCM  (1U << 7)
+#define CAN_MCR_RESET (1U << 15)
+
+#define CAN_MSR_INAK  (1U << 0)
+#define CAN_MSR_SLAK  (1U << 1)
+#define CAN_MSR_ERRI  (1U << 2)
+#define CAN_MSR_WKUI  (1U << 3)
+#define CAN_MSR_SLAKI (1U << 4)
+
+#define CAN_TSR_RQCP0 (1U << 0)
+#define CAN_TSR_TXOK0 (1U << 1)
+#define CAN_TSR_ALST0 (1U << 2)
+#define CAN_TSR_TERR0 (1U << 3)
+#define CAN_TSR_ABRQ0 (1U << 7)
+#define CAN_TSR_RQCP1 (1U << 8)
+#define CAN_TSR_TXOK1 (1U << 9)
+#define CAN_TSR_ALST1 (1U << 10)
+#define CAN_TSR_TERR1 (1U << 11)
+#define CAN_TSR_ABRQ1 (1U << 15)
+#define CAN_TSR_RQCP2 (1U << 16)
+#define CAN_TSR_TXOK2 (1U << 17)
+#define CAN_TSR_ALST2 (1U << 18)
+#define CAN_TSR_TERR2 (1U << 19)
+#define CAN_TSR_ABRQ2 (1U << 23)
+#define CAN_TSR_CODE_Pos 24
+#define CAN_TSR_CODE (3U << 24)
+#define CAN_TSR_TME0_Pos 26
+#define CAN_TSR_TME0 (1U << 26)
+#define CAN_TSR_TME1 (1U << 27)
+#define CAN_TSR_TME2 (1U << 28)
+#define CAN_TSR_TME (7U << 26)
+
+#define CAN_RF0R_FMP0 (3U << 0)
+#define CAN_RF0R_FULL0_Pos 3
+#define CAN_RF0R_FULL0 (1U << 3)
+#define CAN_RF0R_FOVR0_Pos 4
+#define CAN_RF0R_FOVR0 (1U << 4)
+#define CAN_RF0R_RFOM0 (1U << 5)
+#define CAN_RF1R_FMP1 (3U << 0)
+#define CAN_RF1R_FULL1_Pos 3
+#define CAN_RF1R_FULL1 (1U << 3)
+#define CAN_RF1R_FOVR1_Pos 4
+#define CAN_RF1R_FOVR1 (1U << 4)
+#define CAN_RF1R_RFOM1 (1U << 5)
+
+#define CAN_IER_TMEIE  (1U << 0)
+#define CAN_IER_FMPIE0 (1U << 1)
+#define CAN_IER_FFIE0  (1U << 2)
+#define CAN_IER_FOVIE0 (1U << 3)
+#define CAN_IER_FMPIE1 (1U << 4)
+#define CAN_IER_FFIE1  (1U << 5)
+#define CAN_IER_FOVIE1 (1U << 6)
+#define CAN_IER_EWGIE  (1U << 8)
+#define CAN_IER_EPVIE  (1U << 9)
+#define CAN_IER_BOFIE  (1U << 10)
+#define CAN_IER_LECIE  (1U << 11)
+#define CAN_IER_ERRIE  (1U << 15)
+
+#define CAN_ESR_EWGF (1U << 0)
+#define CAN_ESR_EPVF (1U << 1)
+#define CAN_ESR_BOFF (1U << 2)
+#define CAN_ESR_LEC_Pos 4
+#define CAN_ESR_LEC (7U << 4)
+#define CAN_ESR_TEC_Pos 16
+#define CAN_ESR_TEC (0xFFU << 16)
+#define CAN_ESR_REC_Pos 24
+#define CAN_ESR_REC (0xFFU << 24)
+
+#define CAN_BTR_BRP_Pos 0
+#define CAN_BTR_TS1_Pos 16
+#define CAN_BTR_TS2_Pos 20
+#define CAN_BTR_SJW_Pos 24
+#define CAN_BTR_LBKM (1U << 30)
+#define CAN_BTR_SILM (1U << 31)
+
+#define CAN_FMR_FINIT (1U << 0)
+#define CAN_FMR_CAN2SB_Pos 8
+#define CAN_FMR_CAN2SB (0x3FU << 8)
+
+#define CoreDebug_DEMCR_TRCENA_Msk (1U << 24)
+#define DWT_CTRL_CYCCNTENA_Msk (1U << 0)
+
+//------------------------------------------------------------------------------
+//   LL GPIO (pins are not simulated)
+//------------------------------------------------------------------------------
+
+#define LL_GPIO_MODE_ALTERNATE 2
+#define LL_GPIO_OUTPUT_PUSHPULL 0
+#define LL_GPIO_OUTPUT_OPENDRAIN 1
+#define LL_GPIO_SPEED_FREQ_HIGH 2
+
+inline void LL_GPIO_SetPinMode (GPIO_TypeDef *, const uint32_t, const uint32_t) {}
+inline void LL_GPIO_SetPinOutputType (GPIO_TypeDef *, const uint32_t, const uint32_t) {}
+inline void LL_GPIO_SetPinSpeed (GPIO_TypeDef *, const uint32_t, const uint32_t) {}
+inline void LL_GPIO_SetAFPin_0_7 (GPIO_TypeDef *, const uint32_t, const uint32_t) {}
+inline void LL_GPIO_SetAFPin_8_15 (GPIO_TypeDef *, const uint32_t, const uint32_t) {}
+
+//------------------------------------------------------------------------------
+//   CORE (NVIC and interrupt masking are simulated)
+//------------------------------------------------------------------------------
+
+void NVIC_EnableIRQ (const IRQn_Type inIRQ) ;
+void NVIC_DisableIRQ (const IRQn_Type inIRQ) ;
+void NVIC_SetPriority (const IRQn_Type inIRQ, const uint32_t inPriority) ;
+inline void NVIC_ClearPendingIRQ (const IRQn_Type) {} // Interrupt lines are level sensitive
+uint32_t __get_PRIMASK (void) ;
+void __set_PRIMASK (const uint32_t inValue) ;
+void __disable_irq (void) ;
+void __enable_irq (void) ;
+uint32_t __get_BASEPRI (void) ;
+void __set_BASEPRI (const uint32_t inValue) ;
+void __set_BASEPRI_MAX (const uint32_t inValue) ;
+uint32_t __get_IPSR (void) ;
+inline void __DSB (void) {}
+inline void __ISB (void) {}
+
+uint32_t HAL_RCC_GetPCLK1Freq (void) ;
+extern uint32_t SystemCoreClock ;
+
+//------------------------------------------------------------------------------
+//   ARDUINO
+//------------------------------------------------------------------------------
+
+uint32_t millis (void) ;
+uint32_t micros (void) ;
+void delay (const uint32_t inMillis) ;
+void yield (void) ;
+inline void noInterrupts (void) { __disable_irq () ; }
+inline void interrupts (void) { __enable_irq () ; }
+long random (const long inMax) ; // Deterministic sequence
+long random (const long inMin, const long inMax) ;
+
+template <typename T, typename U> inline auto min (const T & a, const U & b) -> decltype (a + b) {
+  return (a < b) ? a : b ;
+}
+
+template <typename T, typename U> inline auto max (const T & a, const U & b) -> decltype (a + b) {
+  return (a > b) ? a : b ;
+}
+
+//--- Pins (LED_BUILTIN is kept in memory, other pins read 0)
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define LED_BUILTIN 13
+
+void pinMode (const uint32_t inPin, const uint32_t inMode) ;
+void digitalWrite (const uint32_t inPin, const uint32_t inValue) ;
+int digitalRead (const uint32_t inPin) ;
+
+//------------------------------------------------------------------------------
+//   SERIAL (standard output)
+//------------------------------------------------------------------------------
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class HostSerial {
+  public: void begin (const uint32_t) {}
+  public: operator bool (void) const { return true ; }
+  public: void flush (void) { fflush (stdout) ; }
+
+  public: void print (const char * inString) { fputs (inString, stdout) ; }
+  public: void print (const char inChar) { putchar (inChar) ; }
+  public: void print (const double inValue, const int inDigits = 2) { printf ("%.*f", inDigits, inValue) ; }
+  public: void print (const int inValue, const int inBase = DEC) { printSigned (inValue, inBase) ; }
+  public: void print (const long inValue, const int inBase = DEC) { printSigned (inValue, inBase) ; }
+  public: void print (const long long inValue, const int inBase = DEC) { printSigned (inValue, inBase) ; }
+  public: void print (const unsigned char inValue, const int inBase = DEC) { printUnsigned (inValue, inBase) ; }
+  public: void print (const unsigned inValue, const int inBase = DEC) { printUnsigned (inValue, inBase) ; }
+  public: void print (const unsigned long inValue, const int inBase = DEC) { printUnsigned (inValue, inBase) ; }
+  public: void print (const unsigned long long inValue, const int inBase = DEC) { printUnsigned (inValue, inBase) ; }
+
+  public: void println (void) { putchar ('\n') ; }
+  public: template <typename T> void println (const T & inValue) { print (inValue) ; println () ; }
+  public: template <typename T> void println (const T & inValue, const int inFormat) { print (inValue, inFormat) ; println () ; }
+
+  private: void printSigned (const long long inValue, const int inBase) {
+    if ((inBase == DEC) && (inValue < 0)) {
+      putchar ('-') ;
+      printUnsigned (0ULL - (unsigned long long) inValue, DEC) ;
+    }else{
+      printUnsigned ((unsigned long long) inValue, inBase) ;
+    }
+  }
+
+  private: void printUnsigned (unsigned long long inValue, const int inBase) {
+    char buffer [65] ;
+    uint32_t idx = sizeof (buffer) ;
+    buffer [--idx] = '\0' ;
+    do{
+      const uint32_t digit = uint32_t (inValue % unsigned (inBase)) ;
+      buffer [--idx] = char ((digit < 10) ? ('0' + digit) : ('A' + digit - 10)) ;
+      inValue /= unsigned (inBase) ;
+    }while (inValue != 0) ;
+    fputs (& buffer [idx], stdout) ;
+  }
+} ;
+
+extern HostSerial Serial ;
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,53 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Host notifier for blocking receive and send methods
+//   Binary semaphore semantics in virtual time, as ACAN_STM32_FreeRTOSNotifier:
+//   notifyFromISR records the notification, wait lets virtual time run (bus
+//   frames, ISRs) until a notification is recorded, or until inTimeoutMillis is
+//   elapsed; the notification is consumed. A notification that occurs before
+//   wait is called is not lost.
+//   Counters give the waits, the notifications, and the waits that timed out.
+//
+//   static HostNotifier gReceiveNotifier ;
+//   ...
+//   can.setReceiveNotifier (& gReceiveNotifier) ;
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32_Notifier.h>
+#include <HostSimulator.h>
+
+//------------------------------------------------------------------------------
+
+class HostNotifier : public ACAN_STM32_Notifier {
+
+  public: HostNotifier (void) { }
+
+  public: virtual void notifyFromISR (void) override {
+    mNotified = true ;
+    mNotifyCount += 1 ;
+  }
+
+  public: virtual void wait (const uint32_t inTimeoutMillis) override {
+    mWaitCount += 1 ;
+    if (!hostRunUntil ([this] () { return mNotified ; }, uint64_t (inTimeoutMillis) * 1000 * 1000)) {
+      mTimeoutCount += 1 ;
+    }
+    mNotified = false ;
+  }
+
+  public: uint32_t waitCount (void) const { return mWaitCount ; }
+  public: uint32_t notifyCount (void) const { return mNotifyCount ; }
+  public: uint32_t timeoutCount (void) const { return mTimeoutCount ; }
+
+  private: volatile bool mNotified = false ;
+  private: uint32_t mWaitCount = 0 ;
+  private: uint32_t mNotifyCount = 0 ;
+  private: uint32_t mTimeoutCount = 0 ;
+
+//--- No copy
+  private : HostNotifier (const HostNotifier &) = delete ;
+  private : HostNotifier & operator = (const HostNotifier &) = delete ;
+} ;
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,237 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// bxCAN simulator: test interface
+//
+// Time is virtual (in ns). It advances by the access duration at every
+// simulated register access and at every millis / micros call (so busy wait
+// loops of the driver terminate), and by hostRun, that stands for an idle main
+// program. When it advances, bus frames are started and completed, and pending
+// interrupt handlers run (NVIC priorities, PRIMASK and BASEPRI are honored;
+// CAN interrupts are level sensitive, as on the device).
+// DWT->CYCCNT counts virtual time at the core clock: a measure in cycles gives
+// the register accesses of the measured code, not its CPU cost. For a CPU bound
+// benchmark, hostUseHostClockForCycleCounter makes it count host time instead.
+//
+// Buses:
+//   - a controller is attached to bus 0 by default (attachToBus); in internal
+//     loop back mode, it is on a private bus;
+//   - a frame is arbitrated among the pending mailboxes of the controllers and
+//     the due frames of the virtual nodes, using the arbitration field (11-bit
+//     identifier, then SRR/IDE, 18-bit extension, RTR); a controller offers its
+//     lowest identifier mailbox, or its oldest request with MCR.TXFP;
+//   - a frame lasts ACAN_STM32_Settings::frameBitCount bits (stuff bits and
+//     interframe space included) at the bit rate of its sender, given by BTR
+//     and PCLK1 for a controller, and by the bus bit rate for a virtual node;
+//   - a frame completes (mailbox released, frame delivered) at the end of its
+//     EOF field; the next arbitration takes place after the 3-bit interframe
+//     space, so a transmit interrupt handler can load a mailbox for it;
+//   - a node whose bit rate differs by more than 1% cannot decode the frame:
+//     it sees a stuff error, and, if it is error active and not silent, it
+//     destroys the frame with an error flag;
+//   - a frame is acknowledged by any other receiving node at its bit rate that
+//     is not silent (a virtual node with inAcknowledge set);
+//   - error frames and ack errors update the error counters (fault confinement,
+//     bus-off after TEC 255, recovery after 128 x 11 recessive bits).
+//
+// Setting the reset bit of a controller in RCC->APB1RSTR resets it, as begin
+// does (for CAN1, it includes the filter module).
+//
+// Not modeled: bit timing within a frame (an error is seen at the end of the
+// frame), sleep and time triggered modes, bus integration delay when leaving
+// init mode.
+//------------------------------------------------------------------------------
+
+#include <Arduino.h>
+#include <ACAN_STM32_CANMessage.h>
+
+#include <functional>
+#include <vector>
+#include <deque>
+
+//------------------------------------------------------------------------------
+//   TIME AND SCHEDULING
+//------------------------------------------------------------------------------
+
+uint64_t hostNanoseconds (void) ;
+
+//--- The main program is idle for inDuration ns
+void hostRun (const uint64_t inDuration) ;
+
+//--- The main program is idle until inCondition is true, at most inTimeout ns;
+//    inCondition is checked every inStep ns. Returns the last value of inCondition.
+bool hostRunUntil (const std::function <bool (void)> & inCondition,
+                   const uint64_t inTimeout,
+                   const uint64_t inStep = 1000) ;
+
+//--- CPU time of a register access and of a millis / micros call (default 20 ns)
+void hostSetAccessDuration (const uint32_t inDuration) ;
+
+//--- DWT->CYCCNT counts host steady clock time at the core clock (default false)
+void hostUseHostClockForCycleCounter (const bool inUse) ;
+
+//--- Peripherals, buses, virtual nodes, NVIC back to reset state (time goes on)
+void hostReset (void) ;
+
+//------------------------------------------------------------------------------
+//   INTERRUPTS
+//------------------------------------------------------------------------------
+
+uint32_t hostInterruptCount (const IRQn_Type inIRQ) ;
+uint64_t hostInterruptDuration (const IRQn_Type inIRQ) ; // Virtual ns spent in handler
+uint32_t hostMaxInterruptNesting (void) ;
+
+//------------------------------------------------------------------------------
+//   BUS
+//------------------------------------------------------------------------------
+
+class HostBusRecord {
+  public: CANMessage mMessage ;
+  public: uint64_t mRequestDate ; // Mailbox load, or virtual node due date
+  public: uint64_t mStartDate ;   // Start of frame
+  public: uint64_t mEndDate ;     // End of interframe space
+  public: int32_t mSender ;       // Controller index, or -1 - virtual node index
+  public: bool mOk ;              // false: error frame, or ack error
+} ;
+
+//------------------------------------------------------------------------------
+
+class HostVirtualNode ;
+
+class HostBus {
+  public: HostBus (void) ;
+
+//--- Bit rate of virtual nodes (default 500 kbit/s)
+  public: void setBitRate (const uint32_t inBitRate) { mBitRate = inBitRate ; }
+  public: uint32_t bitRate (void) const { return mBitRate ; }
+
+//--- The next inFrameCount frames are destroyed by an error flag
+  public: void injectErrors (const uint32_t inFrameCount) { mInjectedErrorCount += inFrameCount ; }
+
+//--- Bus held dominant (shorted, or faulty node): a controller cannot leave init
+//    mode, as 11 consecutive recessive bits are never seen
+  public: void holdDominant (const bool inHold) ;
+
+//--- Frames on the bus (successful or not)
+  public: const std::vector <HostBusRecord> & records (void) const { return mRecords ; }
+  public: void clearRecords (void) { mRecords.clear () ; }
+  public: uint64_t busyDuration (void) const { return mBusyDuration ; }
+  public: bool isIdle (void) const { return !mBusy ; }
+
+//--- Simulator state
+  public: std::vector <HostBusRecord> mRecords ;
+  public: std::vector <HostVirtualNode *> mVirtualNodes ;
+  public: uint32_t mBitRate ;
+  public: uint32_t mInjectedErrorCount ;
+  public: bool mHeldDominant ;
+  public: bool mBusy ;
+  public: bool mFrameCompleted ; // Bus in interframe space
+  public: uint64_t mCompletionDate ; // End of EOF field
+  public: uint64_t mIdleDate ;
+  public: uint64_t mBusyDuration ;
+  public: HostBusRecord mCurrent ;
+  public: int32_t mCurrentMailbox ; // Controller sender
+  public: HostVirtualNode * mCurrentNode ; // Virtual node sender
+
+//--- No copy
+  private : HostBus (const HostBus &) = delete ;
+  private : HostBus & operator = (const HostBus &) = delete ;
+} ;
+
+//------------------------------------------------------------------------------
+
+static const uint32_t HOST_BUS_COUNT = 2 ;
+
+HostBus & hostBus (const uint32_t inIndex) ;
+
+//------------------------------------------------------------------------------
+//   VIRTUAL NODE
+// A scripted CAN node: it offers its due frames by identifier priority, and
+// records every frame it receives. A frame that is not acknowledged is dropped.
+//------------------------------------------------------------------------------
+
+class HostVirtualNode {
+  public: explicit HostVirtualNode (HostBus & ioBus, const bool inAcknowledge = true) ;
+  public: ~ HostVirtualNode (void) ;
+
+//--- Queue a frame, due inDelay ns from now
+  public: void send (const CANMessage & inMessage, const uint64_t inDelay = 0) ;
+
+//--- Periodic frame: first due inOffset ns from now, then every inPeriod ns
+//    (inCount frames, 0 for ever)
+  public: void sendPeriodic (const CANMessage & inMessage,
+                             const uint64_t inPeriod,
+                             const uint64_t inOffset = 0,
+                             const uint32_t inCount = 0) ;
+
+  public: void stop (void) { mQueue.clear () ; }
+  public: uint32_t pendingCount (void) const { return uint32_t (mQueue.size ()) ; }
+
+  public: class Item {
+    public: CANMessage mMessage ;
+    public: uint64_t mDueDate ;
+    public: uint64_t mPeriod ;
+    public: uint32_t mRemainingCount ; // 0: for ever
+  } ;
+
+  public: HostBus & mBus ;
+  public: const bool mAcknowledge ;
+  public: std::vector <CANMessage> mReceived ;
+  public: std::vector <uint64_t> mReceptionDates ;
+  public: uint32_t mSentCount ;
+  public: uint32_t mFailedCount ;
+  public: std::deque <Item> mQueue ;
+
+//--- No copy
+  private : HostVirtualNode (const HostVirtualNode &) = delete ;
+  private : HostVirtualNode & operator = (const HostVirtualNode &) = delete ;
+} ;
+
+//------------------------------------------------------------------------------
+//   CONTROLLER (bxCAN model of gHostCAN [i])
+//------------------------------------------------------------------------------
+
+class HostController {
+  public: void attachToBus (const uint32_t inBusIndex) ;
+  public: uint32_t transmitErrorCounter (void) const { return mTEC ; }
+  public: uint32_t receiveErrorCounter (void) const { return mREC ; }
+  public: bool isBusOff (void) const { return mBusOff ; }
+  public: bool isInInitMode (void) const { return mInitMode ; }
+  public: uint32_t hardwareFIFOCount (const uint32_t inFIFO) const { return uint32_t (mRxFIFO [inFIFO].size ()) ; }
+  public: uint32_t overrunCount (const uint32_t inFIFO) const { return mOverrunCount [inFIFO] ; }
+  public: uint32_t bitRate (void) const ; // From BTR
+//--- Filter bank writes while the bank is active and FINIT is reset (ignored, as on the device)
+  public: uint32_t filterWriteViolationCount (void) const { return mFilterWriteViolationCount ; }
+
+//--- Simulator state
+  public: class RxFrame {
+    public: uint32_t mRIR ;
+    public: uint32_t mRDTR ;
+    public: uint32_t mRDLR ;
+    public: uint32_t mRDHR ;
+  } ;
+  public: typedef enum { MAILBOX_EMPTY, MAILBOX_PENDING, MAILBOX_TRANSMITTING } MailboxState ;
+  public: uint32_t mIndex = 0 ;
+  public: uint32_t mBusIndex = 0 ;
+  public: bool mInitMode = false ;
+  public: bool mBusOff = false ;
+  public: bool mRecoveryRequested = false ; // ABOM reset: INRQ set while bus-off
+  public: bool mWaitingRecessive = false ; // INRQ reset, bus held dominant
+  public: uint64_t mRecoveryDate = 0 ; // Bus-off recovery completes
+  public: uint32_t mTEC = 0 ;
+  public: uint32_t mREC = 0 ;
+  public: MailboxState mMailboxState [3] = {MAILBOX_EMPTY, MAILBOX_EMPTY, MAILBOX_EMPTY} ;
+  public: uint64_t mRequestDate [3] = {0, 0, 0} ;
+  public: uint64_t mRequestOrder [3] = {0, 0, 0} ;
+  public: bool mAbortRequested [3] = {false, false, false} ;
+  public: std::deque <RxFrame> mRxFIFO [2] ;
+  public: uint32_t mOverrunCount [2] = {0, 0} ;
+  public: uint32_t mFilterWriteViolationCount = 0 ;
+  public: HostBus mLoopBackBus ; // Internal loop back mode
+} ;
+
+//------------------------------------------------------------------------------
+
+HostController & hostController (const uint32_t inIndex) ;
+
+//------------------------------------------------------------------------------
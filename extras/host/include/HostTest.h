@@ -0,0 +1,56 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Host test checks: a failing check is reported with its location, and the test
+// program exits with a non zero code (hostTestExitCode).
+//------------------------------------------------------------------------------
+
+#include <HostSimulator.h>
+
+#include <stdio.h>
+
+//------------------------------------------------------------------------------
+
+static uint32_t gHostCheckCount = 0 ;
+static uint32_t gHostFailureCount = 0 ;
+
+//------------------------------------------------------------------------------
+
+inline void hostCheck (const bool inCondition, const char * inText, const char * inFile, const int inLine) {
+  gHostCheckCount += 1 ;
+  if (!inCondition) {
+    gHostFailureCount += 1 ;
+    printf ("%s:%d: check failed: %s\n", inFile, inLine, inText) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+inline void hostCheckEqual (const uint64_t inActual, const uint64_t inExpected,
+                            const char * inText, const char * inFile, const int inLine) {
+  gHostCheckCount += 1 ;
+  if (inActual != inExpected) {
+    gHostFailureCount += 1 ;
+    printf ("%s:%d: check failed: %s is %llu (0x%llX), expected %llu (0x%llX)\n",
+            inFile, inLine, inText,
+            (unsigned long long) inActual, (unsigned long long) inActual,
+            (unsigned long long) inExpected, (unsigned long long) inExpected) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+#define CHECK(condition) hostCheck ((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQUAL(actual, expected) hostCheckEqual (uint64_t (actual), uint64_t (expected), #actual, __FILE__, __LINE__)
+
+//--- Every test starts from reset peripherals
+#define RUN_TEST(test) do { printf ("%s\n", #test) ; hostReset () ; test () ; } while (false)
+
+//------------------------------------------------------------------------------
+
+inline int hostTestExitCode (void) {
+  printf ("%u checks, %u failure(s)\n", unsigned (gHostCheckCount), unsigned (gHostFailureCount)) ;
+  return (gHostFailureCount == 0) ? 0 : 1 ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,38 @@
+//------------------------------------------------------------------------------
+// Runs an Arduino sketch on the simulator: setup, then loop until the virtual
+// time reaches the sketch duration, in ms (first argument, default
+// HOST_SKETCH_DURATION). With HOST_CYCLE_COUNTER_FROM_HOST_CLOCK, DWT->CYCCNT
+// counts host time, for CPU bound benchmarks.
+//------------------------------------------------------------------------------
+
+#include <HostSimulator.h>
+
+#include <stdlib.h>
+
+//------------------------------------------------------------------------------
+
+#ifndef HOST_SKETCH_DURATION
+  #define HOST_SKETCH_DURATION 1000
+#endif
+
+//------------------------------------------------------------------------------
+
+void setup (void) ;
+void loop (void) ;
+
+//------------------------------------------------------------------------------
+
+int main (int argc, char * argv []) {
+  const uint32_t duration = (argc > 1) ? uint32_t (atol (argv [1])) : HOST_SKETCH_DURATION ;
+  #ifdef HOST_CYCLE_COUNTER_FROM_HOST_CLOCK
+    hostUseHostClockForCycleCounter (true) ;
+  #endif
+  setup () ;
+  while (millis () < duration) {
+    loop () ;
+  }
+  Serial.flush () ;
+  return 0 ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,1514 @@
+//------------------------------------------------------------------------------
+// bxCAN simulator (see HostSimulator.h)
+//------------------------------------------------------------------------------
+
+#include <HostSimulator.h>
+#include <ACAN_STM32_Settings.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+//------------------------------------------------------------------------------
+//   DEVICE MEMORY
+//------------------------------------------------------------------------------
+
+CAN_TypeDef gHostCAN [HOST_CAN_COUNT] ;
+GPIO_TypeDef gHostGPIO [2] ;
+RCC_TypeDef gHostRCC ;
+DWT_Type gHostDWT ;
+CoreDebug_Type gHostCoreDebug ;
+
+//------------------------------------------------------------------------------
+//   SIMULATOR STATE
+//------------------------------------------------------------------------------
+
+static uint64_t gNow = 0 ; // ns
+static uint32_t gAccessDuration = 20 ; // ns
+static bool gHostClockForCycleCounter = false ;
+static uint64_t gRequestOrder = 0 ;
+static bool gProcessingBuses = false ;
+static bool gStateChanged = true ; // By a register write, a virtual node
+static bool gInterruptMaskChanged = true ; // NVIC, PRIMASK, BASEPRI
+static uint64_t gNextEventDate = 0 ; // Of buses, valid if !gStateChanged
+static HostController gControllers [HOST_CAN_COUNT] ;
+static HostBus gBuses [HOST_BUS_COUNT] ;
+
+//--- Interframe space, at the end of a frame: mailboxes are released and frames
+//    delivered before it, so handlers can load a mailbox for the next arbitration
+static const uint32_t INTERFRAME_SPACE_BIT_COUNT = 3 ;
+
+//--- Reset values
+static const uint32_t MCR_RESET_VALUE = 0x00010002 ;
+static const uint32_t BTR_RESET_VALUE = 0x01230000 ;
+static const uint32_t FMR_RESET_VALUE = 0x2A1C0E01 ; // CAN2SB = 14, FINIT
+
+//--- LEC values
+static const uint32_t LEC_NO_ERROR    = 0 ;
+static const uint32_t LEC_STUFF_ERROR = 1 ;
+static const uint32_t LEC_ACK_ERROR   = 3 ;
+
+//--- Status bits of a transmit mailbox in TSR (RQCP, TXOK, ALST, TERR)
+static const uint32_t TSR_MAILBOX_STATUS = CAN_TSR_RQCP0 | CAN_TSR_TXOK0 | CAN_TSR_ALST0 | CAN_TSR_TERR0 ;
+
+//------------------------------------------------------------------------------
+//   NVIC STATE
+//------------------------------------------------------------------------------
+
+static const uint32_t IRQ_COUNT = 96 ;
+static const uint32_t MAX_NESTING = 16 ;
+static bool gIRQEnabled [IRQ_COUNT] ;
+static uint8_t gIRQPriority [IRQ_COUNT] ; // Shifted, as BASEPRI
+static uint32_t gIRQCount [IRQ_COUNT] ;
+static uint64_t gIRQDuration [IRQ_COUNT] ;
+static uint32_t gPRIMASK = 0 ;
+static uint32_t gBASEPRI = 0 ;
+static uint32_t gActiveIRQ [MAX_NESTING] ;
+static uint32_t gNesting = 0 ;
+static uint32_t gMaxNesting = 0 ;
+
+//------------------------------------------------------------------------------
+//   VECTOR TABLE (handlers are defined by the board file of the device)
+//------------------------------------------------------------------------------
+
+typedef void (*HandlerRoutine) (void) ;
+
+#ifdef STM32F446xx
+  extern "C" void CAN1_TX_IRQHandler (void) __attribute__ ((weak)) ;
+  extern "C" void CAN1_RX0_IRQHandler (void) __attribute__ ((weak)) ;
+  extern "C" void CAN1_RX1_IRQHandler (void) __attribute__ ((weak)) ;
+  extern "C" void CAN1_SCE_IRQHandler (void) __attribute__ ((weak)) ;
+  extern "C" void CAN2_TX_IRQHandler (void) __attribute__ ((weak)) ;
+  extern "C" void CAN2_RX0_IRQHandler (void) __attribute__ ((weak)) ;
+  extern "C" void CAN2_RX1_IRQHandler (void) __attribute__ ((weak)) ;
+  extern "C" void CAN2_SCE_IRQHandler (void) __attribute__ ((weak)) ;
+
+  static const IRQn_Type CONTROLLER_IRQ [HOST_CAN_COUNT][4] = {
+    {CAN1_TX_IRQn, CAN1_RX0_IRQn, CAN1_RX1_IRQn, CAN1_SCE_IRQn},
+    {CAN2_TX_IRQn, CAN2_RX0_IRQn, CAN2_RX1_IRQn, CAN2_SCE_IRQn}
+  } ;
+
+  static HandlerRoutine handler (const uint32_t inController, const uint32_t inLine) {
+    static const HandlerRoutine HANDLERS [HOST_CAN_COUNT][4] = {
+      {CAN1_TX_IRQHandler, CAN1_RX0_IRQHandler, CAN1_RX1_IRQHandler, CAN1_SCE_IRQHandler},
+      {CAN2_TX_IRQHandler, CAN2_RX0_IRQHandler, CAN2_RX1_IRQHandler, CAN2_SCE_IRQHandler}
+    } ;
+    return HANDLERS [inController][inLine] ;
+  }
+#else
+  extern "C" void CAN_TX_IRQHandler (void) __attribute__ ((weak)) ;
+  extern "C" void CAN_RX0_IRQHandler (void) __attribute__ ((weak)) ;
+  extern "C" void CAN_RX1_IRQHandler (void) __attribute__ ((weak)) ;
+  extern "C" void CAN_SCE_IRQHandler (void) __attribute__ ((weak)) ;
+
+  static const IRQn_Type CONTROLLER_IRQ [HOST_CAN_COUNT][4] = {
+    {CAN_TX_IRQn, CAN_RX0_IRQn, CAN_RX1_IRQn, CAN_SCE_IRQn}
+  } ;
+
+  static HandlerRoutine handler (const uint32_t /* inController */, const uint32_t inLine) {
+    static const HandlerRoutine HANDLERS [4] = {
+      CAN_TX_IRQHandler, CAN_RX0_IRQHandler, CAN_RX1_IRQHandler, CAN_SCE_IRQHandler
+    } ;
+    return HANDLERS [inLine] ;
+  }
+#endif
+
+//------------------------------------------------------------------------------
+//   CONTROLLER HELPERS
+//------------------------------------------------------------------------------
+
+static CAN_TypeDef & registers (const HostController & inController) {
+  return gHostCAN [inController.mIndex] ;
+}
+
+//------------------------------------------------------------------------------
+
+static uint64_t bitDuration (const uint32_t inBTR) { // ns
+  const uint64_t brp = (inBTR & 0x3FF) + 1 ;
+  const uint64_t ts1 = ((inBTR >> CAN_BTR_TS1_Pos) & 0xF) + 1 ;
+  const uint64_t ts2 = ((inBTR >> CAN_BTR_TS2_Pos) & 0x7) + 1 ;
+  return (brp * (1 + ts1 + ts2) * 1000000000ULL + HOST_PCLK1 / 2) / HOST_PCLK1 ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t HostController::bitRate (void) const {
+  const uint32_t btr = registers (*this).BTR.mValue ;
+  const uint32_t brp = (btr & 0x3FF) + 1 ;
+  const uint32_t ts1 = ((btr >> CAN_BTR_TS1_Pos) & 0xF) + 1 ;
+  const uint32_t ts2 = ((btr >> CAN_BTR_TS2_Pos) & 0x7) + 1 ;
+  return HOST_PCLK1 / (brp * (1 + ts1 + ts2)) ;
+}
+
+//------------------------------------------------------------------------------
+
+static bool sameBitRate (const uint32_t inBitRate1, const uint32_t inBitRate2) {
+  const uint32_t difference = (inBitRate1 > inBitRate2) ? (inBitRate1 - inBitRate2) : (inBitRate2 - inBitRate1) ;
+  return (uint64_t (difference) * 100) <= inBitRate2 ;
+}
+
+//------------------------------------------------------------------------------
+
+static bool isLoopBack (const HostController & inController) {
+  return (registers (inController).BTR.mValue & CAN_BTR_LBKM) != 0 ;
+}
+
+//------------------------------------------------------------------------------
+
+static bool isSilent (const HostController & inController) {
+  return (registers (inController).BTR.mValue & CAN_BTR_SILM) != 0 ;
+}
+
+//------------------------------------------------------------------------------
+
+static HostBus & effectiveBus (HostController & inController) {
+  return (isLoopBack (inController) && isSilent (inController))
+    ? inController.mLoopBackBus
+    : gBuses [inController.mBusIndex] ;
+}
+
+//------------------------------------------------------------------------------
+// INRQ reset, and 11 consecutive recessive bits seen
+
+static void leaveInitMode (HostController & ioController) {
+  const CAN_TypeDef & regs = registers (ioController) ;
+  ioController.mInitMode = false ;
+  ioController.mWaitingRecessive = false ;
+  if (ioController.mBusOff && ioController.mRecoveryRequested && ((regs.MCR.mValue & CAN_MCR_ABOM) == 0)) {
+    ioController.mRecoveryDate = gNow + 128 * 11 * bitDuration (regs.BTR.mValue) ;
+  }
+  ioController.mRecoveryRequested = false ;
+}
+
+//------------------------------------------------------------------------------
+// Controller is synchronized on the bus (out of init mode, sleep mode, bus-off)
+
+static bool isOnBus (HostController & inController, const HostBus & inBus) {
+  return (& effectiveBus (inController) == & inBus)
+    && !inController.mInitMode
+    && ((registers (inController).MCR.mValue & CAN_MCR_SLEEP) == 0)
+    && !inController.mBusOff ;
+}
+
+//------------------------------------------------------------------------------
+
+static bool canTransmit (HostController & inController, const HostBus & inBus) {
+  return isOnBus (inController, inBus) && (isLoopBack (inController) || !isSilent (inController)) ;
+}
+
+//------------------------------------------------------------------------------
+// Receives frames of other nodes (in loop back mode, only its own frames)
+
+static bool receivesFromBus (HostController & inController, const HostBus & inBus) {
+  return isOnBus (inController, inBus) && !isLoopBack (inController) ;
+}
+
+//------------------------------------------------------------------------------
+
+static bool isErrorActive (const HostController & inController) {
+  return (inController.mTEC < 128) && (inController.mREC < 128) ;
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t errorFlags (const HostController & inController) {
+  uint32_t flags = 0 ;
+  if ((inController.mTEC >= 96) || (inController.mREC >= 96)) {
+    flags |= CAN_ESR_EWGF ;
+  }
+  if ((inController.mTEC >= 128) || (inController.mREC >= 128)) {
+    flags |= CAN_ESR_EPVF ;
+  }
+  if (inController.mBusOff) {
+    flags |= CAN_ESR_BOFF ;
+  }
+  return flags ;
+}
+
+//------------------------------------------------------------------------------
+
+static void setLastErrorCode (HostController & ioController, const uint32_t inCode) {
+  CAN_TypeDef & regs = registers (ioController) ;
+  regs.ESR.mValue = (regs.ESR.mValue & ~ CAN_ESR_LEC) | (inCode << CAN_ESR_LEC_Pos) ;
+  if ((inCode != LEC_NO_ERROR) && ((regs.IER.mValue & CAN_IER_LECIE) != 0)) {
+    regs.MSR.mValue |= CAN_MSR_ERRI ;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Error counters have changed: sets the error flags, enters bus-off
+
+static void updateErrorState (HostController & ioController, const uint32_t inPreviousFlags) {
+  CAN_TypeDef & regs = registers (ioController) ;
+  if ((ioController.mTEC > 255) && !ioController.mBusOff) {
+    ioController.mBusOff = true ;
+    ioController.mRecoveryRequested = false ;
+    ioController.mRecoveryDate = ((regs.MCR.mValue & CAN_MCR_ABOM) != 0)
+      ? (gNow + 128 * 11 * bitDuration (regs.BTR.mValue))
+      : 0 ;
+    for (uint32_t idx = 0 ; idx < 3 ; idx++) {
+      if (ioController.mMailboxState [idx] == HostController::MAILBOX_TRANSMITTING) {
+        ioController.mMailboxState [idx] = HostController::MAILBOX_PENDING ;
+      }
+    }
+  }
+  const uint32_t raised = errorFlags (ioController) & ~ inPreviousFlags ;
+  const uint32_t ier = regs.IER.mValue ;
+  if ((((raised & CAN_ESR_EWGF) != 0) && ((ier & CAN_IER_EWGIE) != 0))
+   || (((raised & CAN_ESR_EPVF) != 0) && ((ier & CAN_IER_EPVIE) != 0))
+   || (((raised & CAN_ESR_BOFF) != 0) && ((ier & CAN_IER_BOFIE) != 0))) {
+    regs.MSR.mValue |= CAN_MSR_ERRI ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+static void transmitError (HostController & ioController, const uint32_t inCode) {
+  const uint32_t flags = errorFlags (ioController) ;
+  setLastErrorCode (ioController, inCode) ;
+  const bool passiveAckError = (inCode == LEC_ACK_ERROR) && !isErrorActive (ioController) ;
+  if (!passiveAckError) {
+    ioController.mTEC += 8 ;
+  }
+  updateErrorState (ioController, flags) ;
+}
+
+//------------------------------------------------------------------------------
+
+static void receiveError (HostController & ioController) {
+  const uint32_t flags = errorFlags (ioController) ;
+  setLastErrorCode (ioController, LEC_STUFF_ERROR) ;
+  if (ioController.mREC < 255) {
+    ioController.mREC += 1 ;
+  }
+  updateErrorState (ioController, flags) ;
+}
+
+//------------------------------------------------------------------------------
+
+static void recoverFromBusOff (HostController & ioController) {
+  ioController.mBusOff = false ;
+  ioController.mRecoveryDate = 0 ;
+  ioController.mTEC = 0 ;
+  ioController.mREC = 0 ;
+}
+
+//------------------------------------------------------------------------------
+
+static CANMessage mailboxMessage (const HostController & inController, const uint32_t inMailbox) {
+  const CAN_TxMailBox_TypeDef & mailbox = registers (inController).sTxMailBox [inMailbox] ;
+  const uint32_t tir = mailbox.TIR.mValue ;
+  CANMessage message ;
+  message.ext = (tir & 4) != 0 ;
+  message.rtr = (tir & 2) != 0 ;
+  message.id = message.ext ? ((tir >> 3) & 0x1FFFFFFF) : ((tir >> 21) & 0x7FF) ;
+  message.len = uint8_t (mailbox.TDTR.mValue & 0xF) ;
+  message.data32 [0] = mailbox.TDLR.mValue ;
+  message.data32 [1] = mailbox.TDHR.mValue ;
+  message.idx = uint8_t (inMailbox) ;
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+// Transmit request completed (sent, failed without retransmission, aborted)
+
+static void completeMailbox (HostController & ioController,
+                             const uint32_t inMailbox,
+                             const uint32_t inStatus) {
+  CAN_TypeDef & regs = registers (ioController) ;
+  ioController.mMailboxState [inMailbox] = HostController::MAILBOX_EMPTY ;
+  ioController.mAbortRequested [inMailbox] = false ;
+  regs.sTxMailBox [inMailbox].TIR.mValue &= ~ 1U ; // TXRQ
+  regs.TSR.mValue = (regs.TSR.mValue & ~ (TSR_MAILBOX_STATUS << (8 * inMailbox)))
+                  | ((inStatus | CAN_TSR_RQCP0) << (8 * inMailbox)) ;
+}
+
+//------------------------------------------------------------------------------
+//   FILTERS
+//------------------------------------------------------------------------------
+
+static void bankRange (const HostController & inController, uint32_t & outFirst, uint32_t & outEnd) {
+  #ifdef STM32F446xx
+    const uint32_t can2StartBank = (gHostCAN [0].FMR.mValue >> CAN_FMR_CAN2SB_Pos) & 0x3F ;
+    outFirst = (inController.mIndex == 0) ? 0 : can2StartBank ;
+    outEnd = (inController.mIndex == 0) ? can2StartBank : HOST_FILTER_BANK_COUNT ;
+  #else
+    (void) inController ;
+    outFirst = 0 ;
+    outEnd = HOST_FILTER_BANK_COUNT ;
+  #endif
+}
+
+//------------------------------------------------------------------------------
+// Filter numbers are given per FIFO, in bank order, whatever the bank activation;
+// if several filters match, 32-bit scale wins over 16-bit scale, then identifier
+// list over mask, then the lowest filter number (reference manual, "filter match
+// index").
+
+static bool matchFilters (const HostController & inController,
+                          const CANMessage & inMessage,
+                          uint32_t & outFIFO,
+                          uint32_t & outFilterNumber) {
+  const CAN_TypeDef & filters = gHostCAN [0] ;
+  bool found = false ;
+  if ((filters.FMR.mValue & CAN_FMR_FINIT) == 0) { // Reception is disabled during filter initialization
+    const uint32_t word32 = inMessage.ext
+      ? ((inMessage.id << 3) | 4 | (inMessage.rtr ? 2 : 0))
+      : ((inMessage.id << 21) | (inMessage.rtr ? 2 : 0)) ;
+    const uint32_t word16 = inMessage.ext
+      ? (((inMessage.id >> 18) << 5) | (inMessage.rtr ? 0x10 : 0) | 0x08 | ((inMessage.id >> 15) & 7))
+      : ((inMessage.id << 5) | (inMessage.rtr ? 0x10 : 0)) ;
+    uint32_t firstBank ;
+    uint32_t endBank ;
+    bankRange (inController, firstBank, endBank) ;
+    uint32_t numbers [2] = {0, 0} ;
+    uint32_t bestRank = 0 ; // scale32 * 2 + list
+    for (uint32_t bank = firstBank ; bank < endBank ; bank++) {
+      const uint32_t fifo = (filters.FFA1R.mValue >> bank) & 1 ;
+      const bool scale32 = ((filters.FS1R.mValue >> bank) & 1) != 0 ;
+      const bool list = ((filters.FM1R.mValue >> bank) & 1) != 0 ;
+      const uint32_t slotCount = scale32 ? (list ? 2 : 1) : (list ? 4 : 2) ;
+      if (((filters.FA1R.mValue >> bank) & 1) != 0) {
+        const uint32_t fr1 = filters.sFilterRegister [bank].FR1.mValue ;
+        const uint32_t fr2 = filters.sFilterRegister [bank].FR2.mValue ;
+        for (uint32_t slot = 0 ; slot < slotCount ; slot++) {
+          bool match = false ;
+          if (scale32 && !list) {
+            match = ((word32 ^ fr1) & fr2 & ~ 1U) == 0 ;
+          }else if (scale32) {
+            match = ((word32 ^ ((slot == 0) ? fr1 : fr2)) & ~ 1U) == 0 ;
+          }else{
+            const uint32_t fr = (slot < 2) ? fr1 : fr2 ;
+            if (list) {
+              match = word16 == (((slot & 1) == 0) ? (fr & 0xFFFF) : (fr >> 16)) ;
+            }else{
+              const uint32_t maskedFR = (slot == 0) ? fr1 : fr2 ;
+              match = ((word16 ^ (maskedFR & 0xFFFF)) & (maskedFR >> 16)) == 0 ;
+            }
+          }
+          const uint32_t rank = (scale32 ? 2 : 0) + (list ? 1 : 0) ;
+          const uint32_t number = numbers [fifo] + slot ;
+          if (match && (!found || (rank > bestRank) || ((rank == bestRank) && (number < outFilterNumber)))) {
+            found = true ;
+            bestRank = rank ;
+            outFIFO = fifo ;
+            outFilterNumber = number ;
+          }
+        }
+      }
+      numbers [fifo] += slotCount ;
+    }
+  }
+  return found ;
+}
+
+//------------------------------------------------------------------------------
+
+static void deliver (HostController & ioController, const CANMessage & inMessage, const uint64_t inStartDate) {
+  uint32_t fifo = 0 ;
+  uint32_t filterNumber = 0 ;
+  if (matchFilters (ioController, inMessage, fifo, filterNumber)) {
+    CAN_TypeDef & regs = registers (ioController) ;
+    HostController::RxFrame frame ;
+    frame.mRIR = inMessage.ext
+      ? ((inMessage.id << 3) | 4 | (inMessage.rtr ? 2 : 0))
+      : ((inMessage.id << 21) | (inMessage.rtr ? 2 : 0)) ;
+    const uint32_t time = uint32_t (inStartDate / bitDuration (regs.BTR.mValue)) & 0xFFFF ;
+    frame.mRDTR = (inMessage.len & 0xF) | (filterNumber << 8) | (time << 16) ;
+    frame.mRDLR = inMessage.data32 [0] ;
+    frame.mRDHR = inMessage.data32 [1] ;
+    std::deque <HostController::RxFrame> & hardwareFIFO = ioController.mRxFIFO [fifo] ;
+    volatile HostRegister & rfr = (fifo == 0) ? regs.RF0R : regs.RF1R ;
+    if (hardwareFIFO.size () < 3) {
+      hardwareFIFO.push_back (frame) ;
+      if (hardwareFIFO.size () == 3) {
+        rfr.mValue |= CAN_RF0R_FULL0 ;
+      }
+    }else{
+      rfr.mValue |= CAN_RF0R_FOVR0 ;
+      ioController.mOverrunCount [fifo] += 1 ;
+      if ((regs.MCR.mValue & CAN_MCR_RFLM) == 0) { // Not locked: last message is overwritten
+        hardwareFIFO.back () = frame ;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+//   BUS
+//------------------------------------------------------------------------------
+
+HostBus::HostBus (void) :
+mRecords (),
+mVirtualNodes (),
+mBitRate (500 * 1000),
+mInjectedErrorCount (0),
+mHeldDominant (false),
+mBusy (false),
+mFrameCompleted (false),
+mCompletionDate (0),
+mIdleDate (0),
+mBusyDuration (0),
+mCurrent (),
+mCurrentMailbox (0),
+mCurrentNode (nullptr) {
+}
+
+//------------------------------------------------------------------------------
+
+void HostBus::holdDominant (const bool inHold) {
+  mHeldDominant = inHold ;
+  gStateChanged = true ;
+}
+
+//------------------------------------------------------------------------------
+
+HostBus & hostBus (const uint32_t inIndex) {
+  return gBuses [inIndex] ;
+}
+
+//------------------------------------------------------------------------------
+
+HostController & hostController (const uint32_t inIndex) {
+  return gControllers [inIndex] ;
+}
+
+//------------------------------------------------------------------------------
+
+void HostController::attachToBus (const uint32_t inBusIndex) {
+  mBusIndex = inBusIndex ;
+  gStateChanged = true ;
+}
+
+//------------------------------------------------------------------------------
+// Arbitration field as a number: the lowest value wins (dominant bits are 0)
+
+static uint64_t arbitrationKey (const CANMessage & inMessage) {
+  uint64_t key ;
+  if (inMessage.ext) {
+    key = (uint64_t ((inMessage.id >> 18) & 0x7FF) << 21)
+        | (1U << 20) | (1U << 19) // SRR, IDE
+        | ((inMessage.id & 0x3FFFF) << 1)
+        | (inMessage.rtr ? 1 : 0) ;
+  }else{
+    key = (uint64_t (inMessage.id & 0x7FF) << 21) | (inMessage.rtr ? (1U << 20) : 0) ;
+  }
+  return key ;
+}
+
+//------------------------------------------------------------------------------
+// Mailbox a controller offers for arbitration, among the requests made before
+// inDate; returns -1 if none
+
+static int32_t offeredMailbox (const HostController & inController, const uint64_t inDate) {
+  const bool byRequestOrder = (registers (inController).MCR.mValue & CAN_MCR_TXFP) != 0 ;
+  int32_t selected = -1 ;
+  for (uint32_t idx = 0 ; idx < 3 ; idx++) {
+    if ((inController.mMailboxState [idx] == HostController::MAILBOX_PENDING)
+     && (inController.mRequestDate [idx] <= inDate)) {
+      if (selected < 0) {
+        selected = int32_t (idx) ;
+      }else if (byRequestOrder) {
+        if (inController.mRequestOrder [idx] < inController.mRequestOrder [selected]) {
+          selected = int32_t (idx) ;
+        }
+      }else if (arbitrationKey (mailboxMessage (inController, idx)) < arbitrationKey (mailboxMessage (inController, uint32_t (selected)))) {
+        selected = int32_t (idx) ;
+      }
+    }
+  }
+  return selected ;
+}
+
+//------------------------------------------------------------------------------
+
+static int32_t offeredItem (const HostVirtualNode & inNode, const uint64_t inDate) {
+  int32_t selected = -1 ;
+  for (uint32_t i = 0 ; i < inNode.mQueue.size () ; i++) {
+    if ((inNode.mQueue [i].mDueDate <= inDate)
+     && ((selected < 0) || (arbitrationKey (inNode.mQueue [i].mMessage) < arbitrationKey (inNode.mQueue [selected].mMessage)))) {
+      selected = int32_t (i) ;
+    }
+  }
+  return selected ;
+}
+
+//------------------------------------------------------------------------------
+// Earliest request of the nodes of the bus (UINT64_MAX if none)
+
+static uint64_t earliestRequest (HostBus & inBus) {
+  uint64_t earliest = UINT64_MAX ;
+  for (uint32_t c = 0 ; c < HOST_CAN_COUNT ; c++) {
+    HostController & controller = gControllers [c] ;
+    if (canTransmit (controller, inBus)) {
+      for (uint32_t idx = 0 ; idx < 3 ; idx++) {
+        if ((controller.mMailboxState [idx] == HostController::MAILBOX_PENDING) && (controller.mRequestDate [idx] < earliest)) {
+          earliest = controller.mRequestDate [idx] ;
+        }
+      }
+    }
+  }
+  for (HostVirtualNode * node : inBus.mVirtualNodes) {
+    for (const HostVirtualNode::Item & item : node->mQueue) {
+      if (item.mDueDate < earliest) {
+        earliest = item.mDueDate ;
+      }
+    }
+  }
+  return earliest ;
+}
+
+//------------------------------------------------------------------------------
+
+static void startFrame (HostBus & ioBus, const uint64_t inStartDate) {
+  bool found = false ;
+  uint64_t bestKey = 0 ;
+  int32_t bestController = -1 ;
+  int32_t bestMailbox = -1 ;
+  HostVirtualNode * bestNode = nullptr ;
+  int32_t bestItem = -1 ;
+  int32_t offered [HOST_CAN_COUNT] ;
+  for (uint32_t c = 0 ; c < HOST_CAN_COUNT ; c++) {
+    offered [c] = canTransmit (gControllers [c], ioBus) ? offeredMailbox (gControllers [c], inStartDate) : -1 ;
+    if (offered [c] >= 0) {
+      const uint64_t key = arbitrationKey (mailboxMessage (gControllers [c], uint32_t (offered [c]))) ;
+      if (!found || (key < bestKey)) {
+        found = true ;
+        bestKey = key ;
+        bestController = int32_t (c) ;
+        bestMailbox = offered [c] ;
+      }
+    }
+  }
+  for (HostVirtualNode * node : ioBus.mVirtualNodes) {
+    const int32_t item = offeredItem (*node, inStartDate) ;
+    if (item >= 0) {
+      const uint64_t key = arbitrationKey (node->mQueue [item].mMessage) ;
+      if (!found || (key < bestKey)) {
+        found = true ;
+        bestKey = key ;
+        bestController = -1 ;
+        bestNode = node ;
+        bestItem = item ;
+      }
+    }
+  }
+//--- Losing controllers
+  for (uint32_t c = 0 ; c < HOST_CAN_COUNT ; c++) {
+    if ((offered [c] >= 0) && (int32_t (c) != bestController)) {
+      HostController & controller = gControllers [c] ;
+      const uint32_t idx = uint32_t (offered [c]) ;
+      CAN_TypeDef & regs = registers (controller) ;
+      regs.TSR.mValue |= CAN_TSR_ALST0 << (8 * idx) ;
+      if ((regs.MCR.mValue & CAN_MCR_NART) != 0) {
+        completeMailbox (controller, idx, CAN_TSR_ALST0) ;
+      }
+    }
+  }
+//--- Winner
+  if (found) {
+    HostBusRecord & record = ioBus.mCurrent ;
+    uint64_t bitTime ;
+    if (bestController >= 0) {
+      HostController & controller = gControllers [bestController] ;
+      controller.mMailboxState [bestMailbox] = HostController::MAILBOX_TRANSMITTING ;
+      record.mMessage = mailboxMessage (controller, uint32_t (bestMailbox)) ;
+      record.mRequestDate = controller.mRequestDate [bestMailbox] ;
+      record.mSender = bestController ;
+      bitTime = bitDuration (registers (controller).BTR.mValue) ;
+      ioBus.mCurrentMailbox = bestMailbox ;
+      ioBus.mCurrentNode = nullptr ;
+    }else{
+      const HostVirtualNode::Item item = bestNode->mQueue [bestItem] ;
+      bestNode->mQueue.erase (bestNode->mQueue.begin () + bestItem) ;
+      if ((item.mPeriod > 0) && (item.mRemainingCount != 1)) {
+        HostVirtualNode::Item next = item ;
+        next.mDueDate += item.mPeriod ;
+        next.mRemainingCount = (item.mRemainingCount == 0) ? 0 : (item.mRemainingCount - 1) ;
+        bestNode->mQueue.push_back (next) ;
+      }
+      record.mMessage = item.mMessage ;
+      record.mRequestDate = item.mDueDate ;
+      record.mSender = -1 ;
+      for (uint32_t i = 0 ; i < ioBus.mVirtualNodes.size () ; i++) {
+        if (ioBus.mVirtualNodes [i] == bestNode) {
+          record.mSender = - 1 - int32_t (i) ;
+        }
+      }
+      bitTime = 1000000000ULL / ioBus.mBitRate ;
+      ioBus.mCurrentNode = bestNode ;
+    }
+    record.mStartDate = inStartDate ;
+    record.mEndDate = inStartDate + ACAN_STM32_Settings::frameBitCount (record.mMessage) * bitTime ;
+    record.mOk = false ;
+    ioBus.mBusy = true ;
+    ioBus.mFrameCompleted = false ;
+    ioBus.mCompletionDate = record.mEndDate - INTERFRAME_SPACE_BIT_COUNT * bitTime ;
+    ioBus.mBusyDuration += record.mEndDate - inStartDate ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+static void completeFrame (HostBus & ioBus) {
+  HostBusRecord & record = ioBus.mCurrent ;
+  const CANMessage & message = record.mMessage ;
+  HostController * sender = (record.mSender >= 0) ? & gControllers [record.mSender] : nullptr ;
+  HostVirtualNode * senderNode = ioBus.mCurrentNode ;
+  const uint32_t frameBitRate = (sender != nullptr) ? sender->bitRate () : ioBus.mBitRate ;
+  const bool senderLoopBack = (sender != nullptr) && isLoopBack (*sender) ;
+//--- Error flags, acknowledge
+  bool destroyed = false ;
+  if (ioBus.mInjectedErrorCount > 0) {
+    ioBus.mInjectedErrorCount -= 1 ;
+    destroyed = true ;
+  }
+  bool acknowledged = senderLoopBack ;
+  for (uint32_t c = 0 ; c < HOST_CAN_COUNT ; c++) {
+    HostController & receiver = gControllers [c] ;
+    if ((& receiver != sender) && receivesFromBus (receiver, ioBus)) {
+      if (!sameBitRate (receiver.bitRate (), frameBitRate)) {
+        receiveError (receiver) ;
+        destroyed |= !isSilent (receiver) && isErrorActive (receiver) ;
+      }else if (!isSilent (receiver)) {
+        acknowledged = true ;
+      }
+    }
+  }
+  for (HostVirtualNode * node : ioBus.mVirtualNodes) {
+    if ((node != senderNode) && node->mAcknowledge) {
+      if (sameBitRate (ioBus.mBitRate, frameBitRate)) {
+        acknowledged = true ;
+      }else{
+        destroyed = true ;
+      }
+    }
+  }
+  record.mOk = !destroyed && acknowledged ;
+//--- Receivers
+  for (uint32_t c = 0 ; c < HOST_CAN_COUNT ; c++) {
+    HostController & receiver = gControllers [c] ;
+    if ((& receiver != sender) && receivesFromBus (receiver, ioBus) && sameBitRate (receiver.bitRate (), frameBitRate)) {
+      if (record.mOk) {
+        setLastErrorCode (receiver, LEC_NO_ERROR) ;
+        receiver.mREC = (receiver.mREC > 127) ? 120 : ((receiver.mREC > 0) ? (receiver.mREC - 1) : 0) ;
+        deliver (receiver, message, record.mStartDate) ;
+      }else if (destroyed) {
+        receiveError (receiver) ;
+      }
+    }
+  }
+  if (record.mOk) {
+    for (HostVirtualNode * node : ioBus.mVirtualNodes) {
+      if ((node != senderNode) && sameBitRate (ioBus.mBitRate, frameBitRate)) {
+        node->mReceived.push_back (message) ;
+        node->mReceptionDates.push_back (record.mEndDate) ;
+      }
+    }
+  }
+//--- Sender
+  if (sender != nullptr) {
+    const uint32_t idx = uint32_t (ioBus.mCurrentMailbox) ;
+    CAN_TypeDef & regs = registers (*sender) ;
+    if (record.mOk) {
+      setLastErrorCode (*sender, LEC_NO_ERROR) ;
+      if (sender->mTEC > 0) {
+        sender->mTEC -= 1 ;
+      }
+      completeMailbox (*sender, idx, CAN_TSR_TXOK0) ;
+      if (senderLoopBack) {
+        deliver (*sender, message, record.mStartDate) ;
+      }
+    }else{
+      transmitError (*sender, destroyed ? LEC_STUFF_ERROR : LEC_ACK_ERROR) ;
+      if (sender->mAbortRequested [idx]) {
+        completeMailbox (*sender, idx, 0) ;
+      }else if ((regs.MCR.mValue & CAN_MCR_NART) != 0) {
+        completeMailbox (*sender, idx, CAN_TSR_TERR0) ;
+      }else if (sender->mMailboxState [idx] == HostController::MAILBOX_TRANSMITTING) { // Not bus-off
+        sender->mMailboxState [idx] = HostController::MAILBOX_PENDING ; // Automatic retransmission
+      }
+    }
+  }else if (senderNode != nullptr) {
+    if (record.mOk) {
+      senderNode->mSentCount += 1 ;
+    }else{
+      senderNode->mFailedCount += 1 ;
+    }
+  }
+//--- Interframe space
+  ioBus.mRecords.push_back (record) ;
+  ioBus.mFrameCompleted = true ;
+  ioBus.mCurrentNode = nullptr ;
+}
+
+//------------------------------------------------------------------------------
+
+static void processBus (HostBus & ioBus) {
+  bool loop = true ;
+  while (loop) {
+    if (ioBus.mBusy && !ioBus.mFrameCompleted) {
+      loop = ioBus.mCompletionDate <= gNow ;
+      if (loop) {
+        completeFrame (ioBus) ;
+      }
+    }else if (ioBus.mBusy) {
+      loop = ioBus.mCurrent.mEndDate <= gNow ;
+      if (loop) { // End of interframe space: bus is idle
+        ioBus.mBusy = false ;
+        ioBus.mIdleDate = ioBus.mCurrent.mEndDate ;
+      }
+    }else{
+      const uint64_t earliest = earliestRequest (ioBus) ;
+      loop = earliest <= gNow ;
+      if (loop) {
+        startFrame (ioBus, (earliest > ioBus.mIdleDate) ? earliest : ioBus.mIdleDate) ;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+static uint64_t nextEventDate (void) ;
+
+static void processBuses (void) {
+  if (!gProcessingBuses) {
+    gProcessingBuses = true ;
+    for (uint32_t c = 0 ; c < HOST_CAN_COUNT ; c++) {
+      HostController & controller = gControllers [c] ;
+      if (controller.mBusOff && (controller.mRecoveryDate != 0) && (controller.mRecoveryDate <= gNow)) {
+        recoverFromBusOff (controller) ;
+      }
+      if (controller.mWaitingRecessive && !effectiveBus (controller).mHeldDominant) {
+        leaveInitMode (controller) ;
+      }
+    }
+    for (uint32_t b = 0 ; b < HOST_BUS_COUNT ; b++) {
+      processBus (gBuses [b]) ;
+    }
+    for (uint32_t c = 0 ; c < HOST_CAN_COUNT ; c++) {
+      processBus (gControllers [c].mLoopBackBus) ;
+    }
+    gNextEventDate = nextEventDate () ;
+    gProcessingBuses = false ;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Date of the next bus event after now (UINT64_MAX if none)
+
+static uint64_t nextEventDate (void) {
+  uint64_t next = UINT64_MAX ;
+  for (uint32_t c = 0 ; c < HOST_CAN_COUNT ; c++) {
+    const HostController & controller = gControllers [c] ;
+    if (controller.mBusOff && (controller.mRecoveryDate > gNow) && (controller.mRecoveryDate < next)) {
+      next = controller.mRecoveryDate ;
+    }
+  }
+  for (uint32_t b = 0 ; b < (HOST_BUS_COUNT + HOST_CAN_COUNT) ; b++) {
+    HostBus & bus = (b < HOST_BUS_COUNT) ? gBuses [b] : gControllers [b - HOST_BUS_COUNT].mLoopBackBus ;
+    uint64_t date = earliestRequest (bus) ;
+    if (bus.mBusy) {
+      date = bus.mFrameCompleted ? bus.mCurrent.mEndDate : bus.mCompletionDate ;
+    }
+    if ((date > gNow) && (date < next)) {
+      next = date ;
+    }
+  }
+  return next ;
+}
+
+//------------------------------------------------------------------------------
+//   NVIC
+//------------------------------------------------------------------------------
+
+static bool interruptLine (const uint32_t inController, const uint32_t inLine) {
+  const HostController & controller = gControllers [inController] ;
+  const CAN_TypeDef & regs = gHostCAN [inController] ;
+  const uint32_t ier = regs.IER.mValue ;
+  bool line = false ;
+  switch (inLine) {
+  case 0 :
+    line = ((ier & CAN_IER_TMEIE) != 0)
+        && ((regs.TSR.mValue & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2)) != 0) ;
+    break ;
+  case 1 :
+  case 2 : {
+      const uint32_t fifo = inLine - 1 ;
+      const uint32_t rfr = (fifo == 0) ? regs.RF0R.mValue : regs.RF1R.mValue ;
+      const uint32_t shift = 3 * fifo ; // FMPIE1, FFIE1, FOVIE1 follow FMPIE0, FFIE0, FOVIE0
+      line = (((ier & (CAN_IER_FMPIE0 << shift)) != 0) && !controller.mRxFIFO [fifo].empty ())
+          || (((ier & (CAN_IER_FFIE0 << shift)) != 0) && ((rfr & CAN_RF0R_FULL0) != 0))
+          || (((ier & (CAN_IER_FOVIE0 << shift)) != 0) && ((rfr & CAN_RF0R_FOVR0) != 0)) ;
+    }
+    break ;
+  default :
+    line = ((ier & CAN_IER_ERRIE) != 0) && ((regs.MSR.mValue & CAN_MSR_ERRI) != 0) ;
+    break ;
+  }
+  return line ;
+}
+
+//------------------------------------------------------------------------------
+// Runs every interrupt handler that can preempt the current execution priority,
+// highest priority first (lowest IRQ number for equal priorities)
+
+static void dispatchInterrupts (void) {
+  uint32_t iterationCount = 0 ;
+  bool loop = gPRIMASK == 0 ;
+  while (loop) {
+    const uint32_t executionPriority = (gNesting > 0) ? gIRQPriority [gActiveIRQ [gNesting - 1]] : 256 ;
+    uint32_t selectedIRQ = IRQ_COUNT ;
+    uint32_t selectedController = 0 ;
+    uint32_t selectedLine = 0 ;
+    for (uint32_t c = 0 ; c < HOST_CAN_COUNT ; c++) {
+      for (uint32_t line = 0 ; line < 4 ; line++) {
+        const uint32_t irq = CONTROLLER_IRQ [c][line] ;
+        const uint32_t priority = gIRQPriority [irq] ;
+        if (gIRQEnabled [irq]
+         && ((gBASEPRI == 0) || (priority < gBASEPRI))
+         && (priority < executionPriority)
+         && ((selectedIRQ == IRQ_COUNT) || (priority < gIRQPriority [selectedIRQ]) || ((priority == gIRQPriority [selectedIRQ]) && (irq < selectedIRQ)))
+         && interruptLine (c, line)) {
+          selectedIRQ = irq ;
+          selectedController = c ;
+          selectedLine = line ;
+        }
+      }
+    }
+    loop = selectedIRQ < IRQ_COUNT ;
+    if (loop) {
+      const HandlerRoutine routine = handler (selectedController, selectedLine) ;
+      iterationCount += 1 ;
+      if ((routine == nullptr) || (iterationCount > 1000000) || (gNesting == MAX_NESTING)) {
+        fprintf (stderr, "HostSimulator: IRQ %u stuck (no handler, or source never cleared)\n", unsigned (selectedIRQ)) ;
+        abort () ;
+      }
+      const uint64_t start = gNow ;
+      gActiveIRQ [gNesting] = selectedIRQ ;
+      gNesting += 1 ;
+      if (gMaxNesting < gNesting) {
+        gMaxNesting = gNesting ;
+      }
+      gIRQCount [selectedIRQ] += 1 ;
+      routine () ;
+      gNesting -= 1 ;
+      gIRQDuration [selectedIRQ] += gNow - start ;
+      loop = gPRIMASK == 0 ;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+//   TIME
+//------------------------------------------------------------------------------
+
+// Buses and interrupt lines only change on a state change, or at a bus event
+
+static void advance (void) {
+  if (gStateChanged || (gNow >= gNextEventDate)) {
+    gStateChanged = false ;
+    gInterruptMaskChanged = false ;
+    processBuses () ;
+    dispatchInterrupts () ;
+  }else if (gInterruptMaskChanged) {
+    gInterruptMaskChanged = false ;
+    dispatchInterrupts () ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+static void tick (void) {
+  gNow += gAccessDuration ;
+  advance () ;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t hostNanoseconds (void) {
+  return gNow ;
+}
+
+//------------------------------------------------------------------------------
+
+void hostRun (const uint64_t inDuration) {
+  const uint64_t target = gNow + inDuration ;
+  while (gNow < target) {
+    const uint64_t next = nextEventDate () ;
+    gNow = (next < target) ? next : target ;
+    advance () ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+bool hostRunUntil (const std::function <bool (void)> & inCondition,
+                   const uint64_t inTimeout,
+                   const uint64_t inStep) {
+  const uint64_t deadline = gNow + inTimeout ;
+  bool done = inCondition () ;
+  while (!done && (gNow < deadline)) {
+    hostRun (inStep) ;
+    done = inCondition () ;
+  }
+  return done ;
+}
+
+//------------------------------------------------------------------------------
+
+void hostSetAccessDuration (const uint32_t inDuration) {
+  gAccessDuration = inDuration ;
+}
+
+//------------------------------------------------------------------------------
+
+void hostUseHostClockForCycleCounter (const bool inUse) {
+  gHostClockForCycleCounter = inUse ;
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t cycleCounter (void) {
+  uint64_t now = gNow ;
+  if (gHostClockForCycleCounter) {
+    now = uint64_t (std::chrono::duration_cast <std::chrono::nanoseconds> (
+      std::chrono::steady_clock::now ().time_since_epoch ()).count ()) ;
+  }
+  return uint32_t ((now * (HOST_CORE_CLOCK / 1000000)) / 1000) ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t hostInterruptCount (const IRQn_Type inIRQ) {
+  return gIRQCount [inIRQ] ;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t hostInterruptDuration (const IRQn_Type inIRQ) {
+  return gIRQDuration [inIRQ] ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t hostMaxInterruptNesting (void) {
+  return gMaxNesting ;
+}
+
+//------------------------------------------------------------------------------
+//   RESET
+//------------------------------------------------------------------------------
+
+static void resetController (HostController & ioController) {
+  CAN_TypeDef & regs = registers (ioController) ;
+  memset ((void *) & regs, 0, sizeof (CAN_TypeDef)) ;
+  regs.MCR.mValue = MCR_RESET_VALUE ;
+  regs.TSR.mValue = CAN_TSR_TME ;
+  regs.BTR.mValue = BTR_RESET_VALUE ;
+  if (ioController.mIndex == 0) { // Filter module
+    regs.FMR.mValue = FMR_RESET_VALUE ;
+  }
+  ioController.mInitMode = false ;
+  ioController.mBusOff = false ;
+  ioController.mRecoveryRequested = false ;
+  ioController.mWaitingRecessive = false ;
+  ioController.mRecoveryDate = 0 ;
+  ioController.mTEC = 0 ;
+  ioController.mREC = 0 ;
+  for (uint32_t idx = 0 ; idx < 3 ; idx++) {
+    ioController.mMailboxState [idx] = HostController::MAILBOX_EMPTY ;
+    ioController.mAbortRequested [idx] = false ;
+  }
+  for (uint32_t fifo = 0 ; fifo < 2 ; fifo++) {
+    ioController.mRxFIFO [fifo].clear () ;
+    ioController.mOverrunCount [fifo] = 0 ;
+  }
+  ioController.mFilterWriteViolationCount = 0 ;
+}
+
+//------------------------------------------------------------------------------
+
+static void resetBus (HostBus & ioBus) {
+  ioBus.mRecords.clear () ;
+  ioBus.mInjectedErrorCount = 0 ;
+  ioBus.mHeldDominant = false ;
+  ioBus.mBusy = false ;
+  ioBus.mFrameCompleted = false ;
+  ioBus.mIdleDate = gNow ;
+  ioBus.mBusyDuration = 0 ;
+  ioBus.mCurrentNode = nullptr ;
+  for (HostVirtualNode * node : ioBus.mVirtualNodes) {
+    node->mQueue.clear () ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void hostReset (void) {
+//--- Controllers (CAN1 last, as it resets the filter module)
+  for (uint32_t c = HOST_CAN_COUNT ; c > 0 ; c--) {
+    gControllers [c - 1].mIndex = c - 1 ;
+    gControllers [c - 1].mBusIndex = 0 ;
+    resetController (gControllers [c - 1]) ;
+    resetBus (gControllers [c - 1].mLoopBackBus) ;
+  }
+  for (uint32_t b = 0 ; b < HOST_BUS_COUNT ; b++) {
+    resetBus (gBuses [b]) ;
+  }
+//--- NVIC
+  for (uint32_t irq = 0 ; irq < IRQ_COUNT ; irq++) {
+    gIRQEnabled [irq] = false ;
+    gIRQPriority [irq] = 0 ;
+    gIRQCount [irq] = 0 ;
+    gIRQDuration [irq] = 0 ;
+  }
+  gPRIMASK = 0 ;
+  gBASEPRI = 0 ;
+  gNesting = 0 ;
+  gMaxNesting = 0 ;
+//--- Other registers
+  gHostRCC.APB1ENR.mValue = 0 ;
+  gHostRCC.APB1RSTR.mValue = 0 ;
+  gHostDWT.CTRL = 0 ;
+  gHostCoreDebug.DEMCR = 0 ;
+  gStateChanged = true ;
+}
+
+//------------------------------------------------------------------------------
+
+static const bool gInitialized = (hostReset (), true) ;
+
+//------------------------------------------------------------------------------
+//   REGISTER ACCESS
+//------------------------------------------------------------------------------
+
+static bool locate (const volatile HostRegister * inRegister, uint32_t & outController, uint32_t & outOffset) {
+  bool found = false ;
+  for (uint32_t c = 0 ; (c < HOST_CAN_COUNT) && !found ; c++) {
+    const uintptr_t base = uintptr_t (& gHostCAN [c]) ;
+    const uintptr_t address = uintptr_t (inRegister) ;
+    found = (address >= base) && (address < (base + sizeof (CAN_TypeDef))) ;
+    if (found) {
+      outController = c ;
+      outOffset = uint32_t (address - base) ;
+    }
+  }
+  return found ;
+}
+
+//------------------------------------------------------------------------------
+
+static const uint32_t TX_MAILBOX_OFFSET = offsetof (CAN_TypeDef, sTxMailBox) ;
+static const uint32_t RX_MAILBOX_OFFSET = offsetof (CAN_TypeDef, sFIFOMailBox) ;
+static const uint32_t FILTER_BANK_OFFSET = offsetof (CAN_TypeDef, sFilterRegister) ;
+
+//------------------------------------------------------------------------------
+
+static uint32_t readCAN (const uint32_t inController, const uint32_t inOffset, const uint32_t inStoredValue) {
+  const HostController & controller = gControllers [inController] ;
+  const CAN_TypeDef & regs = gHostCAN [inController] ;
+  uint32_t value = inStoredValue ;
+  if (inOffset == offsetof (CAN_TypeDef, MSR)) {
+    value = (inStoredValue & (CAN_MSR_ERRI | CAN_MSR_WKUI | CAN_MSR_SLAKI))
+          | (controller.mInitMode ? CAN_MSR_INAK : 0)
+          | ((((regs.MCR.mValue & CAN_MCR_SLEEP) != 0) && !controller.mInitMode) ? CAN_MSR_SLAK : 0) ;
+  }else if (inOffset == offsetof (CAN_TypeDef, TSR)) {
+    value = inStoredValue & ((TSR_MAILBOX_STATUS << 16) | (TSR_MAILBOX_STATUS << 8) | TSR_MAILBOX_STATUS) ;
+    uint32_t code = 3 ;
+    for (uint32_t idx = 3 ; idx > 0 ; idx--) {
+      if (controller.mMailboxState [idx - 1] == HostController::MAILBOX_EMPTY) {
+        value |= CAN_TSR_TME0 << (idx - 1) ;
+        code = idx - 1 ;
+      }
+      if (controller.mAbortRequested [idx - 1]) {
+        value |= CAN_TSR_ABRQ0 << (8 * (idx - 1)) ;
+      }
+    }
+    value |= (code & 3) << CAN_TSR_CODE_Pos ;
+  }else if ((inOffset == offsetof (CAN_TypeDef, RF0R)) || (inOffset == offsetof (CAN_TypeDef, RF1R))) {
+    const uint32_t fifo = (inOffset == offsetof (CAN_TypeDef, RF0R)) ? 0 : 1 ;
+    value = (inStoredValue & (CAN_RF0R_FULL0 | CAN_RF0R_FOVR0)) | uint32_t (controller.mRxFIFO [fifo].size ()) ;
+  }else if (inOffset == offsetof (CAN_TypeDef, ESR)) {
+    const uint32_t tec = (controller.mTEC > 255) ? 255 : controller.mTEC ;
+    value = errorFlags (controller) | (inStoredValue & CAN_ESR_LEC) | (tec << CAN_ESR_TEC_Pos) | (controller.mREC << CAN_ESR_REC_Pos) ;
+  }else if ((inOffset >= RX_MAILBOX_OFFSET) && (inOffset < (RX_MAILBOX_OFFSET + sizeof (regs.sFIFOMailBox)))) {
+    const uint32_t fifo = (inOffset - RX_MAILBOX_OFFSET) / sizeof (CAN_FIFOMailBox_TypeDef) ;
+    const uint32_t field = ((inOffset - RX_MAILBOX_OFFSET) % sizeof (CAN_FIFOMailBox_TypeDef)) / 4 ;
+    value = 0 ;
+    if (!controller.mRxFIFO [fifo].empty ()) {
+      const HostController::RxFrame & frame = controller.mRxFIFO [fifo].front () ;
+      const uint32_t fields [4] = {frame.mRIR, frame.mRDTR, frame.mRDLR, frame.mRDHR} ;
+      value = fields [field] ;
+    }
+  }
+  return value ;
+}
+
+//------------------------------------------------------------------------------
+
+static void writeFilterRegister (volatile HostRegister & ioRegister, const uint32_t inOffset, const uint32_t inValue) {
+  HostController & controller = gControllers [0] ;
+  const CAN_TypeDef & regs = gHostCAN [0] ;
+  const bool filterInit = (regs.FMR.mValue & CAN_FMR_FINIT) != 0 ;
+  bool allowed = true ;
+  if ((inOffset == offsetof (CAN_TypeDef, FM1R))
+   || (inOffset == offsetof (CAN_TypeDef, FS1R))
+   || (inOffset == offsetof (CAN_TypeDef, FFA1R))) {
+    allowed = filterInit ;
+  }else if (inOffset >= FILTER_BANK_OFFSET) {
+    const uint32_t bank = (inOffset - FILTER_BANK_OFFSET) / sizeof (CAN_FilterRegister_TypeDef) ;
+    allowed = filterInit || (((regs.FA1R.mValue >> bank) & 1) == 0) ;
+  }
+  if (allowed) {
+    ioRegister.mValue = inValue ;
+  }else if (ioRegister.mValue != inValue) {
+    controller.mFilterWriteViolationCount += 1 ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+static void writeCAN (const uint32_t inController, const uint32_t inOffset, volatile HostRegister & ioRegister, const uint32_t inValue) {
+  HostController & controller = gControllers [inController] ;
+  CAN_TypeDef & regs = gHostCAN [inController] ;
+  if (inOffset == offsetof (CAN_TypeDef, MCR)) {
+    if ((inValue & CAN_MCR_RESET) != 0) { // Software master reset
+      resetController (controller) ;
+    }else{
+      regs.MCR.mValue = inValue ;
+      const bool initRequest = (inValue & CAN_MCR_INRQ) != 0 ;
+      if (initRequest && !controller.mInitMode) {
+        controller.mInitMode = true ;
+        controller.mRecoveryRequested = controller.mBusOff ;
+      }else if (initRequest) {
+        controller.mWaitingRecessive = false ;
+      }else if (controller.mInitMode && effectiveBus (controller).mHeldDominant) {
+        controller.mWaitingRecessive = true ;
+      }else if (controller.mInitMode) {
+        leaveInitMode (controller) ;
+      }
+    }
+  }else if (inOffset == offsetof (CAN_TypeDef, MSR)) {
+    regs.MSR.mValue &= ~ (inValue & (CAN_MSR_ERRI | CAN_MSR_WKUI | CAN_MSR_SLAKI)) ;
+  }else if (inOffset == offsetof (CAN_TypeDef, TSR)) {
+    for (uint32_t idx = 0 ; idx < 3 ; idx++) {
+      if ((inValue & (CAN_TSR_RQCP0 << (8 * idx))) != 0) {
+        regs.TSR.mValue &= ~ (TSR_MAILBOX_STATUS << (8 * idx)) ;
+      }
+      if ((inValue & (CAN_TSR_ABRQ0 << (8 * idx))) != 0) {
+        if (controller.mMailboxState [idx] == HostController::MAILBOX_PENDING) {
+          completeMailbox (controller, idx, 0) ;
+        }else if (controller.mMailboxState [idx] == HostController::MAILBOX_TRANSMITTING) {
+          controller.mAbortRequested [idx] = true ;
+        }
+      }
+    }
+  }else if ((inOffset == offsetof (CAN_TypeDef, RF0R)) || (inOffset == offsetof (CAN_TypeDef, RF1R))) {
+    const uint32_t fifo = (inOffset == offsetof (CAN_TypeDef, RF0R)) ? 0 : 1 ;
+    ioRegister.mValue &= ~ (inValue & (CAN_RF0R_FULL0 | CAN_RF0R_FOVR0)) ;
+    if (((inValue & CAN_RF0R_RFOM0) != 0) && !controller.mRxFIFO [fifo].empty ()) {
+      controller.mRxFIFO [fifo].pop_front () ;
+    }
+  }else if (inOffset == offsetof (CAN_TypeDef, ESR)) {
+    regs.ESR.mValue = inValue & CAN_ESR_LEC ;
+  }else if (inOffset == offsetof (CAN_TypeDef, BTR)) {
+    if (controller.mInitMode) { // Write protected outside init mode
+      regs.BTR.mValue = inValue ;
+    }
+  }else if ((inOffset >= TX_MAILBOX_OFFSET) && (inOffset < (TX_MAILBOX_OFFSET + sizeof (regs.sTxMailBox)))) {
+    const uint32_t idx = (inOffset - TX_MAILBOX_OFFSET) / sizeof (CAN_TxMailBox_TypeDef) ;
+    const uint32_t field = ((inOffset - TX_MAILBOX_OFFSET) % sizeof (CAN_TxMailBox_TypeDef)) / 4 ;
+    if (controller.mMailboxState [idx] == HostController::MAILBOX_EMPTY) { // Write protected otherwise
+      ioRegister.mValue = inValue ;
+      if ((field == 0) && ((inValue & 1) != 0)) { // TXRQ
+        controller.mMailboxState [idx] = HostController::MAILBOX_PENDING ;
+        controller.mRequestDate [idx] = gNow ;
+        gRequestOrder += 1 ;
+        controller.mRequestOrder [idx] = gRequestOrder ;
+        controller.mAbortRequested [idx] = false ;
+        regs.TSR.mValue &= ~ (TSR_MAILBOX_STATUS << (8 * idx)) ;
+      }
+    }
+  }else if ((inOffset >= RX_MAILBOX_OFFSET) && (inOffset < (RX_MAILBOX_OFFSET + sizeof (regs.sFIFOMailBox)))) {
+    // Read only
+  }else if (inOffset >= offsetof (CAN_TypeDef, FMR)) {
+    if (inOffset == offsetof (CAN_TypeDef, FMR) || (inOffset == offsetof (CAN_TypeDef, FA1R))) {
+      ioRegister.mValue = inValue ;
+    }else{
+      writeFilterRegister (ioRegister, inOffset, inValue) ;
+    }
+  }else{
+    ioRegister.mValue = inValue ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+// Peripheral reset: a controller is held in reset while its bit is set
+
+static void writeResetRegister (const uint32_t inValue) {
+  #ifdef STM32F446xx
+    static const uint32_t RESET_BITS [HOST_CAN_COUNT] = {
+      1U << RCC_APB1RSTR_CAN1RST_Pos, 1U << RCC_APB1RSTR_CAN2RST_Pos
+    } ;
+  #else
+    static const uint32_t RESET_BITS [HOST_CAN_COUNT] = {1U << RCC_APB1RSTR_CANRST_Pos} ;
+  #endif
+  gHostRCC.APB1RSTR.mValue = inValue ;
+  for (uint32_t c = 0 ; c < HOST_CAN_COUNT ; c++) {
+    if ((inValue & RESET_BITS [c]) != 0) {
+      resetController (gControllers [c]) ;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t hostRegisterRead (const volatile HostRegister * inRegister) {
+  tick () ;
+  uint32_t value = inRegister->mValue ;
+  uint32_t controller = 0 ;
+  uint32_t offset = 0 ;
+  if (inRegister == & gHostDWT.CYCCNT) {
+    value = cycleCounter () ;
+  }else if (locate (inRegister, controller, offset)) {
+    value = readCAN (controller, offset, value) ;
+  }
+  return value ;
+}
+
+//------------------------------------------------------------------------------
+
+void hostRegisterWrite (volatile HostRegister * inRegister, const uint32_t inValue) {
+  tick () ;
+  gStateChanged = true ;
+  uint32_t controller = 0 ;
+  uint32_t offset = 0 ;
+  if (inRegister == & gHostDWT.CYCCNT) {
+    // Read only in the simulation
+  }else if (inRegister == & gHostRCC.APB1RSTR) {
+    writeResetRegister (inValue) ;
+  }else if (locate (inRegister, controller, offset)) {
+    writeCAN (controller, offset, * inRegister, inValue) ;
+  }else{
+    inRegister->mValue = inValue ;
+  }
+}
+
+//------------------------------------------------------------------------------
+//   VIRTUAL NODE
+//------------------------------------------------------------------------------
+
+HostVirtualNode::HostVirtualNode (HostBus & ioBus, const bool inAcknowledge) :
+mBus (ioBus),
+mAcknowledge (inAcknowledge),
+mReceived (),
+mReceptionDates (),
+mSentCount (0),
+mFailedCount (0),
+mQueue () {
+  ioBus.mVirtualNodes.push_back (this) ;
+  gStateChanged = true ;
+}
+
+//------------------------------------------------------------------------------
+
+HostVirtualNode::~ HostVirtualNode (void) {
+  if (mBus.mCurrentNode == this) {
+    mBus.mCurrentNode = nullptr ;
+  }
+  for (uint32_t i = 0 ; i < mBus.mVirtualNodes.size () ; i++) {
+    if (mBus.mVirtualNodes [i] == this) {
+      mBus.mVirtualNodes.erase (mBus.mVirtualNodes.begin () + i) ;
+      break ;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void HostVirtualNode::send (const CANMessage & inMessage, const uint64_t inDelay) {
+  Item item ;
+  item.mMessage = inMessage ;
+  item.mDueDate = gNow + inDelay ;
+  item.mPeriod = 0 ;
+  item.mRemainingCount = 1 ;
+  mQueue.push_back (item) ;
+  gStateChanged = true ;
+}
+
+//------------------------------------------------------------------------------
+
+void HostVirtualNode::sendPeriodic (const CANMessage & inMessage,
+                                    const uint64_t inPeriod,
+                                    const uint64_t inOffset,
+                                    const uint32_t inCount) {
+  Item item ;
+  item.mMessage = inMessage ;
+  item.mDueDate = gNow + inOffset ;
+  item.mPeriod = inPeriod ;
+  item.mRemainingCount = inCount ;
+  mQueue.push_back (item) ;
+  gStateChanged = true ;
+}
+
+//------------------------------------------------------------------------------
+//   CORE
+//------------------------------------------------------------------------------
+
+void NVIC_EnableIRQ (const IRQn_Type inIRQ) {
+  gIRQEnabled [inIRQ] = true ;
+  gInterruptMaskChanged = true ;
+  tick () ;
+}
+
+//------------------------------------------------------------------------------
+
+void NVIC_DisableIRQ (const IRQn_Type inIRQ) {
+  gIRQEnabled [inIRQ] = false ;
+  gInterruptMaskChanged = true ;
+}
+
+//------------------------------------------------------------------------------
+
+void NVIC_SetPriority (const IRQn_Type inIRQ, const uint32_t inPriority) {
+  gIRQPriority [inIRQ] = uint8_t (inPriority << (8 - __NVIC_PRIO_BITS)) ;
+  gInterruptMaskChanged = true ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t __get_PRIMASK (void) {
+  return gPRIMASK ;
+}
+
+//------------------------------------------------------------------------------
+
+void __set_PRIMASK (const uint32_t inValue) {
+  gPRIMASK = inValue & 1 ;
+  gInterruptMaskChanged = true ;
+  tick () ;
+}
+
+//------------------------------------------------------------------------------
+
+void __disable_irq (void) {
+  gPRIMASK = 1 ;
+}
+
+//------------------------------------------------------------------------------
+
+void __enable_irq (void) {
+  gPRIMASK = 0 ;
+  gInterruptMaskChanged = true ;
+  tick () ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t __get_BASEPRI (void) {
+  return gBASEPRI ;
+}
+
+//------------------------------------------------------------------------------
+
+void __set_BASEPRI (const uint32_t inValue) {
+  gBASEPRI = inValue & 0xFF ;
+  gInterruptMaskChanged = true ;
+  tick () ;
+}
+
+//------------------------------------------------------------------------------
+
+void __set_BASEPRI_MAX (const uint32_t inValue) {
+  const uint32_t value = inValue & 0xFF ;
+  if ((value != 0) && ((gBASEPRI == 0) || (value < gBASEPRI))) {
+    gBASEPRI = value ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t __get_IPSR (void) {
+  return (gNesting > 0) ? (gActiveIRQ [gNesting - 1] + 16) : 0 ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t HAL_RCC_GetPCLK1Freq (void) {
+  return HOST_PCLK1 ;
+}
+
+//------------------------------------------------------------------------------
+//   ARDUINO
+//------------------------------------------------------------------------------
+
+uint32_t millis (void) {
+  tick () ;
+  return uint32_t (gNow / 1000000) ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t micros (void) {
+  tick () ;
+  return uint32_t (gNow / 1000) ;
+}
+
+//------------------------------------------------------------------------------
+
+void delay (const uint32_t inMillis) {
+  hostRun (uint64_t (inMillis) * 1000000) ;
+}
+
+//------------------------------------------------------------------------------
+
+void yield (void) {
+  tick () ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t SystemCoreClock = HOST_CORE_CLOCK ;
+HostSerial Serial ;
+
+//------------------------------------------------------------------------------
+
+static uint64_t gRandomState = 1 ;
+
+long random (const long inMax) {
+  gRandomState = gRandomState * 6364136223846793005ULL + 1442695040888963407ULL ;
+  const long value = long (gRandomState >> 33) ; // 31 bits
+  return (inMax > 0) ? (value % inMax) : 0 ;
+}
+
+//------------------------------------------------------------------------------
+
+long random (const long inMin, const long inMax) {
+  return (inMax > inMin) ? (inMin + random (inMax - inMin)) : inMin ;
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t gLED = LOW ;
+
+void pinMode (const uint32_t /* inPin */, const uint32_t /* inMode */) {
+}
+
+//------------------------------------------------------------------------------
+
+void digitalWrite (const uint32_t inPin, const uint32_t inValue) {
+  if (inPin == LED_BUILTIN) {
+    gLED = inValue ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+int digitalRead (const uint32_t inPin) {
+  return (inPin == LED_BUILTIN) ? int (gLED) : LOW ;
+}
+
+//------------------------------------------------------------------------------
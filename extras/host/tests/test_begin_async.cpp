@@ -0,0 +1,130 @@
+//------------------------------------------------------------------------------
+// Asynchronous begin: beginAsync / pollBegin steps up to BEGIN_DONE, settings
+// errors, normal mode timeout with the bus held dominant, and restart
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <HostTest.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+
+//------------------------------------------------------------------------------
+
+static CANMessage standardFrame (const uint32_t inIdentifier) {
+  CANMessage message ;
+  message.id = inIdentifier ;
+  message.len = 8 ;
+  for (uint32_t i = 0 ; i < 8 ; i++) {
+    message.data [i] = uint8_t (inIdentifier + i) ;
+  }
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+// Calls pollBegin every inPeriod ns until a final step; returns the steps seen
+
+static std::vector <ACAN_STM32::BeginStep> pollUntilFinalStep (const uint64_t inPeriod,
+                                                               const uint64_t inTimeout) {
+  std::vector <ACAN_STM32::BeginStep> steps ;
+  steps.push_back (can.beginStep ()) ;
+  const uint64_t deadline = hostNanoseconds () + inTimeout ;
+  while ((can.beginStep () != ACAN_STM32::BEGIN_DONE)
+      && (can.beginStep () != ACAN_STM32::BEGIN_FAILED)
+      && (hostNanoseconds () < deadline)) {
+    const ACAN_STM32::BeginStep step = can.pollBegin () ;
+    if (step != steps.back ()) {
+      steps.push_back (step) ;
+    }
+    hostRun (inPeriod) ;
+  }
+  return steps ;
+}
+
+//------------------------------------------------------------------------------
+//   STEPS
+//------------------------------------------------------------------------------
+// beginAsync returns without waiting; pollBegin goes through every step in order,
+// then the driver works as after begin (interrupts enabled).
+
+static void testStepsUpToDone (void) {
+  HostVirtualNode node (hostBus (0)) ;
+  CHECK_EQUAL (can.beginStep (), ACAN_STM32::BEGIN_IDLE) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.beginAsync (settings), 0) ;
+  CHECK_EQUAL (can.beginStep (), ACAN_STM32::BEGIN_WAITING_INIT_MODE) ;
+  const std::vector <ACAN_STM32::BeginStep> steps = pollUntilFinalStep (10 * 1000, 10 * MS) ;
+  CHECK_EQUAL (steps.size (), 4) ;
+  for (uint32_t i = 0 ; i < steps.size () ; i++) {
+    CHECK_EQUAL (steps [i], ACAN_STM32::BeginStep (ACAN_STM32::BEGIN_WAITING_INIT_MODE + i)) ;
+  }
+  CHECK_EQUAL (can.beginErrorCode (), 0) ;
+  CHECK_EQUAL (can.pollBegin (), ACAN_STM32::BEGIN_DONE) ; // Final step is kept
+//--- Transmit and receive (ISRs)
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x123)), 0) ;
+  node.send (standardFrame (0x456)) ;
+  CHECK (hostRunUntil ([] () { return can.driverReceiveFIFO0Count () == 1 ; }, 10 * MS)) ;
+  CHECK_EQUAL (node.mReceived.size (), 1) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+// Settings are checked by beginAsync as by begin; the controller is not touched.
+
+static void testSettingsError (void) {
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mMessageIRQPriority = 1 << __NVIC_PRIO_BITS ;
+  CHECK_EQUAL (can.beginAsync (settings), ACAN_STM32::kInvalidMessageIRQPriority) ;
+  CHECK_EQUAL (can.beginStep (), ACAN_STM32::BEGIN_FAILED) ;
+  CHECK_EQUAL (can.beginErrorCode (), ACAN_STM32::kInvalidMessageIRQPriority) ;
+  CHECK_EQUAL (can.pollBegin (), ACAN_STM32::BEGIN_FAILED) ;
+  CHECK (!hostController (0).isInInitMode ()) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   TIMEOUT
+//------------------------------------------------------------------------------
+// The bus is held dominant: normal mode is never entered, the step fails after
+// the step timeout (10 ms, millis resolution), the controller stays in
+// initialization mode. Once the bus is released, beginAsync succeeds.
+
+static void testNormalModeTimeout (void) {
+  HostVirtualNode node (hostBus (0)) ;
+  hostBus (0).holdDominant (true) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.beginAsync (settings, ACAN_STM32::Filters (), 10), 0) ;
+  const uint64_t start = hostNanoseconds () ;
+  const std::vector <ACAN_STM32::BeginStep> steps = pollUntilFinalStep (100 * 1000, 100 * MS) ;
+  const uint64_t duration = hostNanoseconds () - start ;
+  CHECK_EQUAL (steps.size (), 3) ;
+  CHECK (steps.size () == 3 && steps [1] == ACAN_STM32::BEGIN_WAITING_NORMAL_MODE) ;
+  CHECK_EQUAL (can.beginStep (), ACAN_STM32::BEGIN_FAILED) ;
+  CHECK_EQUAL (can.beginErrorCode (), ACAN_STM32::kNormalModeTimeout) ;
+  CHECK (duration >= 9 * MS) ;
+  CHECK (duration < 11 * MS) ;
+  CHECK (hostController (0).isInInitMode ()) ;
+//--- Bus released
+  hostBus (0).holdDominant (false) ;
+  CHECK_EQUAL (can.beginAsync (settings, ACAN_STM32::Filters (), 10), 0) ;
+  pollUntilFinalStep (100 * 1000, 100 * MS) ;
+  CHECK_EQUAL (can.beginStep (), ACAN_STM32::BEGIN_DONE) ;
+  CHECK_EQUAL (can.beginErrorCode (), 0) ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x123)), 0) ;
+  CHECK (hostRunUntil ([&] () { return node.mReceived.size () == 1 ; }, 10 * MS)) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testStepsUpToDone) ;
+  RUN_TEST (testSettingsError) ;
+  RUN_TEST (testNormalModeTimeout) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
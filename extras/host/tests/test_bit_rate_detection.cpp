@@ -0,0 +1,126 @@
+//------------------------------------------------------------------------------
+// Bit rate detection: ACAN_STM32_BitRateDetector decisions, and
+// ACAN_STM32::detectBitRate listening to a bus of virtual nodes
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <HostTest.h>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+
+//------------------------------------------------------------------------------
+//   DETECTOR
+//------------------------------------------------------------------------------
+
+static void testDetectorVerdicts (void) {
+  ACAN_STM32_BitRateDetector detector ;
+//--- No bus activity: LEC set by software, or no error
+  detector.addSample (0, ACAN_STM32_BitRateDetector::LEC_SET_BY_SOFTWARE, 0) ;
+  detector.addSample (0, ACAN_STM32_BitRateDetector::LEC_NO_ERROR, 0) ;
+  CHECK_EQUAL (detector.verdict (), ACAN_STM32_BitRateDetector::UNDECIDED) ;
+//--- Frames received
+  detector.addSample (1, ACAN_STM32_BitRateDetector::LEC_NO_ERROR, 0) ;
+  CHECK_EQUAL (detector.verdict (), ACAN_STM32_BitRateDetector::UNDECIDED) ;
+  detector.addSample (1, ACAN_STM32_BitRateDetector::LEC_NO_ERROR, 0) ;
+  CHECK_EQUAL (detector.verdict (), ACAN_STM32_BitRateDetector::MATCH) ;
+//--- Receive errors, seen by the last error code
+  detector.reset () ;
+  detector.addSample (0, ACAN_STM32_BitRateDetector::LEC_STUFF_ERROR, 0) ;
+  CHECK_EQUAL (detector.verdict (), ACAN_STM32_BitRateDetector::UNDECIDED) ;
+  detector.addSample (0, ACAN_STM32_BitRateDetector::LEC_CRC_ERROR, 0) ;
+  CHECK_EQUAL (detector.verdict (), ACAN_STM32_BitRateDetector::MISMATCH) ;
+//--- Several errors between two samples, seen by the receive error counter
+  detector.reset () ;
+  detector.addSample (0, ACAN_STM32_BitRateDetector::LEC_FORM_ERROR, 3) ;
+  CHECK_EQUAL (detector.errorCount (), 3) ;
+  CHECK_EQUAL (detector.verdict (), ACAN_STM32_BitRateDetector::MISMATCH) ;
+//--- Enough frames win over errors
+  detector.reset () ;
+  detector.addSample (2, ACAN_STM32_BitRateDetector::LEC_STUFF_ERROR, 5) ;
+  CHECK_EQUAL (detector.verdict (), ACAN_STM32_BitRateDetector::MATCH) ;
+}
+
+//------------------------------------------------------------------------------
+//   DETECTION ON A BUS
+//------------------------------------------------------------------------------
+
+static CANMessage frame (const uint32_t inIdentifier) {
+  CANMessage message ;
+  message.id = inIdentifier ;
+  message.len = 8 ;
+  message.data64 = 0x0123456789ABCDEFULL ^ inIdentifier ;
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+// A bus at 250 kbit/s: a node sends every 2 ms, another one acknowledges. The
+// controller tries 500 kbit/s first (stuff errors), then 250 kbit/s.
+
+static void testDetectionOnActiveBus (void) {
+  hostBus (0).setBitRate (250 * 1000) ;
+  HostVirtualNode sender (hostBus (0)) ;
+  HostVirtualNode receiver (hostBus (0)) ;
+  sender.sendPeriodic (frame (0x123), 2 * MS) ;
+  const uint64_t start = hostNanoseconds () ;
+  const uint32_t detectedBitRate = can.detectBitRate () ;
+  const uint64_t duration = hostNanoseconds () - start ;
+  CHECK_EQUAL (detectedBitRate, 250 * 1000) ;
+  CHECK (duration < 20 * MS) ; // Verdicts are reached without waiting the listen duration
+//--- The bus is not disturbed
+  CHECK_EQUAL (sender.mFailedCount, 0) ;
+  CHECK (sender.mSentCount > 0) ;
+  CHECK_EQUAL (receiver.mReceived.size (), sender.mSentCount) ;
+  CHECK_EQUAL (hostController (0).transmitErrorCounter (), 0) ;
+//--- The controller is stopped on return
+  CHECK (hostController (0).isInInitMode ()) ;
+//--- It is started at the detected bit rate, and acknowledges frames
+  ACAN_STM32_Settings settings (250 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  CANMessage message ;
+  CHECK (hostRunUntil ([&] () { return can.receive0 (message) ; }, 10 * MS)) ;
+  CHECK_EQUAL (message.id, 0x123) ;
+  can.end () ;
+  hostBus (0).setBitRate (500 * 1000) ;
+}
+
+//------------------------------------------------------------------------------
+// Frames at a bit rate that is not a candidate: every candidate is rejected
+
+static void testDetectionWithoutMatchingCandidate (void) {
+  hostBus (0).setBitRate (125 * 1000) ;
+  HostVirtualNode sender (hostBus (0)) ;
+  HostVirtualNode receiver (hostBus (0)) ;
+  sender.sendPeriodic (frame (0x456), 1 * MS) ;
+  const uint32_t CANDIDATES [3] = {500 * 1000, 250 * 1000, 1000 * 1000} ;
+  CHECK_EQUAL (can.detectBitRate (CANDIDATES, 3, 50), 0) ;
+  CHECK_EQUAL (sender.mFailedCount, 0) ;
+  hostBus (0).setBitRate (500 * 1000) ;
+}
+
+//------------------------------------------------------------------------------
+// No bus activity: every candidate listens for the whole duration (to the
+// millisecond)
+
+static void testDetectionOnIdleBus (void) {
+  const uint32_t CANDIDATES [3] = {500 * 1000, 250 * 1000, 125 * 1000} ;
+  const uint64_t start = hostNanoseconds () ;
+  CHECK_EQUAL (can.detectBitRate (CANDIDATES, 3, 50), 0) ;
+  const uint64_t duration = hostNanoseconds () - start ;
+  CHECK (duration > 3 * 49 * MS) ; // Listen duration counted in milliseconds
+  CHECK (duration < 160 * MS) ;
+  CHECK_EQUAL (hostBus (0).records ().size (), 0) ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testDetectorVerdicts) ;
+  RUN_TEST (testDetectionOnActiveBus) ;
+  RUN_TEST (testDetectionWithoutMatchingCandidate) ;
+  RUN_TEST (testDetectionOnIdleBus) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,132 @@
+//------------------------------------------------------------------------------
+// Blocking receive and send with notifiers (HostNotifier): timeout expiry, and
+// wake up by the receive and transmit ISRs
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <HostNotifier.h>
+#include <HostTest.h>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+
+//------------------------------------------------------------------------------
+
+static CANMessage standardFrame (const uint32_t inIdentifier) {
+  CANMessage message ;
+  message.id = inIdentifier ;
+  message.len = 8 ;
+  for (uint32_t i = 0 ; i < 8 ; i++) {
+    message.data [i] = uint8_t (inIdentifier + i) ;
+  }
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+//   RECEIVE
+//------------------------------------------------------------------------------
+// Nothing is received: receive0 waits on the notifier for the whole timeout.
+
+static void testReceiveTimeoutExpires (void) {
+  HostNotifier notifier ;
+  can.setReceiveNotifier (& notifier) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  const uint64_t start = hostNanoseconds () ;
+  CANMessage message ;
+  CHECK (!can.receive0 (message, 5)) ;
+  const uint64_t duration = hostNanoseconds () - start ;
+  CHECK (duration >= 5 * MS) ;
+  CHECK (duration < 6 * MS) ;
+  CHECK (notifier.waitCount () > 0) ;
+  CHECK_EQUAL (notifier.timeoutCount (), notifier.waitCount ()) ;
+  CHECK_EQUAL (notifier.notifyCount (), 0) ;
+  can.end () ;
+  can.setReceiveNotifier (nullptr) ;
+}
+
+//------------------------------------------------------------------------------
+// A frame due 2 ms later: the receive ISR wakes receive0 up, long before the
+// timeout.
+
+static void testReceiveWakesOnFrame (void) {
+  HostNotifier notifier ;
+  can.setReceiveNotifier (& notifier) ;
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  node.send (standardFrame (0x123), 2 * MS) ;
+  const uint64_t start = hostNanoseconds () ;
+  CANMessage message ;
+  CHECK (can.receive0 (message, 100)) ;
+  const uint64_t duration = hostNanoseconds () - start ;
+  CHECK_EQUAL (message.id, 0x123) ;
+  CHECK (duration >= 2 * MS) ;
+  CHECK (duration < 3 * MS) ;
+  CHECK_EQUAL (notifier.notifyCount (), 1) ;
+  CHECK_EQUAL (notifier.timeoutCount (), 0) ;
+  can.end () ;
+  can.setReceiveNotifier (nullptr) ;
+}
+
+//------------------------------------------------------------------------------
+//   SEND
+//------------------------------------------------------------------------------
+// Nobody acknowledges: the frame in mailbox 0 is retried for ever, and the
+// driver transmit FIFO (1 frame) stays full; send waits for the whole timeout.
+
+static void testSendTimeoutExpires (void) {
+  HostNotifier notifier ;
+  can.setTransmitNotifier (& notifier) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mDriverTransmitFIFOSize = 1 ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x100)), 0) ; // Mailbox 0
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x101)), 0) ; // Driver transmit FIFO
+  const uint64_t start = hostNanoseconds () ;
+  CHECK_EQUAL (can.send (standardFrame (0x102), 5), ACAN_STM32::kTransmitBufferOverflow) ;
+  const uint64_t duration = hostNanoseconds () - start ;
+  CHECK (duration >= 5 * MS) ;
+  CHECK (duration < 6 * MS) ;
+  CHECK (notifier.waitCount () > 0) ;
+  CHECK_EQUAL (notifier.notifyCount (), 0) ;
+  can.end () ;
+  can.setTransmitNotifier (nullptr) ;
+}
+
+//------------------------------------------------------------------------------
+// A node acknowledges: the transmit ISR frees the mailbox and moves the FIFO
+// frame into it, then wakes send up, after about one frame.
+
+static void testSendWakesOnMailboxRelease (void) {
+  HostNotifier notifier ;
+  can.setTransmitNotifier (& notifier) ;
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mDriverTransmitFIFOSize = 1 ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x100)), 0) ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x101)), 0) ;
+  const uint64_t start = hostNanoseconds () ;
+  CHECK_EQUAL (can.send (standardFrame (0x102), 100), 0) ;
+  const uint64_t duration = hostNanoseconds () - start ;
+  CHECK (duration < 1 * MS) ;
+  CHECK (notifier.notifyCount () > 0) ;
+  CHECK_EQUAL (notifier.timeoutCount (), 0) ;
+  CHECK (hostRunUntil ([&] () { return node.mReceived.size () == 3 ; }, 10 * MS)) ;
+  can.end () ;
+  can.setTransmitNotifier (nullptr) ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testReceiveTimeoutExpires) ;
+  RUN_TEST (testReceiveWakesOnFrame) ;
+  RUN_TEST (testSendTimeoutExpires) ;
+  RUN_TEST (testSendWakesOnMailboxRelease) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
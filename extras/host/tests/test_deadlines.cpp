@@ -0,0 +1,123 @@
+//------------------------------------------------------------------------------
+// Transmit deadlines: a stale frame is aborted in its mailbox (ABRQx) by
+// expireStaleFrames, stale frames are dropped from the driver transmit FIFO,
+// every miss is counted and given to the deadline miss call back; frames sent in
+// time are not affected
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <HostTest.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+
+//------------------------------------------------------------------------------
+
+static CANMessage standardFrame (const uint32_t inIdentifier) {
+  CANMessage message ;
+  message.id = inIdentifier ;
+  message.len = 8 ;
+  for (uint32_t i = 0 ; i < 8 ; i++) {
+    message.data [i] = uint8_t (inIdentifier + i) ;
+  }
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+
+static std::vector <uint32_t> gMissedIdentifiers ;
+
+static void deadlineMissed (const CANMessage & inMessage) {
+  gMissedIdentifiers.push_back (inMessage.id) ;
+}
+
+//------------------------------------------------------------------------------
+//   STALE FRAMES
+//------------------------------------------------------------------------------
+// Nobody acknowledges: the frame in mailbox 0 is retried, no transmit interrupt
+// occurs. expireStaleFrames aborts it after its deadline; the abort completion
+// (transmit ISR) drops the stale frames of the driver transmit FIFO, and loads
+// the frame without deadline. Then the bus carries only this one.
+
+static void testStaleFramesAreDropped (void) {
+  gMissedIdentifiers.clear () ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mDriverTransmitFIFOSize = 8 ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  can.setDeadlineMissCallBack (deadlineMissed) ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x100), 1000), 0) ; // Mailbox 0
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x101), 2000), 0) ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x102), 2000), 0) ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x103)), 0) ; // No deadline
+//--- Before the deadline
+  hostRun (500 * 1000) ;
+  can.expireStaleFrames () ;
+  CHECK_EQUAL (can.deadlineMissCount (), 0) ;
+//--- After every deadline
+  hostRun (2 * MS) ;
+  CHECK_EQUAL (can.deadlineMissCount (), 0) ; // No transmit interrupt
+  can.expireStaleFrames () ;
+  CHECK (hostRunUntil ([] () { return can.driverTransmitFIFOCount () == 0 ; }, 1 * MS)) ;
+  CHECK_EQUAL (can.deadlineMissCount (), 3) ;
+  CHECK_EQUAL (gMissedIdentifiers.size (), 3) ;
+  if (gMissedIdentifiers.size () == 3) {
+    CHECK_EQUAL (gMissedIdentifiers [0], 0x100) ;
+    CHECK_EQUAL (gMissedIdentifiers [1], 0x101) ;
+    CHECK_EQUAL (gMissedIdentifiers [2], 0x102) ;
+  }
+//--- Only 0x103 is retried now
+  hostBus (0).clearRecords () ;
+  hostRun (2 * MS) ;
+  const std::vector <HostBusRecord> & records = hostBus (0).records () ;
+  CHECK (records.size () > 0) ;
+  for (const HostBusRecord & record : records) {
+    CHECK_EQUAL (record.mMessage.id, 0x103) ;
+  }
+//--- A frame without deadline never expires
+  hostRun (10 * MS) ;
+  can.expireStaleFrames () ;
+  CHECK_EQUAL (can.deadlineMissCount (), 3) ;
+  can.setDeadlineMissCallBack (nullptr) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   FRAMES IN TIME
+//------------------------------------------------------------------------------
+// A node acknowledges: frames are sent long before their deadline, in order,
+// and nothing is missed.
+
+static void testFramesInTimeAreSent (void) {
+  gMissedIdentifiers.clear () ;
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mDriverTransmitFIFOSize = 8 ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  can.setDeadlineMissCallBack (deadlineMissed) ;
+  for (uint32_t i = 0 ; i < 8 ; i++) {
+    CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x200 + i), 10 * 1000), 0) ;
+  }
+  CHECK (hostRunUntil ([&] () { return node.mReceived.size () == 8 ; }, 20 * MS)) ;
+  for (uint32_t i = 0 ; i < node.mReceived.size () ; i++) {
+    CHECK_EQUAL (node.mReceived [i].id, 0x200 + i) ;
+  }
+  hostRun (20 * MS) ;
+  can.expireStaleFrames () ;
+  CHECK_EQUAL (can.deadlineMissCount (), 0) ;
+  CHECK_EQUAL (gMissedIdentifiers.size (), 0) ;
+  can.setDeadlineMissCallBack (nullptr) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testStaleFramesAreDropped) ;
+  RUN_TEST (testFramesInTimeAreSent) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,329 @@
+//------------------------------------------------------------------------------
+// Driver on the bxCAN simulator: loop back, exchange with a virtual node,
+// filter dispatch and update, fault confinement and bus-off recovery
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <HostTest.h>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+
+//------------------------------------------------------------------------------
+
+static CANMessage standardFrame (const uint32_t inIdentifier, const uint8_t inLength = 8) {
+  CANMessage message ;
+  message.id = inIdentifier ;
+  message.len = inLength ;
+  for (uint32_t i = 0 ; i < inLength ; i++) {
+    message.data [i] = uint8_t (inIdentifier + i) ;
+  }
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+
+static CANMessage extendedFrame (const uint32_t inIdentifier, const uint8_t inLength = 8) {
+  CANMessage message = standardFrame (inIdentifier, inLength) ;
+  message.ext = true ;
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+//   LOOP BACK
+//------------------------------------------------------------------------------
+
+static void testInternalLoopBack (void) {
+  ACAN_STM32_Settings settings (1000 * 1000) ;
+  settings.mModuleMode = ACAN_STM32_Settings::INTERNAL_LOOP_BACK ;
+  settings.mDriverTransmitFIFOSize = 20 ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  const uint32_t FRAME_COUNT = 20 ;
+  for (uint32_t i = 0 ; i < FRAME_COUNT ; i++) {
+    CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x100 + i)), 0) ;
+  }
+  uint32_t receivedCount = 0 ;
+  bool ordered = true ;
+  hostRunUntil ([&] () {
+    CANMessage message ;
+    while (can.receive0 (message)) {
+      ordered &= (message.id == (0x100 + receivedCount)) && (message.data [7] == uint8_t (message.id + 7)) ;
+      receivedCount += 1 ;
+    }
+    return receivedCount == FRAME_COUNT ;
+  }, 10 * MS) ;
+  CHECK_EQUAL (receivedCount, FRAME_COUNT) ;
+  CHECK (ordered) ;
+//--- Frames stay on the private bus of the controller
+  CHECK_EQUAL (hostBus (0).records ().size (), 0) ;
+  CHECK_EQUAL (hostController (0).mLoopBackBus.records ().size (), FRAME_COUNT) ;
+  CHECK (hostInterruptCount (CAN1_TX_IRQn) > 0) ;
+  CHECK (hostInterruptCount (CAN1_RX0_IRQn) > 0) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   VIRTUAL NODE
+//------------------------------------------------------------------------------
+
+static void testExchangeWithVirtualNode (void) {
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+//--- Node to controller
+  node.send (extendedFrame (0x12345678, 3)) ;
+  CANMessage message ;
+  CHECK (hostRunUntil ([&] () { return can.receive0 (message) ; }, 10 * MS)) ;
+  CHECK (message.ext) ;
+  CHECK_EQUAL (message.id, 0x12345678) ;
+  CHECK_EQUAL (message.len, 3) ;
+  CHECK_EQUAL (message.data [2], uint8_t (0x78 + 2)) ;
+//--- Controller to node
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x456)), 0) ;
+  CHECK (hostRunUntil ([&] () { return node.mReceived.size () == 1 ; }, 10 * MS)) ;
+  CHECK_EQUAL (node.mReceived [0].id, 0x456) ;
+  CHECK (!node.mReceived [0].ext) ;
+  CHECK_EQUAL (node.mReceived [0].data64, standardFrame (0x456).data64) ;
+//--- Frame durations follow the bit rate (2 us)
+  const std::vector <HostBusRecord> & records = hostBus (0).records () ;
+  CHECK_EQUAL (records.size (), 2) ;
+  for (const HostBusRecord & record : records) {
+    CHECK (record.mOk) ;
+    CHECK_EQUAL (record.mEndDate - record.mStartDate, ACAN_STM32_Settings::frameBitCount (record.mMessage) * 2000) ;
+  }
+  CHECK_EQUAL (can.transmitErrorCounter (), 0) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   FILTERS
+//------------------------------------------------------------------------------
+
+static uint32_t gCallBackCounts [4] ;
+
+static void callBack0 (const CANMessage &) { gCallBackCounts [0] += 1 ; }
+static void callBack1 (const CANMessage &) { gCallBackCounts [1] += 1 ; }
+static void callBack2 (const CANMessage &) { gCallBackCounts [2] += 1 ; }
+static void callBack3 (const CANMessage &) { gCallBackCounts [3] += 1 ; }
+
+//------------------------------------------------------------------------------
+// The filter match index given by the controller selects the call back: it
+// checks the filter numbering of the driver against the reference manual.
+
+static void testFilterDispatch (void) {
+  for (uint32_t i = 0 ; i < 4 ; i++) {
+    gCallBackCounts [i] = 0 ;
+  }
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mDriverReceiveFIFO1Size = 8 ;
+  ACAN_STM32::Filters filters ;
+  filters.addExtendedMask (0x1000, 0x1FFFF000, ACAN_STM32::DATA, callBack3, ACAN_STM32::FIFO1) ;
+  filters.addStandardQuad (0x100, false, callBack0,
+                           0x101, false, callBack1,
+                           0x102, false, callBack2,
+                           0x103, true, callBack3,
+                           ACAN_STM32::FIFO0) ;
+  filters.addStandardMasks (0x200, 0x700, ACAN_STM32::DATA, callBack0,
+                            0x300, 0x700, ACAN_STM32::DATA, callBack1,
+                            ACAN_STM32::FIFO1) ;
+  CHECK_EQUAL (can.begin (settings, filters), 0) ;
+  CANMessage remote = standardFrame (0x103, 0) ;
+  remote.rtr = true ;
+  node.send (standardFrame (0x101)) ;
+  node.send (standardFrame (0x102)) ;
+  node.send (remote) ;
+  node.send (standardFrame (0x103)) ; // Rejected (data frame)
+  node.send (standardFrame (0x2FF)) ;
+  node.send (standardFrame (0x345)) ;
+  node.send (extendedFrame (0x1ABC)) ;
+  node.send (extendedFrame (0x2ABC)) ; // Rejected
+  CHECK (hostRunUntil ([&] () { return node.pendingCount () == 0 && hostBus (0).isIdle () ; }, 10 * MS)) ;
+  hostRun (1 * MS) ;
+  CHECK_EQUAL (can.driverReceiveFIFO0Count (), 3) ;
+  CHECK_EQUAL (can.driverReceiveFIFO1Count (), 3) ;
+  while (can.dispatchReceivedMessage ()) {}
+  CHECK_EQUAL (gCallBackCounts [0], 1) ; // 0x2FF
+  CHECK_EQUAL (gCallBackCounts [1], 2) ; // 0x101, 0x345
+  CHECK_EQUAL (gCallBackCounts [2], 1) ; // 0x102
+  CHECK_EQUAL (gCallBackCounts [3], 2) ; // 0x103 remote, 0x1ABC
+  CHECK_EQUAL (hostController (0).filterWriteViolationCount (), 0) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+// Frames received before updateFilters carry the filter indexes of the previous
+// filters: they are dispatched with the previous call backs, later frames with
+// the new ones. Another update is refused while such frames are queued.
+
+static void resetCallBackCounts (void) {
+  for (uint32_t i = 0 ; i < 4 ; i++) {
+    gCallBackCounts [i] = 0 ;
+  }
+}
+
+static void previousFilters (ACAN_STM32::Filters & outFilters) {
+  outFilters.addExtendedMask (0x100, 0x1FFFFFFF, ACAN_STM32::DATA, callBack0, ACAN_STM32::FIFO0) ;
+  outFilters.addExtendedMask (0x200, 0x1FFFFFFF, ACAN_STM32::DATA, callBack1, ACAN_STM32::FIFO0) ;
+}
+
+static void newFilters (ACAN_STM32::Filters & outFilters) {
+  outFilters.addExtendedMask (0x200, 0x1FFFFFFF, ACAN_STM32::DATA, callBack2, ACAN_STM32::FIFO0) ;
+  outFilters.addExtendedMask (0x300, 0x1FFFFFFF, ACAN_STM32::DATA, callBack3, ACAN_STM32::FIFO0) ;
+}
+
+static void testUpdateFiltersDispatchesQueuedFrames (void) {
+  resetCallBackCounts () ;
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  ACAN_STM32::Filters filters ;
+  previousFilters (filters) ;
+  CHECK_EQUAL (can.begin (settings, filters), 0) ;
+  node.send (extendedFrame (0x100)) ; // Filter 0
+  node.send (extendedFrame (0x200)) ; // Filter 1
+  CHECK (hostRunUntil ([&] () { return can.driverReceiveFIFO0Count () == 2 ; }, 10 * MS)) ;
+  ACAN_STM32::Filters updatedFilters ;
+  newFilters (updatedFilters) ;
+  CHECK_EQUAL (can.updateFilters (updatedFilters), 0) ;
+  node.send (extendedFrame (0x200)) ; // Filter 0
+  node.send (extendedFrame (0x300)) ; // Filter 1
+  node.send (extendedFrame (0x100)) ; // Rejected
+  CHECK (hostRunUntil ([&] () { return node.pendingCount () == 0 && hostBus (0).isIdle () ; }, 10 * MS)) ;
+  hostRun (1 * MS) ;
+  CHECK_EQUAL (can.driverReceiveFIFO0Count (), 4) ;
+//--- Frames received before the update are still queued
+  CHECK_EQUAL (can.updateFilters (filters), ACAN_STM32::kPreviousFiltersInUse) ;
+  CHECK (can.dispatchReceivedMessage ()) ;
+  CHECK_EQUAL (gCallBackCounts [0], 1) ;
+  CHECK_EQUAL (can.updateFilters (filters), ACAN_STM32::kPreviousFiltersInUse) ;
+  while (can.dispatchReceivedMessage ()) {}
+  CHECK_EQUAL (gCallBackCounts [0], 1) ; // 0x100, previous filter 0
+  CHECK_EQUAL (gCallBackCounts [1], 1) ; // 0x200, previous filter 1
+  CHECK_EQUAL (gCallBackCounts [2], 1) ; // 0x200, new filter 0
+  CHECK_EQUAL (gCallBackCounts [3], 1) ; // 0x300, new filter 1
+//--- receive0 also counts them; then an update is accepted
+  node.send (extendedFrame (0x300)) ;
+  CHECK (hostRunUntil ([&] () { return can.driverReceiveFIFO0Count () == 1 ; }, 10 * MS)) ;
+  CHECK_EQUAL (can.updateFilters (filters), 0) ;
+  CHECK_EQUAL (can.updateFilters (updatedFilters), ACAN_STM32::kPreviousFiltersInUse) ;
+  CANMessage message ;
+  CHECK (can.receive0 (message)) ;
+  CHECK_EQUAL (message.idx, 1) ;
+  CHECK_EQUAL (can.updateFilters (updatedFilters), 0) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+// In polling mode, frames wait in the hardware FIFO until poll: updateFilters
+// moves them to the driver FIFO before replacing the filters.
+
+static void testUpdateFiltersDrainsHardwareFIFOs (void) {
+  resetCallBackCounts () ;
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mPollingMode = true ;
+  ACAN_STM32::Filters filters ;
+  previousFilters (filters) ;
+  CHECK_EQUAL (can.begin (settings, filters), 0) ;
+  node.send (extendedFrame (0x100)) ;
+  node.send (extendedFrame (0x200)) ;
+  CHECK (hostRunUntil ([&] () { return node.pendingCount () == 0 && hostBus (0).isIdle () ; }, 10 * MS)) ;
+  hostRun (1 * MS) ;
+  CHECK_EQUAL (can.driverReceiveFIFO0Count (), 0) ;
+  ACAN_STM32::Filters updatedFilters ;
+  newFilters (updatedFilters) ;
+  CHECK_EQUAL (can.updateFilters (updatedFilters), 0) ;
+  CHECK_EQUAL (can.driverReceiveFIFO0Count (), 2) ;
+  node.send (extendedFrame (0x300)) ;
+  CHECK (hostRunUntil ([&] () { return node.pendingCount () == 0 && hostBus (0).isIdle () ; }, 10 * MS)) ;
+  hostRun (1 * MS) ;
+  can.poll () ;
+  while (can.dispatchReceivedMessage ()) {}
+  CHECK_EQUAL (gCallBackCounts [0], 1) ;
+  CHECK_EQUAL (gCallBackCounts [1], 1) ;
+  CHECK_EQUAL (gCallBackCounts [2], 0) ;
+  CHECK_EQUAL (gCallBackCounts [3], 1) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   FAULT CONFINEMENT
+//------------------------------------------------------------------------------
+
+static void testAckErrorsLeadToErrorPassive (void) {
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x321)), 0) ;
+//--- Nobody acknowledges: TEC rises by 8 up to error passive, then stays
+  hostRun (20 * MS) ;
+  CHECK_EQUAL (can.transmitErrorCounter (), 128) ;
+  CHECK_EQUAL (can.busState (), ACAN_STM32::BUS_ERROR_PASSIVE) ;
+//--- A node joins: the retransmission succeeds
+  HostVirtualNode node (hostBus (0)) ;
+  CHECK (hostRunUntil ([&] () { return node.mReceived.size () == 1 ; }, 10 * MS)) ;
+  CHECK_EQUAL (can.transmitErrorCounter (), 127) ;
+  CHECK_EQUAL (can.busState (), ACAN_STM32::BUS_ERROR_WARNING) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+static void testBusOffAutomaticRecovery (void) {
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  hostBus (0).injectErrors (32) ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x321)), 0) ;
+  CHECK (hostRunUntil ([] () { return hostController (0).isBusOff () ; }, 20 * MS)) ;
+  CHECK_EQUAL (can.busState (), ACAN_STM32::BUS_OFF) ;
+  CHECK_EQUAL (can.busOffCount (), 1) ;
+  CHECK_EQUAL (node.mReceived.size (), 0) ;
+//--- Recovery after 128 x 11 recessive bits (2.8 ms), then the frame is sent
+  CHECK (hostRunUntil ([&] () { return node.mReceived.size () == 1 ; }, 10 * MS)) ;
+  CHECK_EQUAL (can.busState (), ACAN_STM32::BUS_ERROR_ACTIVE) ;
+  CHECK_EQUAL (can.transmitErrorCounter (), 0) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+// Manual recovery: the controller stays bus-off until recoverFromBusOff, then
+// recovers after 128 x 11 recessive bits. The CAN interrupts are not masked
+// when recoverFromBusOff returns.
+
+static void testBusOffManualRecovery (void) {
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mBusOffRecovery = ACAN_STM32_Settings::MANUAL_BUS_OFF_RECOVERY ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  CHECK (!can.recoverFromBusOff ()) ; // Not bus-off
+  hostBus (0).injectErrors (32) ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x321)), 0) ;
+  CHECK (hostRunUntil ([] () { return hostController (0).isBusOff () ; }, 20 * MS)) ;
+  hostRun (10 * MS) ;
+  CHECK (hostController (0).isBusOff ()) ;
+  CHECK_EQUAL (node.mReceived.size (), 0) ;
+  CHECK (can.recoverFromBusOff ()) ;
+  CHECK_EQUAL (__get_PRIMASK (), 0) ;
+  CHECK_EQUAL (__get_BASEPRI (), 0) ;
+  CHECK (hostRunUntil ([&] () { return node.mReceived.size () == 1 ; }, 10 * MS)) ;
+  CHECK_EQUAL (can.busState (), ACAN_STM32::BUS_ERROR_ACTIVE) ;
+  CHECK_EQUAL (can.busOffCount (), 1) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testInternalLoopBack) ;
+  RUN_TEST (testExchangeWithVirtualNode) ;
+  RUN_TEST (testFilterDispatch) ;
+  RUN_TEST (testUpdateFiltersDispatchesQueuedFrames) ;
+  RUN_TEST (testUpdateFiltersDrainsHardwareFIFOs) ;
+  RUN_TEST (testAckErrorsLeadToErrorPassive) ;
+  RUN_TEST (testBusOffAutomaticRecovery) ;
+  RUN_TEST (testBusOffManualRecovery) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,242 @@
+//------------------------------------------------------------------------------
+// Driver FIFO pool: live resize keeps queued frames (and their transmit stamps),
+// transmit share of the pool, autotuner grow and shrink decisions
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <HostTest.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+
+//------------------------------------------------------------------------------
+
+static CANMessage standardFrame (const uint32_t inIdentifier, const uint8_t inIndex = 0) {
+  CANMessage message ;
+  message.id = inIdentifier ;
+  message.idx = inIndex ;
+  message.len = 8 ;
+  for (uint32_t i = 0 ; i < 8 ; i++) {
+    message.data [i] = uint8_t (inIdentifier + i) ;
+  }
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+
+static ACAN_STM32_Settings loopBackSettings (void) {
+  ACAN_STM32_Settings settings (1000 * 1000) ;
+  settings.mModuleMode = ACAN_STM32_Settings::INTERNAL_LOOP_BACK ;
+  return settings ;
+}
+
+//------------------------------------------------------------------------------
+
+static void sendAndReceiveInFIFO0 (const uint32_t inFirstIdentifier,
+                                   const uint32_t inCount,
+                                   const uint32_t inExpectedFIFOCount) {
+  for (uint32_t i = 0 ; i < inCount ; i++) {
+    CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (inFirstIdentifier + i)), 0) ;
+  }
+  CHECK (hostRunUntil ([&] () { return can.driverReceiveFIFO0Count () == inExpectedFIFOCount ; }, 10 * MS)) ;
+}
+
+//------------------------------------------------------------------------------
+//   LIVE RESIZE
+//------------------------------------------------------------------------------
+// The receive FIFO 0 content wraps around its slice; growing the transmit FIFO
+// moves it upward in the pool, resizing it rotates it: frames are received in
+// order, and a FIFO cannot be shrunk below its count.
+
+static void testResizeKeepsReceivedFrames (void) {
+  ACAN_STM32_Settings settings = loopBackSettings () ;
+  settings.mDriverTransmitFIFOSize = 16 ;
+  settings.mDriverReceiveFIFO0Size = 8 ;
+  settings.mDriverFIFOPoolSize = 64 ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+//--- Wrapped content: frames 0x104 ... 0x10A, read index 4
+  sendAndReceiveInFIFO0 (0x100, 6, 6) ;
+  CANMessage message ;
+  for (uint32_t i = 0 ; i < 4 ; i++) {
+    CHECK (can.receive0 (message)) ;
+  }
+  sendAndReceiveInFIFO0 (0x106, 5, 7) ;
+//--- Resizes
+  CHECK (can.resizeDriverTransmitFIFO (24)) ;
+  CHECK_EQUAL (can.driverTransmitFIFOSize (), 24) ;
+  CHECK (!can.resizeDriverReceiveFIFO0 (6)) ; // 7 frames are queued
+  CHECK_EQUAL (can.driverReceiveFIFO0Size (), 8) ;
+  CHECK (can.resizeDriverReceiveFIFO0 (7)) ;
+  CHECK (can.resizeDriverReceiveFIFO0 (20)) ;
+  CHECK_EQUAL (can.driverFIFOPoolFreeCount (), 64 - 24 - 20) ;
+  CHECK_EQUAL (can.driverReceiveFIFO0Count (), 7) ;
+//--- Frames are kept, in order; FIFO still works after resize
+  sendAndReceiveInFIFO0 (0x10B, 10, 17) ;
+  bool ordered = true ;
+  uint32_t count = 0 ;
+  while (can.receive0 (message)) {
+    ordered &= (message.id == (0x104 + count)) && (message.data [7] == uint8_t (message.id + 7)) ;
+    count += 1 ;
+  }
+  CHECK_EQUAL (count, 17) ;
+  CHECK (ordered) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+// Transmit stamps (tags) move with the frames of a transmit class FIFO, when the
+// driver transmit FIFO (class 0, before it in the pool) grows.
+
+static std::vector <uint32_t> gCompletedTags ;
+
+static void transmitComplete (const uint32_t inTag,
+                              const ACAN_STM32::TransmitStatus inStatus,
+                              const uint32_t /* inLatencyMicros */) {
+  if (inStatus == ACAN_STM32::TRANSMIT_OK) {
+    gCompletedTags.push_back (inTag) ;
+  }
+}
+
+static void testResizeKeepsTransmitStamps (void) {
+  gCompletedTags.clear () ;
+  ACAN_STM32_Settings settings = loopBackSettings () ;
+  settings.mDriverFIFOPoolSize = 64 ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  ACAN_STM32::TransmitClasses classes ;
+  classes.addClass (4, 0x1) ;
+  classes.addClass (8, 0x6) ;
+  CHECK_EQUAL (can.setTransmitClasses (classes), 0) ;
+  can.setTransmitCompleteCallBack (transmitComplete) ;
+//--- 2 frames in mailboxes 1 and 2, 8 in class 1 FIFO
+  for (uint32_t i = 0 ; i < 10 ; i++) {
+    CHECK_EQUAL (can.tryToSendWithTagReturnStatus (standardFrame (0x200 + i, 1), 1000 + i), 0) ;
+  }
+  CHECK_EQUAL (can.transmitClassFIFOCount (1), 8) ;
+//--- Class 1 FIFO moves upward
+  CHECK (can.resizeDriverTransmitFIFO (12)) ;
+  CHECK_EQUAL (can.transmitClassFIFOCount (1), 8) ;
+  CHECK (hostRunUntil ([] () { return gCompletedTags.size () == 10 ; }, 10 * MS)) ;
+  bool ordered = gCompletedTags.size () == 10 ;
+  for (uint32_t i = 0 ; (i < gCompletedTags.size ()) && ordered ; i++) {
+    ordered = gCompletedTags [i] == (1000 + i) ;
+  }
+  CHECK (ordered) ;
+  can.setTransmitCompleteCallBack (nullptr) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   TRANSMIT SHARE
+//------------------------------------------------------------------------------
+// Transmit stamps are allocated for the pool minus the receive FIFO sizes given
+// to begin: transmit FIFOs cannot grow beyond it, receive FIFOs can use the whole
+// pool.
+
+static void testTransmitShareOfPool (void) {
+  ACAN_STM32_Settings settings = loopBackSettings () ;
+  settings.mDriverTransmitFIFOSize = 8 ;
+  settings.mDriverReceiveFIFO0Size = 8 ;
+  settings.mDriverReceiveFIFO1Size = 0 ;
+  settings.mDriverFIFOPoolSize = 64 ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  CHECK (can.resizeDriverReceiveFIFO0 (2)) ;
+  CHECK (!can.resizeDriverTransmitFIFO (57)) ; // Pool has room, transmit share has not
+  CHECK_EQUAL (can.driverTransmitFIFOSize (), 8) ;
+  CHECK (can.resizeDriverTransmitFIFO (56)) ;
+  CHECK (can.resizeDriverReceiveFIFO0 (8)) ;
+  CHECK_EQUAL (can.driverFIFOPoolFreeCount (), 0) ;
+  CHECK (can.resizeDriverTransmitFIFO (4)) ;
+  CHECK (can.resizeDriverReceiveFIFO0 (60)) ;
+//--- Transmit classes are bound by the transmit share too
+  CHECK (can.resizeDriverReceiveFIFO0 (2)) ;
+  ACAN_STM32::TransmitClasses classes ;
+  classes.addClass (40, 0x1) ;
+  classes.addClass (17, 0x6) ;
+  CHECK_EQUAL (can.setTransmitClasses (classes), ACAN_STM32::kInvalidTransmitClasses) ;
+  ACAN_STM32::TransmitClasses smallerClasses ;
+  smallerClasses.addClass (40, 0x1) ;
+  smallerClasses.addClass (16, 0x6) ;
+  CHECK_EQUAL (can.setTransmitClasses (smallerClasses), 0) ;
+  CHECK (can.resizeDriverReceiveFIFO0 (8)) ;
+//--- Every transmit FIFO works
+  for (uint32_t i = 0 ; i < 36 ; i++) {
+    CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x300 + i, i % 2)), 0) ;
+  }
+  uint32_t count = 0 ;
+  CHECK (hostRunUntil ([&] () {
+    CANMessage message ;
+    while (can.receive0 (message)) {
+      count += 1 ;
+    }
+    return count == 36 ;
+  }, 20 * MS)) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   AUTOTUNER
+//------------------------------------------------------------------------------
+// A FIFO that overflowed is doubled, an idle one is halved; room of shrunk FIFOs
+// is available for growing ones, in the same call.
+
+static void testAutotuneGrowAndShrink (void) {
+  ACAN_STM32_Settings settings = loopBackSettings () ;
+  settings.mDriverTransmitFIFOSize = 16 ;
+  settings.mDriverReceiveFIFO0Size = 4 ;
+  settings.mDriverReceiveFIFO1Size = 0 ;
+  settings.mDriverFIFOPoolSize = 20 ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+//--- 1 frame in mailbox 0, 3 in the transmit FIFO (peak 3 < 16 / 4); receive
+//    FIFO 0 has been full
+  sendAndReceiveInFIFO0 (0x400, 4, 4) ;
+  CHECK_EQUAL (can.driverTransmitFIFOPeakCount (), 3) ;
+  CHECK_EQUAL (can.driverReceiveFIFO0PeakCount (), 4) ;
+  can.autotuneDriverFIFOs () ;
+  CHECK_EQUAL (can.driverTransmitFIFOSize (), 8) ;
+  CHECK_EQUAL (can.driverReceiveFIFO0Size (), 8) ;
+  CHECK_EQUAL (can.driverReceiveFIFO1Size (), 0) ; // Size 0 is not tuned
+  CHECK_EQUAL (can.driverReceiveFIFO0Count (), 4) ; // Queued frames are kept
+//--- Peak counts are reset to the current counts
+  CHECK_EQUAL (can.driverTransmitFIFOPeakCount (), 0) ;
+  CHECK_EQUAL (can.driverReceiveFIFO0PeakCount (), 4) ;
+//--- Receive FIFO 0 overflows: it gets the free part of the pool only
+  sendAndReceiveInFIFO0 (0x410, 6, 8) ;
+  CHECK (hostRunUntil ([] () { return hostBus (0).isIdle () && (can.driverTransmitFIFOCount () == 0) ; }, 10 * MS)) ;
+  hostRun (1 * MS) ;
+  CHECK_EQUAL (can.driverReceiveFIFO0PeakCount (), 9) ;
+  can.autotuneDriverFIFOs () ;
+  CHECK_EQUAL (can.driverTransmitFIFOSize (), 8) ; // Peak 5, not lower than 8 / 4
+  CHECK_EQUAL (can.driverReceiveFIFO0Size (), 12) ;
+  CHECK_EQUAL (can.driverFIFOPoolFreeCount (), 0) ;
+//--- Peak count between the quarter and the size: unchanged
+  CANMessage message ;
+  while (can.receive0 (message)) {}
+  sendAndReceiveInFIFO0 (0x420, 5, 5) ;
+  can.autotuneDriverFIFOs () ;
+  CHECK_EQUAL (can.driverReceiveFIFO0Size (), 12) ; // Peak 8
+  CHECK_EQUAL (can.driverTransmitFIFOSize (), 8) ; // Peak 4
+//--- Idle: both are halved, once their peak count is reset
+  while (can.receive0 (message)) {}
+  can.autotuneDriverFIFOs () ;
+  CHECK_EQUAL (can.driverReceiveFIFO0Size (), 12) ; // Peak 5
+  CHECK_EQUAL (can.driverTransmitFIFOSize (), 4) ;
+  can.autotuneDriverFIFOs () ;
+  CHECK_EQUAL (can.driverReceiveFIFO0Size (), 6) ;
+  CHECK_EQUAL (can.driverTransmitFIFOSize (), 2) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testResizeKeepsReceivedFrames) ;
+  RUN_TEST (testResizeKeepsTransmitStamps) ;
+  RUN_TEST (testTransmitShareOfPool) ;
+  RUN_TEST (testAutotuneGrowAndShrink) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
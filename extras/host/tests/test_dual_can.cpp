@@ -0,0 +1,195 @@
+//------------------------------------------------------------------------------
+// Dual CAN (STM32F446): filter bank split between CAN1 and CAN2 (CAN2SB),
+// consistency of the split, CAN2 started alone
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <HostTest.h>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+
+//------------------------------------------------------------------------------
+
+static CANMessage extendedFrame (const uint32_t inIdentifier) {
+  CANMessage message ;
+  message.id = inIdentifier ;
+  message.ext = true ;
+  message.len = 8 ;
+  for (uint32_t i = 0 ; i < 8 ; i++) {
+    message.data [i] = uint8_t (inIdentifier + i) ;
+  }
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t can2StartBank (void) {
+  return (uint32_t (CAN1->FMR) >> 8) & 0x3F ;
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t gCallBackCounts [2][3] ;
+
+static void can1CallBack0 (const CANMessage &) { gCallBackCounts [0][0] += 1 ; }
+static void can1CallBack1 (const CANMessage &) { gCallBackCounts [0][1] += 1 ; }
+static void can2CallBack0 (const CANMessage &) { gCallBackCounts [1][0] += 1 ; }
+static void can2CallBack1 (const CANMessage &) { gCallBackCounts [1][1] += 1 ; }
+static void can2CallBack2 (const CANMessage &) { gCallBackCounts [1][2] += 1 ; }
+
+//------------------------------------------------------------------------------
+//   BANK SPLIT
+//------------------------------------------------------------------------------
+// CAN2SB 20: CAN1 has banks 0 ... 19, CAN2 banks 20 ... 27. Filter match
+// indexes of CAN2 are numbered from its first bank.
+
+static void testNonDefaultStartBank (void) {
+  for (uint32_t i = 0 ; i < 3 ; i++) {
+    gCallBackCounts [0][i] = 0 ;
+    gCallBackCounts [1][i] = 0 ;
+  }
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mCAN2StartBank = 20 ;
+  ACAN_STM32::Filters filters1 ;
+  filters1.addExtendedMask (0x100, 0x1FFFFFFF, ACAN_STM32::DATA, can1CallBack0, ACAN_STM32::FIFO0) ;
+  filters1.addExtendedMask (0x110, 0x1FFFFFFF, ACAN_STM32::DATA, can1CallBack1, ACAN_STM32::FIFO0) ;
+  ACAN_STM32::Filters filters2 ;
+  filters2.addExtendedMask (0x200, 0x1FFFFFFF, ACAN_STM32::DATA, can2CallBack0, ACAN_STM32::FIFO0) ;
+  filters2.addExtendedMask (0x210, 0x1FFFFFFF, ACAN_STM32::DATA, can2CallBack1, ACAN_STM32::FIFO0) ;
+  filters2.addExtendedMask (0x220, 0x1FFFFFFF, ACAN_STM32::DATA, can2CallBack2, ACAN_STM32::FIFO0) ;
+  CHECK_EQUAL (can.begin (settings, filters1), 0) ;
+  CHECK_EQUAL (can2.begin (settings, filters2), 0) ;
+  CHECK_EQUAL (can2StartBank (), 20) ;
+//--- CAN2 filters land in banks 20, 21, 22; CAN1 filters in banks 0, 1
+  CHECK_EQUAL (uint32_t (CAN1->FA1R), (0x7U << 20) | 0x3U) ;
+  CHECK_EQUAL (uint32_t (CAN1->sFilterRegister [20].FR1), (0x200U << 3) | 4) ;
+  CHECK_EQUAL (uint32_t (CAN1->sFilterRegister [22].FR1), (0x220U << 3) | 4) ;
+//--- Every frame reaches the controller whose filters accept it
+  const uint32_t identifiers [6] = {0x100, 0x110, 0x200, 0x210, 0x220, 0x300} ;
+  for (uint32_t i = 0 ; i < 6 ; i++) {
+    node.send (extendedFrame (identifiers [i])) ;
+  }
+  CHECK (hostRunUntil ([&] () { return (node.pendingCount () == 0) && hostBus (0).isIdle () ; }, 10 * MS)) ;
+  hostRun (1 * MS) ;
+  CHECK_EQUAL (can.driverReceiveFIFO0Count (), 2) ;
+  CHECK_EQUAL (can2.driverReceiveFIFO0Count (), 3) ;
+  CANMessage message ;
+  CHECK (can2.receive0 (message)) ;
+  CHECK_EQUAL (message.id, 0x200) ;
+  CHECK_EQUAL (message.idx, 0) ; // Filter number, from the first bank of CAN2
+  while (can.dispatchReceivedMessage ()) {}
+  while (can2.dispatchReceivedMessage ()) {}
+  CHECK_EQUAL (gCallBackCounts [0][0], 1) ;
+  CHECK_EQUAL (gCallBackCounts [0][1], 1) ;
+  CHECK_EQUAL (gCallBackCounts [1][0], 0) ; // Received by receive0
+  CHECK_EQUAL (gCallBackCounts [1][1], 1) ;
+  CHECK_EQUAL (gCallBackCounts [1][2], 1) ;
+  CHECK_EQUAL (hostController (0).filterWriteViolationCount (), 0) ;
+  can2.end () ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+// CAN2 has 28 - CAN2SB banks, CAN1 has CAN2SB banks
+
+static void testFilterCountPerInstance (void) {
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mCAN2StartBank = 20 ;
+  ACAN_STM32::Filters filters ;
+  for (uint32_t i = 0 ; i < 9 ; i++) {
+    filters.addExtendedMask (0x100 + i, 0x1FFFFFFF, ACAN_STM32::DATA, ACAN_STM32::FIFO0) ;
+  }
+  CHECK_EQUAL (can2.begin (settings, filters), ACAN_STM32::kTooManyFilters) ;
+  CHECK_EQUAL (can.begin (settings, filters), 0) ;
+  can.end () ;
+  settings.mCAN2StartBank = 8 ;
+  CHECK_EQUAL (can.begin (settings, filters), ACAN_STM32::kTooManyFilters) ;
+  CHECK_EQUAL (can2.begin (settings, filters), 0) ;
+  can2.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   CONSISTENCY
+//------------------------------------------------------------------------------
+// The split is shared: an instance cannot be started with a split that differs
+// from the one of the other started instance; out of range splits are rejected.
+
+static void testInvalidStartBank (void) {
+  ACAN_STM32_Settings settings (500 * 1000) ;
+//--- Out of range
+  settings.mCAN2StartBank = 0 ;
+  CHECK_EQUAL (can.begin (settings), ACAN_STM32::kInvalidCAN2StartBank) ;
+  settings.mCAN2StartBank = 28 ;
+  CHECK_EQUAL (can2.begin (settings), ACAN_STM32::kInvalidCAN2StartBank) ;
+//--- CAN1 started first
+  settings.mCAN2StartBank = 14 ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  settings.mCAN2StartBank = 16 ;
+  CHECK_EQUAL (can2.begin (settings), ACAN_STM32::kInvalidCAN2StartBank) ;
+  CHECK_EQUAL (can2StartBank (), 14) ; // Unchanged
+  settings.mCAN2StartBank = 14 ;
+  CHECK_EQUAL (can2.begin (settings), 0) ;
+  can2.end () ;
+  can.end () ;
+//--- CAN2 started first
+  settings.mCAN2StartBank = 10 ;
+  CHECK_EQUAL (can2.begin (settings), 0) ;
+  settings.mCAN2StartBank = 14 ;
+  CHECK_EQUAL (can.begin (settings), ACAN_STM32::kInvalidCAN2StartBank) ;
+  CHECK_EQUAL (can2StartBank (), 10) ;
+//--- Once the other instance is stopped, any split is accepted
+  can2.end () ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  CHECK_EQUAL (can2StartBank (), 14) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   CAN2 ALONE
+//------------------------------------------------------------------------------
+// CAN1 clock is enabled, but CAN1 is not started: CAN2 sets the split and its
+// filters in the filter module of CAN1, and CAN1 stays in its reset state.
+
+static void testCAN2WithCAN1OnlyClocked (void) {
+  RCC->APB1ENR |= 1U << RCC_APB1ENR_CAN1EN_Pos ;
+  const uint32_t can1MCR = CAN1->MCR ;
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mCAN2StartBank = 18 ;
+  ACAN_STM32::Filters filters ;
+  filters.addExtendedMask (0x200, 0x1FFFFFF0, ACAN_STM32::DATA, ACAN_STM32::FIFO0) ;
+  CHECK_EQUAL (can2.begin (settings, filters), 0) ;
+  CHECK_EQUAL (can2StartBank (), 18) ;
+  CHECK_EQUAL (uint32_t (CAN1->FA1R), 1U << 18) ;
+  CHECK_EQUAL (uint32_t (CAN1->MCR), can1MCR) ;
+//--- Reception and transmission by CAN2
+  node.send (extendedFrame (0x205)) ;
+  node.send (extendedFrame (0x105)) ; // Rejected
+  CANMessage message ;
+  CHECK (hostRunUntil ([&] () { return can2.receive0 (message) ; }, 10 * MS)) ;
+  CHECK_EQUAL (message.id, 0x205) ;
+  CHECK_EQUAL (can2.tryToSendReturnStatus (extendedFrame (0x456)), 0) ;
+  CHECK (hostRunUntil ([&] () { return node.mReceived.size () == 1 ; }, 10 * MS)) ;
+  hostRun (1 * MS) ;
+  CHECK (!can2.receive0 (message)) ;
+  CHECK_EQUAL (uint32_t (CAN1->MCR), can1MCR) ;
+//--- CAN1 cannot be started with another split
+  settings.mCAN2StartBank = 14 ;
+  CHECK_EQUAL (can.begin (settings), ACAN_STM32::kInvalidCAN2StartBank) ;
+  can2.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testNonDefaultStartBank) ;
+  RUN_TEST (testFilterCountPerInstance) ;
+  RUN_TEST (testInvalidStartBank) ;
+  RUN_TEST (testCAN2WithCAN1OnlyClocked) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
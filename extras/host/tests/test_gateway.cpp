@@ -0,0 +1,215 @@
+//------------------------------------------------------------------------------
+// Gateway: CAN1 (bus 0) forwards to CAN2 (bus 1). Route validation against the
+// target, identifier / mask matching, identifier translation, per route counters,
+// forwarding latency
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <HostTest.h>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+static const uint64_t US = 1000 ; // ns
+
+//------------------------------------------------------------------------------
+
+static CANMessage frame (const uint32_t inIdentifier, const bool inExtended = false) {
+  CANMessage message ;
+  message.id = inIdentifier ;
+  message.ext = inExtended ;
+  message.len = 8 ;
+  for (uint32_t i = 0 ; i < 8 ; i++) {
+    message.data [i] = uint8_t (inIdentifier + i) ;
+  }
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+
+static void beginGateway (const uint16_t inTargetTransmitFIFOSize = 16) {
+  hostController (1).attachToBus (1) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  settings.mDriverTransmitFIFOSize = inTargetTransmitFIFOSize ;
+  CHECK_EQUAL (can2.begin (settings), 0) ;
+}
+
+//------------------------------------------------------------------------------
+//   VALIDATION
+//------------------------------------------------------------------------------
+// The transmit index is checked against the message idx accepted by the target
+// (0 ... 2, or its transmit classes); a polling mode target is refused.
+
+static void testRouteValidation (void) {
+  beginGateway () ;
+  ACAN_STM32::Routes routes ;
+  CHECK (routes.addRoute (kStandard, 0x100, 0x700, can2, 0x200, 2)) ;
+  CHECK (!routes.addRoute (kStandard, 0x100, 0x700, can2, 0x200, 3)) ;
+  CHECK (!routes.addRoute (kStandard, 0x101, 0x700, can2, 0x200)) ; // Base out of mask
+  CHECK (!routes.addRoute (kStandard, 0x100, 0x700, can2, 0x280)) ; // Translated base out of mask
+  CHECK (!routes.addRoute (kStandard, 0x800, 0x800, can2, 0x800)) ; // Not a standard identifier
+//--- Target with 4 transmit classes
+  ACAN_STM32::TransmitClasses classes ;
+  for (uint32_t c = 0 ; c < 4 ; c++) {
+    classes.addClass (4, 0x7) ;
+  }
+  CHECK_EQUAL (can2.setTransmitClasses (classes), 0) ;
+  CHECK (routes.addRoute (kExtended, 0x1000, 0x1FFFF000, can2, 0x2000, 3)) ;
+  CHECK (!routes.addRoute (kExtended, 0x1000, 0x1FFFF000, can2, 0x2000, 4)) ;
+  CHECK_EQUAL (routes.count (), 2) ;
+//--- Polling mode target
+  can2.end () ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mPollingMode = true ;
+  CHECK_EQUAL (can2.begin (settings), 0) ;
+  CHECK (!routes.addRoute (kStandard, 0x100, 0x700, can2, 0x200)) ;
+  CHECK (routes.addRoute (kStandard, 0x100, 0x700, can, 0x200)) ; // can is not in polling mode
+  can2.end () ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   MATCHING AND TRANSLATION
+//------------------------------------------------------------------------------
+// The first matching route is used; the matched bits are replaced by the
+// translated base, the other ones are kept. A frame of another format is not
+// matched. A forwarded frame is received too only with inAlsoReceive.
+
+static void testMatchingAndTranslation (void) {
+  beginGateway () ;
+  HostVirtualNode node0 (hostBus (0)) ;
+  HostVirtualNode node1 (hostBus (1)) ;
+  ACAN_STM32::Routes routes ;
+  CHECK (routes.addRoute (kStandard, 0x100, 0x7F0, can2, 0x300)) ;
+  CHECK (routes.addRoute (kExtended, 0x1000, 0x1FFFF000, can2, 0x2000, 0, true)) ;
+  CHECK (routes.addRoute (kStandard, 0x100, 0x700, can2, 0x500)) ; // Shadowed by route 0 for 0x10x
+  can.setRoutes (routes) ;
+  CHECK_EQUAL (can.routeCount (), 3) ;
+  const CANMessage sent [5] = {
+    frame (0x105), frame (0x1ABC, true), frame (0x1FF), frame (0x105, true), frame (0x200)
+  } ;
+  for (uint32_t i = 0 ; i < 5 ; i++) { // One at a time: virtual node frames are arbitrated
+    node0.send (sent [i]) ;
+    CHECK (hostRunUntil ([&] () { return node0.pendingCount () == 0 ; }, 10 * MS)) ;
+  }
+  CHECK (hostRunUntil ([&] () { return node1.mReceived.size () == 3 ; }, 10 * MS)) ;
+  hostRun (1 * MS) ;
+//--- Forwarded frames, in order, data kept
+  CHECK_EQUAL (node1.mReceived.size (), 3) ;
+  if (node1.mReceived.size () == 3) {
+    CHECK_EQUAL (node1.mReceived [0].id, 0x305) ;
+    CHECK (!node1.mReceived [0].ext) ;
+    CHECK_EQUAL (node1.mReceived [0].data64, sent [0].data64) ;
+    CHECK_EQUAL (node1.mReceived [1].id, 0x2ABC) ;
+    CHECK (node1.mReceived [1].ext) ;
+    CHECK_EQUAL (node1.mReceived [2].id, 0x5FF) ;
+  }
+//--- Received frames: not routed, and route 1 (also receive)
+  const uint32_t expectedIdentifiers [3] = {0x1ABC, 0x105, 0x200} ;
+  const bool expectedExtended [3] = {true, true, false} ;
+  CANMessage message ;
+  for (uint32_t i = 0 ; i < 3 ; i++) {
+    CHECK (can.receive0 (message)) ;
+    CHECK_EQUAL (message.id, expectedIdentifiers [i]) ;
+    CHECK_EQUAL (message.ext, expectedExtended [i]) ;
+  }
+  CHECK (!can.receive0 (message)) ;
+//--- Counters
+  for (uint32_t i = 0 ; i < 3 ; i++) {
+    CHECK_EQUAL (can.routeForwardedCount (i), 1) ;
+    CHECK_EQUAL (can.routeOverflowCount (i), 0) ;
+  }
+  can.setRoutes (ACAN_STM32::Routes ()) ;
+  can2.end () ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   COUNTERS
+//------------------------------------------------------------------------------
+// Nobody acknowledges on bus 1: the target keeps its frames (1 in mailbox 0, 2 in
+// its driver transmit FIFO), further frames are counted as overflows.
+
+static void testPerRouteCounters (void) {
+  beginGateway (2) ;
+  HostVirtualNode node0 (hostBus (0)) ;
+  ACAN_STM32::Routes routes ;
+  CHECK (routes.addRoute (kStandard, 0x100, 0x700, can2, 0x200)) ;
+  CHECK (routes.addRoute (kStandard, 0x300, 0x700, can2, 0x400, 1)) ;
+  can.setRoutes (routes) ;
+  for (uint32_t i = 0 ; i < 6 ; i++) {
+    node0.send (frame (0x100 + i)) ;
+  }
+  node0.send (frame (0x310)) ;
+  node0.send (frame (0x311)) ; // Mailbox 1 is still pending
+  CHECK (hostRunUntil ([&] () { return node0.pendingCount () == 0 ; }, 10 * MS)) ;
+  hostRun (1 * MS) ;
+  CHECK_EQUAL (can.routeForwardedCount (0), 3) ;
+  CHECK_EQUAL (can.routeOverflowCount (0), 3) ;
+  CHECK_EQUAL (can.routeForwardedCount (1), 1) ;
+  CHECK_EQUAL (can.routeOverflowCount (1), 1) ;
+  CHECK_EQUAL (can.routeForwardedCount (2), 0) ; // No such route
+  CHECK (can.routeMaxLatency (0) > 0) ;
+  can.resetRouteStatistics () ;
+  for (uint32_t i = 0 ; i < 2 ; i++) {
+    CHECK_EQUAL (can.routeForwardedCount (i), 0) ;
+    CHECK_EQUAL (can.routeOverflowCount (i), 0) ;
+    CHECK_EQUAL (can.routeMaxLatency (i), 0) ;
+  }
+  can.setRoutes (ACAN_STM32::Routes ()) ;
+  can2.end () ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   LATENCY
+//------------------------------------------------------------------------------
+// A frame is forwarded from the receive ISR: on an idle target bus, it starts
+// a few microseconds after the end of the received frame (EOF), and the measured
+// latency (receive ISR entry to target enqueue) is within this delay.
+
+static void testForwardingLatency (void) {
+  beginGateway () ;
+  HostVirtualNode node0 (hostBus (0)) ;
+  HostVirtualNode node1 (hostBus (1)) ;
+  ACAN_STM32::Routes routes ;
+  CHECK (routes.addRoute (kStandard, 0x100, 0x700, can2, 0x200)) ;
+  can.setRoutes (routes) ;
+  const uint32_t FRAME_COUNT = 10 ;
+  for (uint32_t i = 0 ; i < FRAME_COUNT ; i++) {
+    node0.send (frame (0x100 + i)) ;
+  }
+  CHECK (hostRunUntil ([&] () { return node1.mReceived.size () == FRAME_COUNT ; }, 10 * MS)) ;
+  const std::vector <HostBusRecord> & received = hostBus (0).records () ;
+  const std::vector <HostBusRecord> & forwarded = hostBus (1).records () ;
+  CHECK_EQUAL (forwarded.size (), FRAME_COUNT) ;
+  const uint64_t interframeSpace = 3 * 2 * US ; // 3 bits at 500 kbit/s
+  uint64_t maxDelay = 0 ;
+  for (uint32_t i = 0 ; (i < FRAME_COUNT) && (i < received.size ()) && (i < forwarded.size ()) ; i++) {
+    const uint64_t endOfFrame = received [i].mEndDate - interframeSpace ;
+    CHECK (forwarded [i].mStartDate >= endOfFrame) ;
+    const uint64_t delay = forwarded [i].mStartDate - endOfFrame ;
+    maxDelay = (maxDelay < delay) ? delay : maxDelay ;
+  }
+  CHECK (maxDelay < 20 * US) ;
+  CHECK_EQUAL (can.routeForwardedCount (0), FRAME_COUNT) ;
+  const uint64_t maxLatency = uint64_t (can.routeMaxLatency (0)) * 1000 * 1000 * 1000 / SystemCoreClock ; // ns
+  CHECK (maxLatency > 0) ;
+  CHECK (maxLatency <= maxDelay) ;
+  can.setRoutes (ACAN_STM32::Routes ()) ;
+  can2.end () ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testRouteValidation) ;
+  RUN_TEST (testMatchingAndTranslation) ;
+  RUN_TEST (testPerRouteCounters) ;
+  RUN_TEST (testForwardingLatency) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,379 @@
+//------------------------------------------------------------------------------
+// ISO-TP transport layer between CAN1 (clients) and CAN2 (servers) on the
+// virtual bus: segmentation, flow control (block size, STmin), concurrent
+// channels, receive buffer overflow
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32_IsoTp.h>
+#include <HostTest.h>
+
+#include <functional>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+static const uint64_t US = 1000 ; // ns
+
+//------------------------------------------------------------------------------
+//   LAYERS
+//------------------------------------------------------------------------------
+
+static ACAN_STM32_IsoTp gClientLayer (can) ;
+static ACAN_STM32_IsoTp gServerLayer (can2) ;
+
+//------------------------------------------------------------------------------
+
+static void clientTransmitComplete (const uint32_t inTag,
+                                    const ACAN_STM32::TransmitStatus inStatus,
+                                    const uint32_t /* inLatencyMicros */) {
+  gClientLayer.transmitComplete (inTag, inStatus) ;
+}
+
+//------------------------------------------------------------------------------
+
+static void serverTransmitComplete (const uint32_t inTag,
+                                    const ACAN_STM32::TransmitStatus inStatus,
+                                    const uint32_t /* inLatencyMicros */) {
+  gServerLayer.transmitComplete (inTag, inStatus) ;
+}
+
+//------------------------------------------------------------------------------
+// Both controllers at inBitRate; the layers are driven every 10 us of virtual time
+
+static void beginControllers (const uint32_t inBitRate) {
+  ACAN_STM32_Settings settings (inBitRate) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  CHECK_EQUAL (can2.begin (settings), 0) ;
+  can.setTransmitCompleteCallBack (clientTransmitComplete) ;
+  can2.setTransmitCompleteCallBack (serverTransmitComplete) ;
+}
+
+//------------------------------------------------------------------------------
+
+static bool runLayers (const std::function <bool (void)> & inDone, const uint64_t inTimeout) {
+  return hostRunUntil ([&] () {
+    CANMessage frame ;
+    while (can.receive0 (frame)) {
+      gClientLayer.handleReceivedMessage (frame) ;
+    }
+    while (can2.receive0 (frame)) {
+      gServerLayer.handleReceivedMessage (frame) ;
+    }
+    gClientLayer.service () ;
+    gServerLayer.service () ;
+    return inDone () ;
+  }, inTimeout, 10 * US) ;
+}
+
+//------------------------------------------------------------------------------
+//   CHANNELS
+//------------------------------------------------------------------------------
+
+class Transfer {
+  public: uint32_t mTransmitCount = 0 ;
+  public: uint32_t mReceiveCount = 0 ;
+  public: tIsoTpResult mTransmitResult = kIsoTpOk ;
+  public: tIsoTpResult mReceiveResult = kIsoTpOk ;
+} ;
+
+//------------------------------------------------------------------------------
+
+static void messageSent (ACAN_STM32_IsoTpChannel & ioChannel, const tIsoTpResult inResult) {
+  Transfer * transfer = (Transfer *) ioChannel.mUserData ;
+  transfer->mTransmitCount += 1 ;
+  transfer->mTransmitResult = inResult ;
+}
+
+//------------------------------------------------------------------------------
+
+static void messageReceived (ACAN_STM32_IsoTpChannel & ioChannel, const tIsoTpResult inResult) {
+  Transfer * transfer = (Transfer *) ioChannel.mUserData ;
+  transfer->mReceiveCount += 1 ;
+  transfer->mReceiveResult = inResult ;
+}
+
+//------------------------------------------------------------------------------
+
+static void fill (uint8_t outBuffer [], const uint32_t inLength, const uint8_t inSeed) {
+  for (uint32_t i = 0 ; i < inLength ; i++) {
+    outBuffer [i] = uint8_t (inSeed + i * 13) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+static bool sameBytes (const uint8_t inLeft [], const uint8_t inRight [], const uint32_t inLength) {
+  bool same = true ;
+  for (uint32_t i = 0 ; (i < inLength) && same ; i++) {
+    same = inLeft [i] == inRight [i] ;
+  }
+  return same ;
+}
+
+//------------------------------------------------------------------------------
+// Frames of the bus with identifier inIdentifier
+
+static std::vector <HostBusRecord> framesWithIdentifier (const uint32_t inIdentifier) {
+  std::vector <HostBusRecord> result ;
+  for (const HostBusRecord & record : hostBus (0).records ()) {
+    if (record.mMessage.id == inIdentifier) {
+      result.push_back (record) ;
+    }
+  }
+  return result ;
+}
+
+//------------------------------------------------------------------------------
+//   SEGMENTATION
+//------------------------------------------------------------------------------
+
+static void testSegmentation (void) {
+  beginControllers (500 * 1000) ;
+  ACAN_STM32_IsoTpChannel client (0x7E0, 0x7E8) ;
+  ACAN_STM32_IsoTpChannel server (0x7E8, 0x7E0) ;
+  Transfer transfer ;
+  uint8_t message [100] ;
+  uint8_t receiveBuffer [200] ;
+  fill (message, 100, 1) ;
+  client.mUserData = & transfer ;
+  client.mTransmitCallBack = messageSent ;
+  server.mUserData = & transfer ;
+  server.mReceiveCallBack = messageReceived ;
+  server.setReceiveBuffer (receiveBuffer, 200) ;
+  gClientLayer.addChannel (client) ;
+  gServerLayer.addChannel (server) ;
+//--- Multi-frame message: first frame, flow control, 14 consecutive frames
+  CHECK (gClientLayer.send (client, message, 100)) ;
+  CHECK (runLayers ([&] () { return transfer.mReceiveCount == 1 ; }, 100 * MS)) ;
+  CHECK_EQUAL (transfer.mTransmitCount, 1) ;
+  CHECK_EQUAL (transfer.mTransmitResult, kIsoTpOk) ;
+  CHECK_EQUAL (transfer.mReceiveResult, kIsoTpOk) ;
+  CHECK_EQUAL (server.receivedLength (), 100) ;
+  CHECK (sameBytes (server.receiveBuffer (), message, 100)) ;
+  const std::vector <HostBusRecord> clientFrames = framesWithIdentifier (0x7E0) ;
+  const std::vector <HostBusRecord> serverFrames = framesWithIdentifier (0x7E8) ;
+  CHECK_EQUAL (clientFrames.size (), 15) ;
+  CHECK_EQUAL (serverFrames.size (), 1) ;
+  if (clientFrames.size () == 15) {
+    CHECK_EQUAL (clientFrames [0].mMessage.data [0], 0x10) ; // First frame, length 100
+    CHECK_EQUAL (clientFrames [0].mMessage.data [1], 100) ;
+    for (uint32_t i = 1 ; i < 15 ; i++) {
+      CHECK_EQUAL (clientFrames [i].mMessage.data [0], 0x20 | (i & 0x0F)) ;
+      CHECK_EQUAL (clientFrames [i].mMessage.len, 8) ; // Padding
+    }
+  //--- Without block size and STmin, consecutive frames are back to back
+    for (uint32_t i = 2 ; i < 15 ; i++) {
+      CHECK_EQUAL (clientFrames [i].mStartDate, clientFrames [i - 1].mEndDate) ;
+    }
+  }
+  if (serverFrames.size () == 1) {
+    CHECK_EQUAL (serverFrames [0].mMessage.data [0], 0x30) ; // Continue to send, BS 0, STmin 0
+    CHECK_EQUAL (serverFrames [0].mMessage.data [1], 0) ;
+    CHECK_EQUAL (serverFrames [0].mMessage.data [2], 0) ;
+  }
+//--- Single frame
+  hostBus (0).clearRecords () ;
+  CHECK (gClientLayer.send (client, message, 5)) ;
+  CHECK (runLayers ([&] () { return transfer.mReceiveCount == 2 ; }, 10 * MS)) ;
+  CHECK_EQUAL (server.receivedLength (), 5) ;
+  CHECK (sameBytes (server.receiveBuffer (), message, 5)) ;
+  CHECK_EQUAL (hostBus (0).records ().size (), 1) ;
+  CHECK_EQUAL (hostBus (0).records () [0].mMessage.data [0], 0x05) ;
+  gClientLayer.removeChannel (client) ;
+  gServerLayer.removeChannel (server) ;
+  can2.end () ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   FLOW CONTROL
+//------------------------------------------------------------------------------
+// Block size 4: a flow control after the first frame, then after every 4
+// consecutive frames (14 consecutive frames: 4 flow controls). With STmin, the
+// consecutive frames of a block are at least STmin apart on the bus.
+
+static void checkFlowControl (const uint8_t inSeparationTime, const uint64_t inSeparation) {
+  beginControllers (500 * 1000) ;
+  ACAN_STM32_IsoTpChannel client (0x7E0, 0x7E8) ;
+  ACAN_STM32_IsoTpChannel server (0x7E8, 0x7E0) ;
+  Transfer transfer ;
+  uint8_t message [100] ;
+  uint8_t receiveBuffer [100] ;
+  fill (message, 100, 7) ;
+  client.mUserData = & transfer ;
+  client.mTransmitCallBack = messageSent ;
+  server.mUserData = & transfer ;
+  server.mReceiveCallBack = messageReceived ;
+  server.setReceiveBuffer (receiveBuffer, 100) ;
+  server.mBlockSize = 4 ;
+  server.mSeparationTime = inSeparationTime ;
+  gClientLayer.addChannel (client) ;
+  gServerLayer.addChannel (server) ;
+  CHECK (gClientLayer.send (client, message, 100)) ;
+  CHECK (runLayers ([&] () { return transfer.mReceiveCount == 1 ; }, 200 * MS)) ;
+  CHECK_EQUAL (transfer.mTransmitResult, kIsoTpOk) ;
+  CHECK_EQUAL (transfer.mReceiveResult, kIsoTpOk) ;
+  CHECK (sameBytes (server.receiveBuffer (), message, 100)) ;
+  const std::vector <HostBusRecord> serverFrames = framesWithIdentifier (0x7E8) ;
+  CHECK_EQUAL (serverFrames.size (), 4) ;
+  for (const HostBusRecord & record : serverFrames) {
+    CHECK_EQUAL (record.mMessage.data [1], 4) ;
+    CHECK_EQUAL (record.mMessage.data [2], inSeparationTime) ;
+  }
+//--- Consecutive frames of a block: no more than 4, STmin apart from the end of
+//    the previous frame, that completes 3 bits (6 us) before the end of its record;
+//    1 us for the resolution of micros ()
+  uint32_t framesInBlock = 0 ;
+  const HostBusRecord * previous = nullptr ;
+  for (const HostBusRecord & record : hostBus (0).records ()) {
+    if (record.mMessage.id == 0x7E8) {
+      framesInBlock = 0 ;
+      previous = nullptr ;
+    }else if ((record.mMessage.data [0] >> 4) == 2) {
+      framesInBlock += 1 ;
+      CHECK (framesInBlock <= 4) ;
+      if (previous != nullptr) {
+        CHECK ((record.mStartDate - previous->mEndDate + 7 * US) >= inSeparation) ;
+      }
+      previous = & record ;
+    }
+  }
+  gClientLayer.removeChannel (client) ;
+  gServerLayer.removeChannel (server) ;
+  can2.end () ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+static void testBlockSize (void) {
+  checkFlowControl (0, 0) ;
+}
+
+//------------------------------------------------------------------------------
+
+static void testSeparationTimeMillis (void) {
+  checkFlowControl (2, 2 * MS) ;
+}
+
+//------------------------------------------------------------------------------
+
+static void testSeparationTimeMicros (void) {
+  checkFlowControl (0xF5, 500 * US) ;
+}
+
+//------------------------------------------------------------------------------
+//   CONCURRENT CHANNELS
+//------------------------------------------------------------------------------
+// Three channel pairs transfer messages in both directions at the same time,
+// with various flow control settings
+
+static const uint32_t PAIR_COUNT = 3 ;
+static const uint16_t LENGTHS [PAIR_COUNT] = {4095, 300, 1000} ;
+
+static void testConcurrentChannels (void) {
+  beginControllers (1000 * 1000) ;
+  ACAN_STM32_IsoTpChannel clients [PAIR_COUNT] = {{0x7E0, 0x7E8}, {0x7E1, 0x7E9}, {0x18DA10F1, 0x18DAF110, kExtended}} ;
+  ACAN_STM32_IsoTpChannel servers [PAIR_COUNT] = {{0x7E8, 0x7E0}, {0x7E9, 0x7E1}, {0x18DAF110, 0x18DA10F1, kExtended}} ;
+  Transfer transfers [PAIR_COUNT][2] ; // Client to server, server to client
+  static uint8_t messages [PAIR_COUNT][2][4095] ;
+  static uint8_t receiveBuffers [PAIR_COUNT][2][4095] ;
+  for (uint32_t i = 0 ; i < PAIR_COUNT ; i++) {
+    fill (messages [i][0], LENGTHS [i], uint8_t (3 * i)) ;
+    fill (messages [i][1], LENGTHS [i], uint8_t (3 * i + 1)) ;
+    clients [i].mUserData = & transfers [i][0] ;
+    clients [i].mTransmitCallBack = messageSent ;
+    clients [i].setReceiveBuffer (receiveBuffers [i][1], 4095) ;
+    servers [i].mUserData = & transfers [i][1] ;
+    servers [i].mTransmitCallBack = messageSent ;
+    servers [i].setReceiveBuffer (receiveBuffers [i][0], 4095) ;
+    gClientLayer.addChannel (clients [i]) ;
+    gServerLayer.addChannel (servers [i]) ;
+  }
+  clients [1].mBlockSize = 8 ;
+  servers [1].mSeparationTime = 0xF2 ;
+  servers [2].mBlockSize = 2 ;
+  clients [2].mSeparationTime = 1 ;
+//--- Receive call backs count in the transfer of the sender
+  for (uint32_t i = 0 ; i < PAIR_COUNT ; i++) {
+    servers [i].mReceiveCallBack = [] (ACAN_STM32_IsoTpChannel & ioChannel, const tIsoTpResult inResult) {
+      Transfer * transfer = ((Transfer *) ioChannel.mUserData) - 1 ;
+      transfer->mReceiveCount += 1 ;
+      transfer->mReceiveResult = inResult ;
+    } ;
+    clients [i].mReceiveCallBack = [] (ACAN_STM32_IsoTpChannel & ioChannel, const tIsoTpResult inResult) {
+      Transfer * transfer = ((Transfer *) ioChannel.mUserData) + 1 ;
+      transfer->mReceiveCount += 1 ;
+      transfer->mReceiveResult = inResult ;
+    } ;
+    CHECK (gClientLayer.send (clients [i], messages [i][0], LENGTHS [i])) ;
+    CHECK (gServerLayer.send (servers [i], messages [i][1], LENGTHS [i])) ;
+  }
+  CHECK (runLayers ([&] () {
+    bool done = true ;
+    for (uint32_t i = 0 ; i < PAIR_COUNT ; i++) {
+      done &= (transfers [i][0].mReceiveCount == 1) && (transfers [i][1].mReceiveCount == 1) ;
+    }
+    return done ;
+  }, 500 * MS)) ;
+  for (uint32_t i = 0 ; i < PAIR_COUNT ; i++) {
+    for (uint32_t d = 0 ; d < 2 ; d++) {
+      CHECK_EQUAL (transfers [i][d].mTransmitCount, 1) ;
+      CHECK_EQUAL (transfers [i][d].mTransmitResult, kIsoTpOk) ;
+      CHECK_EQUAL (transfers [i][d].mReceiveResult, kIsoTpOk) ;
+    }
+    CHECK_EQUAL (servers [i].receivedLength (), LENGTHS [i]) ;
+    CHECK_EQUAL (clients [i].receivedLength (), LENGTHS [i]) ;
+    CHECK (sameBytes (servers [i].receiveBuffer (), messages [i][0], LENGTHS [i])) ;
+    CHECK (sameBytes (clients [i].receiveBuffer (), messages [i][1], LENGTHS [i])) ;
+    gClientLayer.removeChannel (clients [i]) ;
+    gServerLayer.removeChannel (servers [i]) ;
+  }
+  can2.end () ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   OVERFLOW
+//------------------------------------------------------------------------------
+
+static void testReceiveBufferOverflow (void) {
+  beginControllers (500 * 1000) ;
+  ACAN_STM32_IsoTpChannel client (0x7E0, 0x7E8) ;
+  ACAN_STM32_IsoTpChannel server (0x7E8, 0x7E0) ;
+  Transfer transfer ;
+  uint8_t message [100] ;
+  uint8_t receiveBuffer [50] ;
+  fill (message, 100, 5) ;
+  client.mUserData = & transfer ;
+  client.mTransmitCallBack = messageSent ;
+  server.mUserData = & transfer ;
+  server.mReceiveCallBack = messageReceived ;
+  server.setReceiveBuffer (receiveBuffer, 50) ;
+  gClientLayer.addChannel (client) ;
+  gServerLayer.addChannel (server) ;
+  CHECK (gClientLayer.send (client, message, 100)) ;
+  CHECK (runLayers ([&] () { return transfer.mTransmitCount == 1 ; }, 100 * MS)) ;
+  CHECK_EQUAL (transfer.mTransmitResult, kIsoTpBufferOverflow) ;
+  CHECK_EQUAL (transfer.mReceiveCount, 1) ;
+  CHECK_EQUAL (transfer.mReceiveResult, kIsoTpBufferOverflow) ;
+  CHECK_EQUAL (framesWithIdentifier (0x7E0).size (), 1) ; // First frame only
+  gClientLayer.removeChannel (client) ;
+  gServerLayer.removeChannel (server) ;
+  can2.end () ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testSegmentation) ;
+  RUN_TEST (testBlockSize) ;
+  RUN_TEST (testSeparationTimeMillis) ;
+  RUN_TEST (testSeparationTimeMicros) ;
+  RUN_TEST (testConcurrentChannels) ;
+  RUN_TEST (testReceiveBufferOverflow) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
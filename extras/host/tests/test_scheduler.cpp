@@ -0,0 +1,122 @@
+//------------------------------------------------------------------------------
+// Timer wheel and cyclic scheduler: nodes inserted or removed while the expired
+// list is walked
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32_CyclicScheduler.h>
+#include <HostTest.h>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+
+//------------------------------------------------------------------------------
+//   TIMER WHEEL
+//------------------------------------------------------------------------------
+
+static void testWheelWalkWhileRescheduling (void) {
+  ACAN_STM32_TimerWheel wheel ;
+  wheel.reset (0) ;
+  ACAN_STM32_TimerNode nodes [4] ;
+  for (uint32_t i = 4 ; i > 0 ; i--) { // Slot lists are in reverse insertion order
+    wheel.insert (nodes [i - 1], 10) ;
+  }
+  ACAN_STM32_TimerNode * node = wheel.advance (10) ;
+  CHECK (node == & nodes [0]) ;
+  CHECK_EQUAL (wheel.count (), 0) ;
+//--- First expired node reschedules its siblings, not walked yet: one in the slot
+//    being processed again, one later
+  wheel.insert (nodes [1], 11) ;
+  wheel.insert (nodes [2], 200) ;
+  uint32_t walkedCount = 0 ;
+  while (node != nullptr) {
+    CHECK (node == & nodes [walkedCount]) ;
+    walkedCount += 1 ;
+    node = node->nextExpired () ;
+  }
+  CHECK_EQUAL (walkedCount, 4) ;
+  CHECK (!nodes [0].isScheduled ()) ;
+  CHECK (nodes [1].isScheduled ()) ;
+  CHECK (nodes [2].isScheduled ()) ;
+  CHECK (!nodes [3].isScheduled ()) ;
+  CHECK_EQUAL (wheel.count (), 2) ;
+//--- Rescheduled nodes expire at their new dates
+  node = wheel.advance (11) ;
+  CHECK (node == & nodes [1]) ;
+  CHECK (node->nextExpired () == nullptr) ;
+  CHECK (wheel.advance (199) == nullptr) ;
+  node = wheel.advance (200) ;
+  CHECK (node == & nodes [2]) ;
+  CHECK (node->nextExpired () == nullptr) ;
+  CHECK_EQUAL (wheel.count (), 0) ;
+}
+
+//------------------------------------------------------------------------------
+//   CYCLIC SCHEDULER
+//------------------------------------------------------------------------------
+
+static ACAN_STM32_CyclicScheduler gScheduler (can) ;
+static ACAN_STM32_CyclicFrame gFrames [4] ;
+static bool gSiblingMoved = false ;
+
+//------------------------------------------------------------------------------
+// Call back of frame 0: on its first call, frame 1 (due at the same date, and
+// not processed yet) moves to phase 5 ms
+
+static void moveSibling (ACAN_STM32_CyclicFrame &) {
+  if (!gSiblingMoved) {
+    gSiblingMoved = true ;
+    gScheduler.add (gFrames [1], 10, 5) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+static void testCallBackReschedulesSibling (void) {
+  ACAN_STM32_Settings settings (1000 * 1000) ;
+  settings.mModuleMode = ACAN_STM32_Settings::INTERNAL_LOOP_BACK ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  gSiblingMoved = false ;
+  for (uint32_t i = 4 ; i > 0 ; i--) { // Frame 0 is walked first
+    gFrames [i - 1].mMessage.id = 0x100 + i - 1 ;
+    gFrames [i - 1].mMessage.len = 8 ;
+    CHECK (gScheduler.add (gFrames [i - 1], 10, 0)) ;
+  }
+  gFrames [0].mUpdateCallBack = moveSibling ;
+//--- 100 ms: every frame is sent 10 times (frame 1 at 5, 15, ... 95 ms)
+  uint32_t receivedCounts [4] = {0, 0, 0, 0} ;
+  uint64_t frame1Dates [10] ;
+  while (millis () < 100) {
+    gScheduler.service () ;
+    CANMessage message ;
+    while (can.receive0 (message)) {
+      const uint32_t idx = message.id - 0x100 ;
+      if ((idx == 1) && (receivedCounts [1] < 10)) {
+        frame1Dates [receivedCounts [1]] = hostNanoseconds () ;
+      }
+      receivedCounts [idx] += 1 ;
+    }
+    hostRun (100 * 1000) ;
+  }
+  for (uint32_t i = 0 ; i < 4 ; i++) {
+    CHECK_EQUAL (receivedCounts [i], 10) ;
+    CHECK_EQUAL (gFrames [i].missedPeriodCount (), 0) ;
+  }
+  CHECK_EQUAL (frame1Dates [0] / MS, 5) ;
+  CHECK_EQUAL (frame1Dates [9] / MS, 95) ;
+  CHECK_EQUAL (gScheduler.frameCount (), 4) ;
+  for (uint32_t i = 0 ; i < 4 ; i++) {
+    gScheduler.remove (gFrames [i]) ;
+  }
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testWheelWalkWhileRescheduling) ;
+  RUN_TEST (testCallBackReschedulesSibling) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,184 @@
+//------------------------------------------------------------------------------
+// Transmit classes: a reserved mailbox stays available to its class, strict
+// priority and weighted round robin arbitration between class queues, queue order
+// of equal identifiers, class index check
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <HostTest.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+
+//------------------------------------------------------------------------------
+
+static CANMessage classFrame (const uint32_t inIdentifier, const uint8_t inClass) {
+  CANMessage message ;
+  message.id = inIdentifier ;
+  message.idx = inClass ;
+  message.len = 8 ;
+  for (uint32_t i = 0 ; i < 8 ; i++) {
+    message.data [i] = uint8_t (inIdentifier + i) ;
+  }
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+//   RESERVED MAILBOX
+//------------------------------------------------------------------------------
+// Class 0 (bulk) may use mailboxes 0 and 1, class 1 (urgent) only mailbox 2: with
+// the bulk queue full, an urgent frame is loaded at once, and sent just after
+// the frame in progress. When both classes share every mailbox, the urgent frame
+// waits in its queue until a mailbox is freed: mailbox 0, that the ordering rule
+// keeps from the bulk class while its frames are pending in mailboxes 1 and 2.
+
+static void sendUrgentBehindBulk (const uint8_t inBulkMailboxMask,
+                                  const uint8_t inUrgentMailboxMask,
+                                  uint32_t & outUrgentQueued,
+                                  uint32_t & outUrgentPosition) {
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  ACAN_STM32::TransmitClasses classes ;
+  CHECK (classes.addClass (12, inBulkMailboxMask)) ;
+  CHECK (classes.addClass (4, inUrgentMailboxMask)) ;
+  CHECK_EQUAL (can.setTransmitClasses (classes), 0) ;
+  for (uint32_t i = 0 ; i < 12 ; i++) {
+    CHECK_EQUAL (can.tryToSendReturnStatus (classFrame (0x100 + i, 0)), 0) ;
+  }
+  CHECK_EQUAL (can.tryToSendReturnStatus (classFrame (0x050, 1)), 0) ;
+  outUrgentQueued = can.transmitClassFIFOCount (1) ;
+  CHECK (hostRunUntil ([&] () { return can.transmitClassFIFOCount (0) == 0 ; }, 20 * MS)) ;
+  CHECK (hostRunUntil ([&] () { return hostBus (0).isIdle () ; }, 10 * MS)) ;
+  outUrgentPosition = uint32_t (node.mReceived.size ()) ;
+  for (uint32_t i = 0 ; i < node.mReceived.size () ; i++) {
+    if (node.mReceived [i].id == 0x050) {
+      outUrgentPosition = i ;
+    }
+  }
+  can.end () ;
+}
+
+static void testReservedMailbox (void) {
+  uint32_t urgentQueued = 0 ;
+  uint32_t urgentPosition = 0 ;
+  sendUrgentBehindBulk (0x3, 0x4, urgentQueued, urgentPosition) ;
+  CHECK_EQUAL (urgentQueued, 0) ; // In mailbox 2
+  CHECK_EQUAL (urgentPosition, 1) ;
+//--- Shared mailboxes
+  sendUrgentBehindBulk (0x7, 0x7, urgentQueued, urgentPosition) ;
+  CHECK_EQUAL (urgentQueued, 1) ;
+  CHECK_EQUAL (urgentPosition, 1) ;
+}
+
+//------------------------------------------------------------------------------
+//   ARBITRATION
+//------------------------------------------------------------------------------
+// Both classes share mailbox 0 only, so the bus order is the class selection
+// order. Class 1 frame 0x200 is loaded first (both queues empty), then 3 more
+// class 1 frames and 4 class 0 frames are queued.
+
+static std::vector <uint32_t> sentOrder (const ACAN_STM32::TransmitArbitration inArbitration) {
+  std::vector <uint32_t> result ;
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  ACAN_STM32::TransmitClasses classes (inArbitration) ;
+  CHECK (classes.addClass (8, 0x1, 2)) ;
+  CHECK (classes.addClass (8, 0x1, 1)) ;
+  CHECK_EQUAL (can.setTransmitClasses (classes), 0) ;
+  for (uint32_t i = 0 ; i < 4 ; i++) {
+    CHECK_EQUAL (can.tryToSendReturnStatus (classFrame (0x200 + i, 1)), 0) ;
+  }
+  for (uint32_t i = 0 ; i < 4 ; i++) {
+    CHECK_EQUAL (can.tryToSendReturnStatus (classFrame (0x100 + i, 0)), 0) ;
+  }
+  CHECK (hostRunUntil ([&] () { return node.mReceived.size () == 8 ; }, 20 * MS)) ;
+  for (const CANMessage & message : node.mReceived) {
+    result.push_back (message.id) ;
+  }
+  can.end () ;
+  return result ;
+}
+
+static void testStrictPriority (void) {
+  const std::vector <uint32_t> order = sentOrder (ACAN_STM32::STRICT_PRIORITY) ;
+  const std::vector <uint32_t> expected = {0x200, 0x100, 0x101, 0x102, 0x103, 0x201, 0x202, 0x203} ;
+  CHECK (order == expected) ;
+}
+
+static void testWeightedRoundRobin (void) {
+  const std::vector <uint32_t> order = sentOrder (ACAN_STM32::WEIGHTED_ROUND_ROBIN) ;
+  const std::vector <uint32_t> expected = {0x200, 0x100, 0x101, 0x201, 0x102, 0x103, 0x202, 0x203} ;
+  CHECK (order == expected) ;
+}
+
+//------------------------------------------------------------------------------
+//   ORDERING
+//------------------------------------------------------------------------------
+// With identifier priority, bxCAN sends equal identifiers lowest mailbox first:
+// frames of a class with the same identifier are still sent in queue order.
+
+static void testEqualIdentifiersKeepQueueOrder (void) {
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  ACAN_STM32::TransmitClasses classes ;
+  CHECK (classes.addClass (12, 0x7)) ;
+  CHECK (classes.addClass (4, 0x4)) ;
+  CHECK_EQUAL (can.setTransmitClasses (classes), 0) ;
+  const uint32_t FRAME_COUNT = 12 ;
+  for (uint32_t i = 0 ; i < FRAME_COUNT ; i++) {
+    CANMessage message = classFrame (0x123, 0) ;
+    message.data [0] = uint8_t (i) ;
+    CHECK_EQUAL (can.tryToSendReturnStatus (message), 0) ;
+    if ((i % 4) == 1) { // Mailbox 2 taken in the middle of the sequence
+      CHECK_EQUAL (can.tryToSendReturnStatus (classFrame (0x7F0, 1)), 0) ;
+    }
+  }
+  CHECK (hostRunUntil ([&] () { return node.mReceived.size () == FRAME_COUNT + 3 ; }, 20 * MS)) ;
+  uint32_t expected = 0 ;
+  for (const CANMessage & message : node.mReceived) {
+    if (message.id == 0x123) {
+      CHECK_EQUAL (message.data [0], expected) ;
+      expected += 1 ;
+    }
+  }
+  CHECK_EQUAL (expected, FRAME_COUNT) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   INDEX
+//------------------------------------------------------------------------------
+// With transmit classes, message idx is the class index.
+
+static void testClassIndexCheck (void) {
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  ACAN_STM32::TransmitClasses classes ;
+  for (uint32_t c = 0 ; c < 4 ; c++) {
+    CHECK (classes.addClass (4, 0x7)) ;
+  }
+  CHECK_EQUAL (can.setTransmitClasses (classes), 0) ;
+  CHECK_EQUAL (can.transmitClassCount (), 4) ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (classFrame (0x100, 3)), 0) ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (classFrame (0x100, 4)), ACAN_STM32::kTransmitBufferIndexTooLarge) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testReservedMailbox) ;
+  RUN_TEST (testStrictPriority) ;
+  RUN_TEST (testWeightedRoundRobin) ;
+  RUN_TEST (testEqualIdentifiersKeepQueueOrder) ;
+  RUN_TEST (testClassIndexCheck) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,149 @@
+//------------------------------------------------------------------------------
+// Transmit completion call back: tags in transmission order with their latency,
+// aborted frames (deadline), and the failure cause with NART (acknowledge error,
+// arbitration lost)
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <HostTest.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+
+//------------------------------------------------------------------------------
+
+static CANMessage standardFrame (const uint32_t inIdentifier) {
+  CANMessage message ;
+  message.id = inIdentifier ;
+  message.len = 8 ;
+  for (uint32_t i = 0 ; i < 8 ; i++) {
+    message.data [i] = uint8_t (inIdentifier + i) ;
+  }
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+
+class Completion {
+  public: uint32_t mTag ;
+  public: ACAN_STM32::TransmitStatus mStatus ;
+  public: uint32_t mLatency ; // µs
+} ;
+
+static std::vector <Completion> gCompletions ;
+
+static void transmitComplete (const uint32_t inTag,
+                              const ACAN_STM32::TransmitStatus inStatus,
+                              const uint32_t inLatencyMicros) {
+  gCompletions.push_back ({inTag, inStatus, inLatencyMicros}) ;
+}
+
+//------------------------------------------------------------------------------
+//   SUCCESS
+//------------------------------------------------------------------------------
+// A node acknowledges: every frame is completed once, in order, with its tag (0
+// without tag); the latency grows by about one frame (8 data bytes at 500 kbit/s:
+// more than 200 µs) per queued frame.
+
+static void testTagsInOrder (void) {
+  gCompletions.clear () ;
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  can.setTransmitCompleteCallBack (transmitComplete) ;
+  for (uint32_t i = 0 ; i < 5 ; i++) {
+    CHECK_EQUAL (can.tryToSendWithTagReturnStatus (standardFrame (0x100 + i), 10 + i), 0) ;
+  }
+  CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x105)), 0) ;
+  CHECK (hostRunUntil ([] () { return gCompletions.size () == 6 ; }, 20 * MS)) ;
+  hostRun (1 * MS) ;
+  CHECK_EQUAL (gCompletions.size (), 6) ;
+  CHECK_EQUAL (node.mReceived.size (), 6) ;
+  uint32_t previousLatency = 0 ;
+  for (uint32_t i = 0 ; i < gCompletions.size () ; i++) {
+    CHECK_EQUAL (gCompletions [i].mTag, (i < 5) ? (10 + i) : 0) ;
+    CHECK_EQUAL (gCompletions [i].mStatus, ACAN_STM32::TRANSMIT_OK) ;
+    CHECK (gCompletions [i].mLatency >= previousLatency + 200) ;
+    previousLatency = gCompletions [i].mLatency ;
+  }
+  can.setTransmitCompleteCallBack (nullptr) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   ABORT
+//------------------------------------------------------------------------------
+// Nobody acknowledges: the frame is retried until its deadline, then aborted.
+
+static void testDeadlineAbort (void) {
+  gCompletions.clear () ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  can.setTransmitCompleteCallBack (transmitComplete) ;
+  CHECK_EQUAL (can.tryToSendWithTagReturnStatus (standardFrame (0x100), 42, 1000), 0) ;
+  hostRun (2 * MS) ;
+  CHECK_EQUAL (gCompletions.size (), 0) ;
+  can.expireStaleFrames () ;
+  CHECK (hostRunUntil ([] () { return gCompletions.size () == 1 ; }, 1 * MS)) ;
+  if (gCompletions.size () == 1) {
+    CHECK_EQUAL (gCompletions [0].mTag, 42) ;
+    CHECK_EQUAL (gCompletions [0].mStatus, ACAN_STM32::TRANSMIT_ABORTED) ;
+    CHECK (gCompletions [0].mLatency >= 2000) ;
+  }
+  CHECK_EQUAL (can.deadlineMissCount (), 1) ;
+  can.setTransmitCompleteCallBack (nullptr) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   NART
+//------------------------------------------------------------------------------
+// One-shot transmission: the failure cause is reported, the frame is not retried.
+
+static void testNoAutomaticRetransmission (void) {
+  gCompletions.clear () ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mNoAutomaticRetransmission = true ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  can.setTransmitCompleteCallBack (transmitComplete) ;
+//--- Nobody acknowledges
+  CHECK_EQUAL (can.tryToSendWithTagReturnStatus (standardFrame (0x100), 1), 0) ;
+  CHECK (hostRunUntil ([] () { return gCompletions.size () == 1 ; }, 10 * MS)) ;
+  if (gCompletions.size () == 1) {
+    CHECK_EQUAL (gCompletions [0].mTag, 1) ;
+    CHECK_EQUAL (gCompletions [0].mStatus, ACAN_STM32::TRANSMIT_ERROR) ;
+  }
+  hostRun (1 * MS) ;
+  CHECK_EQUAL (hostBus (0).records ().size (), 1) ;
+//--- While the bus is busy, a node requests a higher priority frame: both start
+//    after the interframe space
+  HostVirtualNode node (hostBus (0)) ;
+  node.send (standardFrame (0x001)) ;
+  hostRun (50 * 1000) ;
+  CHECK (!hostBus (0).isIdle ()) ;
+  node.send (standardFrame (0x010)) ;
+  CHECK_EQUAL (can.tryToSendWithTagReturnStatus (standardFrame (0x100), 2), 0) ;
+  CHECK (hostRunUntil ([] () { return gCompletions.size () == 2 ; }, 10 * MS)) ;
+  if (gCompletions.size () == 2) {
+    CHECK_EQUAL (gCompletions [1].mTag, 2) ;
+    CHECK_EQUAL (gCompletions [1].mStatus, ACAN_STM32::TRANSMIT_ARBITRATION_LOST) ;
+  }
+  hostRun (1 * MS) ;
+  CHECK_EQUAL (node.mReceived.size (), 0) ;
+  can.setTransmitCompleteCallBack (nullptr) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testTagsInOrder) ;
+  RUN_TEST (testDeadlineAbort) ;
+  RUN_TEST (testNoAutomaticRetransmission) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,288 @@
+//------------------------------------------------------------------------------
+// Several nodes on a virtual bus: CAN1 and CAN2 instances and virtual nodes.
+// Bitwise arbitration, frame durations from the settings, and per identifier
+// latencies of a periodic message set against the response time analysis.
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <ACAN_STM32_ResponseTimeAnalysis.h>
+#include <HostTest.h>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+static const uint64_t US = 1000 ; // ns
+
+//------------------------------------------------------------------------------
+
+static CANMessage frame (const uint32_t inIdentifier,
+                         const uint8_t inLength,
+                         const bool inExtended = false) {
+  CANMessage message ;
+  message.id = inIdentifier ;
+  message.ext = inExtended ;
+  message.len = inLength ;
+  message.data64 = 0x0123456789ABCDEFULL * (inIdentifier + 1) ;
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+//   ARBITRATION
+//------------------------------------------------------------------------------
+
+// While a node sends a frame, CAN1, CAN2 and a virtual node queue frames: they
+// are sent by arbitration field, whatever their sender.
+
+static void testArbitration (void) {
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  CHECK_EQUAL (can2.begin (settings), 0) ;
+//--- Bus taken by a low priority frame
+  node.send (frame (0x7FF, 8)) ;
+  hostRun (10 * US) ;
+  CHECK (!hostBus (0).isIdle ()) ;
+//--- Competing frames, in mailboxes 1 and 2 of each controller (through the
+//    driver transmit FIFO, the second frame would wait for the first one)
+  CANMessage message = frame (0x300, 8) ;
+  message.idx = 1 ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (message), 0) ;
+  message = frame (0x120, 2) ;
+  message.idx = 2 ;
+  CHECK_EQUAL (can.tryToSendReturnStatus (message), 0) ;
+  message = frame (0x200, 8) ;
+  message.idx = 1 ;
+  CHECK_EQUAL (can2.tryToSendReturnStatus (message), 0) ;
+  message = frame ((0x120 << 18) | 0x5, 0, true) ;
+  message.idx = 2 ;
+  CHECK_EQUAL (can2.tryToSendReturnStatus (message), 0) ;
+  node.send (frame (0x250, 1)) ;
+  node.send (frame (0x050, 4)) ;
+  CHECK (hostRunUntil ([&] () { return node.mReceived.size () == 4 ; }, 10 * MS)) ;
+  hostRun (1 * MS) ;
+//--- Bus order: a standard frame wins against an extended frame with the same
+//    base identifier
+  const uint32_t EXPECTED_IDENTIFIERS [7] = {0x7FF, 0x050, 0x120, (0x120 << 18) | 0x5, 0x200, 0x250, 0x300} ;
+  const int32_t EXPECTED_SENDERS [7] = {-1, -1, 0, 1, 1, -1, 0} ;
+  const std::vector <HostBusRecord> & records = hostBus (0).records () ;
+  CHECK_EQUAL (records.size (), 7) ;
+  for (uint32_t i = 0 ; (i < 7) && (i < records.size ()) ; i++) {
+    CHECK_EQUAL (records [i].mMessage.id, EXPECTED_IDENTIFIERS [i]) ;
+    CHECK_EQUAL (records [i].mSender, EXPECTED_SENDERS [i]) ;
+    CHECK (records [i].mOk) ;
+  //--- Durations follow the bit timing of the settings, frames are back to back
+    CHECK_EQUAL (records [i].mEndDate - records [i].mStartDate,
+                 settings.frameDurationInNanoseconds (records [i].mMessage)) ;
+    if (i > 0) {
+      CHECK_EQUAL (records [i].mStartDate, records [i - 1].mEndDate) ;
+    }
+  }
+//--- Every controller receives the frames of the other nodes
+  CHECK_EQUAL (can.driverReceiveFIFO0Count (), 5) ;
+  CHECK_EQUAL (can2.driverReceiveFIFO0Count (), 5) ;
+  can2.end () ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   LATENCIES
+//------------------------------------------------------------------------------
+
+// Message set at 500 kbit/s (about 50% bus load): frames of CAN1 are sent by
+// the test program through the driver transmit FIFO, the other ones by two
+// virtual nodes. Every frame is first queued at date 0 (critical instant).
+
+class MessageSpec {
+  public: uint32_t mIdentifier ;
+  public: uint8_t mLength ;
+  public: uint32_t mPeriod ; // ms
+  public: int32_t mSender ; // 0: CAN1, 1, 2: virtual nodes
+} ;
+
+static const uint32_t MESSAGE_COUNT = 10 ;
+
+static const MessageSpec MESSAGES [MESSAGE_COUNT] = {
+  {0x080, 8,  2, 1},
+  {0x100, 8,  5, 0},
+  {0x180, 2,  2, 2},
+  {0x200, 8,  5, 1},
+  {0x300, 8,  5, 0},
+  {0x400, 8, 10, 1},
+  {0x500, 4, 10, 0},
+  {0x600, 8, 10, 1},
+  {0x700, 8, 20, 0},
+  {0x7F0, 8, 20, 2}
+} ;
+
+static const uint64_t SIMULATED_DURATION = 100 * MS ;
+static const uint64_t SEND_STEP = 10 * US ; // Release jitter of CAN1 frames
+
+//------------------------------------------------------------------------------
+
+static uint32_t messageIndex (const uint32_t inIdentifier) {
+  uint32_t idx = 0 ;
+  while ((idx < MESSAGE_COUNT) && (MESSAGES [idx].mIdentifier != inIdentifier)) {
+    idx += 1 ;
+  }
+  return idx ;
+}
+
+//------------------------------------------------------------------------------
+// Latencies (ns), from the request to the end of the frame on the bus: the
+// send call for CAN1 frames, the due date for virtual node frames.
+
+static void runMessageSet (std::vector <uint64_t> outLatencies [MESSAGE_COUNT]) {
+  hostReset () ;
+  HostVirtualNode node1 (hostBus (0)) ;
+  HostVirtualNode node2 (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  const uint64_t start = hostNanoseconds () ;
+  for (uint32_t i = 0 ; i < MESSAGE_COUNT ; i++) {
+    const MessageSpec & spec = MESSAGES [i] ;
+    if (spec.mSender > 0) {
+      HostVirtualNode & node = (spec.mSender == 1) ? node1 : node2 ;
+      node.sendPeriodic (frame (spec.mIdentifier, spec.mLength), spec.mPeriod * MS, 0,
+                         uint32_t (SIMULATED_DURATION / (spec.mPeriod * MS))) ;
+    }
+  }
+//--- CAN1 frames
+  std::vector <uint64_t> sendDates [MESSAGE_COUNT] ;
+  uint64_t nextDates [MESSAGE_COUNT] ;
+  for (uint32_t i = 0 ; i < MESSAGE_COUNT ; i++) {
+    nextDates [i] = start ;
+  }
+  while ((hostNanoseconds () - start) < SIMULATED_DURATION) {
+    for (uint32_t i = 0 ; i < MESSAGE_COUNT ; i++) {
+      if ((MESSAGES [i].mSender == 0) && (hostNanoseconds () >= nextDates [i])) {
+        sendDates [i].push_back (hostNanoseconds ()) ;
+        CHECK_EQUAL (can.tryToSendReturnStatus (frame (MESSAGES [i].mIdentifier, MESSAGES [i].mLength)), 0) ;
+        nextDates [i] += MESSAGES [i].mPeriod * MS ;
+      }
+    }
+    CANMessage message ;
+    while (can.receive0 (message)) {}
+    hostRun (SEND_STEP) ;
+  }
+  hostRunUntil ([&] () { return hostBus (0).isIdle () && (can.driverTransmitFIFOCount () == 0) ; }, 10 * MS) ;
+  hostRun (1 * MS) ;
+//--- Latencies
+  for (const HostBusRecord & record : hostBus (0).records ()) {
+    CHECK (record.mOk) ;
+    const uint32_t idx = messageIndex (record.mMessage.id) ;
+    CHECK (idx < MESSAGE_COUNT) ;
+    if (idx < MESSAGE_COUNT) {
+      uint64_t requestDate = record.mRequestDate ;
+      if (record.mSender == 0) {
+        const uint32_t n = uint32_t (outLatencies [idx].size ()) ;
+        requestDate = (n < sendDates [idx].size ()) ? sendDates [idx][n] : record.mEndDate ;
+      }
+      outLatencies [idx].push_back (record.mEndDate - requestDate) ;
+    }
+  }
+  CHECK_EQUAL (node1.mFailedCount + node2.mFailedCount, 0) ;
+  CHECK_EQUAL (can.transmitErrorCounter (), 0) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+static void testLatenciesAgainstResponseTimeAnalysis (void) {
+  std::vector <uint64_t> latencies [MESSAGE_COUNT] ;
+  runMessageSet (latencies) ;
+//--- Analysis of the same message set
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  const ACAN_STM32_ResponseTimeAnalysis analysis (settings) ;
+  ACAN_STM32_ResponseTimeAnalysis::Frame frames [MESSAGE_COUNT] ;
+  for (uint32_t i = 0 ; i < MESSAGE_COUNT ; i++) {
+    frames [i].mIdentifier = MESSAGES [i].mIdentifier ;
+    frames [i].mLength = MESSAGES [i].mLength ;
+    frames [i].mPeriod = MESSAGES [i].mPeriod * 1000 ;
+    frames [i].mLocal = MESSAGES [i].mSender == 0 ;
+    frames [i].mJitter = frames [i].mLocal ? uint32_t (SEND_STEP / US) : 0 ;
+  }
+  CHECK_EQUAL (analysis.analyze (frames, MESSAGE_COUNT), 0) ;
+//--- Every frame is sent, and its observed latencies are within the bound; the
+//    distribution is printed for tuning
+  printf ("  ID     count  min (us)  mean (us)  max (us)  WCRT (us)\n") ;
+  for (uint32_t i = 0 ; i < MESSAGE_COUNT ; i++) {
+    CHECK_EQUAL (latencies [i].size (), SIMULATED_DURATION / (MESSAGES [i].mPeriod * MS)) ;
+    uint64_t minimum = UINT64_MAX ;
+    uint64_t maximum = 0 ;
+    uint64_t sum = 0 ;
+    for (const uint64_t latency : latencies [i]) {
+      minimum = min (minimum, latency) ;
+      maximum = max (maximum, latency) ;
+      sum += latency ;
+    }
+    const uint64_t count = max (uint64_t (latencies [i].size ()), uint64_t (1)) ;
+    printf ("  0x%03X  %5u  %8u  %9u  %8u  %9u\n",
+            unsigned (MESSAGES [i].mIdentifier), unsigned (latencies [i].size ()),
+            unsigned (minimum / US), unsigned ((sum / count) / US), unsigned (maximum / US),
+            unsigned (frames [i].mWorstCaseResponseTime)) ;
+    CHECK (maximum <= uint64_t (frames [i].mWorstCaseResponseTime) * US) ;
+  //--- A frame lasts at least its own transmission
+    CHECK (minimum >= settings.frameDurationInNanoseconds (frame (MESSAGES [i].mIdentifier, MESSAGES [i].mLength))) ;
+  }
+//--- At the critical instant, the highest priority frame waits for the frame
+//    on the bus at most
+  CHECK (latencies [0][0] <= uint64_t (frames [0].mWorstCaseResponseTime) * US) ;
+//--- The lowest priority frame waits for every other frame released at date 0
+  uint64_t higherPriorityDuration = 0 ;
+  for (uint32_t i = 0 ; i < MESSAGE_COUNT ; i++) {
+    higherPriorityDuration += settings.frameDurationInNanoseconds (frame (MESSAGES [i].mIdentifier, MESSAGES [i].mLength)) ;
+  }
+  CHECK (latencies [MESSAGE_COUNT - 1][0] >= higherPriorityDuration) ;
+}
+
+//------------------------------------------------------------------------------
+// Three frames, each using exactly a third of the bus: the utilization of the
+// lowest priority one is 100% (a sum of floored ppm terms would give 99.9999%,
+// and the busy period would never converge). The analysis terminates, the lowest
+// priority frame is unbounded.
+
+static void testSaturatedMessageSet (void) {
+  const ACAN_STM32_ResponseTimeAnalysis analysis (1000, 0, ACAN_STM32_Settings::BY_IDENTIFIER) ; // 1 Mbit/s
+  const uint32_t C = ACAN_STM32_Settings::worstCaseFrameBitCount (8, false) ; // us
+  ACAN_STM32_ResponseTimeAnalysis::Frame frames [3] ;
+  for (uint32_t i = 0 ; i < 3 ; i++) {
+    frames [i].mIdentifier = 0x100 + i ;
+    frames [i].mPeriod = 3 * C ;
+  }
+  CHECK_EQUAL (analysis.busUtilization (frames, 3), 1000) ;
+  CHECK_EQUAL (analysis.analyze (frames, 3), 1) ;
+  CHECK (frames [0].mSchedulable) ;
+  CHECK (frames [1].mSchedulable) ;
+  CHECK (!frames [2].mSchedulable) ;
+  CHECK_EQUAL (frames [2].mWorstCaseResponseTime, UINT32_MAX) ;
+//--- Just below saturation, the response time of the lowest priority frame is
+//    bounded again: the two other frames, itself, and the interframe space
+  frames [0].mPeriod += 1 ;
+  CHECK_EQUAL (analysis.analyze (frames, 3), 1) ;
+  CHECK_EQUAL (frames [2].mWorstCaseResponseTime, 3 * C + 3) ;
+}
+
+//------------------------------------------------------------------------------
+// The simulation is deterministic: a second run gives the same latencies
+
+static void testDeterminism (void) {
+  std::vector <uint64_t> first [MESSAGE_COUNT] ;
+  std::vector <uint64_t> second [MESSAGE_COUNT] ;
+  runMessageSet (first) ;
+  runMessageSet (second) ;
+  for (uint32_t i = 0 ; i < MESSAGE_COUNT ; i++) {
+    CHECK (first [i] == second [i]) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testArbitration) ;
+  RUN_TEST (testLatenciesAgainstResponseTimeAnalysis) ;
+  RUN_TEST (testSaturatedMessageSet) ;
+  RUN_TEST (testDeterminism) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,142 @@
+//------------------------------------------------------------------------------
+// Driver FIFO watermarks: the call back is raised once when the count reaches
+// the high watermark, once when it falls back to the low watermark (hysteresis),
+// from the send and receive methods and from the ISRs
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <HostTest.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+static const uint64_t MS = 1000 * 1000 ; // ns
+
+//------------------------------------------------------------------------------
+
+static CANMessage standardFrame (const uint32_t inIdentifier) {
+  CANMessage message ;
+  message.id = inIdentifier ;
+  message.len = 8 ;
+  for (uint32_t i = 0 ; i < 8 ; i++) {
+    message.data [i] = uint8_t (inIdentifier + i) ;
+  }
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+
+static std::vector <bool> gWatermarkEvents ;
+static std::vector <uint32_t> gWatermarkEventCounts ; // FIFO count when raised
+
+static void transmitWatermark (const bool inAboveHighWatermark) {
+  gWatermarkEvents.push_back (inAboveHighWatermark) ;
+  gWatermarkEventCounts.push_back (can.driverTransmitFIFOCount ()) ;
+}
+
+static void receiveWatermark (const bool inAboveHighWatermark) {
+  gWatermarkEvents.push_back (inAboveHighWatermark) ;
+  gWatermarkEventCounts.push_back (can.driverReceiveFIFO0Count ()) ;
+}
+
+static void clearWatermarkEvents (void) {
+  gWatermarkEvents.clear () ;
+  gWatermarkEventCounts.clear () ;
+}
+
+//------------------------------------------------------------------------------
+//   TRANSMIT
+//------------------------------------------------------------------------------
+// The producer fills the driver transmit FIFO up to the high watermark (raised
+// by tryToSendReturnStatus); the transmit ISR drains it down to the low
+// watermark (raised from the ISR).
+
+static void testTransmitWatermarks (void) {
+  clearWatermarkEvents () ;
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mDriverTransmitFIFOSize = 16 ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  can.setDriverTransmitFIFOWatermarks (8, 2, transmitWatermark) ;
+//--- 1 frame in mailbox 0, 7 in the FIFO: below the high watermark
+  for (uint32_t i = 0 ; i < 8 ; i++) {
+    CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x100 + i)), 0) ;
+  }
+  CHECK_EQUAL (gWatermarkEvents.size (), 0) ;
+//--- Reaches it, then above it: raised once
+  for (uint32_t i = 8 ; i < 12 ; i++) {
+    CHECK_EQUAL (can.tryToSendReturnStatus (standardFrame (0x100 + i)), 0) ;
+  }
+  CHECK_EQUAL (gWatermarkEvents.size (), 1) ;
+  CHECK (gWatermarkEvents.size () == 1 && gWatermarkEvents [0]) ;
+  CHECK (gWatermarkEventCounts.size () == 1 && gWatermarkEventCounts [0] == 8) ;
+//--- Drained by the transmit ISR
+  CHECK (hostRunUntil ([&] () { return node.mReceived.size () == 12 ; }, 20 * MS)) ;
+  CHECK_EQUAL (gWatermarkEvents.size (), 2) ;
+  CHECK (gWatermarkEvents.size () == 2 && !gWatermarkEvents [1]) ;
+  CHECK (gWatermarkEventCounts.size () == 2 && gWatermarkEventCounts [1] == 2) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+//   RECEIVE
+//------------------------------------------------------------------------------
+// The receive ISR fills the driver receive FIFO 0 (raised from the ISR); the
+// consumer reads it (raised by receive0). Between the watermarks, nothing is
+// raised; a nullptr call back removes the watermarks.
+
+static void testReceiveWatermarksHysteresis (void) {
+  clearWatermarkEvents () ;
+  HostVirtualNode node (hostBus (0)) ;
+  ACAN_STM32_Settings settings (500 * 1000) ;
+  settings.mDriverReceiveFIFO0Size = 16 ;
+  CHECK_EQUAL (can.begin (settings), 0) ;
+  can.setDriverReceiveFIFO0Watermarks (4, 1, receiveWatermark) ;
+  for (uint32_t i = 0 ; i < 5 ; i++) {
+    node.send (standardFrame (0x200 + i)) ;
+  }
+  CHECK (hostRunUntil ([] () { return can.driverReceiveFIFO0Count () == 5 ; }, 10 * MS)) ;
+  CHECK_EQUAL (gWatermarkEvents.size (), 1) ;
+  CHECK (gWatermarkEventCounts.size () == 1 && gWatermarkEventCounts [0] == 4) ;
+//--- Down to 2, up to 4 again: still above the high watermark
+  CANMessage message ;
+  CHECK (can.receive0 (message)) ;
+  CHECK (can.receive0 (message)) ;
+  CHECK (can.receive0 (message)) ;
+  node.send (standardFrame (0x205)) ;
+  node.send (standardFrame (0x206)) ;
+  CHECK (hostRunUntil ([] () { return can.driverReceiveFIFO0Count () == 4 ; }, 10 * MS)) ;
+  CHECK_EQUAL (gWatermarkEvents.size (), 1) ;
+//--- Down to the low watermark
+  for (uint32_t i = 0 ; i < 3 ; i++) {
+    CHECK (can.receive0 (message)) ;
+  }
+  CHECK_EQUAL (gWatermarkEvents.size (), 2) ;
+  CHECK (gWatermarkEvents.size () == 2 && !gWatermarkEvents [1]) ;
+  CHECK (gWatermarkEventCounts.size () == 2 && gWatermarkEventCounts [1] == 1) ;
+//--- Armed again
+  for (uint32_t i = 0 ; i < 3 ; i++) {
+    node.send (standardFrame (0x210 + i)) ;
+  }
+  CHECK (hostRunUntil ([] () { return can.driverReceiveFIFO0Count () == 4 ; }, 10 * MS)) ;
+  CHECK_EQUAL (gWatermarkEvents.size (), 3) ;
+  CHECK (gWatermarkEvents.size () == 3 && gWatermarkEvents [2]) ;
+//--- Removed
+  can.setDriverReceiveFIFO0Watermarks (4, 1, nullptr) ;
+  while (can.receive0 (message)) {}
+  node.send (standardFrame (0x220)) ;
+  CHECK (hostRunUntil ([&] () { return node.pendingCount () == 0 && hostBus (0).isIdle () ; }, 10 * MS)) ;
+  CHECK_EQUAL (gWatermarkEvents.size (), 3) ;
+  can.end () ;
+}
+
+//------------------------------------------------------------------------------
+
+int main (void) {
+  RUN_TEST (testTransmitWatermarks) ;
+  RUN_TEST (testReceiveWatermarksHysteresis) ;
+  return hostTestExitCode () ;
+}
+
+//------------------------------------------------------------------------------
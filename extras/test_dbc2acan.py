@@ -0,0 +1,445 @@
+#!/usr/bin/env python3
+#-------------------------------------------------------------------------------
+# dbc2acan tests
+#
+# Runs dbc2acan.py on sample DBCs, in list mode and with mask merging
+# (--max-banks 1), compiles the generated code with g++ against a stub
+# ACAN_STM32.h (the filters it records are matched as the filter module does),
+# and checks the dispatch of every received identifier, the rejection of
+# unknown identifiers, and the values written and read by the signal codecs
+# (checked against a bit by bit reference of the DBC layouts).
+#
+# Usage (from any directory):
+#   python3 -m unittest discover -s extras -p 'test_*.py'
+#-------------------------------------------------------------------------------
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import unittest
+
+EXTRAS_DIRECTORY = os.path.dirname (os.path.abspath (__file__))
+SOURCE_DIRECTORY = os.path.join (os.path.dirname (EXTRAS_DIRECTORY), 'src')
+sys.path.insert (0, EXTRAS_DIRECTORY)
+
+import dbc2acan
+
+#-------------------------------------------------------------------------------
+#   SAMPLE DBC, generated for node Gateway
+#-------------------------------------------------------------------------------
+
+SAMPLE_DBC = '''VERSION ""
+
+NS_ :
+
+BS_:
+
+BU_: Gateway Sensor Body
+
+BO_ 256 SensorA: 8 Sensor
+ SG_ Speed : 0|16@1+ (0.25,0) [0|16383.75] "rpm" Gateway
+ SG_ Temperature : 16|8@1- (1,-40) [-168|87] "degC" Gateway
+ SG_ Pressure : 39|12@0+ (0.5,0) [0|2047.5] "kPa" Gateway
+ SG_ Torque : 45|14@0- (0.1,-500) [-1319.2|319.1] "Nm" Gateway
+
+BO_ 257 SensorB: 2 Sensor
+ SG_ Level : 0|16@1+ (1,0) [0|65535] "" Gateway
+
+BO_ 258 SensorC: 1 Sensor
+ SG_ Flags : 0|8@1+ (1,0) [0|255] "" Gateway
+
+BO_ 260 SensorD: 1 Sensor
+ SG_ Count : 0|8@1+ (1,0) [0|255] "" Gateway
+
+BO_ 264 SensorE: 1 Sensor
+ SG_ Mode : 0|8@1+ (1,0) [0|255] "" Gateway
+
+BO_ 1024 Status: 4 Body
+ SG_ Page M : 0|4@1+ (1,0) [0|15] "" Gateway
+ SG_ Hours m0 : 8|24@1+ (0.1,0) [0|1677721.5] "h" Gateway
+ SG_ Voltage m1 : 8|8@1+ (0.1,0) [0|25.5] "V" Gateway
+
+BO_ 2566849280 VehicleSpeed: 8 Body
+ SG_ Speed : 0|16@1+ (0.00390625,0) [0|255.99] "km/h" Gateway
+ SG_ Odometer : 16|32@1+ (0.1,0) [0|429496729.5] "km" Gateway
+
+BO_ 2566849296 Trailer: 8 Body
+ SG_ Load : 0|8@1+ (1,0) [0|255] "" Gateway
+
+BO_ 512 Command: 2 Gateway
+ SG_ Request : 0|8@1+ (1,0) [0|255] "" Sensor
+
+BO_ 3221225472 VECTOR__INDEPENDENT_SIG_MSG: 0 Vector__XXX
+ SG_ Orphan : 0|8@1+ (1,0) [0|255] "" Gateway
+
+BA_DEF_ BO_ "GenMsgCycleTime" INT 0 10000;
+BA_ "GenMsgCycleTime" BO_ 256 10;
+BA_ "GenMsgCycleTime" BO_ 2566849280 100;
+'''
+
+RECEIVED_KEYS = [0x100, 0x101, 0x102, 0x104, 0x108, 0x400, (1 << 29) | 0x18FF0300, (1 << 29) | 0x18FF0310]
+RECEIVED_NAMES = ['SensorA', 'SensorB', 'SensorC', 'SensorD', 'SensorE', 'Status', 'VehicleSpeed', 'Trailer']
+
+#--- Identifiers that are not received: transmitted by Gateway, not in the DBC, wrong format
+UNKNOWN_KEYS = [0x200, 0x103, 0x109, 0x7FF, (1 << 29) | 0x100, (1 << 29) | 0x18FF0320, 0x000]
+
+#-------------------------------------------------------------------------------
+# Codec checks: (message, signal, physical value, raw value, multiplexor value)
+
+CODEC_CHECKS = [
+  ('SensorA', 'Speed', 1500.0, 6000, None),
+  ('SensorA', 'Temperature', -25.0, 15, None),
+  ('SensorA', 'Pressure', 1000.5, 2001, None),
+  ('SensorA', 'Torque', -1000.0, -5000, None),
+  ('Status', 'Voltage', 12.6, 126, 1),
+  ('Status', 'Hours', 123456.7, 1234567, 0),
+  ('VehicleSpeed', 'Odometer', 123456.7, 1234567, None)
+]
+
+#-------------------------------------------------------------------------------
+#   STUBS
+#-------------------------------------------------------------------------------
+
+ARDUINO_STUB = '''#pragma once
+#include <stdint.h>
+#include <stddef.h>
+'''
+
+#--- Records the filters; banks are counted as by ACAN_STM32::Filters
+ACAN_STM32_STUB = '''#pragma once
+#include <ACAN_STM32_CANMessage.h>
+#include <vector>
+
+class ACAN_STM32 {
+  public: typedef enum { FIFO0, FIFO1 } Action ;
+  public: typedef enum { DATA, REMOTE, DATA_OR_REMOTE } Format ;
+
+  public: class Filters {
+    public: class Entry {
+      public: uint32_t mBase ;
+      public: uint32_t mMask ;
+      public: bool mExtended ;
+      public: ACANCallBackRoutine mCallBack ;
+    } ;
+    public: std::vector <Entry> mEntries ;
+    public: uint32_t mBankCount = 0 ;
+
+    private: void add (const uint32_t inBase, const uint32_t inMask, const bool inExtended, const ACANCallBackRoutine inCallBack) {
+      mEntries.push_back ({inBase, inMask, inExtended, inCallBack}) ;
+    }
+
+    public: bool addStandardMasks (const uint16_t inBase1, const uint16_t inMask1, const Format, const ACANCallBackRoutine inCallBack1,
+                                   const uint16_t inBase2, const uint16_t inMask2, const Format, const ACANCallBackRoutine inCallBack2,
+                                   const Action) {
+      add (inBase1, inMask1, false, inCallBack1) ;
+      add (inBase2, inMask2, false, inCallBack2) ;
+      mBankCount += 1 ;
+      return true ;
+    }
+
+    public: bool addExtendedMask (const uint32_t inBase, const uint32_t inMask, const Format, const ACANCallBackRoutine inCallBack,
+                                  const Action) {
+      add (inBase, inMask, true, inCallBack) ;
+      mBankCount += 1 ;
+      return true ;
+    }
+
+    public: bool addExtendedDual (const uint32_t inIdentifier1, const bool, const ACANCallBackRoutine inCallBack1,
+                                  const uint32_t inIdentifier2, const bool, const ACANCallBackRoutine inCallBack2,
+                                  const Action) {
+      add (inIdentifier1, 0x1FFFFFFF, true, inCallBack1) ;
+      add (inIdentifier2, 0x1FFFFFFF, true, inCallBack2) ;
+      mBankCount += 1 ;
+      return true ;
+    }
+
+    public: bool addStandardQuad (const uint16_t inIdentifier1, const bool, const ACANCallBackRoutine inCallBack1,
+                                  const uint16_t inIdentifier2, const bool, const ACANCallBackRoutine inCallBack2,
+                                  const uint16_t inIdentifier3, const bool, const ACANCallBackRoutine inCallBack3,
+                                  const uint16_t inIdentifier4, const bool, const ACANCallBackRoutine inCallBack4,
+                                  const Action) {
+      add (inIdentifier1, 0x7FF, false, inCallBack1) ;
+      add (inIdentifier2, 0x7FF, false, inCallBack2) ;
+      add (inIdentifier3, 0x7FF, false, inCallBack3) ;
+      add (inIdentifier4, 0x7FF, false, inCallBack4) ;
+      mBankCount += 1 ;
+      return true ;
+    }
+  } ;
+} ;
+'''
+
+#-------------------------------------------------------------------------------
+# Test program: prints "BANKS n", "DISPATCH key handledKey" (0xFFFFFFFF if
+# rejected by filters, or not dispatched), "CODEC message.signal bytes decoded"
+
+def testProgram (prefix):
+  s = '#include "%s.h"\n#include <stdio.h>\n\n' % prefix
+  s += 'static uint32_t gHandledKey ;\n\n'
+  for name, key in zip (RECEIVED_NAMES, RECEIVED_KEYS):
+    s += 'void %s_%s_received (const CANMessage & /* inMessage */) { gHandledKey = 0x%X ; }\n' % (prefix, name, key)
+  s += '''
+//--- First matching filter entry calls its call back, as the driver does with the filter match index
+static uint32_t receive (const ACAN_STM32::Filters & inFilters, const uint32_t inKey) {
+  CANMessage message ;
+  message.ext = (inKey & (1U << 29)) != 0 ;
+  message.id = inKey & 0x1FFFFFFF ;
+  gHandledKey = 0xFFFFFFFF ;
+  bool accepted = false ;
+  for (size_t i = 0 ; (i < inFilters.mEntries.size ()) && !accepted ; i++) {
+    const ACAN_STM32::Filters::Entry & entry = inFilters.mEntries [i] ;
+    accepted = (entry.mExtended == message.ext) && ((message.id & entry.mMask) == entry.mBase) ;
+    if (accepted && (entry.mCallBack != nullptr)) {
+      entry.mCallBack (message) ;
+    }
+  }
+  return gHandledKey ;
+}
+
+static void printCodec (const char * inName, const CANMessage & inMessage, const float inDecoded) {
+  printf ("CODEC %s ", inName) ;
+  for (uint32_t i = 0 ; i < 8 ; i++) {
+    printf ("%02X", inMessage.data [i]) ;
+  }
+  printf (" %.6f\\n", double (inDecoded)) ;
+}
+
+int main (void) {
+  ACAN_STM32::Filters filters ;
+'''
+  s += '  %s_configureFilters (filters) ;\n' % prefix
+  s += '  printf ("BANKS %u\\n", filters.mBankCount) ;\n'
+  s += '  const uint32_t keys [] = {%s} ;\n' % ', '.join ('0x%X' % k for k in RECEIVED_KEYS + UNKNOWN_KEYS)
+  s += '  for (uint32_t key : keys) {\n'
+  s += '    printf ("DISPATCH 0x%X 0x%X\\n", key, receive (filters, key)) ;\n'
+  s += '  }\n'
+  for message, signal, value, raw, multiplexorValue in CODEC_CHECKS:
+    codec = '%s_%s::%s' % (prefix, message, signal)
+    s += '  { CANMessage message ;\n'
+    s += '    %s.encode (message, %sf) ;\n' % (codec, repr (value))
+    if multiplexorValue is None:
+      s += '    printCodec ("%s.%s", message, %s.decode (message)) ;\n' % (message, signal, codec)
+    else:
+      s += '    float value = 0.0f ;\n'
+      s += '    %s.decode (message, value) ;\n' % codec
+      s += '    printCodec ("%s.%s", message, value) ;\n' % (message, signal)
+    s += '  }\n'
+  s += '  return 0 ;\n}\n'
+  return s
+
+#-------------------------------------------------------------------------------
+#   REFERENCE CODEC: bit by bit, following the DBC definition of the layouts
+#-------------------------------------------------------------------------------
+
+def referencePayload (signals):
+  data = [0] * 8
+  for signal, raw in signals:
+    raw &= (1 << signal.length) - 1
+    position = signal.start
+    for i in range (signal.length):
+      bit = (raw >> (signal.length - 1 - i)) & 1 if signal.motorola else (raw >> i) & 1
+      data [position // 8] |= bit << (position % 8)
+      if not signal.motorola:
+        position += 1
+      elif position % 8 == 0: # Motorola: from MSB, downward in a byte, then next byte
+        position += 15
+      else:
+        position -= 1
+  return ''.join ('%02X' % b for b in data)
+
+#-------------------------------------------------------------------------------
+#   HELPERS
+#-------------------------------------------------------------------------------
+
+def writeFile (directory, fileName, contents):
+  path = os.path.join (directory, fileName)
+  with open (path, 'w') as f:
+    f.write (contents)
+  return path
+
+#-------------------------------------------------------------------------------
+
+def runGenerator (dbcPath, outputDirectory, *arguments):
+  return subprocess.run (
+    [sys.executable, os.path.join (EXTRAS_DIRECTORY, 'dbc2acan.py'), dbcPath,
+     '--node', 'Gateway', '--prefix', 'Sample', '--output', outputDirectory] + list (arguments),
+    stdout = subprocess.PIPE, stderr = subprocess.PIPE, universal_newlines = True
+  )
+
+#-------------------------------------------------------------------------------
+#   TESTS
+#-------------------------------------------------------------------------------
+
+class ParserTests (unittest.TestCase):
+
+  def setUp (self):
+    self.directory = tempfile.mkdtemp ()
+
+  def tearDown (self):
+    shutil.rmtree (self.directory)
+
+  def test_independent_signal_message_is_skipped (self):
+    nodes, messages = dbc2acan.parseDBC (writeFile (self.directory, 'sample.dbc', SAMPLE_DBC))
+    self.assertEqual (nodes, ['Gateway', 'Sensor', 'Body'])
+    names = [m.name for m in messages]
+    self.assertNotIn ('VECTOR__INDEPENDENT_SIG_MSG', names)
+    self.assertEqual (len (messages), 9)
+    self.assertNotIn ('Orphan', [s.name for m in messages for s in m.signals])
+
+  def test_signal_beyond_length_is_rejected (self):
+    for signal in ('SG_ Value : 8|16@1+ (1,0) [0|0] "" Gateway', # Intel, bytes 1 and 2
+                   'SG_ Value : 23|16@0+ (1,0) [0|0] "" Gateway', # Motorola, bytes 2 and 3
+                   'SG_ Value : 7|9@0+ (1,0) [0|0] "" Gateway'): # Motorola, bytes 0 and 1, DLC 1
+      dlc = 1 if signal.startswith ('SG_ Value : 7|') else 2
+      dbc = 'BU_: Gateway Sensor\n\nBO_ 256 Short: %d Sensor\n %s\n' % (dlc, signal)
+      result = runGenerator (writeFile (self.directory, 'short.dbc', dbc), self.directory)
+      self.assertNotEqual (result.returncode, 0, signal)
+      self.assertIn ('exceeds message length', result.stderr)
+
+  def test_signals_within_length_are_accepted (self):
+    dbc = ('BU_: Gateway Sensor\n\nBO_ 256 Short: 2 Sensor\n'
+           ' SG_ A : 0|12@1+ (1,0) [0|0] "" Gateway\n'
+           ' SG_ B : 15|4@0+ (1,0) [0|0] "" Gateway\n'
+           ' SG_ C : 7|8@0+ (1,0) [0|0] "" Gateway\n')
+    result = runGenerator (writeFile (self.directory, 'short.dbc', dbc), self.directory)
+    self.assertEqual (result.returncode, 0, result.stderr)
+
+#-------------------------------------------------------------------------------
+
+class FilterTests (unittest.TestCase):
+
+  def receivedMessages (self):
+    directory = tempfile.mkdtemp ()
+    try:
+      nodes, messages = dbc2acan.parseDBC (writeFile (directory, 'sample.dbc', SAMPLE_DBC))
+    finally:
+      shutil.rmtree (directory)
+    result = [m for m in messages if m.transmitter != 'Gateway' and 'Gateway' in m.receivers ()]
+    result.sort (key = lambda m : m.key ())
+    return result
+
+  def test_list_filters (self):
+    received = self.receivedMessages ()
+    self.assertEqual ([m.key () for m in received], RECEIVED_KEYS)
+    standardList, standardGroups, extendedList, extendedGroups = dbc2acan.computeFilters (received, 14)
+    self.assertEqual (standardList, [0x100, 0x101, 0x102, 0x104, 0x108, 0x400])
+    self.assertEqual (extendedList, [0x18FF0300, 0x18FF0310])
+    self.assertEqual ((standardGroups, extendedGroups), ([], []))
+    self.assertEqual (dbc2acan.bankCount (standardList, standardGroups, extendedList, extendedGroups), 3)
+
+  def test_mask_merge (self):
+    received = self.receivedMessages ()
+    filters = dbc2acan.computeFilters (received, 2)
+    standardList, standardGroups, extendedList, extendedGroups = filters
+    self.assertEqual (dbc2acan.bankCount (*filters), 2)
+  #--- Every received identifier is accepted by a single filter entry
+    for message in received:
+      groups = extendedGroups if message.extended else standardGroups
+      identifiers = extendedList if message.extended else standardList
+      matches = sum (1 for g in groups if (message.identifier & g.mask) == g.base)
+      matches += identifiers.count (message.identifier)
+      self.assertEqual (matches, 1, message.name)
+  #--- Neighbours are merged first: 0x100 ... 0x104 cost less than 0x108 or 0x400
+    self.assertTrue (any (g.keys [:4] == [0x100, 0x101, 0x102, 0x104] for g in standardGroups))
+
+#-------------------------------------------------------------------------------
+
+@unittest.skipUnless (shutil.which ('g++'), 'g++ is required')
+class GeneratedCodeTests (unittest.TestCase):
+
+  def setUp (self):
+    self.directory = tempfile.mkdtemp ()
+
+  def tearDown (self):
+    shutil.rmtree (self.directory)
+
+  def generateAndRun (self, *arguments):
+    result = runGenerator (writeFile (self.directory, 'sample.dbc', SAMPLE_DBC), self.directory, *arguments)
+    self.assertEqual (result.returncode, 0, result.stderr)
+    writeFile (self.directory, 'Arduino.h', ARDUINO_STUB)
+    writeFile (self.directory, 'ACAN_STM32.h', ACAN_STM32_STUB)
+    writeFile (self.directory, 'main.cpp', testProgram ('Sample'))
+    executable = os.path.join (self.directory, 'test')
+    compilation = subprocess.run (
+      ['g++', '-std=gnu++17', '-Wall', '-Wextra', '-Werror', '-I', self.directory, '-I', SOURCE_DIRECTORY,
+       os.path.join (self.directory, 'Sample.cpp'), os.path.join (self.directory, 'main.cpp'), '-o', executable],
+      stdout = subprocess.PIPE, stderr = subprocess.PIPE, universal_newlines = True
+    )
+    self.assertEqual (compilation.returncode, 0, compilation.stderr)
+    execution = subprocess.run ([executable], stdout = subprocess.PIPE, universal_newlines = True, check = True)
+    with open (os.path.join (self.directory, 'Sample.cpp')) as f:
+      source = f.read ()
+    with open (os.path.join (self.directory, 'Sample_report.txt')) as f:
+      report = f.read ()
+    return execution.stdout.split ('\n'), source, report
+
+  def checkDispatch (self, lines):
+    dispatch = {}
+    for line in lines:
+      fields = line.split ()
+      if fields and fields [0] == 'DISPATCH':
+        dispatch [int (fields [1], 16)] = int (fields [2], 16)
+    for key in RECEIVED_KEYS:
+      self.assertEqual (dispatch [key], key, 'received key 0x%X' % key)
+    for key in UNKNOWN_KEYS:
+      self.assertEqual (dispatch [key], 0xFFFFFFFF, 'unknown key 0x%X' % key)
+
+  def checkCodecs (self, lines):
+    nodes, messages = dbc2acan.parseDBC (os.path.join (self.directory, 'sample.dbc'))
+    signals = {(m.name, s.name) : s for m in messages for s in m.signals}
+    codecs = {}
+    for line in lines:
+      fields = line.split ()
+      if fields and fields [0] == 'CODEC':
+        codecs [fields [1]] = (fields [2], float (fields [3]))
+    self.assertEqual (len (codecs), len (CODEC_CHECKS))
+    for message, signalName, value, raw, multiplexorValue in CODEC_CHECKS:
+      signal = signals [(message, signalName)]
+      fields = [(signal, raw)]
+      if multiplexorValue is not None:
+        fields.append ((signals [(message, 'Page')], multiplexorValue))
+      payload, decoded = codecs ['%s.%s' % (message, signalName)]
+      self.assertEqual (payload, referencePayload (fields), '%s.%s' % (message, signalName))
+      self.assertAlmostEqual (decoded, raw * signal.factor + signal.offset, delta = abs (signal.factor) / 4)
+
+  def test_list_mode (self):
+    lines, source, report = self.generateAndRun ()
+    self.assertNotIn ('dispatchMaskFilter', source)
+    self.assertNotIn ('VECTOR__INDEPENDENT_SIG_MSG', source)
+    self.assertIn ('BANKS 3', lines)
+    self.assertIn ('Filters: 8 received messages, 3 filter banks (max 14)', report)
+    self.checkDispatch (lines)
+    self.checkCodecs (lines)
+
+  def test_mask_mode (self):
+    lines, source, report = self.generateAndRun ('--max-banks', '1')
+    self.assertIn ('addStandardMasks', source)
+    self.assertIn ('addExtendedMask', source)
+  #--- One standard mask bank and one extended mask bank: more than 1, reported
+    self.assertIn ('BANKS 2', lines)
+    self.assertIn ('WARNING: filter bank count exceeds 1', report)
+    self.checkDispatch (lines)
+    self.checkCodecs (lines)
+
+  def test_powertrain_example_is_up_to_date (self):
+    example = os.path.join (os.path.dirname (EXTRAS_DIRECTORY), 'examples', 'LoopBackDemoDBC')
+    result = subprocess.run (
+      [sys.executable, os.path.join (EXTRAS_DIRECTORY, 'dbc2acan.py'), os.path.join (example, 'Powertrain.dbc'),
+       '--node', 'Dashboard', '--prefix', 'Powertrain', '--output', self.directory],
+      stdout = subprocess.PIPE, stderr = subprocess.PIPE, universal_newlines = True
+    )
+    self.assertEqual (result.returncode, 0, result.stderr)
+    for fileName in ('Powertrain.h', 'Powertrain.cpp'):
+      with open (os.path.join (example, fileName)) as f:
+        expected = f.read ()
+      with open (os.path.join (self.directory, fileName)) as f:
+        self.assertEqual (f.read (), expected, fileName)
+
+#-------------------------------------------------------------------------------
+
+if __name__ == '__main__':
+  unittest.main ()
+
+#-------------------------------------------------------------------------------
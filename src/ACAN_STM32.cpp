@@ -1,26 +1,31 @@
-#include <ACAN_STM32.h>
+#include <ACAN_STM32_ISR.h>
 
 //------------------------------------------------------------------------------
 //    Constructor
 //------------------------------------------------------------------------------
 
-ACAN_STM32::ACAN_STM32 (volatile uint32_t * inClockEnableRegisterPointer,
+ACAN_STM32::ACAN_STM32 (ACAN_STM32_PeripheralRegister * inClockEnableRegisterPointer,
                         const uint8_t inClockEnableBitOffset,
-                        volatile uint32_t * inResetRegisterPointer,
+                        ACAN_STM32_PeripheralRegister * inResetRegisterPointer,
                         const uint8_t inResetBitOffset,
                         volatile CAN_TypeDef * inPeripheralModuleBasePointer,
                         const IRQn_Type in_TX_IRQn,
                         const IRQn_Type in_RX0_IRQn,
                         const IRQn_Type in_RX1_IRQn,
+                        const IRQn_Type in_SCE_IRQn,
                         GPIO_TypeDef * inTxPinGPIO,
                         const uint8_t inTxPinIndex,
                         const uint8_t inTxPinAlternateMode,
                         GPIO_TypeDef * inRxPinGPIO,
                         const uint8_t inRxPinIndex,
-                        const uint8_t inRxPinAlternateMode) :
+                        const uint8_t inRxPinAlternateMode,
+                        volatile CAN_TypeDef * inFilterModuleBasePointer,
+                        const uint8_t inFilterModuleBankCount,
+                        const uint8_t inFilterModuleClockEnableBitOffset) :
 mClockEnableRegisterPointer (inClockEnableRegisterPointer),
 mResetRegisterPointer (inResetRegisterPointer),
 mCAN (inPeripheralModuleBasePointer),
+mFilterCAN ((inFilterModuleBasePointer == nullptr) ? inPeripheralModuleBasePointer : inFilterModuleBasePointer),
 mTxPinGPIO (inTxPinGPIO),
 mRxPinGPIO (inRxPinGPIO),
 mClockEnableBitOffset (inClockEnableBitOffset),
@@ -28,10 +33,27 @@ mResetBitOffset (inResetBitOffset),
 m_TX_IRQn (in_TX_IRQn),
 m_RX0_IRQn (in_RX0_IRQn),
 m_RX1_IRQn (in_RX1_IRQn),
+m_SCE_IRQn (in_SCE_IRQn),
 mTxPinIndex (inTxPinIndex),
 mTxPinAlternateMode (inTxPinAlternateMode),
 mRxPinIndex (inRxPinIndex),
-mRxPinAlternateMode (inRxPinAlternateMode) {
+mRxPinAlternateMode (inRxPinAlternateMode),
+mFilterModuleBankCount (inFilterModuleBankCount),
+mFilterModuleClockEnableBitOffset (inFilterModuleClockEnableBitOffset) {
+}
+
+//------------------------------------------------------------------------------
+//    Dual CAN devices: the bank split is shared by both instances. Started
+//    instances (bit 0: CAN1, bit 1: CAN2), and the split they have been started with.
+//------------------------------------------------------------------------------
+
+static uint8_t gDualCANStartedInstances = 0 ;
+static uint8_t gDualCANStartBank = 0 ;
+
+//------------------------------------------------------------------------------
+
+uint8_t ACAN_STM32::dualCANInstanceMask (void) const {
+  return (mFilterCAN == mCAN) ? 1 : 2 ;
 }
 
 //------------------------------------------------------------------------------
@@ -43,33 +65,99 @@ void ACAN_STM32::end (void) {
   NVIC_DisableIRQ (m_RX0_IRQn);
   NVIC_DisableIRQ (m_RX1_IRQn);
   NVIC_DisableIRQ (m_TX_IRQn);
-//--- Free receive FIFOs
-  mDriverReceiveFIFO0.free () ;
-  mDriverReceiveFIFO1.free () ;
-//--- Free transmit FIFO
-  mDriverTransmitFIFO.free () ;
+  NVIC_DisableIRQ (m_SCE_IRQn);
+//--- Stop the controller (if its clock is enabled, that is begin has been called):
+//    abort pending transmissions, and request initialization mode, entered at the end
+//    of the current frame; then it no longer takes part in bus activity
+  if ((*mClockEnableRegisterPointer & (1U << mClockEnableBitOffset)) != 0) {
+    mCAN->IER = 0 ;
+    mCAN->TSR = CAN_TSR_ABRQ0 | CAN_TSR_ABRQ1 | CAN_TSR_ABRQ2 ;
+    mCAN->MCR |= CAN_MCR_INRQ ;
+  }
+//--- Free driver FIFO pool, back to single transmit class
+  releaseDriverFIFOPool () ;
 //--- Free callback function array
   mFIFO0CallBackArray.free () ;
   mFIFO1CallBackArray.free () ;
+  mPreviousFIFO0CallBackArray.free () ;
+  mPreviousFIFO1CallBackArray.free () ;
+  mPreviousFiltersMessageCount [0] = 0 ;
+  mPreviousFiltersMessageCount [1] = 0 ;
+//--- No filter bank (updateFilters is rejected)
+  mFilterBankCount = 0 ;
+  if (mFilterModuleBankCount > 14) {
+    gDualCANStartedInstances &= uint8_t (~ dualCANInstanceMask ()) ;
+  }
+  mBeginStep = BEGIN_IDLE ;
+//--- Free routes
+  delete [] mRoutes ;
+  mRoutes = nullptr ;
+  mRouteCount = 0 ;
 }
 
 //------------------------------------------------------------------------------
-//    begin method
+//    Filter banks of this instance
 //------------------------------------------------------------------------------
 
-static const uint32_t MAX_FILTER_COUNT = 14 ;
+static const uint32_t FMR_CAN2SB_POSITION = 8 ; // CAN_FMR_CAN2SB_Pos is not defined by every device header
 
 //------------------------------------------------------------------------------
 
+void ACAN_STM32::firstFilterBankAndCount (const ACAN_STM32_Settings & inSettings,
+                                          uint32_t & outFirstBank,
+                                          uint32_t & outBankCount) const {
+  if (mFilterModuleBankCount <= 14) { // Single CAN device: all banks
+    outFirstBank = 0 ;
+    outBankCount = mFilterModuleBankCount ;
+  }else if (mFilterCAN == mCAN) { // Dual CAN device, CAN1
+    outFirstBank = 0 ;
+    outBankCount = inSettings.mCAN2StartBank ;
+  }else{ // Dual CAN device, CAN2
+    outFirstBank = inSettings.mCAN2StartBank ;
+    outBankCount = mFilterModuleBankCount - inSettings.mCAN2StartBank ;
+  }
+}
+
+//------------------------------------------------------------------------------
+//    begin method
+//------------------------------------------------------------------------------
+
 uint32_t ACAN_STM32::begin (const ACAN_STM32_Settings & inSettings,
                             const ACAN_STM32::Filters & inFilters) {
+  uint32_t errorCode = checkBeginSettings (inSettings, inFilters) ;
+  if (0 == errorCode) {
+    errorCode = internalBegin (inSettings, inFilters) ;
+  }
+  return errorCode ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::checkBeginSettings (const ACAN_STM32_Settings & inSettings,
+                                         const ACAN_STM32::Filters & inFilters) const {
   uint32_t errorCode = inSettings.CANBitSettingConsistency () ;
 //--- No configuration if CAN bit settings are incorrect
   if ((errorCode == 0) && !inSettings.mBitRateClosedToDesiredRate) {
     errorCode = kActualBitRateTooFarFromDesiredBitRate ;
   }
-  if (0 == errorCode) {
-    errorCode = internalBegin (inSettings, inFilters) ;
+//--- Check message IRQ priority
+  if (inSettings.mMessageIRQPriority >= (1U << __NVIC_PRIO_BITS)) {
+    errorCode |= kInvalidMessageIRQPriority ;
+  }
+//--- Check filter bank split and filter count
+  const uint8_t otherInstanceMask = uint8_t (3 ^ dualCANInstanceMask ()) ;
+  if ((mFilterModuleBankCount > 14)
+   && ((inSettings.mCAN2StartBank == 0)
+    || (inSettings.mCAN2StartBank >= mFilterModuleBankCount)
+    || (((gDualCANStartedInstances & otherInstanceMask) != 0) && (inSettings.mCAN2StartBank != gDualCANStartBank)))) {
+    errorCode |= kInvalidCAN2StartBank ;
+  }else{
+    uint32_t firstBank ;
+    uint32_t bankCount ;
+    firstFilterBankAndCount (inSettings, firstBank, bankCount) ;
+    if (inFilters.count () > bankCount) {
+      errorCode |= kTooManyFilters ;
+    }
   }
   return errorCode ;
 }
@@ -79,11 +167,29 @@ uint32_t ACAN_STM32::begin (const ACAN_STM32_Settings & inSettings,
 uint32_t ACAN_STM32::internalBegin (const ACAN_STM32_Settings & inSettings,
                                     const ACAN_STM32::Filters & inFilters) {
   uint32_t errorCode = 0 ; // No error
+  startInitialization (inSettings, inFilters) ;
+  while ((mCAN->MSR & CAN_MSR_INAK) == 0) {}
+  configureController () ;
+  while ((mCAN->MCR & CAN_MCR_INRQ) != 0) {} // Wait until it is ok.
+  while ((mCAN->TSR & CAN_TSR_TME0) == 0) {} // Wait until Transmit box is empty.
+  enableInterrupts () ;
+  mBeginStep = BEGIN_DONE ;
+  return errorCode ;
+}
+
+//------------------------------------------------------------------------------
+// Allocates driver buffers, resets the CAN peripheral, configures pins and
+// filters, and requests initialization mode; computes the BTR, IER and MCR values
+// written by configureController.
+
+void ACAN_STM32::startInitialization (const ACAN_STM32_Settings & inSettings,
+                                      const ACAN_STM32::Filters & inFilters) {
+  mPollingMode = inSettings.mPollingMode ;
+  mMessageIRQPriority = inSettings.mMessageIRQPriority ;
+  mBasePriority = uint8_t (inSettings.mMessageIRQPriority << (8 - __NVIC_PRIO_BITS)) ;
 
 //---------------------------------------------- Allocate buffers
-  mDriverReceiveFIFO0.initWithSize (inSettings.mDriverReceiveFIFO0Size) ;
-  mDriverReceiveFIFO1.initWithSize (inSettings.mDriverReceiveFIFO1Size) ;
-  mDriverTransmitFIFO.initWithSize (inSettings.mDriverTransmitFIFOSize) ;
+  allocateDriverFIFOPool (inSettings) ;
 
 //---------------------------------------------- Allocate call back function array
   inFilters.copyFIFO0CallBackArrayTo (mFIFO0CallBackArray) ;
@@ -91,6 +197,9 @@ uint32_t ACAN_STM32::internalBegin (const ACAN_STM32_Settings & inSettings,
 
 //---------------------------------------------- Enable CAN clock
   *mClockEnableRegisterPointer |= 1U << mClockEnableBitOffset ; // Enable clock for CAN
+  if (mFilterModuleClockEnableBitOffset != NO_FILTER_MODULE_CLOCK) { // CAN2: filter module is in CAN1
+    *mClockEnableRegisterPointer |= 1U << mFilterModuleClockEnableBitOffset ;
+  }
   const uint32_t unused1 __attribute__ ((unused)) = *mClockEnableRegisterPointer ; // Wait until done
 
 //---------------------------------------------- Reset CAN peripheral
@@ -120,11 +229,9 @@ uint32_t ACAN_STM32::internalBegin (const ACAN_STM32_Settings & inSettings,
 //   }
 
 //---------------------------------------------- Init CAN
-// set INRQ bit in MCR and wait until INAK bit in MSR is Ok.
+// set INRQ bit in MCR (INAK bit in MSR is checked by the caller).
 // INRQ: Initialization request, NART: No automatic retransmission
   mCAN->MCR = CAN_MCR_INRQ | CAN_MCR_NART ; // all other fields to 0 (reset state).
-  while ((mCAN->MSR & CAN_MSR_INAK) == 0) {}
-  mCAN->IER = 0; // no interrupt enabled.
 
 //---------------------------------------------- BTR
 //--- Can bit timing
@@ -151,73 +258,344 @@ uint32_t ACAN_STM32::internalBegin (const ACAN_STM32_Settings & inSettings,
     btr |= CAN_BTR_SILM ;
     break ;
   }
-//--- Set BTR register
-  mCAN->BTR = btr ;
+  mBTR = btr ;
 
 //---------------------------------------------- Setup filters
+//--- The filter module does not depend on the controller initialization mode.
+//    Only the banks of this instance are written, the filter module may be shared
+  uint32_t firstBank ;
+  uint32_t bankCount ;
+  firstFilterBankAndCount (inSettings, firstBank, bankCount) ;
+  mFirstFilterBank = uint8_t (firstBank) ;
+  mFilterBankCount = uint8_t (bankCount) ;
+  const uint32_t bankMask = ((1U << bankCount) - 1) << firstBank ;
 //--- Start filter config
-  mCAN->FMR = CAN_FMR_FINIT ;
-  mCAN->FA1R = 0 ; // All filters inactive (put filter inactive for configuration)
-  mCAN->FS1R = 0 ; // filter 0 scale config on single 32-bit
-  mCAN->FM1R = 0 ; // reset to zero filter mode bits
-  mCAN->FFA1R = 0 ; // Assign all filters to FIFO 0
-  mCAN->FA1R = 0 ;  // Filter 0 inactive
+  if (mFilterModuleBankCount > 14) { // Dual CAN: set filter bank split (checked by checkBeginSettings)
+    mFilterCAN->FMR = (uint32_t (inSettings.mCAN2StartBank) << FMR_CAN2SB_POSITION) | CAN_FMR_FINIT ;
+    gDualCANStartedInstances |= dualCANInstanceMask () ;
+    gDualCANStartBank = inSettings.mCAN2StartBank ;
+  }else{
+    mFilterCAN->FMR = CAN_FMR_FINIT ;
+  }
+  mFilterCAN->FA1R &= ~ bankMask ; // Filters inactive (put filter inactive for configuration)
+  mFilterCAN->FS1R &= ~ bankMask ; // Dual 16-bit scale
+  mFilterCAN->FM1R &= ~ bankMask ; // Mask mode
+  mFilterCAN->FFA1R &= ~ bankMask ; // Assign filters to FIFO 0
 //--- If no filter is provided, configure for accepting all valid frames in FIFO0
   if (inFilters.count () == 0) {
-    mCAN->FS1R = 1 ; // filter 0 scale config on single 32-bit
-    mCAN->sFilterRegister [0].FR1 = 0 ; // identifier
-    mCAN->sFilterRegister [0].FR2 = 0 ; // mask, accept any valid frame
-    mCAN->FA1R = 1 ;  // Filter 0 active
+    mFilterCAN->FS1R |= 1U << firstBank ; // First filter scale config on single 32-bit
+    mFilterCAN->sFilterRegister [firstBank].FR1 = 0 ; // identifier
+    mFilterCAN->sFilterRegister [firstBank].FR2 = 0 ; // mask, accept any valid frame
+    mFilterCAN->FA1R |= 1U << firstBank ;  // First filter active
   }else{
   //--- Setup filters
     for (uint32_t i = 0 ; i < inFilters.count () ; i++) {
-      mCAN->sFilterRegister [i].FR1 = inFilters.fr1AtIndex (i) ;
-      mCAN->sFilterRegister [i].FR2 = inFilters.fr2AtIndex (i) ;
+      mFilterCAN->sFilterRegister [firstBank + i].FR1 = inFilters.fr1AtIndex (i) ;
+      mFilterCAN->sFilterRegister [firstBank + i].FR2 = inFilters.fr2AtIndex (i) ;
     }
-    mCAN->FM1R = inFilters.fm1r () ;
-    mCAN->FS1R = inFilters.fs1r () ;
-    mCAN->FFA1R = inFilters.ffa1r () ;
-    mCAN->FA1R |= (1U << inFilters.count ()) - 1 ;
+    mFilterCAN->FM1R |= inFilters.fm1r () << firstBank ;
+    mFilterCAN->FS1R |= inFilters.fs1r () << firstBank ;
+    mFilterCAN->FFA1R |= inFilters.ffa1r () << firstBank ;
+    mFilterCAN->FA1R |= ((1U << inFilters.count ()) - 1) << firstBank ;
   }
 //--- End filter config
-  mCAN->FMR = 0 ;
+  mFilterCAN->FMR &= ~ CAN_FMR_FINIT ;
 
-//---------------------------------------------- Setup Interrupts
+//---------------------------------------------- Interrupts
 //Rx interrupt on FIFO0
-  uint8_t ier = CAN_IER_FMPIE0;  //FIFO 0 message pending interrupt enable
-  ier |= CAN_IER_FFIE0;   //FIFO 0 full interrupt enable
+  uint32_t ier = CAN_IER_FFIE0;   //FIFO 0 full interrupt enable
   ier |= CAN_IER_FOVIE0;  //FIFO 0 overrun interrupt enable
 //Rx interrupt on FIFO1
-  ier |= CAN_IER_FMPIE1;  //FIFO 1 message pending interrupt enable
   ier |= CAN_IER_FFIE1;   //FIFO 1 full interrupt enable
   ier |= CAN_IER_FOVIE1;  //FIFO 1 overrun interrupt enable
+//Message pending interrupts, unless receive interrupts are coalesced
+  if (!inSettings.mReceiveInterruptCoalescing) {
+    ier |= CAN_IER_FMPIE0;  //FIFO 0 message pending interrupt enable
+    ier |= CAN_IER_FMPIE1;  //FIFO 1 message pending interrupt enable
+  }
 //Tx interrupt on transmision
   ier |= CAN_IER_TMEIE;  //Transmit mailbox empty interrupt enable
-  mCAN->IER = ier ;
-
-//---------------------------------------------- Leave init mode
-//ok, now leave init mode (and remove the NART bit).
-//We just set ABOM (Automatic Bus Off recovery, in case of big pb…)
-  uint32_t mcr = CAN_MCR_ABOM ;
+//Error and status change interrupts
+  ier |= CAN_IER_EWGIE;  //Error warning interrupt enable
+  ier |= CAN_IER_EPVIE;  //Error passive interrupt enable
+  ier |= CAN_IER_BOFIE;  //Bus-off interrupt enable
+  if (inSettings.mLastErrorCodeInterrupt) {
+    ier |= CAN_IER_LECIE;  //Last error code interrupt enable
+  }
+  ier |= CAN_IER_ERRIE;  //Error interrupt enable
+  mIER = mPollingMode ? 0 : ier ; // No interrupt in polling mode
+
+//---------------------------------------------- MCR
+//Leaving init mode removes the NART bit.
+//ABOM (Automatic Bus Off recovery) only for automatic recovery policy
+  uint32_t mcr = 0 ;
+  if (inSettings.mBusOffRecovery == ACAN_STM32_Settings::AUTOMATIC_BUS_OFF_RECOVERY) {
+    mcr |= CAN_MCR_ABOM ;
+  }
   if (inSettings.mTransmitPriority == ACAN_STM32_Settings::BY_REQUEST_ORDER) {
     mcr |= CAN_MCR_TXFP ;
   }
-  mCAN->MCR = mcr ;
-  while ((mCAN->MCR & CAN_MCR_INRQ) != 0) {} // Wait until it is ok.
-  while ((mCAN->TSR & CAN_TSR_TME0) == 0) {} // Wait until Transmit box is empty.
+  if (inSettings.mNoAutomaticRetransmission) {
+    mcr |= CAN_MCR_NART ;
+  }
+  mMCR = mcr ;
+
+//---------------------------------------------- Bus health
+  mBusOffRecovery = inSettings.mBusOffRecovery ;
+  mBusOffRecoveryDelay = inSettings.mBusOffRecoveryDelay ;
+  mFlushTransmitOnBusOff = inSettings.mFlushTransmitOnBusOff ;
+  mBusState = BUS_ERROR_ACTIVE ;
+  mBusOffCount = 0 ;
+  mBusOffDowntime = 0 ;
+  mErrorFrameCount = 0 ;
+
+//---------------------------------------------- Deadlines
+  mMailboxDeadlineMask = 0 ;
+  mDeadlineMissCount = 0 ;
+}
+
+//------------------------------------------------------------------------------
+// Should be called in initialization mode (MSR.INAK set): writes BTR and IER,
+// and requests normal mode.
 
-//---------------------------------------------- Enable interrupts
-  if (errorCode == 0) {
-//  NVIC_SetPriority (m_RX0_IRQn, inSettings.mMessageIRQPriority);
+void ACAN_STM32::configureController (void) {
+  mCAN->BTR = mBTR ;
+  mCAN->IER = mIER ;
+  mCAN->MCR = mMCR ; // Leave init mode
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::enableInterrupts (void) {
+  if (!mPollingMode) {
+    NVIC_SetPriority (m_RX0_IRQn, mMessageIRQPriority) ;
     NVIC_EnableIRQ (m_RX0_IRQn) ;
-//  NVIC_SetPriority (m_RX1_IRQn, inSettings.mMessageIRQPriority);
+    NVIC_SetPriority (m_RX1_IRQn, mMessageIRQPriority) ;
     NVIC_EnableIRQ (m_RX1_IRQn) ;
-//  NVIC_SetPriority (m_TX_IRQn, inSettings.mMessageIRQPriority);
+    NVIC_SetPriority (m_TX_IRQn, mMessageIRQPriority) ;
     NVIC_EnableIRQ (m_TX_IRQn) ;
+    NVIC_SetPriority (m_SCE_IRQn, mMessageIRQPriority) ;
+    NVIC_EnableIRQ (m_SCE_IRQn) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+//    Asynchronous begin
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::beginAsync (const ACAN_STM32_Settings & inSettings,
+                                 const ACAN_STM32::Filters & inFilters,
+                                 const uint32_t inStepTimeoutMillis) {
+  const uint32_t errorCode = checkBeginSettings (inSettings, inFilters) ;
+  mBeginErrorCode = errorCode ;
+  if (0 == errorCode) {
+    startInitialization (inSettings, inFilters) ;
+    mBeginStepTimeout = inStepTimeoutMillis ;
+    mBeginStepStartDate = millis () ;
+    mBeginStep = BEGIN_WAITING_INIT_MODE ;
+  }else{
+    mBeginStep = BEGIN_FAILED ;
   }
+  return errorCode ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32::BeginStep ACAN_STM32::pollBegin (void) {
+  bool stepDone = false ;
+  uint32_t timeoutError = 0 ;
+  switch (mBeginStep) {
+  case BEGIN_WAITING_INIT_MODE :
+    stepDone = (mCAN->MSR & CAN_MSR_INAK) != 0 ;
+    if (stepDone) {
+      configureController () ;
+    }
+    timeoutError = kInitModeTimeout ;
+    break ;
+  case BEGIN_WAITING_NORMAL_MODE : // 11 consecutive recessive bits on CANRX
+    stepDone = (mCAN->MSR & CAN_MSR_INAK) == 0 ;
+    timeoutError = kNormalModeTimeout ;
+    break ;
+  case BEGIN_WAITING_MAILBOX_EMPTY :
+    stepDone = (mCAN->TSR & CAN_TSR_TME0) != 0 ;
+    if (stepDone) {
+      enableInterrupts () ;
+    }
+    timeoutError = kTransmitMailboxTimeout ;
+    break ;
+  case BEGIN_IDLE :
+  case BEGIN_DONE :
+  case BEGIN_FAILED :
+    break ;
+  }
+  if (stepDone) {
+    mBeginStep = BeginStep (mBeginStep + 1) ;
+    mBeginStepStartDate = millis () ;
+  }else if ((timeoutError != 0) && ((millis () - mBeginStepStartDate) >= mBeginStepTimeout)) {
+    mBeginErrorCode = timeoutError ;
+    mBeginStep = BEGIN_FAILED ;
+  }
+  return mBeginStep ;
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//   CRITICAL SECTIONS
+//  With a non zero message IRQ priority, only interrupts with the same or a
+//  lower priority (CAN interrupts of this instance included) are masked, by
+//  raising BASEPRI; higher priority interrupts are not delayed. BASEPRI cannot
+//  mask priority 0 interrupts: for priority 0, PRIMASK is used. The previous
+//  state is returned and restored, so critical sections can be nested, and
+//  entered from an ISR.
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::enterCriticalSection (void) const {
+  uint32_t state = 0 ;
+  if (mPollingMode) { // No CAN interrupt
+  }else if (mBasePriority == 0) {
+    state = __get_PRIMASK () ;
+    __disable_irq () ;
+  }else{
+    state = __get_BASEPRI () ;
+    __set_BASEPRI_MAX (mBasePriority) ;
+  }
+  return state ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::leaveCriticalSection (const uint32_t inState) const {
+  if (mPollingMode) { // No CAN interrupt
+  }else if (mBasePriority == 0) {
+    __set_PRIMASK (inState) ;
+  }else{
+    __set_BASEPRI (inState) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+//    Bit rate detection
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::detectBitRate (const uint32_t inCandidates [],
+                                    const uint32_t inCandidateCount,
+                                    const uint32_t inListenDurationMillis) {
+  uint32_t detectedBitRate = 0 ;
+  ACAN_STM32_BitRateDetector detector ;
+  for (uint32_t i = 0 ; (i < inCandidateCount) && (detectedBitRate == 0) ; i++) {
+    ACAN_STM32_Settings settings (inCandidates [i]) ;
+    settings.mModuleMode = ACAN_STM32_Settings::SILENT ;
+    settings.mPollingMode = true ;
+    if (begin (settings) == 0) { // Candidates the bit rate solver cannot reach are skipped
+      detector.reset () ;
+      mCAN->ESR = CAN_ESR_LEC ; // LEC set by software, updated by hardware on next frame
+      ACAN_STM32_BitRateDetector::Verdict verdict = ACAN_STM32_BitRateDetector::UNDECIDED ;
+      const uint32_t start = millis () ;
+      while ((verdict == ACAN_STM32_BitRateDetector::UNDECIDED) && ((millis () - start) < inListenDurationMillis)) {
+        poll () ;
+        uint32_t frameCount = 0 ;
+        CANMessage message ;
+        while (receive0 (message)) {
+          frameCount += 1 ;
+        }
+        const uint32_t esr = mCAN->ESR ;
+        const uint8_t lec = uint8_t ((esr & CAN_ESR_LEC) >> CAN_ESR_LEC_Pos) ;
+        if (lec != ACAN_STM32_BitRateDetector::LEC_SET_BY_SOFTWARE) {
+          mCAN->ESR = CAN_ESR_LEC ;
+        }
+        detector.addSample (frameCount, lec, uint8_t (esr >> CAN_ESR_REC_Pos)) ;
+        verdict = detector.verdict () ;
+      }
+      if (verdict == ACAN_STM32_BitRateDetector::MATCH) {
+        detectedBitRate = inCandidates [i] ;
+      }
+      end () ;
+    }
+  }
+  return detectedBitRate ;
+}
+
+//------------------------------------------------------------------------------
+//   FILTER UPDATE
+//------------------------------------------------------------------------------
 
-//---------------------------------------------- Return
-   return errorCode ;
+uint32_t ACAN_STM32::updateFilters (const ACAN_STM32::Filters & inFilters) {
+  uint32_t errorCode = 0 ;
+  const uint32_t filterCount = inFilters.count () ;
+  if (((filterCount == 0) ? 1 : filterCount) > mFilterBankCount) {
+    errorCode = kTooManyFilters ;
+  }else if ((mPreviousFiltersMessageCount [0] > 0) || (mPreviousFiltersMessageCount [1] > 0)) {
+    errorCode = kPreviousFiltersInUse ;
+  }else{
+  //--- Desired configuration (bits relative to first bank); no filter means accept
+  //    all valid frames in FIFO0 with the first bank
+    const uint32_t activeMask = (filterCount == 0) ? 1 : ((1U << filterCount) - 1) ;
+    const uint32_t fm1r  = inFilters.fm1r () ;
+    const uint32_t fs1r  = (filterCount == 0) ? 1 : inFilters.fs1r () ;
+    const uint32_t ffa1r = inFilters.ffa1r () ;
+  //--- Banks that changed
+    uint32_t changedMask = 0 ;
+    for (uint32_t i = 0 ; i < mFilterBankCount ; i++) {
+      const uint32_t bankBit = 1U << (mFirstFilterBank + i) ;
+      const uint32_t bit = 1U << i ;
+      bool changed = (((mFilterCAN->FA1R & bankBit) != 0) != ((activeMask & bit) != 0))
+                  || (((mFilterCAN->FM1R & bankBit) != 0) != ((fm1r & bit) != 0))
+                  || (((mFilterCAN->FS1R & bankBit) != 0) != ((fs1r & bit) != 0))
+                  || (((mFilterCAN->FFA1R & bankBit) != 0) != ((ffa1r & bit) != 0)) ;
+      if (!changed && ((activeMask & bit) != 0)) {
+        const uint32_t fr1 = (filterCount == 0) ? 0 : inFilters.fr1AtIndex (i) ;
+        const uint32_t fr2 = (filterCount == 0) ? 0 : inFilters.fr2AtIndex (i) ;
+        changed = (mFilterCAN->sFilterRegister [mFirstFilterBank + i].FR1 != fr1)
+               || (mFilterCAN->sFilterRegister [mFirstFilterBank + i].FR2 != fr2) ;
+      }
+      if (changed) {
+        changedMask |= bit ;
+      }
+    }
+  //--- New call back arrays are allocated outside the critical section
+    DynamicArray < ACANCallBackRoutine > fifo0CallBackArray ;
+    DynamicArray < ACANCallBackRoutine > fifo1CallBackArray ;
+    inFilters.copyFIFO0CallBackArrayTo (fifo0CallBackArray) ;
+    inFilters.copyFIFO1CallBackArrayTo (fifo1CallBackArray) ;
+  //--- Write changed banks, and swap call back arrays. Frames of the hardware FIFOs
+  //    are received with the previous filters (reception is deactivated while FINIT
+  //    is set): they are moved to the driver FIFOs first.
+    const uint32_t entryCycle = (mRouteCount > 0) ? DWT->CYCCNT : 0 ;
+    const uint32_t lockState = enterCriticalSection () ;
+      if (changedMask != 0) {
+        mFilterCAN->FMR |= CAN_FMR_FINIT ;
+      }
+      drainHardwareReceiveFIFO <InstanceRegisters> (0, mDriverReceiveFIFO0, entryCycle) ;
+      drainHardwareReceiveFIFO <InstanceRegisters> (1, mDriverReceiveFIFO1, entryCycle) ;
+      if (changedMask != 0) {
+        for (uint32_t i = 0 ; i < mFilterBankCount ; i++) {
+          const uint32_t bit = 1U << i ;
+          if ((changedMask & bit) != 0) {
+            const uint32_t bank = mFirstFilterBank + i ;
+            const uint32_t bankBit = 1U << bank ;
+            mFilterCAN->FA1R &= ~ bankBit ;
+            if ((activeMask & bit) != 0) {
+              mFilterCAN->sFilterRegister [bank].FR1 = (filterCount == 0) ? 0 : inFilters.fr1AtIndex (i) ;
+              mFilterCAN->sFilterRegister [bank].FR2 = (filterCount == 0) ? 0 : inFilters.fr2AtIndex (i) ;
+            }
+            mFilterCAN->FM1R  = (mFilterCAN->FM1R  & ~ bankBit) | (((fm1r  >> i) & 1) << bank) ;
+            mFilterCAN->FS1R  = (mFilterCAN->FS1R  & ~ bankBit) | (((fs1r  >> i) & 1) << bank) ;
+            mFilterCAN->FFA1R = (mFilterCAN->FFA1R & ~ bankBit) | (((ffa1r >> i) & 1) << bank) ;
+            mFilterCAN->FA1R |= ((activeMask >> i) & 1) << bank ;
+          }
+        }
+        mFilterCAN->FMR &= ~ CAN_FMR_FINIT ;
+      }
+      mPreviousFiltersMessageCount [0] = mDriverReceiveFIFO0.count () ;
+      mPreviousFiltersMessageCount [1] = mDriverReceiveFIFO1.count () ;
+      mPreviousFIFO0CallBackArray.swap (mFIFO0CallBackArray) ;
+      mPreviousFIFO1CallBackArray.swap (mFIFO1CallBackArray) ;
+      mFIFO0CallBackArray.swap (fifo0CallBackArray) ;
+      mFIFO1CallBackArray.swap (fifo1CallBackArray) ;
+    leaveCriticalSection (lockState) ;
+  }
+  return errorCode ;
 }
 
 //------------------------------------------------------------------------------
@@ -225,42 +603,350 @@ uint32_t ACAN_STM32::internalBegin (const ACAN_STM32_Settings & inSettings,
 //------------------------------------------------------------------------------
 
 bool ACAN_STM32::available0 (void) const {
-  noInterrupts () ;
+  const uint32_t lockState = enterCriticalSection () ;
     const bool hasMessage = mDriverReceiveFIFO0.count () > 0 ;
-  interrupts () ;
+  leaveCriticalSection (lockState) ;
   return hasMessage ;
 }
 
 //------------------------------------------------------------------------------
 
 bool ACAN_STM32::receive0 (CANMessage & outMessage) {
-  noInterrupts () ;
-    const bool hasMessage = mDriverReceiveFIFO0.remove (outMessage) ;
-  interrupts () ;
+  bool previousFilters ;
+  const uint32_t lockState = enterCriticalSection () ;
+    const bool hasMessage = internalReceive (0, outMessage, previousFilters) ;
+  leaveCriticalSection (lockState) ;
   return hasMessage ;
 }
 
 //------------------------------------------------------------------------------
 
 bool ACAN_STM32::available1 (void) const {
-  noInterrupts () ;
+  const uint32_t lockState = enterCriticalSection () ;
     const bool hasMessage = mDriverReceiveFIFO1.count () > 0 ;
-  interrupts () ;
+  leaveCriticalSection (lockState) ;
   return hasMessage ;
 }
 
 //------------------------------------------------------------------------------
 
 bool ACAN_STM32::receive1 (CANMessage & outMessage) {
-  noInterrupts () ;
-    const bool hasMessage = mDriverReceiveFIFO1.remove (outMessage) ;
-  interrupts () ;
+  bool previousFilters ;
+  const uint32_t lockState = enterCriticalSection () ;
+    const bool hasMessage = internalReceive (1, outMessage, previousFilters) ;
+  leaveCriticalSection (lockState) ;
   return hasMessage ;
 }
 
 //------------------------------------------------------------------------------
+// Should be called with interrupts disabled; outPreviousFilters is set if the
+// message was received before the last updateFilters call.
+
+ACAN_STM32_FAST_CODE bool ACAN_STM32::internalReceive (const uint32_t inFIFOIndex,
+                                                       CANMessage & outMessage,
+                                                       bool & outPreviousFilters) {
+  ACAN_STM32_FIFO & fifo = (inFIFOIndex == 0) ? mDriverReceiveFIFO0 : mDriverReceiveFIFO1 ;
+  const bool hasMessage = fifo.remove (outMessage) ;
+  outPreviousFilters = hasMessage && (mPreviousFiltersMessageCount [inFIFOIndex] > 0) ;
+  if (outPreviousFilters) {
+    mPreviousFiltersMessageCount [inFIFOIndex] -= 1 ;
+  }
+  return hasMessage ;
+}
+
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32::receive0 (CANMessage & outMessage, const uint32_t inTimeoutMillis) {
+  return blockingReceive (0, outMessage, inTimeoutMillis) ;
+}
+
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32::receive1 (CANMessage & outMessage, const uint32_t inTimeoutMillis) {
+  return blockingReceive (1, outMessage, inTimeoutMillis) ;
+}
+
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32::blockingReceive (const uint32_t inFIFOIndex,
+                                  CANMessage & outMessage,
+                                  const uint32_t inTimeoutMillis) {
+  const uint32_t start = millis () ;
+  bool hasMessage = false ;
+  bool wait = true ;
+  while (wait) {
+    if (mPollingMode) {
+      poll () ;
+    }
+    bool previousFilters ;
+    const uint32_t lockState = enterCriticalSection () ;
+      hasMessage = internalReceive (inFIFOIndex, outMessage, previousFilters) ;
+    leaveCriticalSection (lockState) ;
+    const uint32_t elapsed = millis () - start ;
+    wait = !hasMessage && (elapsed < inTimeoutMillis) ;
+    if (wait) {
+      waitForNotification (mReceiveNotifier, inTimeoutMillis - elapsed) ;
+    }
+  }
+  return hasMessage ;
+}
+
+//------------------------------------------------------------------------------
+//   DRIVER FIFO RESIZING
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32::resizeDriverTransmitFIFO (const uint16_t inSize) {
+  return resizeDriverFIFO (mDriverTransmitFIFO, inSize) ;
+}
+
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32::resizeDriverReceiveFIFO0 (const uint16_t inSize) {
+  return resizeDriverFIFO (mDriverReceiveFIFO0, inSize) ;
+}
+
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32::resizeDriverReceiveFIFO1 (const uint16_t inSize) {
+  return resizeDriverFIFO (mDriverReceiveFIFO1, inSize) ;
+}
+
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32::resizeDriverFIFO (ACAN_STM32_FIFO & ioFIFO, const uint16_t inSize) {
+  uint16_t sizes [DRIVER_FIFO_COUNT] ;
+  for (uint32_t i = 0 ; i < DRIVER_FIFO_COUNT ; i++) {
+    sizes [i] = (& driverFIFO (i) == & ioFIFO) ? inSize : driverFIFO (i).size () ;
+  }
+  const uint32_t lockState = enterCriticalSection () ;
+    const bool ok = layOutDriverFIFOs (sizes) ;
+  leaveCriticalSection (lockState) ;
+  return ok ;
+}
+
+//------------------------------------------------------------------------------
+
+uint16_t ACAN_STM32::peakCountAndReset (ACAN_STM32_FIFO & ioFIFO) {
+  const uint32_t lockState = enterCriticalSection () ;
+    const uint16_t peakCount = ioFIFO.peakCount () ;
+    ioFIFO.resetPeakCount () ;
+  leaveCriticalSection (lockState) ;
+  return peakCount ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::autotuneDriverFIFOs (void) {
+  const uint32_t TUNED [3] = {0, MAX_TRANSMIT_CLASS_COUNT, MAX_TRANSMIT_CLASS_COUNT + 1} ;
+  uint16_t sizes [DRIVER_FIFO_COUNT] ;
+  uint32_t totalSize = 0 ;
+  for (uint32_t i = 0 ; i < DRIVER_FIFO_COUNT ; i++) {
+    sizes [i] = driverFIFO (i).size () ;
+    totalSize += sizes [i] ;
+  }
+  uint32_t transmitSize = 0 ;
+  for (uint32_t i = 0 ; i < MAX_TRANSMIT_CLASS_COUNT ; i++) {
+    transmitSize += sizes [i] ;
+  }
+  uint16_t peakCounts [3] ;
+  for (uint32_t t = 0 ; t < 3 ; t++) {
+    peakCounts [t] = peakCountAndReset (driverFIFO (TUNED [t])) ;
+  }
+//--- Shrink idle FIFOs first, so that their room is available for hot ones
+  for (uint32_t t = 0 ; t < 3 ; t++) {
+    const uint32_t size = sizes [TUNED [t]] ;
+    if ((size > 1) && (peakCounts [t] < (size / 4))) {
+      sizes [TUNED [t]] = uint16_t (size / 2) ;
+      totalSize -= size - size / 2 ;
+      if (TUNED [t] < MAX_TRANSMIT_CLASS_COUNT) {
+        transmitSize -= size - size / 2 ;
+      }
+    }
+  }
+//--- Grow hot FIFOs (peak count is greater than size if overflow did occur)
+  for (uint32_t t = 0 ; t < 3 ; t++) {
+    const uint32_t size = sizes [TUNED [t]] ;
+    if ((size > 0) && (peakCounts [t] >= size)) {
+      uint32_t newSize = size * 2 ;
+      if (newSize > ACAN_STM32_FIFO::MAX_SIZE) {
+        newSize = ACAN_STM32_FIFO::MAX_SIZE ;
+      }
+      if ((totalSize - size + newSize) > mFIFOPoolSize) {
+        newSize = mFIFOPoolSize - (totalSize - size) ;
+      }
+      if ((TUNED [t] < MAX_TRANSMIT_CLASS_COUNT) && ((transmitSize - size + newSize) > mFIFOStampPoolSize)) {
+        newSize = mFIFOStampPoolSize - (transmitSize - size) ;
+      }
+      if (TUNED [t] < MAX_TRANSMIT_CLASS_COUNT) {
+        transmitSize += newSize - size ;
+      }
+      sizes [TUNED [t]] = uint16_t (newSize) ;
+      totalSize += newSize - size ;
+    }
+  }
+//--- A single layout; it is rejected if a FIFO to shrink got more messages meanwhile
+  const uint32_t lockState = enterCriticalSection () ;
+    layOutDriverFIFOs (sizes) ;
+  leaveCriticalSection (lockState) ;
+}
+
+//------------------------------------------------------------------------------
+//   DRIVER FIFO POOL
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FIFO & ACAN_STM32::driverFIFO (const uint32_t inIndex) {
+  if (inIndex < MAX_TRANSMIT_CLASS_COUNT) {
+    return transmitClassFIFO (inIndex) ;
+  }else if (inIndex == MAX_TRANSMIT_CLASS_COUNT) {
+    return mDriverReceiveFIFO0 ;
+  }else{
+    return mDriverReceiveFIFO1 ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::driverFIFOPoolFreeCount (void) const {
+  uint32_t usedCount = mDriverReceiveFIFO0.size () + mDriverReceiveFIFO1.size () + mDriverTransmitFIFO.size () ;
+  for (uint32_t c = 1 ; c < MAX_TRANSMIT_CLASS_COUNT ; c++) {
+    usedCount += mExtraTransmitFIFOs [c - 1].size () ;
+  }
+  return mFIFOPoolSize - usedCount ;
+}
+
+//------------------------------------------------------------------------------
+// Called by startInitialization: a previous pool (begin called again without end)
+// is released first. Transmit classes 1 ... get an empty slice. Only the transmit
+// share of the pool (the pool minus the receive FIFO sizes) gets transmit stamps.
+
+void ACAN_STM32::allocateDriverFIFOPool (const ACAN_STM32_Settings & inSettings) {
+  releaseDriverFIFOPool () ;
+  const uint16_t sizes [3] = {
+    (inSettings.mDriverTransmitFIFOSize > ACAN_STM32_FIFO::MAX_SIZE) ? ACAN_STM32_FIFO::MAX_SIZE : inSettings.mDriverTransmitFIFOSize,
+    (inSettings.mDriverReceiveFIFO0Size > ACAN_STM32_FIFO::MAX_SIZE) ? ACAN_STM32_FIFO::MAX_SIZE : inSettings.mDriverReceiveFIFO0Size,
+    (inSettings.mDriverReceiveFIFO1Size > ACAN_STM32_FIFO::MAX_SIZE) ? ACAN_STM32_FIFO::MAX_SIZE : inSettings.mDriverReceiveFIFO1Size
+  } ;
+  const uint32_t totalSize = uint32_t (sizes [0]) + sizes [1] + sizes [2] ;
+  mFIFOPoolSize = (inSettings.mDriverFIFOPoolSize > totalSize) ? inSettings.mDriverFIFOPoolSize : totalSize ;
+  mFIFOPool = new CANMessage [mFIFOPoolSize] ;
+  mFIFOStampPoolSize = mFIFOPoolSize - sizes [1] - sizes [2] ;
+  mFIFOStampPool = new ACAN_STM32_TransmitStamp [mFIFOStampPoolSize] ;
+  mDriverTransmitFIFO.initWithBuffer (mFIFOPool, mFIFOStampPool, sizes [0]) ;
+  for (uint32_t c = 1 ; c < MAX_TRANSMIT_CLASS_COUNT ; c++) {
+    mExtraTransmitFIFOs [c - 1].initWithBuffer (mFIFOPool + sizes [0], mFIFOStampPool + sizes [0], 0) ;
+  }
+  mDriverReceiveFIFO0.initWithBuffer (mFIFOPool + sizes [0], nullptr, sizes [1]) ;
+  mDriverReceiveFIFO1.initWithBuffer (mFIFOPool + sizes [0] + sizes [1], nullptr, sizes [2]) ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::releaseDriverFIFOPool (void) {
+  for (uint32_t i = 0 ; i < DRIVER_FIFO_COUNT ; i++) {
+    driverFIFO (i).free () ;
+  }
+  delete [] mFIFOPool ;
+  mFIFOPool = nullptr ;
+  delete [] mFIFOStampPool ;
+  mFIFOStampPool = nullptr ;
+  mFIFOStampPoolSize = 0 ;
+  mFIFOPoolSize = 0 ;
+  mTransmitClassCount = 1 ;
+  mTransmitClassMode = false ;
+  mTransmitClassMailboxMask [0] = 0x7 ;
+}
+
+//------------------------------------------------------------------------------
+// Lays out the driver FIFOs in the pool, in pool order, with the given sizes;
+// called with interrupts masked. Returns false (FIFOs unchanged) if a FIFO has more
+// messages than its new size, if the pool is too small, or if the transmit FIFOs
+// exceed the transmit share of the pool (receive FIFOs have no transmit stamps).
+//   Every FIFO that is moved or resized is first linearized, in its current slice
+// (current slices are disjoint). Then FIFOs that move upward are moved from the last
+// one, and FIFOs that move downward from the first one: a moved FIFO never overwrites
+// the messages of a FIFO that has not been moved yet.
+
+bool ACAN_STM32::layOutDriverFIFOs (const uint16_t inSizes [DRIVER_FIFO_COUNT]) {
+  uint32_t offsets [DRIVER_FIFO_COUNT] ;
+  uint32_t offset = 0 ;
+  bool ok = mFIFOPool != nullptr ;
+  for (uint32_t i = 0 ; (i < DRIVER_FIFO_COUNT) && ok ; i++) {
+    const ACAN_STM32_FIFO & fifo = driverFIFO (i) ;
+    ok = (inSizes [i] >= fifo.count ()) && (inSizes [i] <= ACAN_STM32_FIFO::MAX_SIZE) ;
+    offsets [i] = offset ;
+    offset += inSizes [i] ;
+  }
+  ok = ok && (offset <= mFIFOPoolSize) && (offsets [MAX_TRANSMIT_CLASS_COUNT] <= mFIFOStampPoolSize) ;
+  if (ok) {
+    for (uint32_t i = 0 ; i < DRIVER_FIFO_COUNT ; i++) {
+      ACAN_STM32_FIFO & fifo = driverFIFO (i) ;
+      if ((fifo.buffer () != (mFIFOPool + offsets [i])) || (fifo.size () != inSizes [i])) {
+        fifo.linearize () ;
+      }
+    }
+    for (uint32_t i = DRIVER_FIFO_COUNT ; i > 0 ; i--) {
+      ACAN_STM32_FIFO & fifo = driverFIFO (i - 1) ;
+      if (fifo.buffer () < (mFIFOPool + offsets [i - 1])) {
+        fifo.moveBuffer (mFIFOPool + offsets [i - 1], stampBuffer (i - 1, offsets [i - 1]), inSizes [i - 1]) ;
+      }
+    }
+    for (uint32_t i = 0 ; i < DRIVER_FIFO_COUNT ; i++) {
+      ACAN_STM32_FIFO & fifo = driverFIFO (i) ;
+      if ((fifo.buffer () != (mFIFOPool + offsets [i])) || (fifo.size () != inSizes [i])) {
+        fifo.moveBuffer (mFIFOPool + offsets [i], stampBuffer (i, offsets [i]), inSizes [i]) ;
+      }
+    }
+  }
+  return ok ;
+}
+
+//------------------------------------------------------------------------------
+//   WATERMARKS
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::setDriverTransmitFIFOWatermarks (const uint16_t inHighWatermark,
+                                                  const uint16_t inLowWatermark,
+                                                  const ACANWatermarkCallBack inCallBack) {
+  const uint32_t lockState = enterCriticalSection () ;
+    mDriverTransmitFIFO.setWatermarks (inHighWatermark, inLowWatermark, inCallBack) ;
+  leaveCriticalSection (lockState) ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::setDriverReceiveFIFO0Watermarks (const uint16_t inHighWatermark,
+                                                  const uint16_t inLowWatermark,
+                                                  const ACANWatermarkCallBack inCallBack) {
+  const uint32_t lockState = enterCriticalSection () ;
+    mDriverReceiveFIFO0.setWatermarks (inHighWatermark, inLowWatermark, inCallBack) ;
+  leaveCriticalSection (lockState) ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::setDriverReceiveFIFO1Watermarks (const uint16_t inHighWatermark,
+                                                  const uint16_t inLowWatermark,
+                                                  const ACANWatermarkCallBack inCallBack) {
+  const uint32_t lockState = enterCriticalSection () ;
+    mDriverReceiveFIFO1.setWatermarks (inHighWatermark, inLowWatermark, inCallBack) ;
+  leaveCriticalSection (lockState) ;
+}
+
+//------------------------------------------------------------------------------
+//   WAITING
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::waitForNotification (ACAN_STM32_Notifier * inNotifier, const uint32_t inTimeoutMillis) {
+  if ((inNotifier != nullptr) && !mPollingMode) {
+    inNotifier->wait (inTimeoutMillis) ;
+  }else{
+    yield () ;
+  }
+}
 
-void ACAN_STM32::internalDispatchReceivedMessage (const CANMessage & inMessage,
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void ACAN_STM32::internalDispatchReceivedMessage (const CANMessage & inMessage,
                                                   const DynamicArray < ACANCallBackRoutine > & inCallBackArray) {
   const uint32_t filterIndex = inMessage.idx ;
   if (filterIndex < inCallBackArray.count ()) {
@@ -273,40 +959,40 @@ void ACAN_STM32::internalDispatchReceivedMessage (const CANMessage & inMessage,
 
 //------------------------------------------------------------------------------
 
-bool ACAN_STM32::dispatchReceivedMessage (void) {
+ACAN_STM32_FAST_CODE bool ACAN_STM32::internalDispatchReceivedMessage (const uint32_t inFIFOIndex) {
   CANMessage receivedMessage ;
-  bool hasReceived = false ;
-  if (receive0 (receivedMessage)) {
-    internalDispatchReceivedMessage (receivedMessage, mFIFO0CallBackArray) ;
-    hasReceived = true ;
-  }
-  if (receive1 (receivedMessage)) {
-    internalDispatchReceivedMessage (receivedMessage, mFIFO1CallBackArray) ;
-    hasReceived = true ;
+  bool previousFilters ;
+  const uint32_t lockState = enterCriticalSection () ;
+    const bool hasReceived = internalReceive (inFIFOIndex, receivedMessage, previousFilters) ;
+  leaveCriticalSection (lockState) ;
+  if (hasReceived) {
+    if (inFIFOIndex == 0) {
+      internalDispatchReceivedMessage (receivedMessage, previousFilters ? mPreviousFIFO0CallBackArray : mFIFO0CallBackArray) ;
+    }else{
+      internalDispatchReceivedMessage (receivedMessage, previousFilters ? mPreviousFIFO1CallBackArray : mFIFO1CallBackArray) ;
+    }
   }
   return hasReceived ;
 }
 
 //------------------------------------------------------------------------------
 
-bool ACAN_STM32::dispatchReceivedMessage0 (void) {
-  CANMessage receivedMessage ;
-  const bool hasReceived = receive0 (receivedMessage) ;
-  if (hasReceived) {
-    internalDispatchReceivedMessage (receivedMessage, mFIFO0CallBackArray) ;
-  }
-  return hasReceived ;
+ACAN_STM32_FAST_CODE bool ACAN_STM32::dispatchReceivedMessage (void) {
+  const bool hasReceived0 = internalDispatchReceivedMessage (0) ;
+  const bool hasReceived1 = internalDispatchReceivedMessage (1) ;
+  return hasReceived0 || hasReceived1 ;
 }
 
 //------------------------------------------------------------------------------
 
-bool ACAN_STM32::dispatchReceivedMessage1 (void) {
-  CANMessage receivedMessage ;
-  const bool hasReceived = receive1 (receivedMessage) ;
-  if (hasReceived) {
-    internalDispatchReceivedMessage (receivedMessage, mFIFO1CallBackArray) ;
-  }
-  return hasReceived ;
+ACAN_STM32_FAST_CODE bool ACAN_STM32::dispatchReceivedMessage0 (void) {
+  return internalDispatchReceivedMessage (0) ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE bool ACAN_STM32::dispatchReceivedMessage1 (void) {
+  return internalDispatchReceivedMessage (1) ;
 }
 
 //------------------------------------------------------------------------------
@@ -315,178 +1001,625 @@ bool ACAN_STM32::dispatchReceivedMessage1 (void) {
 
 bool ACAN_STM32::sendBufferNotFullForIndex (const uint32_t inBufferIndex) {
   bool ok = false ;
-  if (inBufferIndex == 0) {
+  if (mTransmitClassMode) {
+    ok = (inBufferIndex < mTransmitClassCount) && !transmitClassFIFO (inBufferIndex).isFull () ;
+  }else if (inBufferIndex == 0) {
     ok = !mDriverTransmitFIFO.isFull () ;
-  }else if (inBufferIndex == 1) {
-    ok = (mCAN->TSR & CAN_TSR_TME1) != 0 ;
-  }else if (inBufferIndex == 2) {
-    ok = (mCAN->TSR & CAN_TSR_TME2) != 0 ;
+  }else if (inBufferIndex <= 2) { // TME1, TME2 follow TME0
+    ok = (mCAN->TSR & (CAN_TSR_TME0 << inBufferIndex)) != 0 ;
   }
   return ok ;
 }
 
 //------------------------------------------------------------------------------
 
+bool ACAN_STM32::isValidTransmitIndex (const uint32_t inBufferIndex) const {
+  return mTransmitClassMode ? (inBufferIndex < mTransmitClassCount) : (inBufferIndex <= 2) ;
+}
+
+//------------------------------------------------------------------------------
+
 uint32_t ACAN_STM32::tryToSendReturnStatus (const CANMessage & inMessage) {
-  uint32_t sendStatus = 0 ; // Means ok
+  const uint32_t lockState = enterCriticalSection () ;
+    const uint32_t sendStatus = internalTryToSendReturnStatus (inMessage) ;
+  leaveCriticalSection (lockState) ;
+  return sendStatus ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::tryToSendBatch (const CANMessage inMessages [], const uint32_t inCount) {
+  uint32_t sentCount = 0 ;
+  const uint32_t lockState = enterCriticalSection () ;
+    while ((sentCount < inCount) && (internalTryToSendReturnStatus (inMessages [sentCount]) == 0)) {
+      sentCount += 1 ;
+    }
+  leaveCriticalSection (lockState) ;
+  return sentCount ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::send (const CANMessage & inMessage, const uint32_t inTimeoutMillis) {
+  const uint32_t start = millis () ;
+  uint32_t sendStatus = 0 ;
+  bool wait = true ;
+  while (wait) {
+    if (mPollingMode) {
+      poll () ;
+    }
+    sendStatus = tryToSendReturnStatus (inMessage) ;
+    const uint32_t elapsed = millis () - start ;
+    wait = (sendStatus == kTransmitBufferOverflow) && (elapsed < inTimeoutMillis) ;
+    if (wait) {
+      waitForNotification (mTransmitNotifier, inTimeoutMillis - elapsed) ;
+    }
+  }
+  return sendStatus ;
+}
+
+//------------------------------------------------------------------------------
+// Empty mailboxes that can be loaded directly: loading a mailbox clears its RQCP,
+// TXOK, ALST and TERR bits, so a mailbox whose completion has not been handled yet
+// by the transmit ISR is left to it (its completion would be lost). RQCP0, RQCP1
+// and RQCP2 are bits 0, 8 and 16.
+
+static inline uint32_t loadableMailboxes (const uint32_t inTSR) {
+  const uint32_t completed = (inTSR & CAN_TSR_RQCP0)
+                           | ((inTSR & CAN_TSR_RQCP1) >> 7)
+                           | ((inTSR & CAN_TSR_RQCP2) >> 14) ;
+  return ((inTSR & CAN_TSR_TME) >> CAN_TSR_TME0_Pos) & ~ completed ;
+}
+
+//------------------------------------------------------------------------------
+// Should be called with interrupts disabled
 
-  noInterrupts () ;
-  switch (inMessage.idx) {
-  case 0 : // FIFO
-    if (mDriverTransmitFIFO.isEmpty () && ((mCAN->TSR & CAN_TSR_TME0) != 0)) {
-      writeTxRegisters (inMessage, 0) ;
+ACAN_STM32_FAST_CODE uint32_t ACAN_STM32::internalTryToSendReturnStatus (const CANMessage & inMessage,
+                                                                         const ACAN_STM32_TransmitStamp & inStamp) {
+  ACAN_STM32_TransmitStamp stamp = inStamp ;
+  if (mTransmitCompleteCallBack != nullptr) { // Enqueue date only for latency measure
+    stamp.mEnqueueDate = micros () ;
+  }
+  uint32_t sendStatus = 0 ; // Means ok
+  const uint32_t idx = inMessage.idx ;
+  if (mTransmitClassMode) { // idx is the transmit class
+    if (idx >= mTransmitClassCount) {
+      sendStatus = kTransmitBufferIndexTooLarge ;
     }else{
-      const bool ok = mDriverTransmitFIFO.append (inMessage) ;
-      if (!ok) {
+      ACAN_STM32_FIFO & fifo = transmitClassFIFO (idx) ;
+      const uint32_t emptyMailboxes = loadableMailboxes (mCAN->TSR) ;
+      const uint32_t mailboxes = orderedMailboxes (emptyMailboxes, idx) & mTransmitClassMailboxMask [idx] ;
+      if ((mailboxes != 0) && fifo.isEmpty ()) {
+        loadMailbox <InstanceRegisters> (inMessage, stamp, (mailboxes & 1) ? 0 : ((mailboxes & 2) ? 1 : 2), idx) ;
+      }else if (!fifo.append (inMessage, stamp)) {
         sendStatus = kTransmitBufferOverflow ;
       }
     }
-    break ;
-  case 1 : // Mailbox 1
-    if ((mCAN->TSR & CAN_TSR_TME1) != 0) {
-      writeTxRegisters (inMessage, 1) ;
-    }else{
-      sendStatus = kTransmitBufferOverflow ;
-    }
-    break ;
-  case 2 : // Mailbox 2
-    if ((mCAN->TSR & CAN_TSR_TME2) != 0) {
-      writeTxRegisters (inMessage, 2) ;
+  }else if (idx > 2) {
+    sendStatus = kTransmitBufferIndexTooLarge ;
+  }else{
+    const uint32_t emptyMailboxes = loadableMailboxes (mCAN->TSR) ;
+    const bool mailboxIsEmpty = (emptyMailboxes & (1U << idx)) != 0 ;
+    if (idx == 0) { // FIFO
+      if (((orderedMailboxes (emptyMailboxes, 0) & 1) != 0) && mDriverTransmitFIFO.isEmpty ()) {
+        loadMailbox <InstanceRegisters> (inMessage, stamp, 0, 0) ;
+      }else if (!mDriverTransmitFIFO.append (inMessage, stamp)) {
+        sendStatus = kTransmitBufferOverflow ;
+      }
+    }else if (mailboxIsEmpty) { // Mailbox 1 or 2
+      loadMailbox <InstanceRegisters> (inMessage, stamp, idx, NO_TRANSMIT_CLASS) ;
     }else{
       sendStatus = kTransmitBufferOverflow ;
     }
-    break ;
-  default :
-    sendStatus = kTransmitBufferIndexTooLarge ;
-    break ;
   }
-  interrupts () ;
   return sendStatus ;
 }
 
+//------------------------------------------------------------------------------
+//   DEADLINES
 //------------------------------------------------------------------------------
 
-void ACAN_STM32::writeTxRegisters (const CANMessage & inMessage, const uint32_t inBufferIndex) {
-//--- Write rtr, ext, identifier
-  if (inMessage.ext) {
-    mCAN->sTxMailBox [inBufferIndex].TIR = (inMessage.rtr << 1) | (inMessage.ext << 2) | (inMessage.id << 3) ;
+uint32_t ACAN_STM32::tryToSendReturnStatus (const CANMessage & inMessage, const uint32_t inLifetimeMicros) {
+  ACAN_STM32_TransmitStamp stamp ;
+  stamp.mDeadline = micros () + inLifetimeMicros ;
+  stamp.mHasDeadline = true ;
+  const uint32_t lockState = enterCriticalSection () ;
+    const uint32_t sendStatus = internalTryToSendReturnStatus (inMessage, stamp) ;
+  leaveCriticalSection (lockState) ;
+  return sendStatus ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::tryToSendWithTagReturnStatus (const CANMessage & inMessage,
+                                                   const uint32_t inTag,
+                                                   const uint32_t inLifetimeMicros) {
+  ACAN_STM32_TransmitStamp stamp ;
+  stamp.mTag = inTag ;
+  if (inLifetimeMicros > 0) {
+    stamp.mDeadline = micros () + inLifetimeMicros ;
+    stamp.mHasDeadline = true ;
+  }
+  const uint32_t lockState = enterCriticalSection () ;
+    const uint32_t sendStatus = internalTryToSendReturnStatus (inMessage, stamp) ;
+  leaveCriticalSection (lockState) ;
+  return sendStatus ;
+}
+
+//------------------------------------------------------------------------------
+
+
+//------------------------------------------------------------------------------
+// Removes the next frame of a transmit FIFO, expired frames being dropped
+
+ACAN_STM32_FAST_CODE bool ACAN_STM32::removeNextTransmitFrame (ACAN_STM32_FIFO & ioFIFO,
+                                                               CANMessage & outMessage,
+                                                               ACAN_STM32_TransmitStamp & outStamp) {
+  bool found = false ;
+  while (!found && ioFIFO.remove (outMessage, outStamp)) {
+    found = !outStamp.mHasDeadline || !isExpired (outStamp.mDeadline) ;
+    if (!found) {
+      deadlineMiss (outMessage) ;
+    }
+  }
+  return found ;
+}
+
+//------------------------------------------------------------------------------
+void ACAN_STM32::expireStaleFrames (void) {
+  const uint32_t lockState = enterCriticalSection () ;
+    checkMailboxDeadlines <InstanceRegisters> () ;
+  leaveCriticalSection (lockState) ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void ACAN_STM32::deadlineMiss (const CANMessage & inMessage) {
+  mDeadlineMissCount += 1 ;
+  if (mDeadlineMissCallBack != nullptr) {
+    mDeadlineMissCallBack (inMessage) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+CANMessage ACAN_STM32::readTxRegisters (const uint32_t inMailboxIndex) const {
+  const volatile CAN_TxMailBox_TypeDef & mailbox = mCAN->sTxMailBox [inMailboxIndex] ;
+  CANMessage message ;
+  const uint32_t tir = mailbox.TIR ;
+  message.rtr = ((tir >> 1) & 0x1) != 0 ;
+  message.ext = ((tir >> 2) & 0x1) != 0 ;
+  if (message.ext) {
+    message.id = (tir >> 3) & 0x1FFFFFFF ;
   }else{
-    mCAN->sTxMailBox [inBufferIndex].TIR = (inMessage.rtr << 1) | (inMessage.ext << 2) | (inMessage.id << 21) ;
+    message.id = (tir >> 21) & 0x7FF ;
+  }
+  message.len = mailbox.TDTR & 0xF ;
+  message.data32 [0] = mailbox.TDLR ;
+  message.data32 [1] = mailbox.TDHR ;
+  message.idx = uint8_t (inMailboxIndex) ;
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+//   MESSAGE INTERRUPT SERVICE ROUTINES (see ACAN_STM32_ISR.h)
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void ACAN_STM32::message_isr_rx0 (void) {
+  message_isr_rx0 <InstanceRegisters> () ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void ACAN_STM32::message_isr_rx1 (void) {
+  message_isr_rx1 <InstanceRegisters> () ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void ACAN_STM32::message_isr_tx (void) {
+  message_isr_tx <InstanceRegisters> () ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::flushReceiveFIFOs (void) {
+  const uint32_t entryCycle = (mRouteCount > 0) ? DWT->CYCCNT : 0 ;
+  const uint32_t lockState = enterCriticalSection () ;
+    bool stored = drainHardwareReceiveFIFO <InstanceRegisters> (0, mDriverReceiveFIFO0, entryCycle) ;
+    stored |= drainHardwareReceiveFIFO <InstanceRegisters> (1, mDriverReceiveFIFO1, entryCycle) ;
+  leaveCriticalSection (lockState) ;
+//--- Notify only from an ISR (for example a HardwareTimer callback): notifyFromISR
+//    cannot be called from task context
+  if (stored && (mReceiveNotifier != nullptr) && (__get_IPSR () != 0)) {
+    mReceiveNotifier->notifyFromISR () ;
   }
+}
 
-//--- Write length
-  mCAN->sTxMailBox [inBufferIndex].TDTR = inMessage.len & 0xF ;
+//------------------------------------------------------------------------------
 
-//---  Write data
-  mCAN->sTxMailBox [inBufferIndex].TDLR = inMessage.data32 [0] ;
-  mCAN->sTxMailBox [inBufferIndex].TDHR = inMessage.data32 [1] ;
 
-//--- Set TXRQ to request the transmission for the corresponding mailbox
-  mCAN->sTxMailBox [inBufferIndex].TIR |= 1 ;
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//   TRANSMIT CLASSES
+//------------------------------------------------------------------------------
+
+ACAN_STM32::TransmitClasses::TransmitClasses (const TransmitArbitration inArbitration) :
+mArbitration (inArbitration) {
 }
 
 //------------------------------------------------------------------------------
-//   MESSAGE INTERRUPT SERVICE ROUTINES
+
+bool ACAN_STM32::TransmitClasses::addClass (const uint16_t inFIFOSize,
+                                            const uint8_t inMailboxMask,
+                                            const uint8_t inWeight) {
+  const bool ok = (mClassArray.count () < MAX_TRANSMIT_CLASS_COUNT)
+    && (inMailboxMask != 0) && (inMailboxMask <= 0x7) && (inWeight > 0) ;
+  if (ok) {
+    TransmitClass transmitClass ;
+    transmitClass.mFIFOSize = inFIFOSize ;
+    transmitClass.mMailboxMask = inMailboxMask ;
+    transmitClass.mWeight = inWeight ;
+    mClassArray.append (transmitClass) ;
+  }
+  return ok ;
+}
+
 //------------------------------------------------------------------------------
 
-void ACAN_STM32::message_isr_rx0 (void) {
-  if ((mCAN->RF0R & 0x3) != 0) { //case 1: FIFO 0 message pending
-    CANMessage message ;
-    const uint32_t rir  = mCAN->sFIFOMailBox [0].RIR ;
-    const uint32_t rdtr = mCAN->sFIFOMailBox [0].RDTR ;
-  //-- Get rtr, ext, len, identifier
-    message.rtr = ((rir >> 1) & 0x1) != 0 ;
-    message.ext = ((rir >> 2) & 0x1) != 0 ;
-    message.len = rdtr & 0x0F ;
-    if (message.ext) { // extended message
-      message.id = (rir >> 3) & 0x1FFFFFFF ;
-    }else{ //standard message
-      message.id = (rir >> 21) & 0x7FF ;
+uint32_t ACAN_STM32::setTransmitClasses (const ACAN_STM32::TransmitClasses & inClasses) {
+  uint32_t errorCode = 0 ;
+  const uint32_t classCount = inClasses.count () ;
+//--- Class FIFOs are laid out in the pool, in place of the current ones
+  uint16_t sizes [DRIVER_FIFO_COUNT] ;
+  uint32_t totalSize = 0 ;
+  for (uint32_t i = 0 ; i < DRIVER_FIFO_COUNT ; i++) {
+    if (i >= MAX_TRANSMIT_CLASS_COUNT) {
+      sizes [i] = driverFIFO (i).size () ;
+    }else if (i < classCount) {
+      const uint16_t size = inClasses.classAtIndex (i).mFIFOSize ;
+      sizes [i] = (size > ACAN_STM32_FIFO::MAX_SIZE) ? ACAN_STM32_FIFO::MAX_SIZE : size ;
+    }else{
+      sizes [i] = 0 ;
     }
-  //-- Get data
-    message.data32 [0] = mCAN->sFIFOMailBox [0].RDLR ;
-    message.data32 [1] = mCAN->sFIFOMailBox [0].RDHR ;
-  //-- Get filter index
-    message.idx = (rdtr >> 8) & 0xFF ;
-  //-- Store the message
-    mDriverReceiveFIFO0.append (message) ;
-    //Ok message received: set RFR.RFOM bit to release FIFO
-    //if fifo is empty, it acks the interrupt (i.e. FPM returns to 0).
-    mCAN->RF0R = CAN_RF0R_RFOM0 ;
+    totalSize += sizes [i] ;
+  }
+  uint32_t transmitSize = 0 ;
+  for (uint32_t i = 0 ; i < MAX_TRANSMIT_CLASS_COUNT ; i++) {
+    transmitSize += sizes [i] ;
+  }
+  if ((classCount == 0) || (totalSize > mFIFOPoolSize) || (transmitSize > mFIFOStampPoolSize)) {
+    errorCode = kInvalidTransmitClasses ;
+  }else{
+    const uint32_t lockState = enterCriticalSection () ;
+      if (mDriverTransmitFIFO.count () > sizes [0]) {
+        errorCode = kTransmitBufferOverflow ; // Too many frames in driver transmit FIFO
+      }else{
+      //--- Frames queued in previous classes 1 ... are discarded
+        for (uint32_t c = 1 ; c < MAX_TRANSMIT_CLASS_COUNT ; c++) {
+          mExtraTransmitFIFOs [c - 1].clear () ;
+        }
+        layOutDriverFIFOs (sizes) ;
+        mTransmitClassCount = uint8_t (classCount) ;
+        for (uint32_t c = 0 ; c < classCount ; c++) {
+          mTransmitClassMailboxMask [c] = inClasses.classAtIndex (c).mMailboxMask ;
+          mTransmitClassWeight [c] = inClasses.classAtIndex (c).mWeight ;
+        }
+        mTransmitArbitration = inClasses.arbitration () ;
+        mTransmitClassMode = true ;
+        mRoundRobinClass = 0 ;
+        mRoundRobinCredit = mTransmitClassWeight [0] ;
+      }
+    leaveCriticalSection (lockState) ;
+  }
+  return errorCode ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::transmitClassFIFOCount (const uint32_t inClassIndex) {
+  uint32_t count = 0 ;
+  if (inClassIndex < mTransmitClassCount) {
+    const uint32_t lockState = enterCriticalSection () ;
+      count = transmitClassFIFO (inClassIndex).count () ;
+    leaveCriticalSection (lockState) ;
+  }
+  return count ;
+}
+
+//------------------------------------------------------------------------------
+// Returns the class that loads mailbox inMailboxIndex, or mTransmitClassCount if
+// none: a class is eligible if the mailbox belongs to its mask, its queue is not
+// empty, and the mailbox is not below one of its pending frames (orderedMailboxes). Strict priority: lowest class index. Weighted round robin: the current
+// class sends up to its weight frames in a row, then next eligible class is served.
+
+ACAN_STM32_FAST_CODE uint32_t ACAN_STM32::selectTransmitClass (const uint32_t inMailboxIndex,
+                                                                const uint32_t inEmptyMailboxes) {
+  const uint8_t mailboxBit = uint8_t (1U << inMailboxIndex) ;
+  uint32_t selected = mTransmitClassCount ;
+  if (mTransmitArbitration == STRICT_PRIORITY) {
+    for (uint32_t c = 0 ; (c < mTransmitClassCount) && (selected == mTransmitClassCount) ; c++) {
+      if (((mTransmitClassMailboxMask [c] & orderedMailboxes (inEmptyMailboxes, c) & mailboxBit) != 0)
+       && !transmitClassFIFO (c).isEmpty ()) {
+        selected = c ;
+      }
+    }
+  }else{
+    for (uint32_t n = 0 ; (n < mTransmitClassCount) && (selected == mTransmitClassCount) ; n++) {
+      uint32_t c = mRoundRobinClass + n ;
+      if (c >= mTransmitClassCount) {
+        c -= mTransmitClassCount ;
+      }
+      if (((mTransmitClassMailboxMask [c] & orderedMailboxes (inEmptyMailboxes, c) & mailboxBit) != 0)
+       && !transmitClassFIFO (c).isEmpty ()) {
+        selected = c ;
+      }
+    }
+    if (selected < mTransmitClassCount) {
+      if (selected != mRoundRobinClass) {
+        mRoundRobinClass = uint8_t (selected) ;
+        mRoundRobinCredit = mTransmitClassWeight [selected] ;
+      }
+      mRoundRobinCredit -= 1 ;
+      if (mRoundRobinCredit == 0) {
+        mRoundRobinClass = uint8_t ((selected + 1 < mTransmitClassCount) ? (selected + 1) : 0) ;
+        mRoundRobinCredit = mTransmitClassWeight [mRoundRobinClass] ;
+      }
+    }
+  }
+  return selected ;
+}
+
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//   POLLING
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::poll (void) {
+  if (mPollingMode) { // Otherwise the ISRs do this work, poll would race them
+    const uint32_t entryCycle = (mRouteCount > 0) ? DWT->CYCCNT : 0 ;
+  //--- Bus state (no error interrupt in polling mode)
+    updateBusState () ;
+  //--- Receive: drain both hardware FIFOs
+    drainHardwareReceiveFIFO <InstanceRegisters> (0, mDriverReceiveFIFO0, entryCycle) ;
+    drainHardwareReceiveFIFO <InstanceRegisters> (1, mDriverReceiveFIFO1, entryCycle) ;
+  //--- Transmit: report completions, abort expired mailboxes, fill every empty mailbox
+  //    from the driver transmit FIFO
+    handleTransmitCompletions <InstanceRegisters> () ;
+    checkMailboxDeadlines <InstanceRegisters> () ;
+    fillEmptyMailboxes <InstanceRegisters> () ;
   }
+}
+
+//------------------------------------------------------------------------------
+//   BUS HEALTH
+//------------------------------------------------------------------------------
 
-  //case 2: FIFO 0 full
-  if ((mCAN->RF0R & CAN_RF0R_FULL0) >> CAN_RF0R_FULL0_Pos == 1){
-    mCAN->RF0R &= ~CAN_RF0R_FULL0;
+void ACAN_STM32::error_isr (void) {
+  const uint32_t esr = mCAN->ESR ;
+//--- Count bus errors (LEC is reset to 7 by software, so every error is seen once)
+  const uint32_t lec = (esr & CAN_ESR_LEC) >> CAN_ESR_LEC_Pos ;
+  if ((lec != 0) && (lec != 7)) {
+    mErrorFrameCount += 1 ;
+    mCAN->ESR = CAN_ESR_LEC ;
   }
+//--- Acknowledge error interrupt (cleared by writing 1)
+  mCAN->MSR = CAN_MSR_ERRI ;
+  updateBusState () ;
+}
+
+//------------------------------------------------------------------------------
 
-  //case 3: FIFO 0 overrun
-  if ((mCAN->RF0R & CAN_RF0R_FOVR0) >> CAN_RF0R_FOVR0_Pos == 1){
-    mCAN->RF0R &= ~CAN_RF0R_FOVR0;
+ACAN_STM32_FAST_CODE void ACAN_STM32::updateBusState (void) {
+  const uint32_t esr = mCAN->ESR ;
+  BusState state = BUS_ERROR_ACTIVE ;
+  if ((esr & CAN_ESR_BOFF) != 0) {
+    state = BUS_OFF ;
+  }else if ((esr & CAN_ESR_EPVF) != 0) {
+    state = BUS_ERROR_PASSIVE ;
+  }else if ((esr & CAN_ESR_EWGF) != 0) {
+    state = BUS_ERROR_WARNING ;
+  }
+  if (state != mBusState) {
+    const BusState previousState = mBusState ;
+    mBusState = state ;
+    if (state == BUS_OFF) { // Entering bus-off
+      mBusOffCount += 1 ;
+      mBusOffStartDate = millis () ;
+      if (mFlushTransmitOnBusOff) {
+        CANMessage message ;
+        for (uint32_t c = 0 ; c < mTransmitClassCount ; c++) {
+          while (transmitClassFIFO (c).remove (message)) {}
+        }
+        mCAN->TSR = CAN_TSR_ABRQ0 | CAN_TSR_ABRQ1 | CAN_TSR_ABRQ2 ;
+      }
+    }else if (previousState == BUS_OFF) { // Recovered
+      mBusOffDowntime += millis () - mBusOffStartDate ;
+    }
+    if (mBusStateCallBack != nullptr) {
+      mBusStateCallBack (previousState, state) ;
+    }
   }
 }
 
 //------------------------------------------------------------------------------
 
-void ACAN_STM32::message_isr_rx1 (void) {
-//case 1: FIFO 1 message pending
-  if ((mCAN->RF1R & 0x3) != 0) {
-    CANMessage message ;
-    const uint32_t rir  = mCAN->sFIFOMailBox [1].RIR ;
-    const uint32_t rdtr = mCAN->sFIFOMailBox [1].RDTR ;
-  //-- Get rtr, ext, len, identifier
-    message.rtr = ((rir >> 1) & 0x1) != 0 ;
-    message.ext = ((rir >> 2) & 0x1) != 0 ;
-    message.len = rdtr & 0x0F ;
-    if (message.ext) { // extended message
-      message.id = (rir >> 3) & 0x1FFFFFFF ;
-    }else{ //standard message
-      message.id = (rir >> 21) & 0x7FF ;
+ACAN_STM32::BusState ACAN_STM32::busState (void) {
+  const uint32_t lockState = enterCriticalSection () ;
+    updateBusState () ;
+    const BusState state = mBusState ;
+  leaveCriticalSection (lockState) ;
+  return state ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::busOffDowntime (void) const {
+  const uint32_t lockState = enterCriticalSection () ;
+    uint32_t downtime = mBusOffDowntime ;
+    if (mBusState == BUS_OFF) {
+      downtime += millis () - mBusOffStartDate ;
     }
-  //-- Get data
-    message.data32 [0] = mCAN->sFIFOMailBox [1].RDLR ;
-    message.data32 [1] = mCAN->sFIFOMailBox [1].RDHR ;
- //-- Get filter index
-    message.idx = (rdtr >> 8) & 0xFF ;
-  //-- Store the message
-    mDriverReceiveFIFO1.append (message) ;
-  //Ok message received: set RFR.RFOM bit to release FIFO
-  //if fifo is empty, it acks the interrupt (i.e. FPM returns to 0).
-    mCAN->RF1R = CAN_RF1R_RFOM1 ;
+  leaveCriticalSection (lockState) ;
+  return downtime ;
+}
+
+//------------------------------------------------------------------------------
+// Without ABOM, leaving bus-off requires entering and leaving initialization
+// mode; in bus-off state the controller is idle, so INAK is set at once. Only the
+// MCR read-modify-writes are in critical sections: INAK is polled (bounded) with
+// CAN interrupts enabled.
+
+bool ACAN_STM32::recoverFromBusOff (void) {
+  uint32_t lockState = enterCriticalSection () ;
+    const bool busOff = (mCAN->ESR & CAN_ESR_BOFF) != 0 ;
+    if (busOff) {
+      mCAN->MCR |= CAN_MCR_INRQ ;
+    }
+  leaveCriticalSection (lockState) ;
+  if (busOff) {
+    for (uint32_t i = 0 ; (i < 1000) && ((mCAN->MSR & CAN_MSR_INAK) == 0) ; i++) {}
+    lockState = enterCriticalSection () ;
+      mCAN->MCR &= ~ CAN_MCR_INRQ ;
+    leaveCriticalSection (lockState) ;
   }
+  return busOff ;
+}
+
+//------------------------------------------------------------------------------
 
-  //case 2: FIFO 1 full
-  if ((mCAN->RF1R & CAN_RF1R_FULL1) >> CAN_RF1R_FULL1_Pos == 1){
-    mCAN->RF1R &= ~CAN_RF1R_FULL1;
+void ACAN_STM32::serviceBusOffRecovery (void) {
+  const bool recover = (busState () == BUS_OFF)
+    && (mBusOffRecovery == ACAN_STM32_Settings::DELAYED_BUS_OFF_RECOVERY)
+    && ((millis () - mBusOffStartDate) >= mBusOffRecoveryDelay) ;
+  if (recover) {
+    recoverFromBusOff () ;
   }
+}
 
-  //case 3: FIFO 1 overrun
-  if ((mCAN->RF1R & CAN_RF1R_FOVR1) >> CAN_RF1R_FOVR1_Pos == 1){
-    mCAN->RF1R &= ~CAN_RF1R_FOVR1;
+//------------------------------------------------------------------------------
+//   GATEWAY
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::setRoutes (const ACAN_STM32::Routes & inRoutes) {
+//--- Routes latency is measured by DWT cycle counter
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk ;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk ;
+//--- Build new route table
+  const uint32_t routeCount = inRoutes.count () ;
+  RouteEntry * routes = (routeCount > 0) ? new RouteEntry [routeCount] : nullptr ;
+  for (uint32_t i = 0 ; i < routeCount ; i++) {
+    routes [i].mRoute = inRoutes.routeAtIndex (i) ;
+    routes [i].mForwardedCount = 0 ;
+    routes [i].mOverflowCount = 0 ;
+    routes [i].mMaxLatency = 0 ;
   }
+//--- Install it
+  const uint32_t lockState = enterCriticalSection () ;
+    RouteEntry * previousRoutes = mRoutes ;
+    mRoutes = routes ;
+    mRouteCount = uint8_t (routeCount) ;
+  leaveCriticalSection (lockState) ;
+  delete [] previousRoutes ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::routeForwardedCount (const uint32_t inRouteIndex) const {
+  return (inRouteIndex < mRouteCount) ? mRoutes [inRouteIndex].mForwardedCount : 0 ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::routeOverflowCount (const uint32_t inRouteIndex) const {
+  return (inRouteIndex < mRouteCount) ? mRoutes [inRouteIndex].mOverflowCount : 0 ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32::routeMaxLatency (const uint32_t inRouteIndex) const {
+  return (inRouteIndex < mRouteCount) ? mRoutes [inRouteIndex].mMaxLatency : 0 ;
 }
 
 //------------------------------------------------------------------------------
 
-void ACAN_STM32::message_isr_tx (void) {
-  //interrupt acks when a message has been succesfully transmitted
-  //check if there is a message in the transmit buffer
-  if (mDriverTransmitFIFO.count () > 0) {
+void ACAN_STM32::resetRouteStatistics (void) {
+  const uint32_t lockState = enterCriticalSection () ;
+    for (uint32_t i = 0 ; i < mRouteCount ; i++) {
+      mRoutes [i].mForwardedCount = 0 ;
+      mRoutes [i].mOverflowCount = 0 ;
+      mRoutes [i].mMaxLatency = 0 ;
+    }
+  leaveCriticalSection (lockState) ;
+}
 
-    //check if there is a transmit mailbox available
-    if ((mCAN->TSR  & CAN_TSR_TME) != 0) {
-      //there is at least one empty Tx buffer.
-      //get one
-      const int bufferId = (mCAN->TSR & CAN_TSR_CODE) >> CAN_TSR_CODE_Pos ;
-      //and set the message.
-      CANMessage message ;
-      mDriverTransmitFIFO.remove (message) ;
-      writeTxRegisters (message, bufferId);
+//------------------------------------------------------------------------------
+// Called from receive ISR; returns true if the message should be stored in the
+// driver receive FIFO (no matching route, or route with mAlsoReceive).
+
+ACAN_STM32_FAST_CODE bool ACAN_STM32::routeReceivedMessage (const CANMessage & inMessage, const uint32_t inISREntryCycle) {
+  const tFrameFormat format = inMessage.ext ? kExtended : kStandard ;
+  for (uint32_t i = 0 ; i < mRouteCount ; i++) {
+    RouteEntry & entry = mRoutes [i] ;
+    if ((entry.mRoute.mFormat == format) && ((inMessage.id & entry.mRoute.mMask) == entry.mRoute.mBase)) {
+      CANMessage message = inMessage ;
+      message.id = entry.mRoute.mTranslatedBase | (inMessage.id & ~ entry.mRoute.mMask) ;
+      message.idx = entry.mRoute.mTransmitIndex ;
+    //--- Target ISRs may have a higher priority; a target restarted in polling mode
+    //    since the route was added has no critical section: the frame is dropped
+      ACAN_STM32 * target = entry.mRoute.mTarget ;
+      uint32_t sendStatus = kTransmitBufferOverflow ;
+      if (!target->mPollingMode) {
+        const uint32_t lockState = target->enterCriticalSection () ;
+          sendStatus = target->internalTryToSendReturnStatus (message) ;
+        target->leaveCriticalSection (lockState) ;
+      }
+      if (sendStatus == 0) {
+        entry.mForwardedCount += 1 ;
+        const uint32_t latency = DWT->CYCCNT - inISREntryCycle ;
+        if (entry.mMaxLatency < latency) {
+          entry.mMaxLatency = latency ;
+        }
+      }else{
+        entry.mOverflowCount += 1 ;
+      }
+      return entry.mRoute.mAlsoReceive ;
     }
   }
+  return true ;
+}
 
-//interrput handled: set bit TSR.RQCPx bits to reinitialize interrupts
-  mCAN->TSR |= CAN_TSR_RQCP0 ; //mailbox 0
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32::Routes::addRoute (const tFrameFormat inFormat,
+                                   const uint32_t inBase,
+                                   const uint32_t inMask,
+                                   ACAN_STM32 & inTarget,
+                                   const uint32_t inTranslatedBase,
+                                   const uint8_t inTransmitIndex,
+                                   const bool inAlsoReceive) {
+  const uint32_t identifierMax = (inFormat == kExtended) ? 0x1FFFFFFF : 0x7FF ;
+  const bool ok = (inBase <= identifierMax)
+               && (inMask <= identifierMax)
+               && ((inBase & inMask) == inBase)
+               && ((inTranslatedBase & inMask) == inTranslatedBase)
+               && inTarget.isValidTransmitIndex (inTransmitIndex)
+               && !inTarget.mPollingMode // Target critical section would not mask its ISRs
+               && (mRouteArray.count () < 128) ;
+  if (ok) {
+    Route route ;
+    route.mBase = inBase ;
+    route.mMask = inMask ;
+    route.mTranslatedBase = inTranslatedBase ;
+    route.mTarget = & inTarget ;
+    route.mFormat = inFormat ;
+    route.mTransmitIndex = inTransmitIndex ;
+    route.mAlsoReceive = inAlsoReceive ;
+    mRouteArray.append (route) ;
+  }
+  return ok ;
 }
 
 //------------------------------------------------------------------------------
@@ -527,7 +1660,7 @@ bool ACAN_STM32::Filters::addStandardMasks (const uint16_t inBase1,
                && (inBase2 <= 0x7FF)
                && (inMask2 <= 0x7FF)
                && ((inBase2 & inMask2) == inBase2)
-               && (n < 14) ;
+               && (n < MAX_FILTER_BANK_COUNT) ;
   if (ok) {
     switch (inAction) {
     case ACAN_STM32::FIFO0 :
@@ -606,7 +1739,7 @@ bool ACAN_STM32::Filters::addStandardQuad (const uint16_t inIdentifier1,
                && (inIdentifier2 <= 0x7FF)
                && (inIdentifier3 <= 0x7FF)
                && (inIdentifier4 <= 0x7FF)
-               && (n < 14) ;
+               && (n < MAX_FILTER_BANK_COUNT) ;
   if (ok) {
     mFM1R |= (1U << n) ; // Identifier list mode
     switch (inAction) {
@@ -664,7 +1797,7 @@ bool ACAN_STM32::Filters::addExtendedMask (const uint32_t inBase,
   const bool ok = (inBase <= EXTENDED_IDENTIFIER_MAX)
                && (inMask <= EXTENDED_IDENTIFIER_MAX)
                && ((inBase & inMask) == inBase)
-               && (n < 14) ;
+               && (n < MAX_FILTER_BANK_COUNT) ;
   if (ok) {
     mFS1R |= (1U << n) ; // Single 32-bit scale
     switch (inAction) {
@@ -719,7 +1852,7 @@ bool ACAN_STM32::Filters::addExtendedDual (const uint32_t inIdentifier1,
   const uint32_t n = mFR1Array.count () ;
   const bool ok = (inIdentifier1 <= EXTENDED_IDENTIFIER_MAX)
                && (inIdentifier2 <= EXTENDED_IDENTIFIER_MAX)
-               && (n < 14) ;
+               && (n < MAX_FILTER_BANK_COUNT) ;
   if (ok) {
     mFM1R |= (1U << n) ; // Identifier list mode
     mFS1R |= (1U << n) ; // Single 32-bit scale
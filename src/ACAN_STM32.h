@@ -4,8 +4,17 @@
 
 #include <ACAN_STM32_Settings.h>
 #include <ACAN_STM32_FIFO.h>
+#include <ACAN_STM32_Notifier.h>
+#include <ACAN_STM32_ReceiveObserver.h>
+#include <ACAN_STM32_BitRateDetector.h>
 #include <Arduino.h>
 
+//------------------------------------------------------------------------------
+// Type of a peripheral register, as declared by the device header (volatile
+// uint32_t); the RCC clock enable and reset registers are given by pointer.
+
+typedef decltype (CAN_TypeDef::MCR) ACAN_STM32_PeripheralRegister ;
+
 //------------------------------------------------------------------------------
 
 class ACAN_STM32 {
@@ -56,6 +65,12 @@ class ACAN_STM32 {
       }
     }
 
+    public: void swap (DynamicArray <T> & ioArray) {
+      const uint8_t capacity = mCapacity ; mCapacity = ioArray.mCapacity ; ioArray.mCapacity = capacity ;
+      const uint8_t count = mCount ; mCount = ioArray.mCount ; ioArray.mCount = count ;
+      T * array = mArray ; mArray = ioArray.mArray ; ioArray.mArray = array ;
+    }
+
     public: void copyTo (DynamicArray <T> & outArray) const {
       outArray.free () ;
       if (count () > 0) {
@@ -178,9 +193,9 @@ class ACAN_STM32 {
   //--- Private properties
     private: DynamicArray <uint32_t> mFR1Array ;
     private: DynamicArray <uint32_t> mFR2Array ;
-    private: uint16_t mFM1R = 0 ; // By default Mask mode
-    private: uint16_t mFS1R = 0 ; // By default, dual 16-bit scale
-    private: uint16_t mFFA1R = 0 ; // By default, filters assigned to FIFO 0
+    private: uint32_t mFM1R = 0 ; // By default Mask mode
+    private: uint32_t mFS1R = 0 ; // By default, dual 16-bit scale
+    private: uint32_t mFFA1R = 0 ; // By default, filters assigned to FIFO 0
     private: DynamicArray < ACANCallBackRoutine > mFIFO0CallBackArray ;
     private: DynamicArray < ACANCallBackRoutine > mFIFO1CallBackArray ;
 
@@ -190,22 +205,139 @@ class ACAN_STM32 {
   } ;
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  //    Routes (gateway)
+  //  A received frame that matches a route is forwarded from the receive ISR
+  //  to the target controller: it is written into a transmit mailbox, or in the
+  //  driver transmit FIFO (target message idx is inTransmitIndex). The matched
+  //  bits of the identifier are replaced by inTranslatedBase (pass inBase for no
+  //  translation). Routes are checked in order, the first matching one is used.
+  //  A forwarded frame is not stored in the receive FIFO, unless inAlsoReceive.
+  //  The target should be started before adding a route: addRoute returns false
+  //  if inTransmitIndex is not a valid message idx of the target (see transmit
+  //  classes), or if the target is in polling mode (the forward, from the
+  //  receive ISR, could not be serialized with its poll calls).
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  public: class Route {
+    public: uint32_t mBase ;
+    public: uint32_t mMask ;
+    public: uint32_t mTranslatedBase ;
+    public: ACAN_STM32 * mTarget ;
+    public: tFrameFormat mFormat ;
+    public: uint8_t mTransmitIndex ;
+    public: bool mAlsoReceive ;
+  } ;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  public: class Routes {
+  //--- Default constructor
+    public: Routes (void) { }
+
+  //--- Append route
+    public: bool addRoute (const tFrameFormat inFormat,
+                           const uint32_t inBase,
+                           const uint32_t inMask,
+                           ACAN_STM32 & inTarget,
+                           const uint32_t inTranslatedBase,
+                           const uint8_t inTransmitIndex = 0,
+                           const bool inAlsoReceive = false) ;
+
+  //--- Access
+    public: uint32_t count () const { return mRouteArray.count () ; }
+    public: Route routeAtIndex (const uint32_t inIndex) const { return mRouteArray [inIndex] ; }
+
+  //--- Private properties
+    private: DynamicArray <Route> mRouteArray ;
+
+  //--- No copy
+    private : Routes (const Routes &) = delete ;
+    private : Routes & operator = (const Routes &) = delete ;
+  } ;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  //    Transmit classes
+  //  By default, message idx 0 is sent through the driver transmit FIFO, that loads
+  //  any empty mailbox, and idx 1 and 2 are sent directly in mailbox 1 and 2.
+  //  With transmit classes (ACAN_STM32::setTransmitClasses), message idx is the
+  //  class index: every class has its own queue (class 0 uses the driver transmit
+  //  FIFO), and a mailbox mask (bit 0: mailbox 0, ...): a mailbox that belongs to a
+  //  single class is reserved for it, a mailbox in several masks is shared. When a
+  //  mailbox is empty, it is loaded from the eligible classes, either by strict
+  //  priority (class 0 first), or by weighted round robin (up to inWeight frames of
+  //  a class in a row).
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  public: static const uint32_t MAX_TRANSMIT_CLASS_COUNT = 8 ;
+
+  public: typedef enum { STRICT_PRIORITY, WEIGHTED_ROUND_ROBIN } TransmitArbitration ;
+
+  public: class TransmitClass {
+    public: uint16_t mFIFOSize ;
+    public: uint8_t mMailboxMask ;
+    public: uint8_t mWeight ;
+  } ;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  public: class TransmitClasses {
+  //--- Constructor
+    public: TransmitClasses (const TransmitArbitration inArbitration = STRICT_PRIORITY) ;
+
+  //--- Append class (index is the current count)
+    public: bool addClass (const uint16_t inFIFOSize,
+                           const uint8_t inMailboxMask,
+                           const uint8_t inWeight = 1) ;
+
+  //--- Access
+    public: uint32_t count () const { return mClassArray.count () ; }
+    public: TransmitClass classAtIndex (const uint32_t inIndex) const { return mClassArray [inIndex] ; }
+    public: TransmitArbitration arbitration (void) const { return mArbitration ; }
+
+  //--- Private properties
+    private: DynamicArray <TransmitClass> mClassArray ;
+    private: const TransmitArbitration mArbitration ;
+
+  //--- No copy
+    private : TransmitClasses (const TransmitClasses &) = delete ;
+    private : TransmitClasses & operator = (const TransmitClasses &) = delete ;
+  } ;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 //--- Constructor
-  public: ACAN_STM32 (volatile uint32_t * inClockEnableRegisterAddress,
+  public: ACAN_STM32 (ACAN_STM32_PeripheralRegister * inClockEnableRegisterAddress,
                       const uint8_t inClockEnableBitOffset,
-                      volatile uint32_t * inResetRegisterPointer,
+                      ACAN_STM32_PeripheralRegister * inResetRegisterPointer,
                       const uint8_t inResetBitOffset,
                       volatile CAN_TypeDef * inPeripheralModuleBasePointer,
                       const IRQn_Type in_TX_IRQ,
                       const IRQn_Type in_RX0_IRQn,
                       const IRQn_Type in_RX1_IRQn,
+                      const IRQn_Type in_SCE_IRQn,
                       GPIO_TypeDef * inTxPinGPIO,
                       const uint8_t inTxPinIndex,
                       const uint8_t inTxPinAlternateMode,
                       GPIO_TypeDef * inRxPinGPIO,
                       const uint8_t inRxPinIndex,
-                      const uint8_t inRxPinAlternateMode) ;
+                      const uint8_t inRxPinAlternateMode,
+                      volatile CAN_TypeDef * inFilterModuleBasePointer = nullptr,
+                      const uint8_t inFilterModuleBankCount = 14,
+                      const uint8_t inFilterModuleClockEnableBitOffset = NO_FILTER_MODULE_CLOCK) ;
+
+//--- Filter banks
+//  On single CAN devices, the 14 filter banks belong to the CAN module.
+//  On dual CAN devices, the 28 filter banks are located in CAN1 (the filter module):
+//  CAN1 uses banks 0 ... CAN2SB-1, CAN2 uses banks CAN2SB ... 27, CAN2SB being set
+//  from ACAN_STM32_Settings::mCAN2StartBank. For CAN2, inFilterModuleBasePointer
+//  is CAN1, and CAN1 should be started before CAN2 (starting CAN1 resets the
+//  filter module). CAN2 filter banks are only accessible when CAN1 clock is enabled:
+//  for CAN2, inFilterModuleClockEnableBitOffset is the CAN1 clock enable bit, in the
+//  same register as the CAN2 one; begin of CAN2 enables it. Both instances should be
+//  started with the same mCAN2StartBank: begin returns kInvalidCAN2StartBank if it
+//  differs from the one of the other instance, when it is started.
+  public: static const uint8_t NO_FILTER_MODULE_CLOCK = 0xFF ;
+  public: static const uint32_t MAX_FILTER_BANK_COUNT = 28 ;
 
 //--- begin; returns a result code:
 //  0 : Ok
@@ -213,23 +345,154 @@ class ACAN_STM32 {
 //  The error code are thoses returned by ACAN_STM32_Settings::CANBitSettingConsistency
 //  and the following one
   public: static const uint32_t kActualBitRateTooFarFromDesiredBitRate = 1 << 16 ;
+  public: static const uint32_t kTooManyFilters                        = 1 << 17 ;
+  public: static const uint32_t kInvalidCAN2StartBank                  = 1 << 18 ;
+  public: static const uint32_t kInvalidMessageIRQPriority             = 1 << 19 ;
 
   public: uint32_t begin (const ACAN_STM32_Settings & inSettings,
                           const ACAN_STM32::Filters & inFilters = ACAN_STM32::Filters ()) ;
 
-//--- end: stop CAN controller
+//--- Asynchronous begin: beginAsync checks the settings (returning the same error codes
+//  as begin), then resets the CAN peripheral and writes filters, without waiting. The
+//  initialization is completed by pollBegin, to be called repeatedly (for example from
+//  loop) until it returns BEGIN_DONE or BEGIN_FAILED. Every waiting step fails if it
+//  lasts more than inStepTimeoutMillis:
+//    BEGIN_WAITING_INIT_MODE: initialization mode acknowledge (kInitModeTimeout);
+//    BEGIN_WAITING_NORMAL_MODE: normal mode is entered after 11 consecutive recessive
+//      bits on CANRX, so it fails with no transceiver, or a bus held dominant
+//      (kNormalModeTimeout);
+//    BEGIN_WAITING_MAILBOX_EMPTY: transmit mailbox 0 empty (kTransmitMailboxTimeout).
+//  On failure, beginErrorCode returns the error; call end, or beginAsync again.
+  public: typedef enum {
+    BEGIN_IDLE,
+    BEGIN_WAITING_INIT_MODE,
+    BEGIN_WAITING_NORMAL_MODE,
+    BEGIN_WAITING_MAILBOX_EMPTY,
+    BEGIN_DONE,
+    BEGIN_FAILED
+  } BeginStep ;
+
+  public: static const uint32_t kInitModeTimeout         = 1 << 20 ;
+  public: static const uint32_t kNormalModeTimeout       = 1 << 21 ;
+  public: static const uint32_t kTransmitMailboxTimeout  = 1 << 22 ;
+
+  public: uint32_t beginAsync (const ACAN_STM32_Settings & inSettings,
+                               const ACAN_STM32::Filters & inFilters = ACAN_STM32::Filters (),
+                               const uint32_t inStepTimeoutMillis = 100) ;
+  public: BeginStep pollBegin (void) ;
+  public: inline BeginStep beginStep (void) const { return mBeginStep ; }
+  public: inline uint32_t beginErrorCode (void) const { return mBeginErrorCode ; }
+
+//--- Bit rate detection: for every candidate (in order, so most likely first), the
+//  controller is started in SILENT and polling modes (the bus is not disturbed), and
+//  listens at most inListenDurationMillis ms; see ACAN_STM32_BitRateDetector for the
+//  decision. Returns the first matching bit rate, or 0 (no match, or no bus activity).
+//  Worst-case duration is about inCandidateCount x inListenDurationMillis. The
+//  controller is stopped (end) on return: call begin with the detected bit rate.
+  public: uint32_t detectBitRate (const uint32_t inCandidates [] = ACAN_STM32_BitRateDetector::DEFAULT_CANDIDATES,
+                                  const uint32_t inCandidateCount = ACAN_STM32_BitRateDetector::DEFAULT_CANDIDATE_COUNT,
+                                  const uint32_t inListenDurationMillis = 250) ;
+
+//--- updateFilters: replaces the filters installed by begin, without resetting the
+//  CAN controller: only the filter module enters init mode (FMR.FINIT), only the
+//  banks that changed are written, and the call back arrays are replaced. Driver
+//  FIFOs and pending transmissions are unchanged. While FINIT is set (a few register
+//  writes, with CAN interrupts masked), reception is deactivated for the whole
+//  filter module. Frames received before the update (hardware FIFOs are drained
+//  first) carry filter indexes of the previous filters: the driver counts them, and
+//  dispatches them with the previous call back arrays. Returns 0, kTooManyFilters
+//  (also if begin has not been called), or kPreviousFiltersInUse (frames received
+//  before a previous update are still queued: receive or dispatch them first).
+  public: static const uint32_t kPreviousFiltersInUse = 1 << 24 ;
+  public: uint32_t updateFilters (const ACAN_STM32::Filters & inFilters) ;
+
+//--- end: stop CAN controller (pending transmissions are aborted, and initialization
+//  mode is requested: no frame, acknowledge or error frame is sent after the current
+//  frame), and free driver buffers
   public: void end (void) ;
 
 //--- Transmitting messages
   public: bool sendBufferNotFullForIndex (const uint32_t inBufferIndex) ;
+  public: bool isValidTransmitIndex (const uint32_t inBufferIndex) const ; // Accepted as message idx
   public: uint32_t tryToSendReturnStatus (const CANMessage & inMessage) ;
   public: static const uint32_t kTransmitBufferIndexTooLarge = 1 ;
   public: static const uint32_t kTransmitBufferOverflow      = 2 ;
 
+//--- Batch: inMessages are handed to the driver in order, in a single critical
+//    section (so its duration grows with inCount), the first one in a mailbox if
+//    possible; stops at the first message that is not accepted. Returns the number
+//    of accepted messages.
+  public: uint32_t tryToSendBatch (const CANMessage inMessages [], const uint32_t inCount) ;
+
   public: inline uint32_t driverTransmitFIFOSize (void) const { return mDriverTransmitFIFO.size () ; }
   public: inline uint32_t driverTransmitFIFOCount (void) const { return mDriverTransmitFIFO.count () ; }
   public: inline uint32_t driverTransmitFIFOPeakCount (void) const { return mDriverTransmitFIFO.peakCount () ; }
 
+//--- Transmit classes: call after begin, before sending. Frames queued in class 0 are
+//    kept (class 0 is the driver transmit FIFO, resized), frames queued in other classes
+//    of a previous configuration are discarded. Class FIFOs are carved from the driver
+//    FIFO pool. Returns 0, kInvalidTransmitClasses (no class, or class FIFOs do not fit
+//    in the transmit share of the pool), or kTransmitBufferOverflow (too many frames in
+//    driver transmit FIFO).
+  public: static const uint32_t kInvalidTransmitClasses = 1 << 23 ;
+  public: uint32_t setTransmitClasses (const ACAN_STM32::TransmitClasses & inClasses) ;
+  public: inline uint32_t transmitClassCount (void) const { return mTransmitClassCount ; }
+  public: uint32_t transmitClassFIFOCount (const uint32_t inClassIndex) ;
+
+  private: inline ACAN_STM32_FIFO & transmitClassFIFO (const uint32_t inClassIndex) {
+    return (inClassIndex == 0) ? mDriverTransmitFIFO : mExtraTransmitFIFOs [inClassIndex - 1] ;
+  }
+  private: uint32_t selectTransmitClass (const uint32_t inMailboxIndex, const uint32_t inEmptyMailboxes) ;
+//--- With identifier priority (TXFP clear), bxCAN sends pending frames of equal
+//    identifiers lowest mailbox first: a class only loads the empty mailboxes above
+//    its pending frames, so that the frames of a class are sent in queue order
+  private: inline uint32_t orderedMailboxes (const uint32_t inEmptyMailboxes, const uint32_t inTransmitClass) const {
+    uint32_t result = inEmptyMailboxes ;
+    if ((mMCR & CAN_MCR_TXFP) == 0) {
+      for (uint32_t idx = 0 ; idx < 3 ; idx++) {
+        if (((inEmptyMailboxes & (1U << idx)) == 0) && (mMailboxTransmitClass [idx] == inTransmitClass)) {
+          result &= ~ ((2U << idx) - 1) ;
+        }
+      }
+    }
+    return result ;
+  }
+  private: static const uint8_t NO_TRANSMIT_CLASS = 0xFF ; // Mailbox loaded by index
+  private: template <typename REGISTERS> void fillEmptyMailboxes (void) ;
+  private: ACAN_STM32_FIFO mExtraTransmitFIFOs [MAX_TRANSMIT_CLASS_COUNT - 1] ; // Classes 1 ...
+  private: uint8_t mTransmitClassMailboxMask [MAX_TRANSMIT_CLASS_COUNT] = {0x7} ;
+  private: uint8_t mTransmitClassWeight [MAX_TRANSMIT_CLASS_COUNT] = {1} ;
+  private: uint8_t mTransmitClassCount = 1 ;
+  private: uint8_t mMailboxTransmitClass [3] = {NO_TRANSMIT_CLASS, NO_TRANSMIT_CLASS, NO_TRANSMIT_CLASS} ;
+  private: bool mTransmitClassMode = false ;
+  private: TransmitArbitration mTransmitArbitration = STRICT_PRIORITY ;
+  private: uint8_t mRoundRobinClass = 0 ;
+  private: uint8_t mRoundRobinCredit = 1 ;
+
+//--- Blocking methods: they wait at most inTimeoutMillis ms. Waiting uses the installed
+//    notifiers (signalled by the receive and transmit ISRs), or yield () if none is
+//    installed, or in polling mode (poll is then called while waiting).
+//    send returns kTransmitBufferOverflow on timeout.
+  public: uint32_t send (const CANMessage & inMessage, const uint32_t inTimeoutMillis) ;
+  public: bool receive0 (CANMessage & outMessage, const uint32_t inTimeoutMillis) ;
+  public: bool receive1 (CANMessage & outMessage, const uint32_t inTimeoutMillis) ;
+
+//--- Notifiers (nullptr for none): the receive notifier is signalled when a frame has
+//    been stored in a driver receive FIFO, the transmit notifier when a transmit
+//    mailbox becomes empty. Install them before calling begin.
+  public: inline void setReceiveNotifier (ACAN_STM32_Notifier * inNotifier) { mReceiveNotifier = inNotifier ; }
+  public: inline void setTransmitNotifier (ACAN_STM32_Notifier * inNotifier) { mTransmitNotifier = inNotifier ; }
+  private: ACAN_STM32_Notifier * mReceiveNotifier = nullptr ;
+  private: ACAN_STM32_Notifier * mTransmitNotifier = nullptr ;
+  private: bool blockingReceive (const uint32_t inFIFOIndex,
+                                 CANMessage & outMessage,
+                                 const uint32_t inTimeoutMillis) ;
+  private: void waitForNotification (ACAN_STM32_Notifier * inNotifier, const uint32_t inTimeoutMillis) ;
+
+//--- Receive observer (nullptr for none), called for every received frame
+  public: inline void setReceiveObserver (ACAN_STM32_ReceiveObserver * inObserver) { mReceiveObserver = inObserver ; }
+  private: ACAN_STM32_ReceiveObserver * mReceiveObserver = nullptr ;
+
 //--- Receiving messages
   public: bool available0 (void) const ;
   public: bool receive0 (CANMessage & outMessage) ;
@@ -243,6 +506,14 @@ class ACAN_STM32 {
   private: DynamicArray < ACANCallBackRoutine > mFIFO0CallBackArray ;
   private: DynamicArray < ACANCallBackRoutine > mFIFO1CallBackArray ;
 
+//--- Call back arrays replaced by updateFilters, for the frames at the head of the
+//    driver receive FIFOs that were received before the update (their count)
+  private: DynamicArray < ACANCallBackRoutine > mPreviousFIFO0CallBackArray ;
+  private: DynamicArray < ACANCallBackRoutine > mPreviousFIFO1CallBackArray ;
+  private: uint16_t mPreviousFiltersMessageCount [2] = {0, 0} ;
+  private: bool internalReceive (const uint32_t inFIFOIndex, CANMessage & outMessage, bool & outPreviousFilters) ;
+  private: bool internalDispatchReceivedMessage (const uint32_t inFIFOIndex) ;
+
 //--- Driver receive Fifos
   private: ACAN_STM32_FIFO mDriverReceiveFIFO0 ;
   public: inline uint32_t driverReceiveFIFO0Size (void) const { return mDriverReceiveFIFO0.size () ; }
@@ -254,35 +525,274 @@ class ACAN_STM32 {
   public: inline uint32_t driverReceiveFIFO1Count (void) const { return mDriverReceiveFIFO1.count () ; }
   public: inline uint32_t driverReceiveFIFO1PeakCount (void) const { return mDriverReceiveFIFO1.peakCount () ; }
 
+//--- Driver FIFO pool: begin allocates a single pool (see
+//    ACAN_STM32_Settings::mDriverFIFOPoolSize), and end releases it. Every driver FIFO
+//    (transmit, transmit classes, receive 0 and 1) is a slice of it; resizing a FIFO
+//    lays them out again in the pool: no allocation occurs after begin. Transmit FIFOs
+//    also need transmit stamps, that are allocated for the transmit share of the pool
+//    only (the pool minus the receive FIFO sizes given to begin): transmit FIFOs cannot
+//    grow beyond it, receive FIFOs can use the whole pool.
+  public: inline uint32_t driverFIFOPoolSize (void) const { return mFIFOPoolSize ; }
+  public: uint32_t driverFIFOPoolFreeCount (void) const ; // Messages not used by a FIFO
+
+//--- Live resize of driver FIFOs: the CAN controller is not reinitialized, and queued
+//    messages are kept. The FIFOs are laid out again in the pool in a critical section,
+//    that moves the messages of the FIFOs after the resized one (at most the pool).
+//    Returns false if more than inSize messages are queued, if the pool is too small,
+//    or if inSize is greater than ACAN_STM32_FIFO::MAX_SIZE (FIFOs are then unchanged).
+  public: bool resizeDriverTransmitFIFO (const uint16_t inSize) ;
+  public: bool resizeDriverReceiveFIFO0 (const uint16_t inSize) ;
+  public: bool resizeDriverReceiveFIFO1 (const uint16_t inSize) ;
+
+//--- Autotuner, to be called periodically (for example every second) from loop: a FIFO
+//    that did overflow, or that has been full, since the previous call is doubled (or
+//    gets the free part of the pool); a FIFO whose peak count is lower than the quarter
+//    of its size is halved. Only the transmit FIFO and the receive FIFOs are tuned; a
+//    FIFO with size 0 is not changed. Peak counts are reset.
+  public: void autotuneDriverFIFOs (void) ;
+  private: bool resizeDriverFIFO (ACAN_STM32_FIFO & ioFIFO, const uint16_t inSize) ;
+  private: uint16_t peakCountAndReset (ACAN_STM32_FIFO & ioFIFO) ;
+
+//--- Pool order of driver FIFOs: transmit classes 0 ... (class 0 is the driver transmit
+//    FIFO), then receive FIFO 0 and 1
+  private: static const uint32_t DRIVER_FIFO_COUNT = MAX_TRANSMIT_CLASS_COUNT + 2 ;
+  private: ACAN_STM32_FIFO & driverFIFO (const uint32_t inIndex) ;
+  private: void allocateDriverFIFOPool (const ACAN_STM32_Settings & inSettings) ;
+  private: void releaseDriverFIFOPool (void) ;
+  private: bool layOutDriverFIFOs (const uint16_t inSizes [DRIVER_FIFO_COUNT]) ;
+  private: CANMessage * mFIFOPool = nullptr ;
+  private: ACAN_STM32_TransmitStamp * mFIFOStampPool = nullptr ; // Parallel to the transmit share of mFIFOPool
+  private: uint32_t mFIFOStampPoolSize = 0 ; // Transmit share: the pool minus the receive FIFO sizes given to begin
+  private: uint32_t mFIFOPoolSize = 0 ;
+  private: inline ACAN_STM32_TransmitStamp * stampBuffer (const uint32_t inIndex, const uint32_t inOffset) const {
+    return (inIndex < MAX_TRANSMIT_CLASS_COUNT) ? (mFIFOStampPool + inOffset) : nullptr ;
+  }
+
+//--- Driver FIFO watermarks (see ACANWatermarkCallBack): the call back is called with
+//    true when the FIFO count reaches inHighWatermark, with false when it falls back
+//    to inLowWatermark. nullptr call back removes watermarks.
+  public: void setDriverTransmitFIFOWatermarks (const uint16_t inHighWatermark,
+                                                const uint16_t inLowWatermark,
+                                                const ACANWatermarkCallBack inCallBack) ;
+  public: void setDriverReceiveFIFO0Watermarks (const uint16_t inHighWatermark,
+                                                const uint16_t inLowWatermark,
+                                                const ACANWatermarkCallBack inCallBack) ;
+  public: void setDriverReceiveFIFO1Watermarks (const uint16_t inHighWatermark,
+                                                const uint16_t inLowWatermark,
+                                                const ACANWatermarkCallBack inCallBack) ;
+
 //--- Driver transmit buffer
   private: ACAN_STM32_FIFO mDriverTransmitFIFO ;
-  private: void writeTxRegisters (const CANMessage & inMessage, const uint32_t inMBIndex) ;
+  private: template <typename REGISTERS> void writeTxRegisters (const CANMessage & inMessage, const uint32_t inMBIndex) ;
+  private: uint32_t internalTryToSendReturnStatus (const CANMessage & inMessage,
+                                                   const ACAN_STM32_TransmitStamp & inStamp = ACAN_STM32_TransmitStamp ()) ;
+
+//--- Deadlines: a frame sent with a lifetime (in µs, from the call) is dropped from the
+//    driver transmit FIFO if its deadline is over when it should be loaded into a
+//    mailbox, and aborted (ABRQx) if it is still pending in a mailbox after its
+//    deadline. Mailbox deadlines are checked by the transmit ISR, by poll, and by
+//    expireStaleFrames (call it periodically if the bus can stay blocked, so that no
+//    transmit interrupt occurs). Every miss calls the deadline miss call back with the
+//    dropped frame (so misses can be counted per identifier), and increments
+//    deadlineMissCount. For one-shot transmission, see
+//    ACAN_STM32_Settings::mNoAutomaticRetransmission.
+  public: uint32_t tryToSendReturnStatus (const CANMessage & inMessage, const uint32_t inLifetimeMicros) ;
+  public: void expireStaleFrames (void) ;
+  public: inline void setDeadlineMissCallBack (const ACANCallBackRoutine inCallBack) { mDeadlineMissCallBack = inCallBack ; }
+  public: inline uint32_t deadlineMissCount (void) const { return mDeadlineMissCount ; }
+
+  private: template <typename REGISTERS> void loadMailbox (const CANMessage & inMessage,
+                                                           const ACAN_STM32_TransmitStamp & inStamp,
+                                                           const uint32_t inMailboxIndex,
+                                                           const uint32_t inTransmitClass) ;
+  private: bool removeNextTransmitFrame (ACAN_STM32_FIFO & ioFIFO,
+                                        CANMessage & outMessage,
+                                        ACAN_STM32_TransmitStamp & outStamp) ;
+  private: template <typename REGISTERS> void checkMailboxDeadlines (void) ;
+  private: void deadlineMiss (const CANMessage & inMessage) ;
+  private: CANMessage readTxRegisters (const uint32_t inMailboxIndex) const ;
+  private: ACANCallBackRoutine mDeadlineMissCallBack = nullptr ;
+  private: volatile uint32_t mDeadlineMissCount = 0 ;
+  private: uint32_t mMailboxDeadline [3] = {0, 0, 0} ;
+
+//--- Transmit completion: the transmit complete call back is called from the transmit
+//    ISR (or poll) for every completed mailbox request, with the tag given by
+//    tryToSendWithTagReturnStatus (0 for other send methods), the status, and the
+//    duration from the send call to completion (µs). Without NART, a failed
+//    transmission is retried until success, so a completion is either TRANSMIT_OK or
+//    TRANSMIT_ABORTED (deadline, bus-off flush); with NART, the status gives the cause
+//    of the failure. A non zero inLifetimeMicros also sets a deadline (see above).
+  public: typedef enum {
+    TRANSMIT_OK,
+    TRANSMIT_ARBITRATION_LOST,
+    TRANSMIT_ERROR,
+    TRANSMIT_ABORTED
+  } TransmitStatus ;
+  public: typedef void (*TransmitCompleteCallBack) (const uint32_t inTag,
+                                                    const TransmitStatus inStatus,
+                                                    const uint32_t inLatencyMicros) ;
+  public: uint32_t tryToSendWithTagReturnStatus (const CANMessage & inMessage,
+                                                 const uint32_t inTag,
+                                                 const uint32_t inLifetimeMicros = 0) ;
+  public: inline void setTransmitCompleteCallBack (const TransmitCompleteCallBack inCallBack) {
+    mTransmitCompleteCallBack = inCallBack ;
+  }
+  private: template <typename REGISTERS> void handleTransmitCompletions (void) ;
+  private: TransmitCompleteCallBack mTransmitCompleteCallBack = nullptr ;
+  private: uint32_t mMailboxTag [3] = {0, 0, 0} ;
+  private: uint32_t mMailboxEnqueueDate [3] = {0, 0, 0} ;
+  private: uint8_t mMailboxDeadlineMask = 0 ;
+
+//--- Gateway: routes are installed (replacing previous ones) at any time; statistics
+//    are given for every route: forwarded frames, frames lost because target
+//    transmit buffer was full (or target was restarted in polling mode), maximum
+//    latency from receive ISR entry to target enqueue (in CPU cycles, measured by
+//    the DWT cycle counter).
+  public: void setRoutes (const ACAN_STM32::Routes & inRoutes) ;
+  public: inline uint32_t routeCount (void) const { return mRouteCount ; }
+  public: uint32_t routeForwardedCount (const uint32_t inRouteIndex) const ;
+  public: uint32_t routeOverflowCount (const uint32_t inRouteIndex) const ;
+  public: uint32_t routeMaxLatency (const uint32_t inRouteIndex) const ;
+  public: void resetRouteStatistics (void) ;
+
+  private: class RouteEntry {
+    public: Route mRoute ;
+    public: uint32_t mForwardedCount ;
+    public: uint32_t mOverflowCount ;
+    public: uint32_t mMaxLatency ;
+  } ;
+  private: RouteEntry * mRoutes = nullptr ;
+  private: uint8_t mRouteCount = 0 ;
+  private: bool routeReceivedMessage (const CANMessage & inMessage, const uint32_t inISREntryCycle) ;
 
-//--- Message interrupt service routines
+//--- Message interrupt service routines. The template versions get the register
+//    block from REGISTERS::registers (*this), a compile-time constant in the IRQ
+//    handlers of the board files; they are defined in ACAN_STM32_ISR.h.
   public: void message_isr_rx0 (void) ; // interrupt on FIFO 0
   public: void message_isr_rx1 (void) ; // interrupt on FIFO 1
   public: void message_isr_tx (void) ;  // interrupt on transmission
+  public: template <typename REGISTERS> void message_isr_rx0 (void) ;
+  public: template <typename REGISTERS> void message_isr_rx1 (void) ;
+  public: template <typename REGISTERS> void message_isr_tx (void) ;
+  private: class InstanceRegisters ; // Register block given to the constructor
+  private: template <typename REGISTERS> bool drainHardwareReceiveFIFO (const uint32_t inFIFOIndex,
+                                                                        ACAN_STM32_FIFO & ioDriverFIFO,
+                                                                        const uint32_t inEntryCycle) ;
+
+//--- Bus health: bus state is tracked from ESR error flags (TEC / REC thresholds), and
+//    every transition is reported by the bus state call back (called from error_isr,
+//    from message_isr_tx, or from busState / poll, with CAN interrupts masked).
+//    Entering error warning, error passive and bus-off raise the error interrupt;
+//    return to a less severe state is detected on next transmission, or busState call.
+//    Bus-off recovery follows ACAN_STM32_Settings::mBusOffRecovery:
+//      - MANUAL_BUS_OFF_RECOVERY: call recoverFromBusOff;
+//      - DELAYED_BUS_OFF_RECOVERY: call serviceBusOffRecovery periodically (from loop).
+//    Driver transmit FIFO is kept or flushed on bus-off (mFlushTransmitOnBusOff).
+  public: typedef enum {
+    BUS_ERROR_ACTIVE,
+    BUS_ERROR_WARNING,
+    BUS_ERROR_PASSIVE,
+    BUS_OFF
+  } BusState ;
+  public: typedef void (*BusStateCallBack) (const BusState inPreviousState, const BusState inNewState) ;
+
+  public: inline void setBusStateCallBack (const BusStateCallBack inCallBack) { mBusStateCallBack = inCallBack ; }
+  public: BusState busState (void) ;
+  public: inline uint32_t transmitErrorCounter (void) const { return (mCAN->ESR & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos ; }
+  public: inline uint32_t receiveErrorCounter (void) const { return (mCAN->ESR & CAN_ESR_REC) >> CAN_ESR_REC_Pos ; }
+  public: bool recoverFromBusOff (void) ; // Returns false if not bus-off
+  public: void serviceBusOffRecovery (void) ;
+  public: inline uint32_t busOffCount (void) const { return mBusOffCount ; }
+  public: uint32_t busOffDowntime (void) const ; // Cumulated bus-off duration (ms), current one included
+  public: inline uint32_t errorFrameCount (void) const { return mErrorFrameCount ; } // mLastErrorCodeInterrupt only
+  public: void error_isr (void) ; // interrupt on error and status change
+
+  private: void updateBusState (void) ;
+  private: BusStateCallBack mBusStateCallBack = nullptr ;
+  private: volatile BusState mBusState = BUS_ERROR_ACTIVE ;
+  private: ACAN_STM32_Settings::BusOffRecovery mBusOffRecovery = ACAN_STM32_Settings::AUTOMATIC_BUS_OFF_RECOVERY ;
+  private: uint32_t mBusOffRecoveryDelay = 0 ;
+  private: bool mFlushTransmitOnBusOff = false ;
+  private: volatile uint32_t mBusOffCount = 0 ;
+  private: uint32_t mBusOffStartDate = 0 ;
+  private: uint32_t mBusOffDowntime = 0 ;
+  private: volatile uint32_t mErrorFrameCount = 0 ;
+
+//--- Receive interrupt coalescing (ACAN_STM32_Settings::mReceiveInterruptCoalescing):
+//    the receive ISRs only run when a hardware FIFO is full (3 frames) or overruns.
+//    flushReceiveFIFOs moves the pending frames of both hardware FIFOs into the
+//    driver receive FIFOs; call it periodically (from a HardwareTimer callback, or
+//    from loop) to bound the reception latency of partial batches. For example:
+//      HardwareTimer timer (TIM2) ;
+//      timer.setOverflow (1000, MICROSEC_FORMAT) ;
+//      timer.attachInterrupt ([] () { can.flushReceiveFIFOs () ; }) ;
+//      timer.resume () ;
+//    The receive notifier is only signalled when flushReceiveFIFOs is called from an ISR.
+  public: void flushReceiveFIFOs (void) ;
+
+//--- Polling mode (ACAN_STM32_Settings::mPollingMode): CAN interrupts are not enabled,
+//    and no critical section is used by the driver. poll should be called periodically
+//    (for example once per cycle of a cyclic executive), it:
+//      - moves the pending frames of both hardware receive FIFOs into the driver
+//        receive FIFOs (at most 2 x 3 frames);
+//      - loads the empty transmit mailboxes from the driver transmit FIFO (at most
+//        3 frames).
+//    So its worst-case cost is bounded by 6 frame readings and 3 mailbox writings;
+//    LoopBackDemoPolling sketch measures it. poll does nothing if the driver is not
+//    in polling mode: the ISRs do this work, and poll would race them.
+  public: void poll (void) ;
+  private: bool mPollingMode = false ;
+
+//--- Critical sections: mask CAN interrupts (BASEPRI raised to message IRQ priority,
+//    or PRIMASK for priority 0), nothing in polling mode
+  private: uint8_t mBasePriority = 0 ;
+  private: uint32_t enterCriticalSection (void) const ;
+  private: void leaveCriticalSection (const uint32_t inState) const ;
 
 //--- Private properties
-  private: volatile uint32_t * mClockEnableRegisterPointer ;
-  private: volatile uint32_t * mResetRegisterPointer ;
-  private: volatile CAN_TypeDef * mCAN ;
-  private: GPIO_TypeDef * mTxPinGPIO ;
-  private: GPIO_TypeDef * mRxPinGPIO ;
+  private: ACAN_STM32_PeripheralRegister * const mClockEnableRegisterPointer ;
+  private: ACAN_STM32_PeripheralRegister * const mResetRegisterPointer ;
+  private: volatile CAN_TypeDef * const mCAN ;
+  private: volatile CAN_TypeDef * const mFilterCAN ;
+  private: GPIO_TypeDef * const mTxPinGPIO ;
+  private: GPIO_TypeDef * const mRxPinGPIO ;
   private: const uint8_t mClockEnableBitOffset ;
   private: const uint8_t mResetBitOffset ;
   private: const IRQn_Type m_TX_IRQn ;
   private: const IRQn_Type m_RX0_IRQn ;
   private: const IRQn_Type m_RX1_IRQn ;
+  private: const IRQn_Type m_SCE_IRQn ;
   private: const uint8_t mTxPinIndex ;
   private: const uint8_t mTxPinAlternateMode ;
   private: const uint8_t mRxPinIndex ;
   private: const uint8_t mRxPinAlternateMode ;
+  private: const uint8_t mFilterModuleBankCount ;
+  private: const uint8_t mFilterModuleClockEnableBitOffset ;
+  private: uint8_t mFirstFilterBank = 0 ; // Set by begin
+  private: uint8_t mFilterBankCount = 0 ; // Set by begin
+  private: uint8_t mMessageIRQPriority = 0 ; // Set by begin
+  private: uint32_t mBTR = 0 ; // Computed by begin
+  private: uint32_t mIER = 0 ; // Computed by begin
+  private: uint32_t mMCR = 0 ; // Computed by begin
+  private: BeginStep mBeginStep = BEGIN_IDLE ;
+  private: uint32_t mBeginErrorCode = 0 ;
+  private: uint32_t mBeginStepStartDate = 0 ;
+  private: uint32_t mBeginStepTimeout = 0 ;
 
 
 //--- Private methods
   private: uint32_t internalBegin (const ACAN_STM32_Settings & inSettings,
                                    const ACAN_STM32::Filters & inFilters) ;
+  private: uint32_t checkBeginSettings (const ACAN_STM32_Settings & inSettings,
+                                        const ACAN_STM32::Filters & inFilters) const ;
+  private: void startInitialization (const ACAN_STM32_Settings & inSettings,
+                                     const ACAN_STM32::Filters & inFilters) ;
+  private: void configureController (void) ;
+  private: void enableInterrupts (void) ;
+  private: void firstFilterBankAndCount (const ACAN_STM32_Settings & inSettings,
+                                         uint32_t & outFirstBank,
+                                         uint32_t & outBankCount) const ;
+  private: uint8_t dualCANInstanceMask (void) const ;
   private: void internalDispatchReceivedMessage (const CANMessage & inMessage,
                           const DynamicArray < ACANCallBackRoutine > & inCallBackArray) ;
 
@@ -308,4 +818,8 @@ class ACAN_STM32 {
   #error "This board has no CAN module"
 #endif
 
+#ifdef CAN2
+  extern ACAN_STM32 can2 ;
+#endif
+
 //------------------------------------------------------------------------------
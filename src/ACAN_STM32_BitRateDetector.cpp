@@ -0,0 +1,72 @@
+#include <ACAN_STM32_BitRateDetector.h>
+
+//------------------------------------------------------------------------------
+
+const uint32_t ACAN_STM32_BitRateDetector::DEFAULT_CANDIDATES [DEFAULT_CANDIDATE_COUNT] = {
+  500 * 1000,
+  250 * 1000,
+  125 * 1000,
+  1000 * 1000,
+  100 * 1000,
+  50 * 1000,
+  20 * 1000,
+  10 * 1000
+} ;
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_BitRateDetector::ACAN_STM32_BitRateDetector (const uint32_t inRequiredFrameCount,
+                                                        const uint32_t inErrorThreshold) :
+mRequiredFrameCount (inRequiredFrameCount),
+mErrorThreshold (inErrorThreshold),
+mReceivedFrameCount (0),
+mErrorCodeCount (0),
+mReceiveErrorCounterIncrement (0),
+mReceiveErrorCounter (0) {
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_BitRateDetector::reset (void) {
+  mReceivedFrameCount = 0 ;
+  mErrorCodeCount = 0 ;
+  mReceiveErrorCounterIncrement = 0 ;
+  mReceiveErrorCounter = 0 ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_BitRateDetector::addSample (const uint32_t inReceivedFrameCount,
+                                            const uint8_t inLastErrorCode,
+                                            const uint8_t inReceiveErrorCounter) {
+  mReceivedFrameCount += inReceivedFrameCount ;
+//--- Receive errors; acknowledge and bit errors can only be detected by a transmitter
+  switch (inLastErrorCode) {
+  case LEC_STUFF_ERROR :
+  case LEC_FORM_ERROR :
+  case LEC_CRC_ERROR :
+    mErrorCodeCount += 1 ;
+    break ;
+  default :
+    break ;
+  }
+//--- Receive error counter increments: catch several errors between two samples
+  if (inReceiveErrorCounter > mReceiveErrorCounter) {
+    mReceiveErrorCounterIncrement += inReceiveErrorCounter - mReceiveErrorCounter ;
+  }
+  mReceiveErrorCounter = inReceiveErrorCounter ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_BitRateDetector::Verdict ACAN_STM32_BitRateDetector::verdict (void) const {
+  Verdict result = UNDECIDED ;
+  if (mReceivedFrameCount >= mRequiredFrameCount) {
+    result = MATCH ;
+  }else if (errorCount () >= mErrorThreshold) {
+    result = MISMATCH ;
+  }
+  return result ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,68 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Bit rate detection decision logic
+//
+// ACAN_STM32::detectBitRate listens to the bus in SILENT mode (no acknowledge,
+// no error frame: the bus is not disturbed) at every candidate bit rate, and
+// feeds a detector with samples: frames received since the previous sample,
+// last error code (ESR.LEC) and receive error counter (ESR.REC).
+//   - a candidate matches when inRequiredFrameCount frames have been received
+//     (a frame is only received if its CRC is valid);
+//   - a candidate is rejected when inErrorThreshold receive errors (stuff,
+//     form, CRC errors, or receive error counter increments) have been seen,
+//     and not enough frames have been received;
+//   - otherwise (no bus activity), the verdict is undecided.
+//
+// This class does not access the CAN peripheral, so it can be tested on a
+// host with recorded samples.
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_BitRateDetector {
+
+  public: typedef enum { UNDECIDED, MATCH, MISMATCH } Verdict ;
+
+//--- ESR.LEC values
+  public: static const uint8_t LEC_NO_ERROR        = 0 ;
+  public: static const uint8_t LEC_STUFF_ERROR     = 1 ;
+  public: static const uint8_t LEC_FORM_ERROR      = 2 ;
+  public: static const uint8_t LEC_CRC_ERROR       = 6 ;
+  public: static const uint8_t LEC_SET_BY_SOFTWARE = 7 ;
+
+//--- Candidate bit rates, ordered by likelihood (most used first)
+  public: static const uint32_t DEFAULT_CANDIDATE_COUNT = 8 ;
+  public: static const uint32_t DEFAULT_CANDIDATES [DEFAULT_CANDIDATE_COUNT] ;
+
+//--- Constructor
+  public: ACAN_STM32_BitRateDetector (const uint32_t inRequiredFrameCount = 2,
+                                      const uint32_t inErrorThreshold = 2) ;
+
+//--- Start a new candidate
+  public: void reset (void) ;
+
+//--- Add a sample
+  public: void addSample (const uint32_t inReceivedFrameCount,
+                          const uint8_t inLastErrorCode,
+                          const uint8_t inReceiveErrorCounter) ;
+
+//--- Verdict
+  public: Verdict verdict (void) const ;
+  public: inline uint32_t receivedFrameCount (void) const { return mReceivedFrameCount ; }
+  public: inline uint32_t errorCount (void) const {
+    return (mErrorCodeCount > mReceiveErrorCounterIncrement) ? mErrorCodeCount : mReceiveErrorCounterIncrement ;
+  }
+
+//--- Private properties
+  private: const uint32_t mRequiredFrameCount ;
+  private: const uint32_t mErrorThreshold ;
+  private: uint32_t mReceivedFrameCount ;
+  private: uint32_t mErrorCodeCount ;
+  private: uint32_t mReceiveErrorCounterIncrement ;
+  private: uint8_t mReceiveErrorCounter ;
+} ;
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,89 @@
+#include <ACAN_STM32_CyclicScheduler.h>
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_CyclicScheduler::ACAN_STM32_CyclicScheduler (ACAN_STM32 & inDriver) :
+mDriver (inDriver),
+mWheel (),
+mFrameCount (0),
+mRegistrationRank (0),
+mMissedPeriodCount (0) {
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_CyclicScheduler::schedule (ACAN_STM32_CyclicFrame & ioFrame, const uint32_t inDate) {
+  ioFrame.mDueDate = inDate ;
+  mWheel.insert (ioFrame, inDate) ;
+}
+
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32_CyclicScheduler::add (ACAN_STM32_CyclicFrame & ioFrame,
+                                      const uint32_t inPeriod,
+                                      const uint32_t inPhase) {
+  const bool automaticPhase = inPhase == AUTOMATIC_PHASE ;
+  const bool ok = (inPeriod > 0) && (automaticPhase || (inPhase < inPeriod)) ;
+  if (ok) {
+    remove (ioFrame) ;
+    const uint32_t now = millis () ;
+    if (mWheel.count () == 0) {
+      mWheel.reset (now) ;
+    }
+    ioFrame.mPeriod = inPeriod ;
+    ioFrame.mPhase = automaticPhase ? (mRegistrationRank % inPeriod) : inPhase ;
+    ioFrame.mSentCount = 0 ;
+    ioFrame.mMissedPeriodCount = 0 ;
+  //--- First due date: next date equal to phase modulo period
+    uint32_t dueDate = now - (now % inPeriod) + ioFrame.mPhase ;
+    if (int32_t (dueDate - now) < 0) {
+      dueDate += inPeriod ;
+    }
+    schedule (ioFrame, dueDate) ;
+    mFrameCount += 1 ;
+    mRegistrationRank += 1 ;
+  }
+  return ok ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_CyclicScheduler::remove (ACAN_STM32_CyclicFrame & ioFrame) {
+  if (ioFrame.mPeriod > 0) {
+    mWheel.remove (ioFrame) ;
+    ioFrame.mPeriod = 0 ;
+    mFrameCount -= 1 ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_CyclicScheduler::service (void) {
+  const uint32_t now = millis () ;
+  ACAN_STM32_TimerNode * node = mWheel.advance (now) ;
+  while (node != nullptr) {
+    ACAN_STM32_CyclicFrame & frame = * static_cast <ACAN_STM32_CyclicFrame *> (node) ;
+    node = node->nextExpired () ;
+    if ((frame.mPeriod > 0) && !frame.isScheduled ()) { // A previous call back may have removed or added the frame
+    //--- Whole periods elapsed since due date are missed
+      const uint32_t latePeriods = (now - frame.mDueDate) / frame.mPeriod ;
+      uint32_t missed = latePeriods ;
+    //--- Update payload, and send
+      if (frame.mUpdateCallBack != nullptr) {
+        frame.mUpdateCallBack (frame) ;
+      }
+      if ((frame.mPeriod > 0) && !frame.isScheduled ()) { // Call back may have removed or added the frame
+        if (mDriver.tryToSendReturnStatus (frame.mMessage) == 0) {
+          frame.mSentCount += 1 ;
+        }else{
+          missed += 1 ;
+        }
+        frame.mMissedPeriodCount += missed ;
+        mMissedPeriodCount += missed ;
+        schedule (frame, frame.mDueDate + (latePeriods + 1) * frame.mPeriod) ;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,119 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Cyclic transmit scheduler
+//
+// Periodic frames are registered once, with a period and a phase (both in
+// milliseconds), and are sent by ACAN_STM32_CyclicScheduler::service, that
+// should be called from loop () (or from a periodic task): due dates are kept
+// in a timer wheel, with a 1 ms tick, so the cost of service is O(1) per
+// elapsed millisecond, plus the cost of the frames that are due.
+//
+// Phases spread the frames with the same period over time, instead of sending
+// them in bursts: for example, 10 frames with a 10 ms period and phases
+// 0, 1, ..., 9 ms load the bus with one frame per millisecond.
+// With AUTOMATIC_PHASE, the phase of a frame is its registration rank,
+// modulo its period.
+//
+// Payloads are updated in place: the frame message (mMessage) is the shared
+// buffer, sent as it is at every period; an optional call back is invoked just
+// before sending, for refreshing it. Frames are enqueued with
+// ACAN_STM32::tryToSendReturnStatus, so message idx selects the mailbox, or
+// the transmit class (ACAN_STM32::setTransmitClasses).
+//
+// A period is missed when the frame cannot be enqueued (driver transmit queue
+// full), or when service has not been called for a whole period: the frame is
+// then sent once, and its next due date is realigned on its phase.
+//
+// Frames are owned by the caller (no allocation), and should remain valid
+// while they are registered. The scheduler is not protected against concurrent
+// access: register frames, update mMessage and call service from the same
+// execution context.
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <ACAN_STM32_TimerWheel.h>
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_CyclicFrame ;
+
+//------------------------------------------------------------------------------
+// Update call back: called by service just before ioFrame.mMessage is sent
+
+typedef void (*ACANCyclicFrameCallBack) (ACAN_STM32_CyclicFrame & ioFrame) ;
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_CyclicFrame : public ACAN_STM32_TimerNode {
+
+//--- Constructor
+  public: ACAN_STM32_CyclicFrame (void) { }
+
+//--- Frame sent at every period
+  public: CANMessage mMessage ;
+
+//--- Optional payload update call back, and user data
+  public: ACANCyclicFrameCallBack mUpdateCallBack = nullptr ;
+  public: void * mUserData = nullptr ;
+
+//--- Statistics
+  public: inline uint32_t period (void) const { return mPeriod ; }
+  public: inline uint32_t phase (void) const { return mPhase ; }
+  public: inline uint32_t sentCount (void) const { return mSentCount ; }
+  public: inline uint32_t missedPeriodCount (void) const { return mMissedPeriodCount ; }
+
+//--- Private properties, handled by ACAN_STM32_CyclicScheduler
+  private: uint32_t mDueDate = 0 ; // In ms
+  private: uint32_t mPeriod = 0 ; // In ms
+  private: uint32_t mPhase = 0 ; // In ms
+  private: uint32_t mSentCount = 0 ;
+  private: uint32_t mMissedPeriodCount = 0 ;
+
+  friend class ACAN_STM32_CyclicScheduler ;
+} ;
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_CyclicScheduler {
+
+  public: static const uint32_t AUTOMATIC_PHASE = UINT32_MAX ;
+
+//--- Constructor
+  public: ACAN_STM32_CyclicScheduler (ACAN_STM32 & inDriver) ;
+
+//--- Register ioFrame (its statistics are reset); returns false if inPeriod is 0,
+//    or if inPhase is not lower than inPeriod. Registering a frame again changes
+//    its period and phase. The first transmission occurs at the next date
+//    equal to inPhase modulo inPeriod.
+  public: bool add (ACAN_STM32_CyclicFrame & ioFrame,
+                    const uint32_t inPeriod,
+                    const uint32_t inPhase = AUTOMATIC_PHASE) ;
+
+//--- Unregister ioFrame
+  public: void remove (ACAN_STM32_CyclicFrame & ioFrame) ;
+
+//--- Send due frames; should be called at least once per millisecond for an
+//    accurate timing.
+  public: void service (void) ;
+
+//--- Statistics
+  public: inline uint32_t frameCount (void) const { return mFrameCount ; }
+  public: inline uint32_t missedPeriodCount (void) const { return mMissedPeriodCount ; }
+
+//--- Private methods
+  private: void schedule (ACAN_STM32_CyclicFrame & ioFrame, const uint32_t inDate) ;
+
+//--- Private properties
+  private: ACAN_STM32 & mDriver ;
+  private: ACAN_STM32_TimerWheel mWheel ;
+  private: uint32_t mFrameCount ;
+  private: uint32_t mRegistrationRank ;
+  private: uint32_t mMissedPeriodCount ;
+
+//--- No copy
+  private : ACAN_STM32_CyclicScheduler (const ACAN_STM32_CyclicScheduler &) = delete ;
+  private : ACAN_STM32_CyclicScheduler & operator = (const ACAN_STM32_CyclicScheduler &) = delete ;
+} ;
+
+//------------------------------------------------------------------------------
@@ -1,4 +1,4 @@
-#include <ACAN_STM32.h>
+#include <ACAN_STM32_ISR.h>
 
 //------------------------------------------------------------------------------
 //  STM32F303
@@ -19,32 +19,53 @@ ACAN_STM32 can (
   CAN_TX_IRQn,  // Transmit interrupt
   CAN_RX0_IRQn, // RX0 receive interrupt
   CAN_RX1_IRQn, // RX1 receive interrupt
+  CAN_SCE_IRQn, // Status change and error interrupt
   GPIOA, 12, 9, // Tx Pin, AF9
   GPIOA, 11, 9  // Rx Pin, AF9
 ) ;
 
+//------------------------------------------------------------------------------
+//  Register blocks as compile-time constants for the message ISRs
+//  (see ACAN_STM32_ISR.h)
+//------------------------------------------------------------------------------
+
+namespace {
+
+class CANRegisters {
+  public: static inline volatile CAN_TypeDef * registers (const ACAN_STM32 &) { return CAN ; }
+} ;
+
+}
+
 //------------------------------------------------------------------------------
 
 extern "C" void CAN_RX0_IRQHandler (void) ;
 extern "C" void CAN_RX1_IRQHandler (void) ;
 extern "C" void CAN_TX_IRQHandler (void) ;
+extern "C" void CAN_SCE_IRQHandler (void) ;
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void CAN_RX0_IRQHandler (void) {
+  can.message_isr_rx0 <CANRegisters> () ;
+}
 
 //------------------------------------------------------------------------------
 
-void CAN_RX0_IRQHandler (void) {
-  can.message_isr_rx0 () ;
+ACAN_STM32_FAST_CODE void CAN_RX1_IRQHandler (void){
+  can.message_isr_rx1 <CANRegisters> () ;
 }
 
 //------------------------------------------------------------------------------
 
-void CAN_RX1_IRQHandler (void){
-  can.message_isr_rx1 () ;
+ACAN_STM32_FAST_CODE void CAN_TX_IRQHandler (void){
+  can.message_isr_tx <CANRegisters> () ;
 }
 
 //------------------------------------------------------------------------------
 
-void CAN_TX_IRQHandler (void){
-  can.message_isr_tx () ;
+void CAN_SCE_IRQHandler (void) {
+  can.error_isr () ;
 }
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,160 @@
+#include <ACAN_STM32_ISR.h>
+
+//------------------------------------------------------------------------------
+//  STM32F446
+//    CAN1_RX : PA11
+//    CAN1_TX : PA12
+//    CAN2_RX : PB12
+//    CAN2_TX : PB13
+//  CAN1 and CAN2 share 28 filter banks, located in CAN1: the split is given by
+//  ACAN_STM32_Settings::mCAN2StartBank, that should be the same for both. CAN2
+//  filter banks are only accessible when CAN1 clock is enabled (can2.begin enables
+//  it), and starting CAN1 resets them: call can.begin before can2.begin.
+//------------------------------------------------------------------------------
+
+#ifdef STM32F446xx
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32 can (
+  & (RCC->APB1ENR), // Enable CAN Clock Register address
+  RCC_APB1ENR_CAN1EN_Pos, // Enable CAN Clock bit offset in Enable CAN Clock Register
+  & (RCC->APB1RSTR), // Reset CAN peripheral Register address
+  RCC_APB1RSTR_CAN1RST_Pos, // Reset CAN Clock bit offset in Reset CAN peripheral Register
+  CAN1, // CAN Peripheral base address
+  CAN1_TX_IRQn,  // Transmit interrupt
+  CAN1_RX0_IRQn, // RX0 receive interrupt
+  CAN1_RX1_IRQn, // RX1 receive interrupt
+  CAN1_SCE_IRQn, // Status change and error interrupt
+  GPIOA, 12, 9, // Tx Pin, AF9
+  GPIOA, 11, 9, // Rx Pin, AF9
+  CAN1, // Filter module
+  28    // Filter bank count of filter module
+) ;
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32 can2 (
+  & (RCC->APB1ENR), // Enable CAN Clock Register address
+  RCC_APB1ENR_CAN2EN_Pos, // Enable CAN Clock bit offset in Enable CAN Clock Register
+  & (RCC->APB1RSTR), // Reset CAN peripheral Register address
+  RCC_APB1RSTR_CAN2RST_Pos, // Reset CAN Clock bit offset in Reset CAN peripheral Register
+  CAN2, // CAN Peripheral base address
+  CAN2_TX_IRQn,  // Transmit interrupt
+  CAN2_RX0_IRQn, // RX0 receive interrupt
+  CAN2_RX1_IRQn, // RX1 receive interrupt
+  CAN2_SCE_IRQn, // Status change and error interrupt
+  GPIOB, 13, 9, // Tx Pin, AF9
+  GPIOB, 12, 9, // Rx Pin, AF9
+  CAN1, // Filter module
+  28,   // Filter bank count of filter module
+  RCC_APB1ENR_CAN1EN_Pos // Filter module (CAN1) clock enable bit offset
+) ;
+
+//------------------------------------------------------------------------------
+//  Register blocks as compile-time constants for the message ISRs
+//  (see ACAN_STM32_ISR.h)
+//------------------------------------------------------------------------------
+
+namespace {
+
+class CAN1Registers {
+  public: static inline volatile CAN_TypeDef * registers (const ACAN_STM32 &) { return CAN1 ; }
+} ;
+
+class CAN2Registers {
+  public: static inline volatile CAN_TypeDef * registers (const ACAN_STM32 &) { return CAN2 ; }
+} ;
+
+}
+
+//------------------------------------------------------------------------------
+
+extern "C" void CAN1_RX0_IRQHandler (void) ;
+extern "C" void CAN1_RX1_IRQHandler (void) ;
+extern "C" void CAN1_TX_IRQHandler (void) ;
+extern "C" void CAN1_SCE_IRQHandler (void) ;
+extern "C" void CAN2_RX0_IRQHandler (void) ;
+extern "C" void CAN2_RX1_IRQHandler (void) ;
+extern "C" void CAN2_TX_IRQHandler (void) ;
+extern "C" void CAN2_SCE_IRQHandler (void) ;
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void CAN1_RX0_IRQHandler (void) {
+  can.message_isr_rx0 <CAN1Registers> () ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void CAN1_RX1_IRQHandler (void) {
+  can.message_isr_rx1 <CAN1Registers> () ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void CAN1_TX_IRQHandler (void) {
+  can.message_isr_tx <CAN1Registers> () ;
+}
+
+//------------------------------------------------------------------------------
+
+void CAN1_SCE_IRQHandler (void) {
+  can.error_isr () ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void CAN2_RX0_IRQHandler (void) {
+  can2.message_isr_rx0 <CAN2Registers> () ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void CAN2_RX1_IRQHandler (void) {
+  can2.message_isr_rx1 <CAN2Registers> () ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void CAN2_TX_IRQHandler (void) {
+  can2.message_isr_tx <CAN2Registers> () ;
+}
+
+//------------------------------------------------------------------------------
+
+void CAN2_SCE_IRQHandler (void) {
+  can2.error_isr () ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::configureTxPin (const bool inOpenCollector) {
+  const uint32_t txPinMask = 1U << mTxPinIndex ;
+  LL_GPIO_SetPinMode  (mTxPinGPIO, txPinMask, LL_GPIO_MODE_ALTERNATE) ;
+  LL_GPIO_SetPinOutputType (mTxPinGPIO, txPinMask, inOpenCollector ? LL_GPIO_OUTPUT_OPENDRAIN : LL_GPIO_OUTPUT_PUSHPULL) ;
+  LL_GPIO_SetPinSpeed (mTxPinGPIO, txPinMask, LL_GPIO_SPEED_FREQ_HIGH) ;
+  if (mTxPinIndex < 8) {
+    LL_GPIO_SetAFPin_0_7 (mTxPinGPIO, txPinMask, mTxPinAlternateMode) ;
+  }else{
+    LL_GPIO_SetAFPin_8_15 (mTxPinGPIO, txPinMask, mTxPinAlternateMode) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32::configureRxPin (void) {
+  const uint32_t rxPinMask = 1U << mRxPinIndex ;
+  LL_GPIO_SetPinMode  (mRxPinGPIO, rxPinMask, LL_GPIO_MODE_ALTERNATE) ;
+  if (mRxPinIndex < 8) {
+    LL_GPIO_SetAFPin_0_7 (mRxPinGPIO, rxPinMask, mRxPinAlternateMode) ;
+  }else{
+    LL_GPIO_SetAFPin_8_15 (mRxPinGPIO, rxPinMask, mRxPinAlternateMode) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+#endif
+
+//------------------------------------------------------------------------------
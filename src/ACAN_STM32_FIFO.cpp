@@ -8,10 +8,16 @@
 
 ACAN_STM32_FIFO::ACAN_STM32_FIFO (void) :
 mBuffer (nullptr),
+mStampBuffer (nullptr),
 mSize (0),
 mReadIndex (0),
 mCount (0),
-mPeakCount (0) {
+mPeakCount (0),
+mHighWatermark (UINT16_MAX),
+mLowWatermark (0),
+mAboveHighWatermark (false),
+mWatermarkCallBack (nullptr),
+mOwnsBuffer (false) {
 }
 
 //------------------------------------------------------------------------------
@@ -19,7 +25,7 @@ mPeakCount (0) {
 //------------------------------------------------------------------------------
 
 ACAN_STM32_FIFO:: ~ ACAN_STM32_FIFO (void) {
-  delete [] mBuffer ;
+  releaseOwnedBuffer () ;
 }
 
 //------------------------------------------------------------------------------
@@ -27,19 +33,44 @@ ACAN_STM32_FIFO:: ~ ACAN_STM32_FIFO (void) {
 //------------------------------------------------------------------------------
 
 void ACAN_STM32_FIFO::initWithSize (const uint16_t inSize) {
-  delete [] mBuffer ;
-  mBuffer = new CANMessage [inSize] ;
-  mSize = inSize ;
-  mReadIndex = 0 ;
-  mCount = 0 ;
-  mPeakCount = 0 ;
+  releaseOwnedBuffer () ;
+  mSize = (inSize > MAX_SIZE) ? MAX_SIZE : inSize ;
+  mBuffer = new CANMessage [mSize] ;
+  mStampBuffer = nullptr ;
+  mOwnsBuffer = true ;
+  clear () ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_FIFO::releaseOwnedBuffer (void) {
+  if (mOwnsBuffer) {
+    delete [] mBuffer ;
+    mBuffer = nullptr ;
+    mOwnsBuffer = false ;
+  }
+}
+
+//------------------------------------------------------------------------------
+// initWithBuffer
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_FIFO::initWithBuffer (CANMessage * inBuffer,
+                                      ACAN_STM32_TransmitStamp * inStampBuffer,
+                                      const uint16_t inSize) {
+  releaseOwnedBuffer () ;
+  mBuffer = inBuffer ;
+  mStampBuffer = inStampBuffer ;
+  mSize = (inSize > MAX_SIZE) ? MAX_SIZE : inSize ;
+  clear () ;
 }
 
 //------------------------------------------------------------------------------
 // append
 //------------------------------------------------------------------------------
 
-bool ACAN_STM32_FIFO::append (const CANMessage & inMessage) {
+ACAN_STM32_FAST_CODE bool ACAN_STM32_FIFO::append (const CANMessage & inMessage,
+                                                    const ACAN_STM32_TransmitStamp & inStamp) {
   const bool ok = mCount < mSize ;
   if (ok) {
     uint16_t writeIndex = mReadIndex + mCount ;
@@ -47,10 +78,21 @@ bool ACAN_STM32_FIFO::append (const CANMessage & inMessage) {
       writeIndex -= mSize ;
     }
     mBuffer [writeIndex] = inMessage ;
+    if (mStampBuffer != nullptr) {
+      mStampBuffer [writeIndex] = inStamp ;
+    }
     mCount += 1 ;
     if (mPeakCount < mCount) {
       mPeakCount = mCount ;
     }
+    if ((mCount >= mHighWatermark) && !mAboveHighWatermark) {
+      mAboveHighWatermark = true ;
+      if (mWatermarkCallBack != nullptr) {
+        mWatermarkCallBack (true) ;
+      }
+    }
+  }else{
+    mPeakCount = mSize + 1 ; // Overflow
   }
   return ok ;
 }
@@ -59,29 +101,127 @@ bool ACAN_STM32_FIFO::append (const CANMessage & inMessage) {
 // Remove
 //------------------------------------------------------------------------------
 
-bool ACAN_STM32_FIFO::remove (CANMessage & outMessage) {
+ACAN_STM32_FAST_CODE bool ACAN_STM32_FIFO::remove (CANMessage & outMessage,
+                                                    ACAN_STM32_TransmitStamp & outStamp) {
   const bool ok = mCount > 0 ;
   if (ok) {
     outMessage = mBuffer [mReadIndex] ;
+    if (mStampBuffer != nullptr) {
+      outStamp = mStampBuffer [mReadIndex] ;
+    }
     mCount -= 1 ;
     mReadIndex += 1 ;
     if (mReadIndex == mSize) {
       mReadIndex = 0 ;
     }
+    if ((mCount <= mLowWatermark) && mAboveHighWatermark) {
+      mAboveHighWatermark = false ;
+      if (mWatermarkCallBack != nullptr) {
+        mWatermarkCallBack (false) ;
+      }
+    }
   }
   return ok ;
 }
 
 //------------------------------------------------------------------------------
-// Free
+// Linearize: rotation by mReadIndex, by three reversals
 //------------------------------------------------------------------------------
 
-void ACAN_STM32_FIFO::free (void) {
-  delete [] mBuffer ; mBuffer = nullptr ;
-  mSize = 0 ;
+void ACAN_STM32_FIFO::linearize (void) {
+  if (mReadIndex != 0) {
+    reverse (0, mReadIndex) ;
+    reverse (mReadIndex, mSize) ;
+    reverse (0, mSize) ;
+    mReadIndex = 0 ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_FIFO::reverse (const uint16_t inFirst, const uint16_t inEnd) {
+  uint16_t low = inFirst ;
+  uint16_t high = inEnd ;
+  while ((high - low) > 1) {
+    high -= 1 ;
+    const CANMessage message = mBuffer [low] ;
+    mBuffer [low] = mBuffer [high] ;
+    mBuffer [high] = message ;
+    if (mStampBuffer != nullptr) {
+      const ACAN_STM32_TransmitStamp stamp = mStampBuffer [low] ;
+      mStampBuffer [low] = mStampBuffer [high] ;
+      mStampBuffer [high] = stamp ;
+    }
+    low += 1 ;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Move buffer (the FIFO is linearized)
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_FIFO::moveBuffer (CANMessage * inBuffer,
+                                  ACAN_STM32_TransmitStamp * inStampBuffer,
+                                  const uint16_t inSize) {
+  ACAN_STM32_TransmitStamp * stampBuffer = (mStampBuffer != nullptr) ? inStampBuffer : nullptr ;
+  if (inBuffer > mBuffer) { // Upward: from the last message
+    for (uint16_t i = mCount ; i > 0 ; i--) {
+      inBuffer [i - 1] = mBuffer [i - 1] ;
+      if (stampBuffer != nullptr) {
+        stampBuffer [i - 1] = mStampBuffer [i - 1] ;
+      }
+    }
+  }else if (inBuffer < mBuffer) { // Downward: from the first message
+    for (uint16_t i = 0 ; i < mCount ; i++) {
+      inBuffer [i] = mBuffer [i] ;
+      if (stampBuffer != nullptr) {
+        stampBuffer [i] = mStampBuffer [i] ;
+      }
+    }
+  }
+  if (inBuffer != mBuffer) {
+    releaseOwnedBuffer () ;
+  }
+  mBuffer = inBuffer ;
+  mStampBuffer = stampBuffer ;
+  mSize = inSize ;
+  mPeakCount = mCount ;
+}
+
+//------------------------------------------------------------------------------
+// Clear
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_FIFO::clear (void) {
   mReadIndex = 0 ;
   mCount = 0 ;
   mPeakCount = 0 ;
+  mAboveHighWatermark = false ;
+}
+
+//------------------------------------------------------------------------------
+// Free
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_FIFO::free (void) {
+  releaseOwnedBuffer () ;
+  mBuffer = nullptr ;
+  mStampBuffer = nullptr ;
+  mSize = 0 ;
+  clear () ;
+}
+
+//------------------------------------------------------------------------------
+// Watermarks
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_FIFO::setWatermarks (const uint16_t inHighWatermark,
+                                     const uint16_t inLowWatermark,
+                                     const ACANWatermarkCallBack inCallBack) {
+  mWatermarkCallBack = inCallBack ;
+  mHighWatermark = (inCallBack == nullptr) ? UINT16_MAX : inHighWatermark ;
+  mLowWatermark = inLowWatermark ;
+  mAboveHighWatermark = false ;
 }
 
 //------------------------------------------------------------------------------
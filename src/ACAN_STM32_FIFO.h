@@ -6,6 +6,43 @@
 
 #include <ACAN_STM32_CANMessage.h>
 
+//------------------------------------------------------------------------------
+// Interrupt fast path in RAM (opt-in)
+//   Define ACAN_STM32_RAM_ISR (for example in the build_opt.h file of the
+//   sketch) for running the receive / transmit interrupt service routines,
+//   the driver FIFO append / remove routines and the dispatch routines from
+//   RAM, without flash wait states. The .RamFunc section is copied to RAM at
+//   startup by the STM32 core linker scripts.
+//------------------------------------------------------------------------------
+
+#ifdef ACAN_STM32_RAM_ISR
+  #define ACAN_STM32_FAST_CODE __attribute__ ((section (".RamFunc"), noinline))
+#else
+  #define ACAN_STM32_FAST_CODE
+#endif
+
+//------------------------------------------------------------------------------
+// Watermark call back: called with true when the FIFO count reaches the high
+// watermark, with false when it falls back to the low watermark (hysteresis:
+// a notification is raised only once per crossing). It is called from append
+// and remove, that is from an ISR or from a driver method, in both cases with
+// CAN interrupts masked: it should be short, and should not call the driver.
+//------------------------------------------------------------------------------
+
+typedef void (*ACANWatermarkCallBack) (const bool inAboveHighWatermark) ;
+
+//------------------------------------------------------------------------------
+// Transmit stamp: per frame attributes of the driver transmit FIFO, stored in a
+// parallel buffer (CANMessage is common to several libraries, and is unchanged).
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_TransmitStamp {
+  public: uint32_t mDeadline = 0 ; // micros () date
+  public: uint32_t mTag = 0 ; // User tag, given back on transmit completion
+  public: uint32_t mEnqueueDate = 0 ; // micros () date
+  public: bool mHasDeadline = false ;
+} ;
+
 //------------------------------------------------------------------------------
 
 class ACAN_STM32_FIFO {
@@ -27,45 +64,111 @@ class ACAN_STM32_FIFO {
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
   private: CANMessage * mBuffer ;
+  private: ACAN_STM32_TransmitStamp * mStampBuffer ; // nullptr if no stamp
   private: uint16_t mSize ;
   private: uint16_t mReadIndex ;
   private: uint16_t mCount ;
-  private: uint16_t mPeakCount ; // > mSize if overflow did occur
+  private: uint16_t mPeakCount ; // > mSize if overflow did occur (mSize + 1)
+  private: uint16_t mHighWatermark ; // UINT16_MAX if no watermark
+  private: uint16_t mLowWatermark ;
+  private: bool mAboveHighWatermark ;
+  private: ACANWatermarkCallBack mWatermarkCallBack ;
+  private: bool mOwnsBuffer ; // true if allocated by initWithSize
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // Accessors
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+  public: inline const CANMessage * buffer (void) const { return mBuffer ; }
   public: inline uint16_t size (void) const { return mSize ; }
   public: inline uint16_t count (void) const { return mCount ; }
   public: inline bool isEmpty (void) const { return mCount == 0 ; }
   public: inline bool isFull (void) const { return mCount == mSize ; }
   public: inline uint16_t peakCount (void) const { return mPeakCount ; }
+  public: inline bool isAboveHighWatermark (void) const { return mAboveHighWatermark ; }
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // initWithBuffer: the FIFO uses inBuffer (inSize messages), and inStampBuffer
+  // (inSize stamps, or nullptr for no stamp); it does not own them (driver FIFOs
+  // are carved from the driver FIFO pool). The FIFO is empty.
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  // Sizes are capped at MAX_SIZE, so that an overflow can always be recorded in
+  // the peak count (mSize + 1).
+
+  public: static const uint16_t MAX_SIZE = UINT16_MAX - 1 ;
+
+  public: void initWithBuffer (CANMessage * inBuffer,
+                               ACAN_STM32_TransmitStamp * inStampBuffer,
+                               const uint16_t inSize) ;
+  public: inline bool hasStamps (void) const { return mStampBuffer != nullptr ; }
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-  // initWithSize
+  // initWithSize: the FIFO allocates and owns a buffer of inSize messages, without
+  // stamps; it is released by the destructor, free, initWithBuffer, initWithSize,
+  // and moveBuffer to another buffer. The FIFO is empty.
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
   public: void initWithSize (const uint16_t inSize) ;
+  private: void releaseOwnedBuffer (void) ;
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // append
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-  public: bool append (const CANMessage & inMessage) ;
+  public: inline bool append (const CANMessage & inMessage) {
+    return append (inMessage, ACAN_STM32_TransmitStamp ()) ;
+  }
+
+  public: bool append (const CANMessage & inMessage, const ACAN_STM32_TransmitStamp & inStamp) ;
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // Remove
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-  public: bool remove (CANMessage & outMessage) ;
+  public: inline bool remove (CANMessage & outMessage) {
+    ACAN_STM32_TransmitStamp stamp ;
+    return remove (outMessage, stamp) ;
+  }
+
+  public: bool remove (CANMessage & outMessage, ACAN_STM32_TransmitStamp & outStamp) ;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // Live resize, in two steps:
+  //   - linearize rotates the buffer in place, so that the queued messages are at
+  //     its beginning, in order;
+  //   - moveBuffer then moves them to inBuffer / inStampBuffer (inSize messages,
+  //     not lower than count), that can overlap the current buffer: messages are
+  //     copied upward from the last one, and downward from the first one. The stamp
+  //     buffer is only used if hasStamps. Peak count is reset.
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  public: void linearize (void) ;
+
+  public: void moveBuffer (CANMessage * inBuffer,
+                           ACAN_STM32_TransmitStamp * inStampBuffer,
+                           const uint16_t inSize) ;
+
+  private: void reverse (const uint16_t inFirst, const uint16_t inEnd) ;
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-  // Free
+  // Clear: queued messages are discarded; free: the buffers are detached (an owned
+  // buffer is released)
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+  public: void clear (void) ;
+
   public: void free (void) ;
 
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  // Watermarks (kept by initWithBuffer, clear and free); inCallBack == nullptr removes them.
+  // inLowWatermark should be lower than inHighWatermark.
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  public: void setWatermarks (const uint16_t inHighWatermark,
+                              const uint16_t inLowWatermark,
+                              const ACANWatermarkCallBack inCallBack) ;
+
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
   // Reset Peak Count
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -0,0 +1,60 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// FreeRTOS notifier for blocking receive and send methods
+//   This header is not included by ACAN_STM32.h: include it in a sketch that
+//   uses the STM32FreeRTOS library.
+//   FreeRTOS API can only be called from ISRs whose priority is lower than (or
+//   equal to) configMAX_SYSCALL_INTERRUPT_PRIORITY: set
+//   ACAN_STM32_Settings::mMessageIRQPriority accordingly (for example 6 or more
+//   with the STM32FreeRTOS default configuration).
+//
+//   static ACAN_STM32_FreeRTOSNotifier gReceiveNotifier ;
+//   ...
+//   gReceiveNotifier.begin () ;
+//   can.setReceiveNotifier (& gReceiveNotifier) ;
+//   ...
+//   if (can.receive0 (message, 100)) { ... } // Waits at most 100 ms
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32_Notifier.h>
+#include <STM32FreeRTOS.h>
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_FreeRTOSNotifier : public ACAN_STM32_Notifier {
+
+  public: ACAN_STM32_FreeRTOSNotifier (void) { }
+
+  public: ~ ACAN_STM32_FreeRTOSNotifier (void) {
+    if (mSemaphore != nullptr) {
+      vSemaphoreDelete (mSemaphore) ;
+    }
+  }
+
+//--- Should be called before the notifier is installed
+  public: bool begin (void) {
+    if (mSemaphore == nullptr) {
+      mSemaphore = xSemaphoreCreateBinary () ;
+    }
+    return mSemaphore != nullptr ;
+  }
+
+  public: virtual void notifyFromISR (void) override {
+    BaseType_t higherPriorityTaskWoken = pdFALSE ;
+    xSemaphoreGiveFromISR (mSemaphore, & higherPriorityTaskWoken) ;
+    portYIELD_FROM_ISR (higherPriorityTaskWoken) ;
+  }
+
+  public: virtual void wait (const uint32_t inTimeoutMillis) override {
+    xSemaphoreTake (mSemaphore, pdMS_TO_TICKS (inTimeoutMillis)) ;
+  }
+
+  private: SemaphoreHandle_t mSemaphore = nullptr ;
+
+//--- No copy
+  private : ACAN_STM32_FreeRTOSNotifier (const ACAN_STM32_FreeRTOSNotifier &) = delete ;
+  private : ACAN_STM32_FreeRTOSNotifier & operator = (const ACAN_STM32_FreeRTOSNotifier &) = delete ;
+} ;
+
+//------------------------------------------------------------------------------
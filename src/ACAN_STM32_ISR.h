@@ -0,0 +1,261 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Receive and transmit paths of the message interrupt service routines
+//
+// They are templates on the access to the register block of the CAN module:
+// REGISTERS::registers (driver) returns it. ACAN_STM32::InstanceRegisters
+// returns the pointer given to the constructor (mCAN): it is used by poll,
+// flushReceiveFIFOs, the send methods and message_isr_rx0 / rx1 / tx.
+//
+// The IRQ handlers of the board files instantiate them with a class that
+// returns the device header constant (CAN1, CAN2 or CAN):
+//
+//   class CAN1Registers {
+//     public: static inline volatile CAN_TypeDef * registers (const ACAN_STM32 &) { return CAN1 ; }
+//   } ;
+//
+//   void CAN1_RX0_IRQHandler (void) {
+//     can.message_isr_rx0 <CAN1Registers> () ;
+//   }
+//
+// so register addresses are absolute (no load of mCAN, offsets folded), and
+// the ISR bodies can be inlined in the IRQ handlers. The register block
+// returned should be the one given to the constructor of the driver.
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+
+//------------------------------------------------------------------------------
+//   REGISTERS OF THE INSTANCE
+//------------------------------------------------------------------------------
+
+class ACAN_STM32::InstanceRegisters {
+  public: static inline volatile CAN_TypeDef * registers (const ACAN_STM32 & inDriver) {
+    return inDriver.mCAN ;
+  }
+} ;
+
+//------------------------------------------------------------------------------
+//   TRANSMIT
+//------------------------------------------------------------------------------
+
+static inline bool isExpired (const uint32_t inDeadline) {
+  return int32_t (micros () - inDeadline) >= 0 ;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename REGISTERS>
+ACAN_STM32_FAST_CODE void ACAN_STM32::writeTxRegisters (const CANMessage & inMessage, const uint32_t inBufferIndex) {
+  volatile CAN_TxMailBox_TypeDef & mailbox = REGISTERS::registers (*this)->sTxMailBox [inBufferIndex] ;
+//--- Write length
+  mailbox.TDTR = inMessage.len & 0xF ;
+
+//---  Write data
+  mailbox.TDLR = inMessage.data32 [0] ;
+  mailbox.TDHR = inMessage.data32 [1] ;
+
+//--- Write rtr, ext, identifier, and set TXRQ to request the transmission
+//    (a single TIR write, instead of a write and a read-modify-write)
+  const uint32_t tir = (inMessage.rtr << 1) | (inMessage.ext << 2) | 1 ;
+  if (inMessage.ext) {
+    mailbox.TIR = tir | (inMessage.id << 3) ;
+  }else{
+    mailbox.TIR = tir | (inMessage.id << 21) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename REGISTERS>
+ACAN_STM32_FAST_CODE void ACAN_STM32::loadMailbox (const CANMessage & inMessage,
+                                                   const ACAN_STM32_TransmitStamp & inStamp,
+                                                   const uint32_t inMailboxIndex,
+                                                   const uint32_t inTransmitClass) {
+  writeTxRegisters <REGISTERS> (inMessage, inMailboxIndex) ;
+  mMailboxTransmitClass [inMailboxIndex] = uint8_t (inTransmitClass) ;
+  mMailboxTag [inMailboxIndex] = inStamp.mTag ;
+  mMailboxEnqueueDate [inMailboxIndex] = inStamp.mEnqueueDate ;
+  if (inStamp.mHasDeadline) {
+    mMailboxDeadline [inMailboxIndex] = inStamp.mDeadline ;
+    mMailboxDeadlineMask |= uint8_t (1U << inMailboxIndex) ;
+  }else{
+    mMailboxDeadlineMask &= uint8_t (~ (1U << inMailboxIndex)) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Aborts pending mailboxes whose deadline is expired. An abort request does not
+// stop a transmission in progress, that may still succeed.
+
+template <typename REGISTERS>
+ACAN_STM32_FAST_CODE void ACAN_STM32::checkMailboxDeadlines (void) {
+  if (mMailboxDeadlineMask != 0) {
+    volatile CAN_TypeDef * const peripheral = REGISTERS::registers (*this) ;
+    const uint32_t tsr = peripheral->TSR ;
+    for (uint32_t idx = 0 ; idx < 3 ; idx++) {
+      const uint8_t bit = uint8_t (1U << idx) ;
+      if ((mMailboxDeadlineMask & bit) == 0) {
+      }else if ((tsr & (CAN_TSR_TME0 << idx)) != 0) { // Sent, or aborted
+        mMailboxDeadlineMask &= uint8_t (~ bit) ;
+      }else if (isExpired (mMailboxDeadline [idx])) {
+        peripheral->TSR = CAN_TSR_ABRQ0 << (8 * idx) ; // ABRQ1, ABRQ2 follow ABRQ0
+        mMailboxDeadlineMask &= uint8_t (~ bit) ;
+        deadlineMiss (readTxRegisters (idx)) ;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Acknowledges completed mailboxes (writing RQCPx also clears TXOKx, ALSTx, TERRx;
+// it should be done before loading a mailbox, that also clears them), and reports
+// their completion. RQCP0, RQCP1 and RQCP2 are 8 bits apart, as are their status bits.
+
+template <typename REGISTERS>
+ACAN_STM32_FAST_CODE void ACAN_STM32::handleTransmitCompletions (void) {
+  volatile CAN_TypeDef * const peripheral = REGISTERS::registers (*this) ;
+  const uint32_t tsr = peripheral->TSR ;
+  const uint32_t completed = tsr & (CAN_TSR_RQCP0 | CAN_TSR_RQCP1 | CAN_TSR_RQCP2) ;
+  peripheral->TSR = completed ;
+  if ((completed != 0) && (mTransmitCompleteCallBack != nullptr)) {
+    const uint32_t now = micros () ;
+    for (uint32_t idx = 0 ; idx < 3 ; idx++) {
+      const uint32_t mailboxStatus = tsr >> (8 * idx) ;
+      if ((mailboxStatus & CAN_TSR_RQCP0) != 0) {
+        TransmitStatus status = TRANSMIT_ABORTED ;
+        if ((mailboxStatus & CAN_TSR_TXOK0) != 0) {
+          status = TRANSMIT_OK ;
+        }else if ((mailboxStatus & CAN_TSR_ALST0) != 0) {
+          status = TRANSMIT_ARBITRATION_LOST ;
+        }else if ((mailboxStatus & CAN_TSR_TERR0) != 0) {
+          status = TRANSMIT_ERROR ;
+        }
+        mTransmitCompleteCallBack (mMailboxTag [idx], status, now - mMailboxEnqueueDate [idx]) ;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Loads every empty mailbox from the transmit queues (at most 3 frames); mailboxes
+// are loaded in increasing order, so frames of a class loaded by a single call
+// keep their queue order
+
+template <typename REGISTERS>
+ACAN_STM32_FAST_CODE void ACAN_STM32::fillEmptyMailboxes (void) {
+  const uint32_t emptyMailboxes = (REGISTERS::registers (*this)->TSR & CAN_TSR_TME) >> CAN_TSR_TME0_Pos ;
+  for (uint32_t idx = 0 ; idx < 3 ; idx++) {
+    if ((emptyMailboxes & (1U << idx)) != 0) {
+      bool loaded = false ;
+      uint32_t c = selectTransmitClass (idx, emptyMailboxes) ;
+      while (!loaded && (c < mTransmitClassCount)) {
+        CANMessage message ;
+        ACAN_STM32_TransmitStamp stamp ;
+        loaded = removeNextTransmitFrame (transmitClassFIFO (c), message, stamp) ;
+        if (loaded) {
+          loadMailbox <REGISTERS> (message, stamp, idx, c) ;
+        }else{ // Every frame of the class was expired, try another one
+          c = selectTransmitClass (idx, emptyMailboxes) ;
+        }
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+//   RECEIVE
+//------------------------------------------------------------------------------
+
+// Every pending message of the hardware FIFO is read (up to 3), so a single
+// ISR entry handles a whole batch. RF0R and RF1R have the same layout.
+// Returns true if at least one message has been stored in the driver FIFO.
+
+template <typename REGISTERS>
+ACAN_STM32_FAST_CODE bool ACAN_STM32::drainHardwareReceiveFIFO (const uint32_t inFIFOIndex,
+                                                                ACAN_STM32_FIFO & ioDriverFIFO,
+                                                                const uint32_t inEntryCycle) {
+  volatile CAN_TypeDef * const peripheral = REGISTERS::registers (*this) ;
+  auto & rfr = (& peripheral->RF0R) [inFIFOIndex] ;
+  volatile CAN_FIFOMailBox_TypeDef & mailbox = peripheral->sFIFOMailBox [inFIFOIndex] ;
+  bool stored = false ;
+  while ((rfr & CAN_RF0R_FMP0) != 0) { // Message pending
+    CANMessage message ;
+    const uint32_t rir  = mailbox.RIR ;
+    const uint32_t rdtr = mailbox.RDTR ;
+  //-- Get rtr, ext, len, identifier
+    message.rtr = ((rir >> 1) & 0x1) != 0 ;
+    message.ext = ((rir >> 2) & 0x1) != 0 ;
+    message.len = rdtr & 0x0F ;
+    if (message.ext) { // extended message
+      message.id = (rir >> 3) & 0x1FFFFFFF ;
+    }else{ //standard message
+      message.id = (rir >> 21) & 0x7FF ;
+    }
+  //-- Get data
+    message.data32 [0] = mailbox.RDLR ;
+    message.data32 [1] = mailbox.RDHR ;
+  //-- Get filter index
+    message.idx = (rdtr >> 8) & 0xFF ;
+  //-- Observe, forward and / or store the message
+    if (mReceiveObserver != nullptr) {
+      mReceiveObserver->messageReceived (message) ;
+    }
+    if ((mRouteCount == 0) || routeReceivedMessage (message, inEntryCycle)) {
+      stored |= ioDriverFIFO.append (message) ;
+    }
+  //-- Release the output mailbox, and wait until it is done (RFOM is reset by hardware)
+    rfr = CAN_RF0R_RFOM0 ;
+    while ((rfr & CAN_RF0R_RFOM0) != 0) {}
+  }
+//--- Acknowledge FIFO full and FIFO overrun (these bits are cleared by writing 1)
+  rfr = CAN_RF0R_FULL0 | CAN_RF0R_FOVR0 ;
+  return stored ;
+}
+
+//------------------------------------------------------------------------------
+//   MESSAGE INTERRUPT SERVICE ROUTINES
+//------------------------------------------------------------------------------
+
+template <typename REGISTERS>
+ACAN_STM32_FAST_CODE void ACAN_STM32::message_isr_rx0 (void) {
+  const uint32_t entryCycle = (mRouteCount > 0) ? DWT->CYCCNT : 0 ;
+  const bool stored = drainHardwareReceiveFIFO <REGISTERS> (0, mDriverReceiveFIFO0, entryCycle) ;
+  if (stored && (mReceiveNotifier != nullptr)) {
+    mReceiveNotifier->notifyFromISR () ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename REGISTERS>
+ACAN_STM32_FAST_CODE void ACAN_STM32::message_isr_rx1 (void) {
+  const uint32_t entryCycle = (mRouteCount > 0) ? DWT->CYCCNT : 0 ;
+  const bool stored = drainHardwareReceiveFIFO <REGISTERS> (1, mDriverReceiveFIFO1, entryCycle) ;
+  if (stored && (mReceiveNotifier != nullptr)) {
+    mReceiveNotifier->notifyFromISR () ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename REGISTERS>
+ACAN_STM32_FAST_CODE void ACAN_STM32::message_isr_tx (void) {
+  //interrupt acks when a message has been succesfully transmitted
+  handleTransmitCompletions <REGISTERS> () ;
+  //check if there is a message in the transmit buffer
+  checkMailboxDeadlines <REGISTERS> () ;
+  fillEmptyMailboxes <REGISTERS> () ;
+
+//--- Return to error active is not signaled by an interrupt
+  if (mBusState != BUS_ERROR_ACTIVE) {
+    updateBusState () ;
+  }
+//--- A mailbox or a driver transmit FIFO entry has been freed
+  if (mTransmitNotifier != nullptr) {
+    mTransmitNotifier->notifyFromISR () ;
+  }
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,514 @@
+#include <ACAN_STM32_IsoTp.h>
+
+//------------------------------------------------------------------------------
+// Protocol control information (high nibble of first payload byte)
+//------------------------------------------------------------------------------
+
+static const uint8_t PCI_SINGLE_FRAME      = 0x0 ;
+static const uint8_t PCI_FIRST_FRAME       = 0x1 ;
+static const uint8_t PCI_CONSECUTIVE_FRAME = 0x2 ;
+static const uint8_t PCI_FLOW_CONTROL      = 0x3 ;
+
+static const uint8_t FLOW_STATUS_CONTINUE_TO_SEND = 0 ;
+static const uint8_t FLOW_STATUS_WAIT             = 1 ;
+static const uint8_t FLOW_STATUS_OVERFLOW         = 2 ;
+
+static const uint32_t SINGLE_FRAME_MAX_LENGTH = 7 ;
+static const uint32_t FIRST_FRAME_DATA_LENGTH = 6 ;
+static const uint32_t CONSECUTIVE_FRAME_DATA_LENGTH = 7 ;
+
+//------------------------------------------------------------------------------
+// STmin: 0x00 ... 0x7F -> 0 ... 127 ms, 0xF1 ... 0xF9 -> 100 ... 900 us,
+// reserved values are handled as 127 ms
+
+static uint32_t separationTimeMicros (const uint8_t inSeparationTime) {
+  uint32_t result = 127000 ;
+  if (inSeparationTime <= 0x7F) {
+    result = uint32_t (inSeparationTime) * 1000 ;
+  }else if ((inSeparationTime >= 0xF1) && (inSeparationTime <= 0xF9)) {
+    result = uint32_t (inSeparationTime - 0xF0) * 100 ;
+  }
+  return result ;
+}
+
+//------------------------------------------------------------------------------
+//   CHANNEL
+//------------------------------------------------------------------------------
+
+ACAN_STM32_IsoTpChannel::ACAN_STM32_IsoTpChannel (const uint32_t inTransmitIdentifier,
+                                                  const uint32_t inReceiveIdentifier,
+                                                  const tFrameFormat inFormat) :
+mTransmitIdentifier (inTransmitIdentifier),
+mReceiveIdentifier (inReceiveIdentifier),
+mExtended (inFormat == kExtended) {
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_IsoTpChannel::setReceiveBuffer (uint8_t * inBuffer, const uint16_t inSize) {
+  mReceiveBuffer = inBuffer ;
+  mReceiveBufferSize = (inBuffer == nullptr) ? 0 : inSize ;
+}
+
+//------------------------------------------------------------------------------
+//   TRANSPORT LAYER
+//------------------------------------------------------------------------------
+
+ACAN_STM32_IsoTp::ACAN_STM32_IsoTp (ACAN_STM32 & inDriver) :
+mDriver (inDriver),
+mFirstChannel (nullptr),
+mChannelSerialNumber (0) {
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_IsoTp::addChannel (ACAN_STM32_IsoTpChannel & ioChannel) {
+  bool found = false ;
+  ACAN_STM32_IsoTpChannel * p = mFirstChannel ;
+  while ((p != nullptr) && !found) {
+    found = p == & ioChannel ;
+    p = p->mNextChannel ;
+  }
+  if (!found) {
+    ioChannel.mTransmitTag = TAG_BASE + mChannelSerialNumber ;
+    mChannelSerialNumber += 1 ;
+    ioChannel.mNextChannel = mFirstChannel ;
+    mFirstChannel = & ioChannel ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_IsoTp::removeChannel (ACAN_STM32_IsoTpChannel & ioChannel) {
+  ACAN_STM32_IsoTpChannel ** pp = & mFirstChannel ;
+  while ((* pp != nullptr) && (* pp != & ioChannel)) {
+    pp = & (* pp)->mNextChannel ;
+  }
+  if (* pp != nullptr) {
+  //--- mNextChannel is kept: transmitComplete may be walking the list (transmit ISR)
+    * pp = ioChannel.mNextChannel ;
+  //--- Transfers in progress are dropped, without call back
+    ioChannel.mTransmitState = ACAN_STM32_IsoTpChannel::TRANSMIT_IDLE ;
+    ioChannel.mTransmitBuffer = nullptr ;
+    ioChannel.mTransmitFrameInFlight = false ;
+    ioChannel.mReceiveState = ACAN_STM32_IsoTpChannel::RECEIVE_IDLE ;
+    ioChannel.mFlowControlPending = false ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32_IsoTp::send (ACAN_STM32_IsoTpChannel & ioChannel,
+                             const uint8_t * inBuffer,
+                             const uint16_t inLength) {
+  const bool ok = !ioChannel.transmitInProgress ()
+    && (inBuffer != nullptr)
+    && (inLength > 0)
+    && (inLength <= MAX_MESSAGE_LENGTH)
+    && mDriver.isValidTransmitIndex (ioChannel.mTransmitIdx) ;
+  if (ok) {
+    ioChannel.mTransmitBuffer = inBuffer ;
+    ioChannel.mTransmitLength = inLength ;
+    ioChannel.mTransmitIndex = 0 ;
+    ioChannel.mTransmitFrameInFlight = false ;
+    ioChannel.mTransmitDeadline = millis () + ioChannel.mTransmitTimeout ;
+    ioChannel.mTransmitState = ACAN_STM32_IsoTpChannel::TRANSMIT_SINGLE_OR_FIRST_FRAME ;
+    serviceTransmission (ioChannel) ;
+  }
+  return ok ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_IsoTp::buildFrame (const ACAN_STM32_IsoTpChannel & inChannel,
+                                   const uint8_t inHeader [],
+                                   const uint32_t inHeaderLength,
+                                   const uint8_t * inData,
+                                   const uint32_t inDataLength,
+                                   CANMessage & outFrame) const {
+  outFrame.id = inChannel.mTransmitIdentifier ;
+  outFrame.ext = inChannel.mExtended ;
+  outFrame.rtr = false ;
+  outFrame.idx = inChannel.mTransmitIdx ;
+  uint32_t length = 0 ;
+  for (uint32_t i = 0 ; i < inHeaderLength ; i++) {
+    outFrame.data [length] = inHeader [i] ;
+    length += 1 ;
+  }
+  for (uint32_t i = 0 ; i < inDataLength ; i++) {
+    outFrame.data [length] = inData [i] ;
+    length += 1 ;
+  }
+  if (inChannel.mPadding) {
+    while (length < 8) {
+      outFrame.data [length] = inChannel.mPaddingByte ;
+      length += 1 ;
+    }
+  }
+  outFrame.len = uint8_t (length) ;
+}
+
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32_IsoTp::sendFrame (ACAN_STM32_IsoTpChannel & ioChannel,
+                                  const uint8_t inHeader [],
+                                  const uint32_t inHeaderLength,
+                                  const uint8_t * inData,
+                                  const uint32_t inDataLength) {
+  CANMessage frame ;
+  buildFrame (ioChannel, inHeader, inHeaderLength, inData, inDataLength, frame) ;
+  return mDriver.tryToSendReturnStatus (frame) == 0 ;
+}
+
+//------------------------------------------------------------------------------
+// In flight before the send call: completion can occur before it returns
+
+bool ACAN_STM32_IsoTp::sendTrackedFrame (ACAN_STM32_IsoTpChannel & ioChannel, const CANMessage & inFrame) {
+  ioChannel.mTransmitFrameInFlight = true ;
+  const bool sent = mDriver.tryToSendWithTagReturnStatus (inFrame, ioChannel.mTransmitTag) == 0 ;
+  ioChannel.mTransmitFrameInFlight = sent && ioChannel.mTransmitFrameInFlight ;
+  return sent ;
+}
+
+//------------------------------------------------------------------------------
+// Builds the next consecutive frames (at most inMaxFrameCount and BATCH_SIZE), and
+// hands them to the driver: one tracked frame, or a batch. Returns the number of
+// frames accepted by the driver; the transmit index is not changed.
+
+uint32_t ACAN_STM32_IsoTp::sendConsecutiveFrames (ACAN_STM32_IsoTpChannel & ioChannel,
+                                                  const uint32_t inMaxFrameCount,
+                                                  const bool inTracked) {
+  CANMessage frames [BATCH_SIZE] ;
+  uint32_t frameCount = 0 ;
+  uint32_t index = ioChannel.mTransmitIndex ;
+  uint8_t sequenceNumber = ioChannel.mTransmitSequenceNumber ;
+  while ((frameCount < inMaxFrameCount) && (frameCount < BATCH_SIZE) && (index < ioChannel.mTransmitLength)) {
+    const uint32_t remaining = ioChannel.mTransmitLength - index ;
+    const uint32_t length = (remaining < CONSECUTIVE_FRAME_DATA_LENGTH) ? remaining : CONSECUTIVE_FRAME_DATA_LENGTH ;
+    const uint8_t header [1] = {uint8_t ((PCI_CONSECUTIVE_FRAME << 4) | sequenceNumber)} ;
+    buildFrame (ioChannel, header, 1, ioChannel.mTransmitBuffer + index, length, frames [frameCount]) ;
+    index += length ;
+    sequenceNumber = (sequenceNumber + 1) & 0x0F ;
+    frameCount += 1 ;
+  }
+  uint32_t sentCount = 0 ;
+  if (frameCount == 0) {
+  }else if (inTracked) {
+    sentCount = sendTrackedFrame (ioChannel, frames [0]) ? 1 : 0 ;
+  }else{
+    sentCount = mDriver.tryToSendBatch (frames, frameCount) ;
+  }
+  return sentCount ;
+}
+
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32_IsoTp::sendFlowControl (ACAN_STM32_IsoTpChannel & ioChannel,
+                                        const uint8_t inFlowStatus) {
+  const uint8_t header [3] = {
+    uint8_t ((PCI_FLOW_CONTROL << 4) | inFlowStatus),
+    ioChannel.mBlockSize,
+    ioChannel.mSeparationTime
+  } ;
+  const bool sent = sendFrame (ioChannel, header, 3, nullptr, 0) ;
+//--- Driver transmit queue full: retried by service
+  ioChannel.mFlowControlPending = !sent ;
+  ioChannel.mPendingFlowStatus = inFlowStatus ;
+  return sent ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_IsoTp::endTransmission (ACAN_STM32_IsoTpChannel & ioChannel,
+                                        const tIsoTpResult inResult) {
+  ioChannel.mTransmitState = ACAN_STM32_IsoTpChannel::TRANSMIT_IDLE ;
+  ioChannel.mTransmitBuffer = nullptr ;
+  ioChannel.mTransmitFrameInFlight = false ;
+  if (ioChannel.mTransmitCallBack != nullptr) {
+    ioChannel.mTransmitCallBack (ioChannel, inResult) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_IsoTp::endReception (ACAN_STM32_IsoTpChannel & ioChannel,
+                                     const tIsoTpResult inResult) {
+  ioChannel.mReceiveState = ACAN_STM32_IsoTpChannel::RECEIVE_IDLE ;
+  if (ioChannel.mReceiveCallBack != nullptr) {
+    ioChannel.mReceiveCallBack (ioChannel, inResult) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Transmission: frames are handed to the driver as long as it accepts them, the
+// block size and the separation time allow. With a separation time, a consecutive
+// frame is sent once the previous one has been transmitted (transmitComplete sets
+// the date of the next one). Every state that waits has a deadline.
+
+void ACAN_STM32_IsoTp::serviceTransmission (ACAN_STM32_IsoTpChannel & ioChannel) {
+  switch (ioChannel.mTransmitState) {
+  case ACAN_STM32_IsoTpChannel::TRANSMIT_IDLE :
+    break ;
+  case ACAN_STM32_IsoTpChannel::TRANSMIT_SINGLE_OR_FIRST_FRAME :
+    if (ioChannel.mTransmitLength <= SINGLE_FRAME_MAX_LENGTH) {
+      const uint8_t header [1] = {uint8_t ((PCI_SINGLE_FRAME << 4) | ioChannel.mTransmitLength)} ;
+      if (sendFrame (ioChannel, header, 1, ioChannel.mTransmitBuffer, ioChannel.mTransmitLength)) {
+        endTransmission (ioChannel, kIsoTpOk) ;
+      }
+    }else{
+      const uint8_t header [2] = {
+        uint8_t ((PCI_FIRST_FRAME << 4) | (ioChannel.mTransmitLength >> 8)),
+        uint8_t (ioChannel.mTransmitLength)
+      } ;
+      if (sendFrame (ioChannel, header, 2, ioChannel.mTransmitBuffer, FIRST_FRAME_DATA_LENGTH)) {
+        ioChannel.mTransmitIndex = FIRST_FRAME_DATA_LENGTH ;
+        ioChannel.mTransmitSequenceNumber = 1 ;
+        ioChannel.mWaitFlowControlCount = 0 ;
+        ioChannel.mTransmitDeadline = millis () + ioChannel.mFlowControlTimeout ;
+        ioChannel.mTransmitState = ACAN_STM32_IsoTpChannel::TRANSMIT_WAITING_FLOW_CONTROL ;
+      }
+    }
+    if ((ioChannel.mTransmitState == ACAN_STM32_IsoTpChannel::TRANSMIT_SINGLE_OR_FIRST_FRAME)
+     && (int32_t (millis () - ioChannel.mTransmitDeadline) >= 0)) { // N_As
+      endTransmission (ioChannel, kIsoTpTimeout) ;
+    }
+    break ;
+  case ACAN_STM32_IsoTpChannel::TRANSMIT_WAITING_FLOW_CONTROL :
+    if (int32_t (millis () - ioChannel.mTransmitDeadline) >= 0) { // N_Bs
+      endTransmission (ioChannel, kIsoTpTimeout) ;
+    }
+    break ;
+  case ACAN_STM32_IsoTpChannel::TRANSMIT_CONSECUTIVE_FRAMES :
+    { const bool tracked = ioChannel.mTransmitSeparationMicros > 0 ;
+      bool loop = !ioChannel.mTransmitFrameInFlight && (int32_t (micros () - ioChannel.mTransmitDate) >= 0) ;
+      while (loop) {
+        uint32_t maxFrameCount = tracked ? 1 : BATCH_SIZE ;
+        if ((ioChannel.mTransmitBlockSize > 0) && (maxFrameCount > ioChannel.mTransmitBlockCount)) {
+          maxFrameCount = ioChannel.mTransmitBlockCount ;
+        }
+        const uint32_t sentCount = sendConsecutiveFrames (ioChannel, maxFrameCount, tracked) ;
+        loop = sentCount == maxFrameCount ; // The driver may accept more frames
+        if (sentCount > 0) {
+          const uint32_t index = ioChannel.mTransmitIndex + sentCount * CONSECUTIVE_FRAME_DATA_LENGTH ;
+          ioChannel.mTransmitIndex = uint16_t ((index < ioChannel.mTransmitLength) ? index : ioChannel.mTransmitLength) ;
+          ioChannel.mTransmitSequenceNumber = (ioChannel.mTransmitSequenceNumber + sentCount) & 0x0F ;
+          ioChannel.mTransmitDeadline = millis () + ioChannel.mTransmitTimeout
+                                      + (ioChannel.mTransmitSeparationMicros + 999) / 1000 ;
+          if (ioChannel.mTransmitIndex >= ioChannel.mTransmitLength) {
+            loop = false ;
+            endTransmission (ioChannel, kIsoTpOk) ;
+          }else if ((ioChannel.mTransmitBlockSize > 0)
+                 && ((ioChannel.mTransmitBlockCount -= uint8_t (sentCount)) == 0)) {
+            loop = false ;
+            ioChannel.mTransmitDeadline = millis () + ioChannel.mFlowControlTimeout ;
+            ioChannel.mTransmitState = ACAN_STM32_IsoTpChannel::TRANSMIT_WAITING_FLOW_CONTROL ;
+          }else if (tracked) { // Next frame STmin after completion of this one
+            loop = false ;
+          }
+        }
+      }
+      if ((ioChannel.mTransmitState == ACAN_STM32_IsoTpChannel::TRANSMIT_CONSECUTIVE_FRAMES)
+       && (int32_t (millis () - ioChannel.mTransmitDeadline) >= 0)) { // N_As, N_Cs
+        endTransmission (ioChannel, kIsoTpTimeout) ;
+      }
+    }
+    break ;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Transmit completion (called from the transmit ISR, or from poll): only the
+// in flight flag and the date of the next consecutive frame are written. A frame
+// that is not sent (aborted, or failed with NART) stays in flight: the transfer
+// ends with kIsoTpTimeout.
+
+bool ACAN_STM32_IsoTp::transmitComplete (const uint32_t inTag,
+                                         const ACAN_STM32::TransmitStatus inStatus) {
+  ACAN_STM32_IsoTpChannel * channel = mFirstChannel ;
+  while ((channel != nullptr) && (channel->mTransmitTag != inTag)) {
+    channel = channel->mNextChannel ;
+  }
+  if ((channel != nullptr) && (inStatus == ACAN_STM32::TRANSMIT_OK) && channel->mTransmitFrameInFlight) {
+    channel->mTransmitDate = micros () + channel->mTransmitSeparationMicros ;
+    channel->mTransmitFrameInFlight = false ;
+  }
+  return channel != nullptr ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_IsoTp::serviceReception (ACAN_STM32_IsoTpChannel & ioChannel) {
+  if (ioChannel.mFlowControlPending) {
+    sendFlowControl (ioChannel, ioChannel.mPendingFlowStatus) ;
+  }
+  if ((ioChannel.mReceiveState == ACAN_STM32_IsoTpChannel::RECEIVE_CONSECUTIVE_FRAMES)
+   && (int32_t (millis () - ioChannel.mConsecutiveFrameDeadline) >= 0)) {
+    ioChannel.mFlowControlPending = false ;
+    endReception (ioChannel, kIsoTpTimeout) ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_IsoTp::service (void) {
+  ACAN_STM32_IsoTpChannel * channel = mFirstChannel ;
+  while (channel != nullptr) {
+    ACAN_STM32_IsoTpChannel * next = channel->mNextChannel ; // Call back may remove channel
+    serviceReception (* channel) ;
+    serviceTransmission (* channel) ;
+    channel = next ;
+  }
+}
+
+//------------------------------------------------------------------------------
+//   RECEPTION
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32_IsoTp::handleReceivedMessage (const CANMessage & inMessage) {
+  ACAN_STM32_IsoTpChannel * channel = nullptr ;
+  if (!inMessage.rtr && (inMessage.len > 0)) {
+    ACAN_STM32_IsoTpChannel * p = mFirstChannel ;
+    while ((p != nullptr) && (channel == nullptr)) {
+      if ((p->mReceiveIdentifier == inMessage.id) && (p->mExtended == inMessage.ext)) {
+        channel = p ;
+      }
+      p = p->mNextChannel ;
+    }
+  }
+  if (channel != nullptr) {
+    switch (inMessage.data [0] >> 4) {
+    case PCI_SINGLE_FRAME :
+      handleSingleFrame (* channel, inMessage) ;
+      break ;
+    case PCI_FIRST_FRAME :
+      handleFirstFrame (* channel, inMessage) ;
+      break ;
+    case PCI_CONSECUTIVE_FRAME :
+      handleConsecutiveFrame (* channel, inMessage) ;
+      break ;
+    case PCI_FLOW_CONTROL :
+      handleFlowControl (* channel, inMessage) ;
+      break ;
+    default : // Unknown frame type: ignored
+      break ;
+    }
+  }
+  return channel != nullptr ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_IsoTp::handleFlowControl (ACAN_STM32_IsoTpChannel & ioChannel,
+                                          const CANMessage & inMessage) {
+  if ((ioChannel.mTransmitState == ACAN_STM32_IsoTpChannel::TRANSMIT_WAITING_FLOW_CONTROL)
+   && (inMessage.len >= 3)) {
+    switch (inMessage.data [0] & 0x0F) {
+    case FLOW_STATUS_CONTINUE_TO_SEND :
+      ioChannel.mTransmitBlockSize = inMessage.data [1] ;
+      ioChannel.mTransmitBlockCount = inMessage.data [1] ;
+      ioChannel.mTransmitSeparationMicros = separationTimeMicros (inMessage.data [2]) ;
+      ioChannel.mTransmitDate = micros () ;
+      ioChannel.mTransmitDeadline = millis () + ioChannel.mTransmitTimeout ;
+      ioChannel.mWaitFlowControlCount = 0 ;
+      ioChannel.mTransmitState = ACAN_STM32_IsoTpChannel::TRANSMIT_CONSECUTIVE_FRAMES ;
+      serviceTransmission (ioChannel) ; // Send the block without waiting for service
+      break ;
+    case FLOW_STATUS_WAIT :
+      ioChannel.mWaitFlowControlCount += 1 ;
+      if (ioChannel.mWaitFlowControlCount > ioChannel.mMaxWaitFlowControlCount) {
+        endTransmission (ioChannel, kIsoTpWaitLimit) ;
+      }else{
+        ioChannel.mTransmitDeadline = millis () + ioChannel.mFlowControlTimeout ;
+      }
+      break ;
+    case FLOW_STATUS_OVERFLOW :
+      endTransmission (ioChannel, kIsoTpBufferOverflow) ;
+      break ;
+    default :
+      endTransmission (ioChannel, kIsoTpInvalidFlowControl) ;
+      break ;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_IsoTp::handleSingleFrame (ACAN_STM32_IsoTpChannel & ioChannel,
+                                          const CANMessage & inMessage) {
+  const uint32_t length = inMessage.data [0] & 0x0F ;
+  if ((length > 0) && (length <= SINGLE_FRAME_MAX_LENGTH) && (length < inMessage.len)) {
+    if (ioChannel.receiveInProgress ()) {
+      ioChannel.mFlowControlPending = false ;
+      endReception (ioChannel, kIsoTpUnexpectedFrame) ;
+    }
+    if (length > ioChannel.mReceiveBufferSize) {
+      ioChannel.mReceivedLength = 0 ;
+      endReception (ioChannel, kIsoTpBufferOverflow) ;
+    }else{
+      for (uint32_t i = 0 ; i < length ; i++) {
+        ioChannel.mReceiveBuffer [i] = inMessage.data [i + 1] ;
+      }
+      ioChannel.mReceivedLength = uint16_t (length) ;
+      endReception (ioChannel, kIsoTpOk) ;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_IsoTp::handleFirstFrame (ACAN_STM32_IsoTpChannel & ioChannel,
+                                         const CANMessage & inMessage) {
+  const uint32_t length = (uint32_t (inMessage.data [0] & 0x0F) << 8) | inMessage.data [1] ;
+  if ((inMessage.len == 8) && (length > SINGLE_FRAME_MAX_LENGTH)) {
+    if (ioChannel.receiveInProgress ()) {
+      ioChannel.mFlowControlPending = false ;
+      endReception (ioChannel, kIsoTpUnexpectedFrame) ;
+    }
+    if (length > ioChannel.mReceiveBufferSize) {
+      sendFlowControl (ioChannel, FLOW_STATUS_OVERFLOW) ;
+      ioChannel.mReceivedLength = 0 ;
+      endReception (ioChannel, kIsoTpBufferOverflow) ;
+    }else{
+      for (uint32_t i = 0 ; i < FIRST_FRAME_DATA_LENGTH ; i++) {
+        ioChannel.mReceiveBuffer [i] = inMessage.data [i + 2] ;
+      }
+      ioChannel.mReceiveLength = uint16_t (length) ;
+      ioChannel.mReceivedLength = FIRST_FRAME_DATA_LENGTH ;
+      ioChannel.mReceiveSequenceNumber = 1 ;
+      ioChannel.mReceiveBlockCount = ioChannel.mBlockSize ;
+      ioChannel.mConsecutiveFrameDeadline = millis () + ioChannel.mConsecutiveFrameTimeout ;
+      ioChannel.mReceiveState = ACAN_STM32_IsoTpChannel::RECEIVE_CONSECUTIVE_FRAMES ;
+      sendFlowControl (ioChannel, FLOW_STATUS_CONTINUE_TO_SEND) ;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_IsoTp::handleConsecutiveFrame (ACAN_STM32_IsoTpChannel & ioChannel,
+                                               const CANMessage & inMessage) {
+  if (ioChannel.mReceiveState == ACAN_STM32_IsoTpChannel::RECEIVE_CONSECUTIVE_FRAMES) {
+    const uint32_t remaining = ioChannel.mReceiveLength - ioChannel.mReceivedLength ;
+    const uint32_t length = (remaining < CONSECUTIVE_FRAME_DATA_LENGTH) ? remaining : CONSECUTIVE_FRAME_DATA_LENGTH ;
+    if ((inMessage.data [0] & 0x0F) != ioChannel.mReceiveSequenceNumber) {
+      ioChannel.mFlowControlPending = false ;
+      endReception (ioChannel, kIsoTpWrongSequenceNumber) ;
+    }else if (inMessage.len > length) { // Shorter frames are ignored
+      uint8_t * p = ioChannel.mReceiveBuffer + ioChannel.mReceivedLength ;
+      for (uint32_t i = 0 ; i < length ; i++) {
+        p [i] = inMessage.data [i + 1] ;
+      }
+      ioChannel.mReceivedLength += length ;
+      ioChannel.mReceiveSequenceNumber = (ioChannel.mReceiveSequenceNumber + 1) & 0x0F ;
+      ioChannel.mConsecutiveFrameDeadline = millis () + ioChannel.mConsecutiveFrameTimeout ;
+      if (ioChannel.mReceivedLength >= ioChannel.mReceiveLength) {
+        endReception (ioChannel, kIsoTpOk) ;
+      }else if ((ioChannel.mBlockSize > 0) && (--ioChannel.mReceiveBlockCount == 0)) {
+        ioChannel.mReceiveBlockCount = ioChannel.mBlockSize ;
+        sendFlowControl (ioChannel, FLOW_STATUS_CONTINUE_TO_SEND) ;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
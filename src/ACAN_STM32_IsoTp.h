@@ -0,0 +1,233 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// ISO-TP transport layer (ISO 15765-2), classic CAN, normal addressing
+//
+// A channel is a pair of identifiers (transmit and receive), for example a
+// UDS client 0x7E0 / 0x7E8. Several channels are handled concurrently by an
+// ACAN_STM32_IsoTp layer; every channel can send and receive a message at the
+// same time (full duplex). Messages are up to 4095 bytes.
+//
+// No intermediate buffer:
+//   - a message is sent from the caller buffer (it should remain valid until
+//     the transmit call back is invoked, that is when its last frame has been
+//     handed to the driver): every frame payload is copied from
+//     it into a CANMessage (on the stack) given to the driver, that copies it
+//     into a free mailbox, or into the driver transmit FIFO. When the receiver
+//     separation time (STmin) is 0, consecutive frames are built by batches (up
+//     to BATCH_SIZE frames, and up to the end of the block), and every batch is
+//     handed to the driver by a single call (ACAN_STM32::tryToSendBatch, a single
+//     critical section); otherwise a consecutive frame is enqueued STmin after the
+//     transmission of the previous one has completed (see transmitComplete);
+//   - a message is reassembled straight into the caller receive buffer of the
+//     channel; a first frame of a message that does not fit is rejected with an
+//     overflow flow control.
+//
+// Received frames are given to handleReceivedMessage (for example for every
+// frame got by ACAN_STM32::receive0); service drives transmission, flow control
+// retries and timeouts: call both from loop (), or from the same task.
+// Channels are owned by the caller (no allocation).
+//
+// Transmit completions are reported by the transmit complete call back of the
+// driver (ACAN_STM32::setTransmitCompleteCallBack), that should forward them to
+// transmitComplete: without it, transfers to a receiver that requires a
+// separation time end with kIsoTpTimeout.
+//
+//   static void transmitComplete (const uint32_t inTag,
+//                                 const ACAN_STM32::TransmitStatus inStatus,
+//                                 const uint32_t /* inLatencyMicros */) {
+//     gIsoTp.transmitComplete (inTag, inStatus) ;
+//   }
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_IsoTpChannel ;
+
+//------------------------------------------------------------------------------
+// Transfer results
+
+typedef enum {
+  kIsoTpOk,
+  kIsoTpTimeout, // Frame not sent (N_As, N_Cs), no flow control (N_Bs) or no consecutive frame (N_Cr)
+  kIsoTpWrongSequenceNumber,
+  kIsoTpBufferOverflow, // Receive buffer too small, or overflow flow control received
+  kIsoTpUnexpectedFrame, // New message received while a message is being received
+  kIsoTpWaitLimit, // Too many wait flow controls
+  kIsoTpInvalidFlowControl
+} tIsoTpResult ;
+
+//------------------------------------------------------------------------------
+// Transfer call back: transmit (the transmit buffer can be reused) or receive
+// completion (data is in the receive buffer, see receivedLength)
+
+typedef void (*ACANIsoTpCallBack) (ACAN_STM32_IsoTpChannel & ioChannel,
+                                   const tIsoTpResult inResult) ;
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_IsoTpChannel {
+
+//--- Constructor
+  public: ACAN_STM32_IsoTpChannel (const uint32_t inTransmitIdentifier,
+                                   const uint32_t inReceiveIdentifier,
+                                   const tFrameFormat inFormat = kStandard) ;
+
+//--- Receive buffer (messages longer than inSize are rejected)
+  public: void setReceiveBuffer (uint8_t * inBuffer, const uint16_t inSize) ;
+
+//--- Settings, as a receiver: block size (0 for no limit), and separation time
+//    (STmin: 0 ... 127 ms, or 0xF1 ... 0xF9 for 100 ... 900 us), sent in flow controls
+  public: uint8_t mBlockSize = 0 ;
+  public: uint8_t mSeparationTime = 0 ;
+
+//--- Frame settings: padding of frames to 8 bytes, message idx of sent frames
+//    (mailbox, or transmit class, see ACAN_STM32::setTransmitClasses)
+  public: bool mPadding = true ;
+  public: uint8_t mPaddingByte = 0xCC ;
+  public: uint8_t mTransmitIdx = 0 ;
+
+//--- Timeouts (ms): frame transmission (N_As, N_Cs: a frame should be accepted by
+//    the driver, and with a separation time, sent, within mTransmitTimeout, plus
+//    STmin for consecutive frames), flow control (N_Bs), consecutive frame (N_Cr)
+  public: uint16_t mTransmitTimeout = 1000 ;
+  public: uint16_t mFlowControlTimeout = 1000 ;
+  public: uint16_t mConsecutiveFrameTimeout = 1000 ;
+  public: uint8_t mMaxWaitFlowControlCount = 10 ;
+
+//--- Call backs
+  public: ACANIsoTpCallBack mTransmitCallBack = nullptr ;
+  public: ACANIsoTpCallBack mReceiveCallBack = nullptr ;
+  public: void * mUserData = nullptr ;
+
+//--- Access
+  public: inline uint32_t transmitIdentifier (void) const { return mTransmitIdentifier ; }
+  public: inline uint32_t receiveIdentifier (void) const { return mReceiveIdentifier ; }
+  public: inline bool transmitInProgress (void) const { return mTransmitState != TRANSMIT_IDLE ; }
+  public: inline bool receiveInProgress (void) const { return mReceiveState != RECEIVE_IDLE ; }
+  public: inline const uint8_t * receiveBuffer (void) const { return mReceiveBuffer ; }
+  public: inline uint16_t receivedLength (void) const { return mReceivedLength ; }
+
+//--- Private properties, handled by ACAN_STM32_IsoTp
+  private: typedef enum {
+    TRANSMIT_IDLE,
+    TRANSMIT_SINGLE_OR_FIRST_FRAME,
+    TRANSMIT_WAITING_FLOW_CONTROL,
+    TRANSMIT_CONSECUTIVE_FRAMES
+  } TransmitState ;
+
+  private: typedef enum {
+    RECEIVE_IDLE,
+    RECEIVE_CONSECUTIVE_FRAMES
+  } ReceiveState ;
+
+  private: ACAN_STM32_IsoTpChannel * mNextChannel = nullptr ;
+  private: const uint32_t mTransmitIdentifier ;
+  private: const uint32_t mReceiveIdentifier ;
+  private: const bool mExtended ;
+//--- Transmission
+  private: TransmitState mTransmitState = TRANSMIT_IDLE ;
+  private: const uint8_t * mTransmitBuffer = nullptr ;
+  private: uint16_t mTransmitLength = 0 ;
+  private: uint16_t mTransmitIndex = 0 ;
+  private: uint8_t mTransmitSequenceNumber = 0 ;
+  private: uint8_t mTransmitBlockCount = 0 ; // Remaining frames in block, 0 if no limit
+  private: uint8_t mTransmitBlockSize = 0 ; // From flow control
+  private: uint8_t mWaitFlowControlCount = 0 ;
+  private: uint32_t mTransmitSeparationMicros = 0 ; // From flow control
+  private: volatile uint32_t mTransmitDate = 0 ; // micros (): next consecutive frame
+  private: uint32_t mTransmitDeadline = 0 ; // millis (): N_As, N_Bs, N_Cs
+  private: uint32_t mTransmitTag = 0 ; // Of consecutive frames sent with a separation time
+  private: volatile bool mTransmitFrameInFlight = false ; // Waiting for its completion
+//--- Reception
+  private: ReceiveState mReceiveState = RECEIVE_IDLE ;
+  private: uint8_t * mReceiveBuffer = nullptr ;
+  private: uint16_t mReceiveBufferSize = 0 ;
+  private: uint16_t mReceiveLength = 0 ; // Announced by first frame
+  private: uint16_t mReceivedLength = 0 ;
+  private: uint8_t mReceiveSequenceNumber = 0 ;
+  private: uint8_t mReceiveBlockCount = 0 ;
+  private: uint8_t mPendingFlowStatus = 0 ;
+  private: bool mFlowControlPending = false ;
+  private: uint32_t mConsecutiveFrameDeadline = 0 ; // millis ()
+
+  friend class ACAN_STM32_IsoTp ;
+
+//--- No copy
+  private : ACAN_STM32_IsoTpChannel (const ACAN_STM32_IsoTpChannel &) = delete ;
+  private : ACAN_STM32_IsoTpChannel & operator = (const ACAN_STM32_IsoTpChannel &) = delete ;
+} ;
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_IsoTp {
+
+  public: static const uint16_t MAX_MESSAGE_LENGTH = 4095 ;
+  public: static const uint32_t BATCH_SIZE = 8 ; // Consecutive frames per driver call
+
+//--- Constructor
+  public: ACAN_STM32_IsoTp (ACAN_STM32 & inDriver) ;
+
+//--- Channels
+  public: void addChannel (ACAN_STM32_IsoTpChannel & ioChannel) ;
+  public: void removeChannel (ACAN_STM32_IsoTpChannel & ioChannel) ;
+
+//--- Send inBuffer (it should remain valid until the transmit call back); returns
+//    false if a message is being sent by the channel, if inLength is 0 or too long,
+//    or if the channel mTransmitIdx is not accepted by the driver
+  public: bool send (ACAN_STM32_IsoTpChannel & ioChannel,
+                     const uint8_t * inBuffer,
+                     const uint16_t inLength) ;
+
+//--- Handle a transmit completion, forwarded by the transmit complete call back of
+//    the driver (it can be called from the transmit ISR); returns true if inTag
+//    belongs to a channel. Tags of the layer are TAG_BASE + channel serial number,
+//    other tags can be used by the application.
+  public: static const uint32_t TAG_BASE = 0x150F0000 ;
+  public: bool transmitComplete (const uint32_t inTag, const ACAN_STM32::TransmitStatus inStatus) ;
+
+//--- Handle a received frame; returns true if it belongs to a channel
+  public: bool handleReceivedMessage (const CANMessage & inMessage) ;
+
+//--- Transmission, flow control retries and timeouts
+  public: void service (void) ;
+
+//--- Private methods
+  private: void serviceTransmission (ACAN_STM32_IsoTpChannel & ioChannel) ;
+  private: void serviceReception (ACAN_STM32_IsoTpChannel & ioChannel) ;
+  private: void buildFrame (const ACAN_STM32_IsoTpChannel & inChannel,
+                            const uint8_t inHeader [],
+                            const uint32_t inHeaderLength,
+                            const uint8_t * inData,
+                            const uint32_t inDataLength,
+                            CANMessage & outFrame) const ;
+  private: bool sendFrame (ACAN_STM32_IsoTpChannel & ioChannel,
+                           const uint8_t inHeader [],
+                           const uint32_t inHeaderLength,
+                           const uint8_t * inData,
+                           const uint32_t inDataLength) ;
+  private: bool sendTrackedFrame (ACAN_STM32_IsoTpChannel & ioChannel, const CANMessage & inFrame) ;
+  private: uint32_t sendConsecutiveFrames (ACAN_STM32_IsoTpChannel & ioChannel,
+                                           const uint32_t inMaxFrameCount,
+                                           const bool inTracked) ;
+  private: bool sendFlowControl (ACAN_STM32_IsoTpChannel & ioChannel, const uint8_t inFlowStatus) ;
+  private: void handleFlowControl (ACAN_STM32_IsoTpChannel & ioChannel, const CANMessage & inMessage) ;
+  private: void handleSingleFrame (ACAN_STM32_IsoTpChannel & ioChannel, const CANMessage & inMessage) ;
+  private: void handleFirstFrame (ACAN_STM32_IsoTpChannel & ioChannel, const CANMessage & inMessage) ;
+  private: void handleConsecutiveFrame (ACAN_STM32_IsoTpChannel & ioChannel, const CANMessage & inMessage) ;
+  private: void endTransmission (ACAN_STM32_IsoTpChannel & ioChannel, const tIsoTpResult inResult) ;
+  private: void endReception (ACAN_STM32_IsoTpChannel & ioChannel, const tIsoTpResult inResult) ;
+
+//--- Private properties
+  private: ACAN_STM32 & mDriver ;
+  private: ACAN_STM32_IsoTpChannel * mFirstChannel ;
+  private: uint16_t mChannelSerialNumber ;
+
+//--- No copy
+  private : ACAN_STM32_IsoTp (const ACAN_STM32_IsoTp &) = delete ;
+  private : ACAN_STM32_IsoTp & operator = (const ACAN_STM32_IsoTp &) = delete ;
+} ;
+
+//------------------------------------------------------------------------------
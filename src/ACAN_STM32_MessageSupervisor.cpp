@@ -0,0 +1,141 @@
+#include <ACAN_STM32_MessageSupervisor.h>
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_MessageSupervisor::ACAN_STM32_MessageSupervisor (ACAN_STM32 & inDriver,
+                                                            const uint16_t inBucketCount) :
+mWheel (),
+mBuckets (nullptr),
+mBucketCountBits (0),
+mTimedOutMessageCount (0) {
+  while ((1U << mBucketCountBits) < inBucketCount) {
+    mBucketCountBits += 1 ;
+  }
+  const uint32_t bucketCount = 1U << mBucketCountBits ;
+  mBuckets = new ACAN_STM32_SupervisedMessage * volatile [bucketCount] ;
+  for (uint32_t i = 0 ; i < bucketCount ; i++) {
+    mBuckets [i] = nullptr ;
+  }
+  inDriver.setReceiveObserver (this) ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_MessageSupervisor::~ ACAN_STM32_MessageSupervisor (void) {
+  delete [] mBuckets ;
+}
+
+//------------------------------------------------------------------------------
+// Multiplicative hashing (Knuth); the extended flag is bit 29 of the key
+
+ACAN_STM32_FAST_CODE uint32_t ACAN_STM32_MessageSupervisor::bucketIndex (const uint32_t inIdentifier,
+                                                                         const bool inExtended) const {
+  const uint32_t key = inIdentifier | (inExtended ? (1U << 29) : 0) ;
+  return (mBucketCountBits == 0) ? 0 : ((key * 2654435761U) >> (32 - mBucketCountBits)) ;
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE ACAN_STM32_SupervisedMessage * ACAN_STM32_MessageSupervisor::find (const uint32_t inIdentifier,
+                                                                                        const bool inExtended) const {
+  ACAN_STM32_SupervisedMessage * message = mBuckets [bucketIndex (inIdentifier, inExtended)] ;
+  while ((message != nullptr) && ((message->mIdentifier != inIdentifier) || (message->mExtended != inExtended))) {
+    message = message->mHashNext ;
+  }
+  return message ;
+}
+
+//------------------------------------------------------------------------------
+
+bool ACAN_STM32_MessageSupervisor::add (ACAN_STM32_SupervisedMessage & ioMessage,
+                                        const uint32_t inIdentifier,
+                                        const tFrameFormat inFormat,
+                                        const uint32_t inTimeout,
+                                        const ACANSupervisionCallBack inCallBack) {
+  remove (ioMessage) ;
+  const bool extended = inFormat == kExtended ;
+  const bool ok = (inTimeout > 0) && (find (inIdentifier, extended) == nullptr) ;
+  if (ok) {
+    const uint32_t now = millis () ;
+    if (mWheel.count () == 0) {
+      mWheel.reset (now) ;
+    }
+    ioMessage.mCallBack = inCallBack ;
+    ioMessage.mIdentifier = inIdentifier ;
+    ioMessage.mExtended = extended ;
+    ioMessage.mTimeout = inTimeout ;
+    ioMessage.mLastReceptionDate = now ;
+    ioMessage.mReceptionCount = 0 ;
+    ioMessage.mCheckedReceptionCount = 0 ;
+    ioMessage.mTimeoutCount = 0 ;
+    ioMessage.mAlive = true ;
+    mWheel.insert (ioMessage, now + inTimeout) ;
+  //--- Publish in hash table: the message is complete before the bucket is written
+    const uint32_t idx = bucketIndex (inIdentifier, extended) ;
+    ioMessage.mHashNext = mBuckets [idx] ;
+    mBuckets [idx] = & ioMessage ;
+  }
+  return ok ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_MessageSupervisor::remove (ACAN_STM32_SupervisedMessage & ioMessage) {
+  if (ioMessage.mTimeout > 0) {
+    mWheel.remove (ioMessage) ;
+    ACAN_STM32_SupervisedMessage * volatile * p = & mBuckets [bucketIndex (ioMessage.mIdentifier, ioMessage.mExtended)] ;
+    while (*p != & ioMessage) {
+      p = & (*p)->mHashNext ;
+    }
+    *p = ioMessage.mHashNext ;
+    ioMessage.mHashNext = nullptr ;
+    if (!ioMessage.mAlive) {
+      mTimedOutMessageCount -= 1 ;
+    }
+    ioMessage.mTimeout = 0 ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_FAST_CODE void ACAN_STM32_MessageSupervisor::messageReceived (const CANMessage & inMessage) {
+  ACAN_STM32_SupervisedMessage * message = find (inMessage.id, inMessage.ext) ;
+  if (message != nullptr) {
+    message->mLastReceptionDate = millis () ;
+    message->mReceptionCount = message->mReceptionCount + 1 ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_MessageSupervisor::service (void) {
+  const uint32_t now = millis () ;
+  ACAN_STM32_TimerNode * node = mWheel.advance (now) ;
+  while (node != nullptr) {
+    ACAN_STM32_SupervisedMessage & message = * static_cast <ACAN_STM32_SupervisedMessage *> (node) ;
+    node = node->nextExpired () ;
+    if ((message.mTimeout > 0) && !message.isScheduled ()) { // A call back may have removed or added it
+      const uint32_t receptionCount = message.mReceptionCount ;
+      const uint32_t lastReceptionDate = message.mLastReceptionDate ;
+      const bool received = receptionCount != message.mCheckedReceptionCount ;
+      message.mCheckedReceptionCount = receptionCount ;
+    //--- Next deadline (a message timed out is checked every timeout)
+      mWheel.insert (message, (received ? lastReceptionDate : now) + message.mTimeout) ;
+    //--- State change
+      if (received != message.mAlive) {
+        message.mAlive = received ;
+        if (received) {
+          mTimedOutMessageCount -= 1 ;
+        }else{
+          mTimedOutMessageCount += 1 ;
+          message.mTimeoutCount += 1 ;
+        }
+        if (message.mCallBack != nullptr) {
+          message.mCallBack (message, received) ;
+        }
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,127 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Message timeout supervisor (node liveness)
+//
+// Every supervised message (identifier and format) has a timeout, in ms: the
+// message is alive while it is received at least once per timeout, and it
+// times out otherwise. A call back is invoked on every change, from
+// ACAN_STM32_MessageSupervisor::service (that should be called from loop (),
+// or from a periodic task).
+//
+// The supervisor is a receive observer of the driver: for every received frame,
+// the receive ISR looks the identifier up in a hash table (O(1)), and records
+// the reception date and count in the supervised message. Deadlines are kept in
+// a timer wheel (1 ms tick), and are refreshed lazily: when a deadline expires,
+// service checks whether the message has been received meanwhile, and then
+// re-inserts it at its last reception date + timeout. So the receive ISR does
+// not touch the wheel, and the cost of service is O(1) per elapsed millisecond,
+// plus one check per supervised message and per timeout.
+// A timed out message is checked again every timeout: it recovers (call back
+// with inAlive true) at most one timeout after it is received again.
+//
+// Supervised messages are owned by the caller (no allocation), and should
+// remain valid while they are registered. add, remove and service should be
+// called from the same task context (not from an ISR): the hash table is
+// updated with single pointer stores, so the receive ISR always sees a
+// consistent chain.
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32.h>
+#include <ACAN_STM32_TimerWheel.h>
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_SupervisedMessage ;
+
+//------------------------------------------------------------------------------
+// Supervision call back: inAlive is false when the message times out, true when
+// it is received again
+
+typedef void (*ACANSupervisionCallBack) (ACAN_STM32_SupervisedMessage & ioMessage,
+                                         const bool inAlive) ;
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_SupervisedMessage : public ACAN_STM32_TimerNode {
+
+//--- Constructor
+  public: ACAN_STM32_SupervisedMessage (void) { }
+
+//--- User data (for example a node index)
+  public: void * mUserData = nullptr ;
+
+//--- Access
+  public: inline uint32_t identifier (void) const { return mIdentifier ; }
+  public: inline bool extended (void) const { return mExtended ; }
+  public: inline uint32_t timeout (void) const { return mTimeout ; }
+  public: inline bool isAlive (void) const { return mAlive ; }
+  public: inline uint32_t lastReceptionDate (void) const { return mLastReceptionDate ; } // millis ()
+  public: inline uint32_t receptionCount (void) const { return mReceptionCount ; }
+  public: inline uint32_t timeoutCount (void) const { return mTimeoutCount ; }
+
+//--- Private properties, handled by ACAN_STM32_MessageSupervisor
+  private: ACAN_STM32_SupervisedMessage * volatile mHashNext = nullptr ;
+  private: ACANSupervisionCallBack mCallBack = nullptr ;
+  private: uint32_t mIdentifier = 0 ;
+  private: uint32_t mTimeout = 0 ; // In ms, 0 if not registered
+  private: volatile uint32_t mLastReceptionDate = 0 ; // Written by receive ISR
+  private: volatile uint32_t mReceptionCount = 0 ; // Written by receive ISR
+  private: uint32_t mCheckedReceptionCount = 0 ;
+  private: uint32_t mTimeoutCount = 0 ;
+  private: bool mExtended = false ;
+  private: bool mAlive = false ;
+
+  friend class ACAN_STM32_MessageSupervisor ;
+} ;
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_MessageSupervisor : public ACAN_STM32_ReceiveObserver {
+
+//--- Constructor: the hash table has inBucketCount entries (rounded up to a power
+//    of 2); about the number of supervised messages is a good choice.
+//    The supervisor installs itself as receive observer of inDriver.
+  public: ACAN_STM32_MessageSupervisor (ACAN_STM32 & inDriver,
+                                        const uint16_t inBucketCount = 64) ;
+
+//--- Destructor
+  public: virtual ~ ACAN_STM32_MessageSupervisor (void) ;
+
+//--- Register ioMessage: it is alive, its first deadline is now + inTimeout.
+//    Returns false if inTimeout is 0, or if the identifier is already supervised.
+  public: bool add (ACAN_STM32_SupervisedMessage & ioMessage,
+                    const uint32_t inIdentifier,
+                    const tFrameFormat inFormat,
+                    const uint32_t inTimeout,
+                    const ACANSupervisionCallBack inCallBack) ;
+
+//--- Unregister ioMessage
+  public: void remove (ACAN_STM32_SupervisedMessage & ioMessage) ;
+
+//--- Check expired deadlines, and invoke call backs
+  public: void service (void) ;
+
+//--- Statistics
+  public: inline uint32_t messageCount (void) const { return mWheel.count () ; }
+  public: inline uint32_t timedOutMessageCount (void) const { return mTimedOutMessageCount ; }
+
+//--- Receive observer (called by the receive ISR)
+  public: virtual void messageReceived (const CANMessage & inMessage) override ;
+
+//--- Private methods
+  private: uint32_t bucketIndex (const uint32_t inIdentifier, const bool inExtended) const ;
+  private: ACAN_STM32_SupervisedMessage * find (const uint32_t inIdentifier, const bool inExtended) const ;
+
+//--- Private properties
+  private: ACAN_STM32_TimerWheel mWheel ;
+  private: ACAN_STM32_SupervisedMessage * volatile * mBuckets ;
+  private: uint32_t mBucketCountBits ;
+  private: uint32_t mTimedOutMessageCount ;
+
+//--- No copy
+  private : ACAN_STM32_MessageSupervisor (const ACAN_STM32_MessageSupervisor &) = delete ;
+  private : ACAN_STM32_MessageSupervisor & operator = (const ACAN_STM32_MessageSupervisor &) = delete ;
+} ;
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,26 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+
+#include <Arduino.h>
+
+//------------------------------------------------------------------------------
+// Notifier, used by blocking receive and send methods (pluggable RTOS layer)
+//   notifyFromISR is called by the driver from the CAN ISRs: a frame has been
+//   received (receive notifier), a transmit mailbox has been freed (transmit
+//   notifier). It should record the notification (binary semaphore semantics),
+//   so a notification that occurs before wait is called is not lost.
+//   wait is called from task context; it returns when notified, or when
+//   inTimeoutMillis is elapsed.
+// See ACAN_STM32_FreeRTOS.h for a FreeRTOS implementation.
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_Notifier {
+  public: virtual ~ ACAN_STM32_Notifier (void) { }
+
+  public: virtual void notifyFromISR (void) = 0 ;
+
+  public: virtual void wait (const uint32_t inTimeoutMillis) = 0 ;
+} ;
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,22 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32_CANMessage.h>
+
+//------------------------------------------------------------------------------
+// Receive observer, called by the driver for every frame read from a hardware
+// receive FIFO (ACAN_STM32::setReceiveObserver), before routing and before it is
+// stored in a driver receive FIFO (a frame lost because the driver FIFO is full
+// is observed). It is called from the receive ISRs (or from poll in polling
+// mode): it should be short, and should not call the driver.
+// See ACAN_STM32_MessageSupervisor.h.
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_ReceiveObserver {
+  public: virtual ~ ACAN_STM32_ReceiveObserver (void) { }
+
+  public: virtual void messageReceived (const CANMessage & inMessage) = 0 ;
+} ;
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,256 @@
+#include <ACAN_STM32_ResponseTimeAnalysis.h>
+
+//------------------------------------------------------------------------------
+//    Constructors
+//------------------------------------------------------------------------------
+
+ACAN_STM32_ResponseTimeAnalysis::ACAN_STM32_ResponseTimeAnalysis (const ACAN_STM32_Settings & inSettings) :
+mBitDurationInNanoseconds (inSettings.bitDurationInNanoseconds ()),
+mDriverTransmitFIFOSize (inSettings.mDriverTransmitFIFOSize),
+mTransmitPriority (inSettings.mTransmitPriority) {
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_ResponseTimeAnalysis::ACAN_STM32_ResponseTimeAnalysis (const uint32_t inBitDurationInNanoseconds,
+                                                                  const uint16_t inDriverTransmitFIFOSize,
+                                                                  const ACAN_STM32_Settings::TransmitPriority inTransmitPriority) :
+mBitDurationInNanoseconds (inBitDurationInNanoseconds),
+mDriverTransmitFIFOSize (inDriverTransmitFIFOSize),
+mTransmitPriority (inTransmitPriority) {
+}
+
+//------------------------------------------------------------------------------
+//    Helpers
+//------------------------------------------------------------------------------
+
+static const uint64_t NS_PER_US = 1000 ;
+
+//------------------------------------------------------------------------------
+// Arbitration key: the lower, the higher priority. A standard frame wins
+// against an extended frame with the same base identifier (SRR is recessive).
+
+static uint32_t arbitrationKey (const ACAN_STM32_ResponseTimeAnalysis::Frame & inFrame) {
+  uint32_t key ;
+  if (inFrame.mExtended) {
+    key = ((inFrame.mIdentifier >> 18) << 19) | (1U << 18) | (inFrame.mIdentifier & 0x3FFFF) ;
+  }else{
+    key = (inFrame.mIdentifier & 0x7FF) << 19 ;
+  }
+  return key ;
+}
+
+//------------------------------------------------------------------------------
+
+static uint64_t divideRoundingUp (const uint64_t inNumerator, const uint64_t inDenominator) {
+  return (inNumerator + inDenominator - 1) / inDenominator ;
+}
+
+//------------------------------------------------------------------------------
+
+static uint32_t nanosecondsToMicroseconds (const uint64_t inDuration) {
+  const uint64_t us = divideRoundingUp (inDuration, NS_PER_US) ;
+  return (us > UINT32_MAX) ? UINT32_MAX : uint32_t (us) ;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t ACAN_STM32_ResponseTimeAnalysis::transmissionTimeInNanoseconds (const uint8_t inLength,
+                                                                         const bool inExtended) const {
+  const uint32_t bitCount = ACAN_STM32_Settings::worstCaseFrameBitCount (inLength, inExtended) ;
+  return uint64_t (bitCount) * mBitDurationInNanoseconds ;
+}
+
+//------------------------------------------------------------------------------
+// Worst-case transmission time only depends on length and format: lower priority
+// frames candidates for a priority inversion are counted by (format, length)
+// class, so the sum of the longest ones needs neither allocation nor sort.
+
+uint64_t ACAN_STM32_ResponseTimeAnalysis::sumOfLongest (const uint32_t inFrameCounts [2][9],
+                                                        const uint32_t inCount) const {
+  uint32_t counts [2][9] ;
+  for (uint32_t f = 0 ; f < 2 ; f++) {
+    for (uint32_t len = 0 ; len <= 8 ; len++) {
+      counts [f][len] = inFrameCounts [f][len] ;
+    }
+  }
+  uint64_t sum = 0 ;
+  uint32_t remaining = inCount ;
+  bool found = true ;
+  while ((remaining > 0) && found) {
+  //--- Longest class with remaining frames
+    found = false ;
+    uint32_t format = 0 ;
+    uint32_t length = 0 ;
+    uint64_t longest = 0 ;
+    for (uint32_t f = 0 ; f < 2 ; f++) {
+      for (uint32_t len = 0 ; len <= 8 ; len++) {
+        if (counts [f][len] > 0) {
+          const uint64_t c = transmissionTimeInNanoseconds (uint8_t (len), f != 0) ;
+          if (!found || (longest < c)) {
+            found = true ;
+            format = f ;
+            length = len ;
+            longest = c ;
+          }
+        }
+      }
+    }
+  //--- Take as many frames of this class as needed
+    if (found) {
+      const uint32_t n = (counts [format][length] < remaining) ? counts [format][length] : remaining ;
+      sum += n * longest ;
+      remaining -= n ;
+      counts [format][length] = 0 ;
+    }
+  }
+  return sum ;
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t ACAN_STM32_ResponseTimeAnalysis::blockingTimeInNanoseconds (const Frame inFrames [],
+                                                                     const uint32_t inFrameCount,
+                                                                     const uint32_t inFrameIndex) const {
+  const Frame & frame = inFrames [inFrameIndex] ;
+  const uint32_t key = arbitrationKey (frame) ;
+//--- Non-preemptive blocking: longest lower priority frame (at least the
+//    interframe space when the frame is the lowest priority one)
+  uint64_t blocking = 3 * uint64_t (mBitDurationInNanoseconds) ;
+//--- Lower priority local frames, candidates for driver priority inversion,
+//    counted by [extended][length]
+  uint32_t fifoFrameCounts [2][9] = {{0}} ;
+  uint32_t localFrameCounts [2][9] = {{0}} ;
+  for (uint32_t i = 0 ; i < inFrameCount ; i++) {
+    const Frame & other = inFrames [i] ;
+    if ((i != inFrameIndex) && (arbitrationKey (other) > key) && (other.mPeriod > 0)) {
+      const uint64_t c = transmissionTimeInNanoseconds (other) ;
+      if (blocking < c) {
+        blocking = c ;
+      }
+      if (other.mLocal) {
+        const uint32_t length = (other.mLength > 8) ? 8 : other.mLength ;
+        localFrameCounts [other.mExtended ? 1 : 0][length] += 1 ;
+        if (other.mUseDriverTransmitFIFO) {
+          fifoFrameCounts [other.mExtended ? 1 : 0][length] += 1 ;
+        }
+      }
+    }
+  }
+//--- Driver transmit FIFO is ordered by request: at most its depth lower
+//    priority frames are ahead (the last one has been loaded in a mailbox)
+  if (frame.mLocal && frame.mUseDriverTransmitFIFO) {
+    blocking += sumOfLongest (fifoFrameCounts, mDriverTransmitFIFOSize) ;
+  }
+//--- Mailboxes served by request order: the two other mailboxes can be sent first
+  if (frame.mLocal && (mTransmitPriority == ACAN_STM32_Settings::BY_REQUEST_ORDER)) {
+    blocking += sumOfLongest (localFrameCounts, 2) ;
+  }
+  return blocking ;
+}
+
+//------------------------------------------------------------------------------
+//    Analysis
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32_ResponseTimeAnalysis::analyze (Frame ioFrames [], const uint32_t inFrameCount) const {
+  const uint64_t tbit = mBitDurationInNanoseconds ;
+  uint32_t missCount = 0 ;
+  for (uint32_t m = 0 ; m < inFrameCount ; m++) {
+    Frame & frame = ioFrames [m] ;
+    const uint32_t key = arbitrationKey (frame) ;
+    const uint64_t C = transmissionTimeInNanoseconds (frame) ;
+    const uint64_t T = uint64_t (frame.mPeriod) * NS_PER_US ;
+    const uint64_t J = uint64_t (frame.mJitter) * NS_PER_US ;
+    const uint64_t D = uint64_t ((frame.mDeadline == 0) ? frame.mPeriod : frame.mDeadline) * NS_PER_US ;
+    const uint64_t B = blockingTimeInNanoseconds (ioFrames, inFrameCount, m) ;
+    frame.mTransmissionTime = nanosecondsToMicroseconds (C) ;
+    frame.mBlockingTime = nanosecondsToMicroseconds (B) ;
+  //--- Utilization of higher or equal priority frames (ppm) should be < 100%: every
+  //    term is rounded up, so a sum below 100% guarantees the exact one is
+    uint64_t utilization = (T > 0) ? divideRoundingUp (C * 1000000, T) : 1000000 ;
+    for (uint32_t k = 0 ; k < inFrameCount ; k++) {
+      if ((k != m) && (arbitrationKey (ioFrames [k]) < key) && (ioFrames [k].mPeriod > 0)) {
+        utilization += divideRoundingUp (transmissionTimeInNanoseconds (ioFrames [k]) * 1000000,
+                                         uint64_t (ioFrames [k].mPeriod) * NS_PER_US) ;
+      }
+    }
+    bool bounded = utilization < 1000000 ;
+  //--- Fixed point iterations (busy period, and every instance) are counted: near
+  //    100% utilization, they can be too many; the frame is then unschedulable
+    uint32_t iterationCount = 0 ;
+    uint64_t worstQueuingDelay = 0 ;
+    uint64_t worstResponseTime = 0 ;
+    if (bounded) {
+    //--- Length of the priority level-m busy period
+      uint64_t t = C ;
+      uint64_t previous = 0 ;
+      while (bounded && (t != previous)) {
+        iterationCount += 1 ;
+        bounded = iterationCount <= MAX_ITERATION_COUNT ;
+        previous = t ;
+        t = B + divideRoundingUp (previous + J, T) * C ;
+        for (uint32_t k = 0 ; k < inFrameCount ; k++) {
+          const Frame & other = ioFrames [k] ;
+          if ((k != m) && (arbitrationKey (other) < key) && (other.mPeriod > 0)) {
+            const uint64_t Tk = uint64_t (other.mPeriod) * NS_PER_US ;
+            const uint64_t Jk = uint64_t (other.mJitter) * NS_PER_US ;
+            t += divideRoundingUp (previous + Jk, Tk) * transmissionTimeInNanoseconds (other) ;
+          }
+        }
+      }
+    //--- Every instance in the busy period
+      const uint64_t instanceCount = bounded ? divideRoundingUp (t + J, T) : 0 ;
+      for (uint64_t q = 0 ; (q < instanceCount) && bounded ; q++) {
+        uint64_t w = B + q * C ;
+        previous = 0 ;
+        while (bounded && (w != previous)) {
+          iterationCount += 1 ;
+          bounded = iterationCount <= MAX_ITERATION_COUNT ;
+          previous = w ;
+          w = B + q * C ;
+          for (uint32_t k = 0 ; k < inFrameCount ; k++) {
+            const Frame & other = ioFrames [k] ;
+            if ((k != m) && (arbitrationKey (other) < key) && (other.mPeriod > 0)) {
+              const uint64_t Tk = uint64_t (other.mPeriod) * NS_PER_US ;
+              const uint64_t Jk = uint64_t (other.mJitter) * NS_PER_US ;
+              w += divideRoundingUp (previous + Jk + tbit, Tk) * transmissionTimeInNanoseconds (other) ;
+            }
+          }
+        }
+        const uint64_t release = q * T ;
+        const uint64_t queuingDelay = (w > release) ? (w - release) : 0 ;
+        const uint64_t responseTime = J + queuingDelay + C ;
+        if (worstQueuingDelay < queuingDelay) {
+          worstQueuingDelay = queuingDelay ;
+        }
+        if (worstResponseTime < responseTime) {
+          worstResponseTime = responseTime ;
+        }
+      }
+    }
+    frame.mWorstCaseQueuingDelay = bounded ? nanosecondsToMicroseconds (worstQueuingDelay) : UINT32_MAX ;
+    frame.mWorstCaseResponseTime = bounded ? nanosecondsToMicroseconds (worstResponseTime) : UINT32_MAX ;
+    frame.mSchedulable = bounded && (worstResponseTime <= D) ;
+    if (!frame.mSchedulable) {
+      missCount += 1 ;
+    }
+  }
+  return missCount ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32_ResponseTimeAnalysis::busUtilization (const Frame inFrames [],
+                                                          const uint32_t inFrameCount) const {
+  uint64_t utilization = 0 ; // In ppm, every term rounded up
+  for (uint32_t i = 0 ; i < inFrameCount ; i++) {
+    if (inFrames [i].mPeriod > 0) {
+      utilization += divideRoundingUp (transmissionTimeInNanoseconds (inFrames [i]) * 1000000,
+                                       uint64_t (inFrames [i].mPeriod) * NS_PER_US) ;
+    }
+  }
+  return uint32_t (utilization / 1000) ;
+}
+
+//------------------------------------------------------------------------------
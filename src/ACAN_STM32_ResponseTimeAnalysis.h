@@ -0,0 +1,101 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Worst-case response time analysis of a CAN message set
+//
+// The analysis is the classical one for non-preemptive fixed priority CAN
+// scheduling (R. Davis, A. Burns, R. Bril, J. Lukkien, "Controller Area Network
+// (CAN) schedulability analysis: Refuted, revisited and revised", 2007), with
+// worst-case bit stuffing.
+//
+// Frames sent by this node (mLocal) also suffer the priority inversions
+// introduced by the driver:
+//   - frames sent through the driver transmit FIFO (mUseDriverTransmitFIFO,
+//     message idx == 0) are ordered by request, so a frame can wait behind
+//     lower priority local frames already in the FIFO (at most its depth);
+//   - with ACAN_STM32_Settings::BY_REQUEST_ORDER, mailboxes are not served
+//     by identifier, so the two other mailboxes can hold lower priority
+//     local frames that are sent first.
+//
+// All durations are in microseconds.
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32_Settings.h>
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_ResponseTimeAnalysis {
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  //   Frame description, and analysis results
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  public: class Frame {
+  //--- Description
+    public: uint32_t mIdentifier = 0 ;
+    public: bool mExtended = false ;
+    public: uint8_t mLength = 8 ; // 0 ... 8
+    public: uint32_t mPeriod = 0 ; // Period, or minimum inter-arrival time (us)
+    public: uint32_t mJitter = 0 ; // Queuing jitter (us)
+    public: uint32_t mDeadline = 0 ; // Deadline (us), 0 means equal to period
+    public: bool mLocal = false ; // true if sent by this node
+    public: bool mUseDriverTransmitFIFO = true ; // Only relevant for local frames
+
+  //--- Results, set by analyze
+    public: uint32_t mTransmissionTime = 0 ; // Worst-case transmission time (us)
+    public: uint32_t mBlockingTime = 0 ; // Lower priority blocking, including driver inversions (us)
+    public: uint32_t mWorstCaseQueuingDelay = 0 ; // (us)
+    public: uint32_t mWorstCaseResponseTime = 0 ; // (us), UINT32_MAX if unbounded
+    public: bool mSchedulable = false ;
+  } ;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  //   Constructors
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+//--- Bit time, driver transmit FIFO size and mailbox priority from settings
+  public: explicit ACAN_STM32_ResponseTimeAnalysis (const ACAN_STM32_Settings & inSettings) ;
+
+//--- Explicit parameters
+  public: ACAN_STM32_ResponseTimeAnalysis (const uint32_t inBitDurationInNanoseconds,
+                                           const uint16_t inDriverTransmitFIFOSize,
+                                           const ACAN_STM32_Settings::TransmitPriority inTransmitPriority) ;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  //   Analysis
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+//--- Computes results of every frame; returns the number of frames that can miss
+//    their deadline (0 means the message set is schedulable).
+//    Frames with the same identifier are not allowed (result is undefined).
+//    The response time of a frame is unbounded if the utilization of higher or equal
+//    priority frames reaches 100%, or if its computation takes more than
+//    MAX_ITERATION_COUNT fixed point iterations (the frame is then unschedulable).
+  public: static const uint32_t MAX_ITERATION_COUNT = 100000 ;
+  public: uint32_t analyze (Frame ioFrames [], const uint32_t inFrameCount) const ;
+
+//--- Bus utilization, in per-thousand (‰)
+  public: uint32_t busUtilization (const Frame inFrames [], const uint32_t inFrameCount) const ;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+  //   Private
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+  private: uint64_t transmissionTimeInNanoseconds (const uint8_t inLength, const bool inExtended) const ;
+  private: inline uint64_t transmissionTimeInNanoseconds (const Frame & inFrame) const {
+    return transmissionTimeInNanoseconds (inFrame.mLength, inFrame.mExtended) ;
+  }
+  private: uint64_t sumOfLongest (const uint32_t inFrameCounts [2][9], const uint32_t inCount) const ;
+  private: uint64_t blockingTimeInNanoseconds (const Frame inFrames [],
+                                               const uint32_t inFrameCount,
+                                               const uint32_t inFrameIndex) const ;
+
+  private: const uint32_t mBitDurationInNanoseconds ;
+  private: const uint16_t mDriverTransmitFIFOSize ;
+  private: const ACAN_STM32_Settings::TransmitPriority mTransmitPriority ;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+} ;
+
+//------------------------------------------------------------------------------
@@ -101,6 +101,120 @@ uint32_t ACAN_STM32_Settings::samplePointFromBitStart (void) const {
   return (samplePoint * partPerCent) / TQCount ;
 }
 
+//------------------------------------------------------------------------------
+//    Frame durations
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32_Settings::bitDurationInNanoseconds (void) const {
+  const uint32_t TQCount = 1 /* Sync Seg */ + mPhaseSegment1 + mPhaseSegment2 ;
+  const uint32_t CAN_CLOCK_FREQUENCY = HAL_RCC_GetPCLK1Freq () ;
+  const uint64_t ns = uint64_t (1000 * 1000 * 1000) ;
+  return uint32_t ((uint64_t (TQCount * mBitRatePrescaler) * ns) / CAN_CLOCK_FREQUENCY) ;
+}
+
+//------------------------------------------------------------------------------
+// Accumulates the stuffed part of a frame (SOF ... CRC field): computes CRC15
+// and counts stuff bits as the CAN controller does.
+
+namespace {
+
+class StuffedBitCounter {
+  public: void append (const uint32_t inValue, const uint32_t inBitCount, const bool inWithCRC = true) {
+    for (uint32_t i = inBitCount ; i > 0 ; i--) {
+      const bool bit = ((inValue >> (i - 1)) & 1) != 0 ;
+      if (inWithCRC) {
+        const bool crcNext = bit != (((mCRC >> 14) & 1) != 0) ;
+        mCRC = (mCRC << 1) & 0x7FFF ;
+        if (crcNext) {
+          mCRC ^= 0x4599 ;
+        }
+      }
+      appendBit (bit) ;
+    }
+  }
+
+  public: void appendCRC (void) {
+    append (mCRC, 15, false) ;
+  }
+
+  public: uint32_t bitCount (void) const { return mBitCount ; }
+
+  private: void appendBit (const bool inBit) {
+    mBitCount += 1 ;
+    if ((mRunLength > 0) && (inBit == mLastBit)) {
+      mRunLength += 1 ;
+    }else{
+      mLastBit = inBit ;
+      mRunLength = 1 ;
+    }
+    if (mRunLength == 5) { // Stuff bit, it begins a new run
+      mBitCount += 1 ;
+      mLastBit = !inBit ;
+      mRunLength = 1 ;
+    }
+  }
+
+  private: uint32_t mBitCount = 0 ;
+  private: uint32_t mRunLength = 0 ;
+  private: uint16_t mCRC = 0 ;
+  private: bool mLastBit = false ;
+} ;
+
+}
+
+//------------------------------------------------------------------------------
+
+static const uint32_t UNSTUFFED_TRAILER_BIT_COUNT =
+  1 /* CRC delimiter */ + 2 /* ACK */ + 7 /* EOF */ + 3 /* Interframe space */ ;
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32_Settings::frameBitCount (const CANMessage & inMessage) {
+  const uint32_t length = (inMessage.len > 8) ? 8 : inMessage.len ;
+  StuffedBitCounter counter ;
+  counter.append (0, 1) ; // SOF
+  if (inMessage.ext) {
+    counter.append (inMessage.id >> 18, 11) ; // Base identifier
+    counter.append (3, 2) ; // SRR, IDE (recessive)
+    counter.append (inMessage.id, 18) ; // Identifier extension
+    counter.append (inMessage.rtr ? 1 : 0, 1) ; // RTR
+    counter.append (0, 2) ; // r1, r0
+  }else{
+    counter.append (inMessage.id, 11) ; // Identifier
+    counter.append (inMessage.rtr ? 1 : 0, 1) ; // RTR
+    counter.append (0, 2) ; // IDE, r0
+  }
+  counter.append (inMessage.len, 4) ; // DLC
+  if (!inMessage.rtr) {
+    for (uint32_t i = 0 ; i < length ; i++) {
+      counter.append (inMessage.data [i], 8) ;
+    }
+  }
+  counter.appendCRC () ;
+  return counter.bitCount () + UNSTUFFED_TRAILER_BIT_COUNT ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32_Settings::worstCaseFrameBitCount (const uint8_t inLength, const bool inExtended) {
+  const uint32_t dataBitCount = 8 * ((inLength > 8) ? 8 : inLength) ;
+  const uint32_t stuffedBitCount = (inExtended ? 54 : 34) + dataBitCount ;
+  return stuffedBitCount + UNSTUFFED_TRAILER_BIT_COUNT + (stuffedBitCount - 1) / 4 ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32_Settings::frameDurationInNanoseconds (const CANMessage & inMessage) const {
+  return frameBitCount (inMessage) * bitDurationInNanoseconds () ;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ACAN_STM32_Settings::worstCaseFrameDurationInNanoseconds (const uint8_t inLength,
+                                                                   const bool inExtended) const {
+  return worstCaseFrameBitCount (inLength, inExtended) * bitDurationInNanoseconds () ;
+}
+
 //------------------------------------------------------------------------------
 
 uint32_t ACAN_STM32_Settings::CANBitSettingConsistency (void) const {
@@ -2,11 +2,11 @@
 
 //------------------------------------------------------------------------------
 
-#include <Arduino.h>
+#include <ACAN_STM32_CANMessage.h>
 
 //------------------------------------------------------------------------------
 
-#if !defined (STM32L4xx) && !defined(STM32F303x8) && !defined(STM32F103xB)
+#if !defined (STM32L4xx) && !defined(STM32F303x8) && !defined(STM32F103xB) && !defined(STM32F446xx)
   #error "Unhandled STM32 Board"
 #endif
 
@@ -34,6 +34,14 @@ class ACAN_STM32_Settings {
 
   // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+  public: typedef enum {
+    AUTOMATIC_BUS_OFF_RECOVERY, // By hardware (MCR.ABOM)
+    MANUAL_BUS_OFF_RECOVERY, // ACAN_STM32::recoverFromBusOff
+    DELAYED_BUS_OFF_RECOVERY // ACAN_STM32::serviceBusOffRecovery, after mBusOffRecoveryDelay
+  } BusOffRecovery ;
+
+  // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
 //--- Constructor for a given baud rate
   public: explicit ACAN_STM32_Settings (const uint32_t inWhishedBitRate,
                                         const uint32_t inTolerancePPM = 1000) ;
@@ -60,9 +68,55 @@ class ACAN_STM32_Settings {
   public: uint16_t mDriverReceiveFIFO0Size = 32 ;
   public: uint16_t mDriverReceiveFIFO1Size = 0 ;
 
+//--- Driver FIFO pool (in messages): begin allocates the driver FIFOs in a single pool
+//    of mDriverFIFOPoolSize messages, or of the sum of the driver FIFO sizes if greater
+//    (0: no spare room). FIFO resizing, autotuning and transmit classes share it out,
+//    without allocation. Every pool message takes 16 bytes (a message); the transmit
+//    share of the pool (the pool minus the receive FIFO sizes) takes 16 more bytes per
+//    message (a transmit stamp), so transmit FIFOs cannot grow beyond it.
+  public: uint32_t mDriverFIFOPoolSize = 0 ;
+
+//--- Receive interrupt coalescing: message pending interrupts are not enabled, so
+//    receive ISRs run when a hardware receive FIFO is full (3 frames) or overruns,
+//    and drain it. Partial batches are received by ACAN_STM32::flushReceiveFIFOs.
+  public: bool mReceiveInterruptCoalescing = false ;
+
+//--- Polling mode: CAN interrupts are not enabled, ACAN_STM32::poll should be called
+//    periodically; no critical section is used by the driver.
+  public: bool mPollingMode = false ;
+
+//--- NVIC priority of the CAN interrupts (0 is the highest priority). With a non zero
+//    value, driver critical sections only mask interrupts of same or lower priority
+//    (using BASEPRI); with 0, every interrupt is masked during critical sections.
+  public: uint8_t mMessageIRQPriority = 0 ; // 0 ... (1 << __NVIC_PRIO_BITS) - 1
+
+//--- Bus-off recovery policy; with every policy, recovery completes after 128
+//    occurrences of 11 consecutive recessive bits.
+  public: BusOffRecovery mBusOffRecovery = AUTOMATIC_BUS_OFF_RECOVERY ;
+  public: uint32_t mBusOffRecoveryDelay = 0 ; // In ms, for DELAYED_BUS_OFF_RECOVERY
+
+//--- On bus-off, discard the driver transmit FIFO and abort pending transmit mailboxes
+//    (stale frames are not sent on recovery); otherwise they are kept.
+  public: bool mFlushTransmitOnBusOff = false ;
+
+//--- Last error code interrupt (ESR.LEC): every bus error is counted by
+//    ACAN_STM32::errorFrameCount; it can fire at a high rate on a disturbed bus.
+  public: bool mLastErrorCodeInterrupt = false ;
+
+//--- No automatic retransmission (MCR.NART): every frame is sent once, whatever its
+//    success (lost arbitration, error); it applies to every frame, as NART is a
+//    controller setting.
+  public: bool mNoAutomaticRetransmission = false ;
+
 //--- Transmit buffer size
   public: uint16_t mDriverTransmitFIFOSize = 16 ;
 
+//--- Filter bank split (dual CAN devices only): first filter bank of CAN2 (CAN2SB),
+//    banks 0 ... mCAN2StartBank-1 are assigned to CAN1. Both instances should be
+//    started with the same value (otherwise begin returns kInvalidCAN2StartBank).
+//    Ignored by single CAN devices.
+  public: uint8_t mCAN2StartBank = 14 ; // 1 ... 27
+
 //--- Compute actual bit rate
   public: uint32_t actualBitRate (void) const ;
 
@@ -75,6 +129,23 @@ class ACAN_STM32_Settings {
 //--- Distance of sample point from bit start (in ppc, part-per-cent, denoted by %)
   public: uint32_t samplePointFromBitStart (void) const ;
 
+//--- Duration of a bit (in ns), computed from actual bit rate settings
+  public: uint32_t bitDurationInNanoseconds (void) const ;
+
+//--- Number of bits of a frame on the bus, including stuff bits, and the 3-bit interframe space.
+//  frameBitCount computes the exact stuffing of the given frame (SOF ... CRC field).
+//  worstCaseFrameBitCount returns the bound given by the classical CAN response time analysis:
+//    standard frame: 47 + 8 * len + (34 + 8 * len - 1) / 4
+//    extended frame: 67 + 8 * len + (54 + 8 * len - 1) / 4
+//  Remote frames are handled by giving a 0 length.
+  public: static uint32_t frameBitCount (const CANMessage & inMessage) ;
+  public: static uint32_t worstCaseFrameBitCount (const uint8_t inLength, const bool inExtended) ;
+
+//--- Frame durations (in ns), using actual bit rate settings
+  public: uint32_t frameDurationInNanoseconds (const CANMessage & inMessage) const ;
+  public: uint32_t worstCaseFrameDurationInNanoseconds (const uint8_t inLength,
+                                                        const bool inExtended) const ;
+
 //--- Bit settings are consistent ? (returns 0 if ok)
   public: uint32_t CANBitSettingConsistency (void) const ;
 
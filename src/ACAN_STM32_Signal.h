@@ -0,0 +1,202 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Compile-time signal codec (header only)
+//
+// A signal is a bit field of the CAN frame payload, described as in a DBC
+// file:
+//   - start bit: for Intel (little endian) byte order, the least significant
+//     bit of the signal; for Motorola (big endian) byte order, its most
+//     significant bit. Bit n is bit (n % 8) of data [n / 8];
+//   - length, in bits (1 ... 64);
+//   - signedness (two's complement);
+//   - physical value = raw value * factor + offset.
+//
+// The layout is given by template arguments, so every access is a single shift
+// and mask of CANMessage::data64 (plus a byte swap for Motorola order, that is
+// a single REV instruction on Cortex-M). Invalid layouts are rejected at
+// compile time. Factor and offset are given to the constexpr constructor:
+//
+//   static constexpr ACAN_STM32_Signal <24, 16, kIntel, false> kEngineSpeed (0.25f) ;
+//   const float rpm = kEngineSpeed.decode (message) ;
+//   kEngineSpeed.encode (message, 1500.0f) ;
+//
+// Multiplexed signals are only present when a multiplexor signal has a given
+// value (ACAN_STM32_MultiplexedSignal). ACAN_STM32_decodeSignals decodes several
+// signals of a frame at once, reading the payload once.
+//
+// The payload is read as a little endian 64-bit word: this is the byte order of
+// every STM32.
+//------------------------------------------------------------------------------
+
+#include <ACAN_STM32_CANMessage.h>
+
+//------------------------------------------------------------------------------
+
+typedef enum {kIntel, kMotorola} tByteOrder ;
+
+//------------------------------------------------------------------------------
+
+template <uint8_t SIGNAL_START_BIT, uint8_t SIGNAL_LENGTH, tByteOrder SIGNAL_BYTE_ORDER = kIntel, bool SIGNAL_SIGNED = false>
+class ACAN_STM32_Signal {
+
+//--- Layout
+  public: static constexpr uint64_t RAW_MASK = (SIGNAL_LENGTH == 64) ? ~ uint64_t (0) : ((uint64_t (1) << SIGNAL_LENGTH) - 1) ;
+
+//--- Motorola: bit position of MSB in the byte swapped payload (data [0] is the
+//    most significant byte)
+  private: static constexpr uint32_t MOTOROLA_MSB_POSITION = (7 - (SIGNAL_START_BIT / 8)) * 8 + (SIGNAL_START_BIT % 8) ;
+
+  public: static constexpr uint32_t PAYLOAD_SHIFT = (SIGNAL_BYTE_ORDER == kIntel)
+    ? SIGNAL_START_BIT
+    : (MOTOROLA_MSB_POSITION - (SIGNAL_LENGTH - 1)) ;
+
+  static_assert ((SIGNAL_LENGTH >= 1) && (SIGNAL_LENGTH <= 64), "Signal length should be 1 ... 64") ;
+  static_assert (SIGNAL_START_BIT < 64, "Signal start bit should be 0 ... 63") ;
+  static_assert ((SIGNAL_BYTE_ORDER == kMotorola) || ((SIGNAL_START_BIT + SIGNAL_LENGTH) <= 64), "Intel signal exceeds payload") ;
+  static_assert ((SIGNAL_BYTE_ORDER == kIntel) || (MOTOROLA_MSB_POSITION >= (SIGNAL_LENGTH - 1U)), "Motorola signal exceeds payload") ;
+
+//--- Raw value range
+  public: static constexpr int64_t RAW_MIN = SIGNAL_SIGNED ? - int64_t (RAW_MASK >> 1) - 1 : 0 ;
+  public: static constexpr uint64_t RAW_MAX = SIGNAL_SIGNED ? (RAW_MASK >> 1) : RAW_MASK ;
+
+//--- Constructor
+  public: constexpr ACAN_STM32_Signal (const float inFactor = 1.0f, const float inOffset = 0.0f) :
+  mFactor (inFactor),
+  mOffset (inOffset) {
+  }
+
+//--- Payload word, in the byte order of the signal
+  public: static constexpr uint64_t orderedPayload (const uint64_t inData64) {
+    return (SIGNAL_BYTE_ORDER == kIntel) ? inData64 : __builtin_bswap64 (inData64) ;
+  }
+
+//--- Raw value (sign extended if signed)
+  public: static constexpr int64_t rawFromPayload (const uint64_t inData64) {
+    return SIGNAL_SIGNED
+      ? (int64_t ((orderedPayload (inData64) >> PAYLOAD_SHIFT) << (64 - SIGNAL_LENGTH)) >> (64 - SIGNAL_LENGTH))
+      : int64_t ((orderedPayload (inData64) >> PAYLOAD_SHIFT) & RAW_MASK) ;
+  }
+
+  public: static constexpr int64_t raw (const CANMessage & inMessage) {
+    return rawFromPayload (inMessage.data64) ;
+  }
+
+  public: static inline void setRaw (CANMessage & ioMessage, const int64_t inRaw) {
+    const uint64_t payload = orderedPayload (ioMessage.data64) ;
+    const uint64_t newPayload = (payload & ~ (RAW_MASK << PAYLOAD_SHIFT)) | ((uint64_t (inRaw) & RAW_MASK) << PAYLOAD_SHIFT) ;
+    ioMessage.data64 = orderedPayload (newPayload) ;
+  }
+
+//--- Physical value. Up to FLOAT_RAW_LENGTH bits, the raw value is computed in
+//    single precision, with an exact rounding (float has a 24-bit mantissa); wider
+//    signals are computed in double precision (software emulated on Cortex-M4F, so
+//    slower). Physical values are float: beyond 24 bits, they are not exact, use
+//    raw / setRaw for exact raw values.
+  public: static constexpr uint32_t FLOAT_RAW_LENGTH = 23 ;
+
+  public: constexpr float decodePayload (const uint64_t inData64) const {
+    return (SIGNAL_LENGTH <= FLOAT_RAW_LENGTH)
+      ? (float (rawFromPayload (inData64)) * mFactor + mOffset)
+      : float (double (rawFromPayload (inData64)) * double (mFactor) + double (mOffset)) ;
+  }
+
+  public: constexpr float decode (const CANMessage & inMessage) const {
+    return decodePayload (inMessage.data64) ;
+  }
+
+//--- Encode physical value: rounded to nearest raw value, saturated to raw range
+  public: constexpr int64_t rawFromPhysical (const float inValue) const {
+    return (SIGNAL_LENGTH <= FLOAT_RAW_LENGTH)
+      ? rawFromScaledValue <float> ((inValue - mOffset) / mFactor)
+      : rawFromScaledValue <double> ((double (inValue) - double (mOffset)) / double (mFactor)) ;
+  }
+
+//--- Raw range bounds are exact in T for the signals computed in T (RAW_MAX of a
+//    64-bit signal rounds up to 2^64 or 2^63 in double, and saturates). Non
+//    negative values are converted through uint64_t, as they can exceed INT64_MAX.
+  private: template <typename T> static constexpr int64_t rawFromScaledValue (const T inValue) {
+    return (inValue <= T (RAW_MIN)) ? RAW_MIN
+         : (inValue >= T (RAW_MAX)) ? int64_t (RAW_MAX)
+         : (inValue >= T (0)) ? int64_t (uint64_t (inValue + T (0.5)))
+         : int64_t (inValue - T (0.5)) ;
+  }
+
+  public: inline void encode (CANMessage & ioMessage, const float inValue) const {
+    setRaw (ioMessage, rawFromPhysical (inValue)) ;
+  }
+
+//--- Scaling
+  public: constexpr float factor (void) const { return mFactor ; }
+  public: constexpr float offset (void) const { return mOffset ; }
+
+  private: const float mFactor ;
+  private: const float mOffset ;
+} ;
+
+//------------------------------------------------------------------------------
+// Multiplexed signal: present only when MULTIPLEXOR raw value is MULTIPLEXOR_VALUE
+//
+//   typedef ACAN_STM32_Signal <0, 8> Mux ;
+//   static constexpr ACAN_STM32_MultiplexedSignal <Mux, 2, ACAN_STM32_Signal <8, 16>>
+//     kPressure (ACAN_STM32_Signal <8, 16> (0.1f)) ;
+//   float pressure ;
+//   if (kPressure.decode (message, pressure)) { ... }
+//------------------------------------------------------------------------------
+
+template <typename MULTIPLEXOR, int64_t MULTIPLEXOR_VALUE, typename SIGNAL>
+class ACAN_STM32_MultiplexedSignal {
+
+//--- Constructor
+  public: constexpr ACAN_STM32_MultiplexedSignal (const SIGNAL & inSignal) :
+  mSignal (inSignal) {
+  }
+
+//--- Presence
+  public: static constexpr bool isPresentInPayload (const uint64_t inData64) {
+    return MULTIPLEXOR::rawFromPayload (inData64) == MULTIPLEXOR_VALUE ;
+  }
+
+  public: static constexpr bool isPresent (const CANMessage & inMessage) {
+    return isPresentInPayload (inMessage.data64) ;
+  }
+
+//--- Decode: returns false (outValue unchanged) if the signal is not present
+  public: inline bool decode (const CANMessage & inMessage, float & outValue) const {
+    const uint64_t payload = inMessage.data64 ;
+    const bool present = isPresentInPayload (payload) ;
+    if (present) {
+      outValue = mSignal.decodePayload (payload) ;
+    }
+    return present ;
+  }
+
+//--- Encode: also sets the multiplexor
+  public: inline void encode (CANMessage & ioMessage, const float inValue) const {
+    MULTIPLEXOR::setRaw (ioMessage, MULTIPLEXOR_VALUE) ;
+    mSignal.encode (ioMessage, inValue) ;
+  }
+
+  public: constexpr const SIGNAL & signal (void) const { return mSignal ; }
+
+  private: const SIGNAL mSignal ;
+} ;
+
+//------------------------------------------------------------------------------
+// Batch decoding: outValues [i] receives the physical value of the i-th signal;
+// the payload is read once.
+//
+//   float values [3] ;
+//   ACAN_STM32_decodeSignals (message, values, kEngineSpeed, kCoolant, kThrottle) ;
+//------------------------------------------------------------------------------
+
+template <typename... SIGNALS>
+inline void ACAN_STM32_decodeSignals (const CANMessage & inMessage,
+                                      float outValues [],
+                                      const SIGNALS & ... inSignals) {
+  const uint64_t payload = inMessage.data64 ;
+  uint32_t idx = 0 ;
+  ((outValues [idx++] = inSignals.decodePayload (payload)), ...) ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,149 @@
+#include <ACAN_STM32_TimerWheel.h>
+
+//------------------------------------------------------------------------------
+
+static const uint32_t SLOT_MASK = ACAN_STM32_TimerWheel::SLOT_COUNT - 1 ;
+static const uint32_t BLOCK_MASK = (1U << (32 - ACAN_STM32_TimerWheel::SLOT_COUNT_BITS)) - 1 ;
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_TimerWheel::ACAN_STM32_TimerWheel (void) :
+mSlots (),
+mNextTick (0),
+mCount (0) {
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_TimerWheel::reset (const uint32_t inTick) {
+  for (uint32_t i = 0 ; i < 2 * SLOT_COUNT ; i++) {
+    ACAN_STM32_TimerNode * node = mSlots [i] ;
+    while (node != nullptr) {
+      ACAN_STM32_TimerNode * next = node->mNext ;
+      node->mNext = nullptr ;
+      node->mPrevious = nullptr ;
+      node->mScheduled = false ;
+      node = next ;
+    }
+    mSlots [i] = nullptr ;
+  }
+  mNextTick = inTick ;
+  mCount = 0 ;
+}
+
+//------------------------------------------------------------------------------
+// Slot selection, relative to mNextTick (the next tick to be processed):
+//   - expiry less than 64 ticks ahead: level 0 slot of expiry tick, visited in
+//     order from mNextTick;
+//   - expiry in one of the next 63 blocks of 64 ticks: level 1 slot of expiry
+//     block, cascaded at the first tick of the block;
+//   - farther: level 1 slot cascaded last, the node is re-inserted from there.
+
+void ACAN_STM32_TimerWheel::link (ACAN_STM32_TimerNode & ioNode) {
+  if (int32_t (ioNode.mExpiryTick - mNextTick) < 0) {
+    ioNode.mExpiryTick = mNextTick ;
+  }
+  const uint32_t expiry = ioNode.mExpiryTick ;
+  const uint32_t blockDelta = ((expiry >> SLOT_COUNT_BITS) - (mNextTick >> SLOT_COUNT_BITS)) & BLOCK_MASK ;
+  uint32_t slot ;
+  if ((expiry - mNextTick) < SLOT_COUNT) {
+    slot = expiry & SLOT_MASK ;
+  }else if (blockDelta < SLOT_COUNT) {
+    slot = SLOT_COUNT + ((expiry >> SLOT_COUNT_BITS) & SLOT_MASK) ;
+  }else{
+    slot = SLOT_COUNT + (((mNextTick >> SLOT_COUNT_BITS) + SLOT_COUNT - 1) & SLOT_MASK) ;
+  }
+  ioNode.mSlot = uint8_t (slot) ;
+  ioNode.mPrevious = nullptr ;
+  ioNode.mNext = mSlots [slot] ;
+  if (ioNode.mNext != nullptr) {
+    ioNode.mNext->mPrevious = & ioNode ;
+  }
+  mSlots [slot] = & ioNode ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_TimerWheel::unlink (ACAN_STM32_TimerNode & ioNode) {
+  if (ioNode.mPrevious == nullptr) {
+    mSlots [ioNode.mSlot] = ioNode.mNext ;
+  }else{
+    ioNode.mPrevious->mNext = ioNode.mNext ;
+  }
+  if (ioNode.mNext != nullptr) {
+    ioNode.mNext->mPrevious = ioNode.mPrevious ;
+  }
+  ioNode.mNext = nullptr ;
+  ioNode.mPrevious = nullptr ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_TimerWheel::insert (ACAN_STM32_TimerNode & ioNode, const uint32_t inExpiryTick) {
+  if (ioNode.mScheduled) {
+    unlink (ioNode) ;
+  }else{
+    ioNode.mScheduled = true ;
+    mCount += 1 ;
+  }
+  ioNode.mExpiryTick = inExpiryTick ;
+  link (ioNode) ;
+}
+
+//------------------------------------------------------------------------------
+
+void ACAN_STM32_TimerWheel::remove (ACAN_STM32_TimerNode & ioNode) {
+  if (ioNode.mScheduled) {
+    unlink (ioNode) ;
+    ioNode.mScheduled = false ;
+    mCount -= 1 ;
+  }
+}
+
+//------------------------------------------------------------------------------
+
+ACAN_STM32_TimerNode * ACAN_STM32_TimerWheel::advance (const uint32_t inTick) {
+  ACAN_STM32_TimerNode * expiredHead = nullptr ;
+  ACAN_STM32_TimerNode * expiredTail = nullptr ;
+  while ((mCount > 0) && (int32_t (inTick - mNextTick) >= 0)) {
+    const uint32_t tick = mNextTick ;
+  //--- First tick of a block: cascade level 1 slot of the block
+    if ((tick & SLOT_MASK) == 0) {
+      const uint32_t slot = SLOT_COUNT + ((tick >> SLOT_COUNT_BITS) & SLOT_MASK) ;
+      ACAN_STM32_TimerNode * node = mSlots [slot] ;
+      mSlots [slot] = nullptr ;
+      while (node != nullptr) {
+        ACAN_STM32_TimerNode * next = node->mNext ;
+        link (*node) ;
+        node = next ;
+      }
+    }
+  //--- Level 0 slot of the tick: every node expires
+    const uint32_t slot = tick & SLOT_MASK ;
+    ACAN_STM32_TimerNode * node = mSlots [slot] ;
+    mSlots [slot] = nullptr ;
+    while (node != nullptr) {
+      ACAN_STM32_TimerNode * next = node->mNext ;
+      node->mScheduled = false ;
+      node->mPrevious = nullptr ;
+      node->mNext = nullptr ;
+      node->mNextExpired = nullptr ;
+      mCount -= 1 ;
+      if (expiredTail == nullptr) {
+        expiredHead = node ;
+      }else{
+        expiredTail->mNextExpired = node ;
+      }
+      expiredTail = node ;
+      node = next ;
+    }
+    mNextTick = tick + 1 ;
+  }
+//--- Empty wheel: nothing to process
+  if (int32_t (inTick - mNextTick) >= 0) {
+    mNextTick = inTick + 1 ;
+  }
+  return expiredHead ;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,102 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Hierarchical timer wheel, with intrusive nodes
+//
+// Time is counted in ticks (the user defines the tick duration, for example
+// one millisecond). The wheel has two levels of 64 slots:
+//   - level 0: one slot per tick, for expiries less than 64 ticks ahead;
+//   - level 1: one slot per 64 ticks, for expiries up to 4095 ticks ahead.
+// Farther expiries are parked in the last level 1 slot, and are re-inserted
+// when it is cascaded. Insertion and removal are O(1); advancing the wheel is
+// O(1) per tick, plus the cost of the expired nodes (and, every 64 ticks, of
+// the nodes cascaded from level 1 to level 0).
+//
+// Nodes are owned by the user (no allocation): a timer client derives from
+// ACAN_STM32_TimerNode, and a node is linked in at most one wheel.
+// Tick dates are compared modulo 2^32, so the tick counter can wrap around.
+//
+// The wheel is not protected against concurrent access: use it from a single
+// execution context.
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_TimerNode {
+
+//--- Constructor
+  public: ACAN_STM32_TimerNode (void) { }
+
+//--- Access
+  public: inline bool isScheduled (void) const { return mScheduled ; }
+  public: inline uint32_t expiryTick (void) const { return mExpiryTick ; }
+  public: inline ACAN_STM32_TimerNode * nextExpired (void) const { return mNextExpired ; }
+
+//--- Properties, handled by ACAN_STM32_TimerWheel: slot list links, and expired
+//    list link (only written by advance)
+  private: ACAN_STM32_TimerNode * mNext = nullptr ;
+  private: ACAN_STM32_TimerNode * mNextExpired = nullptr ;
+  private: ACAN_STM32_TimerNode * mPrevious = nullptr ;
+  private: uint32_t mExpiryTick = 0 ;
+  private: uint8_t mSlot = 0 ;
+  private: bool mScheduled = false ;
+
+  friend class ACAN_STM32_TimerWheel ;
+
+//--- No copy
+  private : ACAN_STM32_TimerNode (const ACAN_STM32_TimerNode &) = delete ;
+  private : ACAN_STM32_TimerNode & operator = (const ACAN_STM32_TimerNode &) = delete ;
+} ;
+
+//------------------------------------------------------------------------------
+
+class ACAN_STM32_TimerWheel {
+
+//--- Geometry
+  public: static const uint32_t SLOT_COUNT_BITS = 6 ;
+  public: static const uint32_t SLOT_COUNT = 1 << SLOT_COUNT_BITS ; // Per level
+  public: static const uint32_t MAX_DIRECT_DELAY = SLOT_COUNT * SLOT_COUNT - 1 ; // In ticks
+
+//--- Constructor
+  public: ACAN_STM32_TimerWheel (void) ;
+
+//--- Restart at inTick; every scheduled node is unlinked
+  public: void reset (const uint32_t inTick) ;
+
+//--- Next tick to be processed by advance
+  public: inline uint32_t tick (void) const { return mNextTick ; }
+
+//--- Number of scheduled nodes
+  public: inline uint32_t count (void) const { return mCount ; }
+
+//--- Schedule ioNode at inExpiryTick; an expiry tick before tick () expires at
+//    tick (). A node already scheduled is moved.
+  public: void insert (ACAN_STM32_TimerNode & ioNode, const uint32_t inExpiryTick) ;
+
+//--- Unschedule ioNode (no operation if it is not scheduled)
+  public: void remove (ACAN_STM32_TimerNode & ioNode) ;
+
+//--- Process ticks from tick () to inTick (included); returns the expired nodes
+//    (unscheduled, in expiry order), linked with ACAN_STM32_TimerNode::nextExpired.
+//    This link is not used by the slots: while the list is walked, any node (also
+//    one not walked yet) can be inserted or removed; a node of the list that is
+//    scheduled again is still in the list (check isScheduled).
+  public: ACAN_STM32_TimerNode * advance (const uint32_t inTick) ;
+
+//--- Private methods
+  private: void link (ACAN_STM32_TimerNode & ioNode) ;
+  private: void unlink (ACAN_STM32_TimerNode & ioNode) ;
+
+//--- Private properties: slots 0 ... 63 are level 0, slots 64 ... 127 level 1
+  private: ACAN_STM32_TimerNode * mSlots [2 * SLOT_COUNT] ;
+  private: uint32_t mNextTick ;
+  private: uint32_t mCount ;
+
+//--- No copy
+  private : ACAN_STM32_TimerWheel (const ACAN_STM32_TimerWheel &) = delete ;
+  private : ACAN_STM32_TimerWheel & operator = (const ACAN_STM32_TimerWheel &) = delete ;
+} ;
+
+//------------------------------------------------------------------------------